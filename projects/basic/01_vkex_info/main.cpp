@@ -263,6 +263,7 @@ void VkexInfoApp::Present(vkex::Application::PresentData* p_data)
 
       // Application Info
       this->DrawDebugApplicationInfo();
+      this->DrawDebugMemoryStats();
       this->DrawImGui(cmd);
     }
     cmd->CmdEndRenderPass();
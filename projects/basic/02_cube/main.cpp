@@ -17,7 +17,9 @@
 #include "common/AssetUtil.h"
 #include "shaders/Common.h"
 #include "common/DebugUi.h"
+#include "common/TextureStreamer.h"
 #include "vkex/Application.h"
+#include "vkex/BufferHeap.h"
 
 #if defined(VKEX_GGP)
 const uint32_t k_window_width  = 1920;
@@ -36,7 +38,9 @@ using ViewConstants = vkex::ConstantBufferData<vkex::ViewConstantsData>;
 struct PerFrameData
 {
   vkex::DescriptorSet descriptor_set  = nullptr;
-  vkex::Buffer        constant_buffer = nullptr;
+  vkex::BufferRange   constants       = {};
+  // Texture descriptor still points at the placeholder
+  bool                texture_dirty   = false;
 };
 
 class VkexInfoApp : public vkex::Application {
@@ -50,7 +54,8 @@ public:
 
   void Configure(const vkex::ArgParser& args, vkex::Configuration& configuration);
   void Setup();
-  void Update(double frame_elapsed_time) {}
+  void Destroy();
+  void Update(double frame_elapsed_time);
   void Render(vkex::Application::RenderData* p_data);
   void Present(vkex::Application::PresentData* p_data);
 
@@ -62,9 +67,13 @@ private:
   vkex::PipelineLayout      m_color_pipeline_layout = nullptr;
   vkex::GraphicsPipeline    m_color_pipeline        = nullptr;
   ViewConstants             m_view_constants        = {};
-  vkex::Buffer              m_vertex_buffer         = nullptr;
-  vkex::Texture             m_texture               = nullptr;
+  vkex::BufferHeap          m_buffer_heap;
+  vkex::BufferRange         m_vertex_buffer         = {};
   vkex::Sampler             m_sampler               = nullptr;
+
+  std::unique_ptr<vkex::ThreadPool>             m_thread_pool;
+  std::unique_ptr<asset_util::TextureStreamer>  m_texture_streamer;
+  asset_util::TextureStreamer::Handle           m_texture_handle = asset_util::TextureStreamer::kInvalidHandle;
 };
 
 void VkexInfoApp::Configure(const vkex::ArgParser& args, vkex::Configuration& configuration)
@@ -140,29 +149,30 @@ void VkexInfoApp::Setup()
     VKEX_CALL(GetDevice()->CreateGraphicsPipeline(create_info, &m_color_pipeline));
   }
 
+  // Buffer heap, the vertex data and all constants share one buffer
+  {
+    vkex::BufferHeapCreateInfo create_info          = {};
+    create_info.usage_flags.bits.vertex_buffer      = true;
+    create_info.usage_flags.bits.uniform_buffer     = true;
+    create_info.memory_usage                        = VMA_MEMORY_USAGE_CPU_TO_GPU;
+    VKEX_CALL(m_buffer_heap.Initialize(GetDevice(), create_info));
+  }
+
   // Vertex buffer
   {
-    size_t size                         = p_vertex_buffer_cpu->GetDataSize();
-    vkex::BufferCreateInfo create_info  = {};
-    create_info.size                    = size;
-    create_info.committed               = true;
-    create_info.memory_usage            = VMA_MEMORY_USAGE_CPU_TO_GPU;
-    VKEX_CALL(GetDevice()->CreateVertexBuffer(create_info, &m_vertex_buffer));
-    VKEX_CALL(
-      m_vertex_buffer->Copy(p_vertex_buffer_cpu->GetDataSize(), p_vertex_buffer_cpu->GetData()));
+    size_t size = p_vertex_buffer_cpu->GetDataSize();
+    VKEX_CALL(m_buffer_heap.Allocate(size, &m_vertex_buffer));
+    VKEX_CALL(m_vertex_buffer.Write(0, size, p_vertex_buffer_cpu->GetData()));
   }
 
-  // Texture
+  // Texture, streamed in the background. The cube shows the placeholder
+  // until it's resident.
   {
-    const bool host_visible = false;
-
-    // Load file data
-    auto image_file_path = GetAssetPath("textures/box_panel.jpg");
-    VKEX_CALL(asset_util::CreateTexture(
-      image_file_path,
-      GetGraphicsQueue(),
-      host_visible,
-      &m_texture));
+    m_thread_pool      = std::make_unique<vkex::ThreadPool>();
+    m_texture_streamer = std::make_unique<asset_util::TextureStreamer>(this, m_thread_pool.get());
+    VKEX_CALL(m_texture_streamer->Initialize());
+
+    m_texture_handle = m_texture_streamer->Request(GetAssetPath("textures/box_panel.jpg"));
   }
 
   // Sampler
@@ -191,25 +201,42 @@ void VkexInfoApp::Setup()
         VKEX_CALL(m_color_descriptor_pool->AllocateDescriptorSets(allocate_info, &per_frame_data.descriptor_set));
       }
 
-      // Constant buffer
+      // Constants
       {
-        vkex::BufferCreateInfo create_info = {};
-        create_info.size                   = m_view_constants.size;
-        create_info.committed              = true;
-        create_info.memory_usage           = VMA_MEMORY_USAGE_CPU_TO_GPU;
-        VKEX_CALL(GetDevice()->CreateConstantBuffer(create_info, &per_frame_data.constant_buffer));
+        VKEX_CALL(m_buffer_heap.Allocate(m_view_constants.size, &per_frame_data.constants));
       }
 
       // Update descriptors
       {
-        per_frame_data.descriptor_set->UpdateDescriptor(VKEX_SHADER_CONSTANTS_BASE_REGISTER, per_frame_data.constant_buffer);
-        per_frame_data.descriptor_set->UpdateDescriptor(VKEX_SHADER_TEXTURE_BASE_REGISTER, m_texture);
+        const vkex::BufferRange& constants = per_frame_data.constants;
+        per_frame_data.descriptor_set->UpdateDescriptor(VKEX_SHADER_CONSTANTS_BASE_REGISTER, constants.buffer, constants.offset, m_view_constants.size);
+        per_frame_data.descriptor_set->UpdateDescriptor(VKEX_SHADER_TEXTURE_BASE_REGISTER, m_texture_streamer->GetTexture(m_texture_handle));
         per_frame_data.descriptor_set->UpdateDescriptor(VKEX_SHADER_SAMPLER_BASE_REGISTER, m_sampler);
       }
     }
   }
 }
 
+void VkexInfoApp::Destroy()
+{
+  // Textures are destroyed while the device is still around
+  m_texture_streamer.reset();
+  m_thread_pool.reset();
+}
+
+void VkexInfoApp::Update(double frame_elapsed_time)
+{
+  std::vector<asset_util::TextureStreamer::Handle> resident;
+  VKEX_CALL(m_texture_streamer->Update(&resident));
+  if (!resident.empty()) {
+    // Frames in flight keep sampling the placeholder, each descriptor set
+    // is rewritten when its frame comes around again.
+    for (auto& per_frame_data : m_per_frame_data) {
+      per_frame_data.texture_dirty = true;
+    }
+  }
+}
+
 void VkexInfoApp::Render(vkex::Application::RenderData* p_data)
 {
 }
@@ -220,6 +247,12 @@ void VkexInfoApp::Present(vkex::Application::PresentData* p_data)
   uint32_t frame_index = p_data->GetFrameIndex();
   PerFrameData& frame_data = m_per_frame_data[frame_index];
 
+  // Swap in the streamed texture
+  if (frame_data.texture_dirty) {
+    frame_data.descriptor_set->UpdateDescriptor(VKEX_SHADER_TEXTURE_BASE_REGISTER, m_texture_streamer->GetTexture(m_texture_handle));
+    frame_data.texture_dirty = false;
+  }
+
   // Update constant buffer
   {
     float3            eye    = float3(0, 1, 2);
@@ -240,7 +273,7 @@ void VkexInfoApp::Present(vkex::Application::PresentData* p_data)
     m_view_constants.data.N   = glm::inverseTranspose(float3x3(M));
     m_view_constants.data.LP  = float3(0, 3, 5);
     
-    VKEX_CALL(frame_data.constant_buffer->Copy(m_view_constants.size, &m_view_constants.data));
+    VKEX_CALL(frame_data.constants.Write(0, m_view_constants.size, &m_view_constants.data));
   }
 
   // Build command buffer
@@ -259,11 +292,12 @@ void VkexInfoApp::Present(vkex::Application::PresentData* p_data)
       cmd->CmdSetScissor(render_pass->GetFullRenderArea());
       cmd->CmdBindPipeline(m_color_pipeline);
       cmd->CmdBindDescriptorSets(VK_PIPELINE_BIND_POINT_GRAPHICS, *m_color_pipeline_layout, 0, {*frame_data.descriptor_set});
-      cmd->CmdBindVertexBuffers(m_vertex_buffer);
+      cmd->CmdBindVertexBuffers(m_vertex_buffer.buffer, m_vertex_buffer.offset);
       cmd->CmdDraw(36, 1, 0, 0);  
 
       // Application Info
       this->DrawDebugApplicationInfo();
+      this->DrawDebugMemoryStats();
       this->DrawImGui(cmd);
     }
     cmd->CmdEndRenderPass();
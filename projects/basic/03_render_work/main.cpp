@@ -17,6 +17,7 @@
 #include "common/AssetUtil.h"
 #include "shaders/Common.h"
 #include "common/DebugUi.h"
+#include "common/MipGenerator.h"
 #include "common/SimpleRenderPass.h"
 #include "vkex/Application.h"
 
@@ -45,7 +46,6 @@ struct PerFrameData
   vkex::Fence         work_complete_fence     = nullptr;
   SimpleRenderPass    draw_render_pass        = {};
   vkex::DescriptorSet descriptor_set          = nullptr;
-  vkex::Buffer        constant_buffer         = nullptr;
 };
 
 class VkexInfoApp : public vkex::Application
@@ -61,9 +61,8 @@ public:
 
   void Configure(const vkex::ArgParser& args, vkex::Configuration& configuration);
   void Setup();
-  void Update(double frame_elapsed_time)
-  {
-  }
+  void Destroy();
+  void Update(double frame_elapsed_time);
   void Render(Application::RenderData* p_current_render_data, Application::PresentData* p_current_present_data);
   void Present(vkex::Application::PresentData* p_current_present_data);
 
@@ -76,10 +75,11 @@ private:
   vkex::DescriptorPool      m_descriptor_pool       = nullptr;
   vkex::PipelineLayout      m_color_pipeline_layout = nullptr;
   vkex::GraphicsPipeline    m_color_pipeline        = nullptr;
-  ViewConstants             m_view_constants        = {};
   vkex::Buffer              m_vertex_buffer         = nullptr;
   vkex::Texture             m_texture               = nullptr;
   vkex::Sampler             m_sampler               = nullptr;
+
+  std::unique_ptr<asset_util::MipGenerator> m_mip_generator;
 };
 
 void VkexInfoApp::Configure(const vkex::ArgParser& args, vkex::Configuration& configuration)
@@ -150,18 +150,11 @@ void VkexInfoApp::SetupPerFrameObjects()
       VKEX_CALL(m_descriptor_pool->AllocateDescriptorSets(allocate_info, &per_frame_data.descriptor_set));
     }
 
-    // Constant buffer
+    // Update descriptors, constants come from the frame's constant
+    // allocator through a dynamic offset
     {
-      vkex::BufferCreateInfo create_info = {};
-      create_info.size                   = m_view_constants.size;
-      create_info.committed              = true;
-      create_info.memory_usage           = VMA_MEMORY_USAGE_CPU_TO_GPU;
-      VKEX_CALL(GetDevice()->CreateConstantBuffer(create_info, &per_frame_data.constant_buffer));
-    }
-
-    // Update descriptors
-    {
-      per_frame_data.descriptor_set->UpdateDescriptor(VKEX_SHADER_CONSTANTS_BASE_REGISTER, per_frame_data.constant_buffer);
+      vkex::Buffer constant_buffer = GetRenderData(frame_index)->GetConstantAllocator()->GetBuffer();
+      per_frame_data.descriptor_set->UpdateDescriptor(VKEX_SHADER_CONSTANTS_BASE_REGISTER, constant_buffer, 0, ViewConstants::size);
       per_frame_data.descriptor_set->UpdateDescriptor(VKEX_SHADER_TEXTURE_BASE_REGISTER, m_texture);
       per_frame_data.descriptor_set->UpdateDescriptor(VKEX_SHADER_SAMPLER_BASE_REGISTER, m_sampler);
     }
@@ -190,6 +183,7 @@ void VkexInfoApp::Setup()
   {
     const vkex::ShaderInterface&        shader_interface = m_color_shader->GetInterface();
     vkex::DescriptorSetLayoutCreateInfo create_info      = ToVkexCreateInfo(shader_interface.GetSet(0));
+    VKEX_CALL(vkex::SetDynamicBinding(VKEX_SHADER_CONSTANTS_BASE_REGISTER, &create_info));
     VKEX_CALL(GetDevice()->CreateDescriptorSetLayout(create_info, &m_descriptor_set_layout));
   }
 
@@ -200,6 +194,8 @@ void VkexInfoApp::Setup()
     const vkex::ShaderInterface&   shader_interface = m_color_shader->GetInterface();
     vkex::DescriptorPoolCreateInfo create_info      = {};
     create_info.pool_sizes                          = frame_count * shader_interface.GetDescriptorPoolSizes();
+    create_info.pool_sizes.uniform_buffer_dynamic   = create_info.pool_sizes.uniform_buffer;
+    create_info.pool_sizes.uniform_buffer           = 0;
     VKEX_CALL(GetDevice()->CreateDescriptorPool(create_info, &m_descriptor_pool));
   }
 
@@ -241,7 +237,16 @@ void VkexInfoApp::Setup()
       m_vertex_buffer->Copy(p_vertex_buffer_cpu->GetDataSize(), p_vertex_buffer_cpu->GetData()));
   }
 
-  // Texture
+  // MIP generator, falls back to the compute shader for formats that
+  // can't be blitted
+  {
+    m_mip_generator.reset(new asset_util::MipGenerator(GetDevice()));
+    auto cs = asset_util::LoadFile(GetAssetPath("shaders/GenerateMips.cs.spv"));
+    VKEX_ASSERT_MSG(!cs.empty(), "Compute shader failed to load!");
+    VKEX_CALL(m_mip_generator->Initialize(cs));
+  }
+
+  // Texture, only level 0 is decoded and the rest are generated on the GPU
   {
     const bool host_visible = false;
 
@@ -251,7 +256,10 @@ void VkexInfoApp::Setup()
       image_file_path,
       GetGraphicsQueue(),
       host_visible,
-      &m_texture));
+      &m_texture,
+      VK_FORMAT_UNDEFINED,
+      nullptr,
+      m_mip_generator.get()));
   }
 
   // Sampler
@@ -269,6 +277,18 @@ void VkexInfoApp::Setup()
   SetupPerFrameObjects();
 }
 
+void VkexInfoApp::Destroy()
+{
+  // Waits for the device and destroys what's left of the generator's views
+  m_mip_generator.reset();
+}
+
+void VkexInfoApp::Update(double frame_elapsed_time)
+{
+  // Views and descriptor sets of finished MIP generation are freed here
+  VKEX_CALL(m_mip_generator->Collect());
+}
+
 void VkexInfoApp::Render(Application::RenderData* p_current_render_data, Application::PresentData* p_current_present_data)
 {
   const uint32_t frame_index         = GetCurrentFrameIndex();
@@ -278,7 +298,8 @@ void VkexInfoApp::Render(Application::RenderData* p_current_render_data, Applica
   VkResult vk_result = work_complete_fence->WaitForAndResetFence();
   VKEX_ASSERT(vk_result == VK_SUCCESS);
 
-  // Update constant buffer
+  // Update constants
+  uint32_t view_constants_offset = 0;
   {
     float3            eye    = float3(0, 1, 2);
     float3            center = float3(0, 0, 0);
@@ -291,14 +312,14 @@ void VkexInfoApp::Render(Application::RenderData* p_current_render_data, Applica
     float4x4 V = camera.GetViewMatrix();
     float4x4 P = camera.GetProjectionMatrix();
 
-    m_view_constants.data.M   = M;
-    m_view_constants.data.V   = V;
-    m_view_constants.data.P   = P;
-    m_view_constants.data.MVP = P * V * M;
-    m_view_constants.data.N   = glm::inverseTranspose(float3x3(M));
-    m_view_constants.data.LP  = float3(0, 3, 5);
-
-    VKEX_CALL(per_frame_data.constant_buffer->Copy(m_view_constants.size, &m_view_constants.data));
+    vkex::ViewConstantsData* p_view_constants = p_current_render_data->GetConstantAllocator()->Allocate<vkex::ViewConstantsData>(&view_constants_offset);
+    VKEX_ASSERT(p_view_constants != nullptr);
+    p_view_constants->M   = M;
+    p_view_constants->V   = V;
+    p_view_constants->P   = P;
+    p_view_constants->MVP = P * V * M;
+    p_view_constants->N   = glm::inverseTranspose(float3x3(M));
+    p_view_constants->LP  = float3(0, 3, 5);
   }
 
   // Build render work command buffer
@@ -318,7 +339,8 @@ void VkexInfoApp::Render(Application::RenderData* p_current_render_data, Applica
       cmd->CmdSetViewport(render_pass->GetFullRenderArea());
       cmd->CmdSetScissor(render_pass->GetFullRenderArea());
       cmd->CmdBindPipeline(m_color_pipeline);
-      cmd->CmdBindDescriptorSets(VK_PIPELINE_BIND_POINT_GRAPHICS, *m_color_pipeline_layout, 0, {*descriptor_set});
+      std::vector<uint32_t> dynamic_offsets = {view_constants_offset};
+      cmd->CmdBindDescriptorSets(VK_PIPELINE_BIND_POINT_GRAPHICS, *m_color_pipeline_layout, 0, {*descriptor_set}, &dynamic_offsets);
       cmd->CmdBindVertexBuffers(m_vertex_buffer);
       cmd->CmdDraw(36, 1, 0, 0);
     }
@@ -328,6 +350,8 @@ void VkexInfoApp::Render(Application::RenderData* p_current_render_data, Applica
 
   // Submit render work
   {
+    VKEX_CALL(p_current_render_data->GetConstantAllocator()->Flush());
+
     vkex::SubmitInfo submit_info = {};
 
     if (p_current_present_data->GetPrevious() != nullptr) {
@@ -368,7 +392,7 @@ void VkexInfoApp::Present(vkex::Application::PresentData* p_data)
 
       cmd->CmdTransitionImageLayout(
         render_pass->GetRtvs()[0]->GetColorImageView()->GetImage(),
-        VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
+        GetPresentLayout(),
         VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
         VK_PIPELINE_STAGE_TRANSFER_BIT);
 
@@ -389,7 +413,7 @@ void VkexInfoApp::Present(vkex::Application::PresentData* p_data)
       cmd->CmdTransitionImageLayout(
         render_pass->GetRtvs()[0]->GetColorImageView()->GetImage(),
         VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-        VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
+        GetPresentLayout(),
         VK_PIPELINE_STAGE_PRESENT_BIT);
     }
 
@@ -400,6 +424,7 @@ void VkexInfoApp::Present(vkex::Application::PresentData* p_data)
     cmd->CmdBeginRenderPass(render_pass, &clear_values);
     {
       this->DrawDebugApplicationInfo();
+      this->DrawDebugMemoryStats();
       this->DrawImGui(cmd);
     }
     cmd->CmdEndRenderPass();
@@ -15,6 +15,7 @@
 */
 
 #include "AssetUtil.h"
+#include "MipGenerator.h"
 
 namespace asset_util {
 
@@ -35,53 +36,84 @@ vkex::Result CreateTexture(
   const vkex::fs::path& image_file_path,
   vkex::Queue           queue,
   bool                  host_visible,
-  vkex::Texture*        p_texture)
+  vkex::Texture*        p_texture,
+  VkFormat              compressed_format,
+  vkex::ThreadPool*     p_thread_pool,
+  MipGenerator*         p_mip_generator)
 {
-  VKEX_ASSERT_MSG(queue != nullptr, "Queue is null");
-  VKEX_ASSERT_MSG(p_texture != nullptr, "Target texture object is null");
-
-  vkex::Device device = queue->GetDevice();
+  if (image_file_path.extension() == vkex::fs::path(".mip")) {
+    MIPMappedFile mapped_file;
+    if (!mapped_file.Open(image_file_path.c_str())) {
+      // Chunked files can't be mapped, decompress them instead
+      std::unique_ptr<vkex::Bitmap> bitmap;
+      vkex::Result vkex_result = vkex::Bitmap::CreateFromMIPFile(image_file_path, 0, UINT32_MAX, &bitmap, p_thread_pool);
+      if (!vkex_result) {
+        VKEX_LOG_ERROR("Invalid MIP file: " << image_file_path);
+        return vkex_result;
+      }
+      return CreateTexture(*bitmap, queue, host_visible, p_texture, p_mip_generator);
+    }
+    vkex::Bitmap bitmap(mapped_file);
+    if (!bitmap.IsValid()) {
+      VKEX_LOG_ERROR("Invalid MIP file: " << image_file_path);
+      return vkex::Result::ErrorImageLoadFailed;
+    }
+    return CreateTexture(bitmap, queue, host_visible, p_texture, p_mip_generator);
+  }
 
   // Load file data
   auto file_data = LoadFile(image_file_path);
   VKEX_ASSERT_MSG(!file_data.empty(), "Texture failed to load!");
 
-  // Load bitmap
+  // Load bitmap, compression needs the whole MIP chain up front
+  bool gpu_mips = (p_mip_generator != nullptr) && (compressed_format == VK_FORMAT_UNDEFINED);
   std::unique_ptr<vkex::Bitmap> bitmap;
   VKEX_CALL(vkex::Bitmap::Create(
     file_data.size(),
     file_data.data(),
-    0,
-    &bitmap));
+    gpu_mips ? 1 : 0,
+    &bitmap,
+    vkex::Bitmap::MipFilterBox,
+    p_thread_pool));
 
-  // Create staging buffer and copy bitmap
-  vkex::Buffer cpu_buffer = nullptr;
-  {
-    uint64_t data_size = bitmap->GetDataSizeAllLevels();
-
-    vkex::BufferCreateInfo create_info        = {};
-    create_info.size                          = data_size;
-    create_info.usage_flags.bits.transfer_src = true;
-    create_info.committed                     = true;
-    create_info.memory_usage                  = VMA_MEMORY_USAGE_CPU_TO_GPU;
-    VKEX_CALL(device->CreateStorageBuffer(create_info, &cpu_buffer));
-
-    void* address = nullptr;
-    VkResult vk_result = cpu_buffer->MapMemory(&address);
-    VKEX_ASSERT(vk_result == VK_SUCCESS);
-    memcpy(address, bitmap->GetData(), data_size);
-    cpu_buffer->UnmapMemory();
+  if (compressed_format != VK_FORMAT_UNDEFINED) {
+    std::unique_ptr<vkex::Bitmap> compressed;
+    VKEX_CALL(vkex::Bitmap::Compress(*bitmap, compressed_format, p_thread_pool, &compressed));
+    bitmap = std::move(compressed);
+  }
+
+  return CreateTexture(*bitmap, queue, host_visible, p_texture, p_mip_generator);
+}
+
+// Creates the texture and adds its upload to transfer_batch. The bitmap
+// must stay valid until the batch is submitted. If p_mip_generator is set
+// levels past the ones in the bitmap are generated on the GPU, and
+// p_mip_id receives the id to pass to MipGenerator::Track() or Discard().
+static vkex::Result RecordTexture(
+  const vkex::Bitmap&   bitmap,
+  vkex::Device          device,
+  bool                  host_visible,
+  vkex::Texture*        p_texture,
+  vkex::TransferBatch*  p_transfer_batch,
+  MipGenerator*         p_mip_generator = nullptr,
+  uint64_t*             p_mip_id        = nullptr)
+{
+  uint32_t mip_levels = bitmap.GetMipLevels();
+  if (p_mip_generator != nullptr) {
+    vkex::Bitmap::CalculateMipLevelCount(bitmap.GetWidth(), bitmap.GetHeight(), &mip_levels);
   }
 
- 
   // Create image
   {
     vkex::TextureCreateInfo create_info             = {};
     create_info.image.image_type                    = VK_IMAGE_TYPE_2D;
-    create_info.image.format                        = bitmap->GetFormat();
-    create_info.image.extent                        = bitmap->GetExtent();
-    create_info.image.mip_levels                    = bitmap->GetMipLevels();
+    create_info.image.format                        = bitmap.GetFormat();
+    create_info.image.extent                        = bitmap.GetExtent();
+    create_info.image.mip_levels                    = mip_levels;
     create_info.image.tiling                        = VK_IMAGE_TILING_OPTIMAL;
+    if (p_mip_generator != nullptr) {
+      create_info.image.usage_flags                 = p_mip_generator->GetRequiredUsage(bitmap.GetFormat());
+    }
     create_info.image.usage_flags.bits.transfer_dst = true;
     create_info.image.initial_layout                = VK_IMAGE_LAYOUT_UNDEFINED;
     create_info.image.committed                     = true;
@@ -90,23 +122,27 @@ vkex::Result CreateTexture(
     VKEX_CALL(device->CreateTexture(create_info, p_texture));
   }
 
-  // Transition from VK_IMAGE_LAYOUT_PREINITIALIZED to VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL
-  // for VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT.
-  VKEX_CALL(vkex::TransitionImageLayout(
-    queue,
+  // Transition from VK_IMAGE_LAYOUT_UNDEFINED to VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL
+  p_transfer_batch->TransitionImageLayout(
     (*p_texture)->GetImage(),
     VK_IMAGE_LAYOUT_UNDEFINED,
     VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-    VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT));
+    VK_PIPELINE_STAGE_TRANSFER_BIT);
 
   std::vector<VkBufferImageCopy> regions;
-  for (uint32_t level = 0; level < bitmap->GetMipLevels(); ++level) {
+  for (uint32_t level = 0; level < bitmap.GetMipLevels(); ++level) {
     vkex::Bitmap::Mip mip = {};
-    bitmap->GetMipLayout(level, &mip);
+    bitmap.GetMipLayout(level, &mip);
     VkBufferImageCopy region               = {};
+    // Row length and image height are in texels, for block compressed
+    // formats they're rounded up to whole blocks.
+    uint32_t block_width  = vkex::FormatBlockWidth(bitmap.GetFormat());
+    uint32_t block_height = vkex::FormatBlockHeight(bitmap.GetFormat());
+    uint32_t block_size   = vkex::FormatBlockSize(bitmap.GetFormat());
+    uint32_t row_count    = (mip.height + block_height - 1) / block_height;
     region.bufferOffset                    = mip.data_offset;
-    region.bufferRowLength                 = mip.width;
-    region.bufferImageHeight               = mip.height;
+    region.bufferRowLength                 = (mip.row_stride / block_size) * block_width;
+    region.bufferImageHeight               = row_count * block_height;
     region.imageSubresource.aspectMask     = VK_IMAGE_ASPECT_COLOR_BIT;
     region.imageSubresource.mipLevel       = level;
     region.imageSubresource.baseArrayLayer = 0;
@@ -120,24 +156,160 @@ vkex::Result CreateTexture(
     regions.push_back(region);
   }
 
-  vkex::CopyResource(
-    queue,
-    cpu_buffer,
+  // Bitmap data is copied straight into the staging ring on submit
+  p_transfer_batch->CopyToImage(
+    bitmap.GetDataSizeAllLevels(),
+    bitmap.GetData(),
     (*p_texture)->GetImage(),
     vkex::CountU32(regions),
     vkex::DataPtr(regions));
 
-  // Transition from VK_IMAGE_LAYOUT_PREINITIALIZED to VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
-  // for VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT.
-  VKEX_CALL(vkex::TransitionImageLayout(
-    queue,
-    (*p_texture)->GetImage(),
-    VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-    VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
-    VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT)); 
+  // Generate the remaining levels, or transition from VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL
+  // to VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL for VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT.
+  if (p_mip_generator != nullptr) {
+    VKEX_ASSERT(p_mip_id != nullptr);
+    VKEX_CALL(p_mip_generator->Record(
+      (*p_texture)->GetImage(),
+      VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+      VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+      VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+      p_transfer_batch,
+      p_mip_id));
+  }
+  else {
+    p_transfer_batch->TransitionImageLayout(
+      (*p_texture)->GetImage(),
+      VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+      VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+      VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+  }
+
+  return vkex::Result::Success;
+}
+
+vkex::Result CreateTexture(
+  const vkex::Bitmap&   bitmap,
+  vkex::Queue           queue,
+  bool                  host_visible,
+  vkex::Texture*        p_texture,
+  MipGenerator*         p_mip_generator)
+{
+  VKEX_ASSERT_MSG(queue != nullptr, "Queue is null");
+  VKEX_ASSERT_MSG(p_texture != nullptr, "Target texture object is null");
+
+  // Only bitmaps without MIPs need generating
+  if ((p_mip_generator != nullptr) && (bitmap.GetMipLevels() > 1)) {
+    p_mip_generator = nullptr;
+  }
+
+  // Unsupported formats fall back to CPU MIPs, block compressed data
+  // can't be filtered so it's uploaded as is
+  std::unique_ptr<vkex::Bitmap> cpu_mips;
+  if ((p_mip_generator != nullptr) && !p_mip_generator->IsSupported(bitmap.GetFormat())) {
+    p_mip_generator = nullptr;
+    if (vkex::FormatBlockWidth(bitmap.GetFormat()) == 1) {
+      vkex::Bitmap::Mip mip = {};
+      bitmap.GetMipLayout(0, &mip);
+      cpu_mips = std::make_unique<vkex::Bitmap>(
+        bitmap.GetWidth(),
+        bitmap.GetHeight(),
+        bitmap.GetFormat(),
+        0,
+        bitmap.GetData(0),
+        mip.row_stride,
+        mip.height,
+        vkex::Bitmap::MipFilterBox);
+      if (!cpu_mips->IsValid()) {
+        return vkex::Result::ErrorImageLoadFailed;
+      }
+    }
+  }
+  const vkex::Bitmap& src_bitmap = cpu_mips ? *cpu_mips : bitmap;
+
+  // Transitions, copy and MIP generation go out in one submission, work
+  // submitted to the queue afterwards is ordered after it.
+  vkex::TransferBatch transfer_batch;
+  vkex::TransferToken token;
+  uint64_t            mip_id = 0;
+  VKEX_CALL(RecordTexture(src_bitmap, queue->GetDevice(), host_visible, p_texture, &transfer_batch, p_mip_generator, &mip_id));
+  vkex::Result vkex_result = transfer_batch.Submit(queue, &token);
+  if (p_mip_generator != nullptr) {
+    if (vkex_result) {
+      p_mip_generator->Track(mip_id, token);
+    }
+    else {
+      p_mip_generator->Discard(mip_id);
+    }
+  }
+  VKEX_CALL(vkex_result);
+
+  return vkex::Result::Success;
+}
+
+vkex::Result CreateTextureAsync(
+  const vkex::Bitmap&   bitmap,
+  vkex::Application*    p_application,
+  bool                  host_visible,
+  vkex::Texture*        p_texture,
+  vkex::TransferToken*  p_token)
+{
+  VKEX_ASSERT_MSG(p_application != nullptr, "Application is null");
+  VKEX_ASSERT_MSG(p_texture != nullptr, "Target texture object is null");
+
+  vkex::TransferBatch transfer_batch;
+  VKEX_CALL(RecordTexture(bitmap, p_application->GetDevice(), host_visible, p_texture, &transfer_batch));
+  VKEX_CALL(p_application->SubmitAsyncUpload(&transfer_batch, p_token));
+
+  return vkex::Result::Success;
+}
+
+vkex::Result CreateTextures(
+  const std::vector<vkex::fs::path>& image_file_paths,
+  vkex::Queue                        queue,
+  bool                               host_visible,
+  vkex::ThreadPool*                  p_thread_pool,
+  std::vector<vkex::Texture>*        p_textures,
+  uint64_t                           memory_ceiling)
+{
+  vkex::BitmapBatchLoader loader(p_thread_pool, memory_ceiling);
+
+  std::vector<std::future<vkex::BitmapBatchLoader::LoadResult>> futures;
+  for (size_t i = 0; i < image_file_paths.size(); ++i) {
+    vkex::BitmapBatchLoader::LoadRequest request = {};
+    request.file_path   = image_file_paths[i];
+    request.level_count = 0;
+    request.mip_filter  = vkex::Bitmap::MipFilterBox;
+    futures.push_back(loader.Load(static_cast<uint32_t>(i), request));
+  }
+
+  // Upload in order while the rest are still decoding, one submission
+  // per texture. Each Bitmap and its charge are dropped as soon as its
+  // upload has completed so decoded data stays under memory_ceiling.
+  std::vector<vkex::BitmapBatchLoader::LoadResult> timings;
+  p_textures->resize(image_file_paths.size(), nullptr);
+  for (size_t i = 0; i < futures.size(); ++i) {
+    vkex::BitmapBatchLoader::LoadResult result = futures[i].get();
+    vkex::Result vkex_result = result.result;
+    if (vkex_result != vkex::Result::Success) {
+      VKEX_LOG_ERROR("Texture failed to load: " << image_file_paths[i]);
+    }
+    else {
+      vkex_result = CreateTexture(*result.bitmap, queue, host_visible, &(*p_textures)[i]);
+    }
+
+    result.bitmap.reset();
+    result.charge.Release();
+    if (!vkex_result) {
+      // Unread results hold charges the remaining requests may wait on
+      futures.clear();
+      loader.WaitIdle();
+      return vkex_result;
+    }
+
+    timings.push_back(std::move(result));
+  }
 
-  // Destroy temp CPU buffer
-  VKEX_CALL(device->DestroyStorageBuffer(cpu_buffer));
+  vkex::BitmapBatchLoader::LogSlowest(timings, 5);
 
   return vkex::Result::Success;
 }
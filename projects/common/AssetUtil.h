@@ -18,16 +18,61 @@
 #define __COMMON_ASSET_UTIL_H__
 
 #include "vkex/Application.h"
+#include "vkex/BitmapBatchLoader.h"
+#include "vkex/ThreadPool.h"
 
 namespace asset_util {
 
+class MipGenerator;
+
 std::vector<uint8_t> LoadFile(const vkex::fs::path& file_path);
 
+// .mip files are memory mapped and copied straight into the staging buffer,
+// anything else goes through vkex::Bitmap::Create. If compressed_format is
+// a BC format, images loaded through Bitmap::Create are compressed before 
+// upload, .mip files are uploaded in whatever format they're stored in.
+// If p_mip_generator is set, uncompressed images only decode level 0 and
+// the rest is generated on the GPU, queue must support graphics.
 vkex::Result CreateTexture(
   const vkex::fs::path& image_file_path,
   vkex::Queue           queue,
   bool                  host_visible,
-  vkex::Texture*        p_texture);
+  vkex::Texture*        p_texture,
+  VkFormat              compressed_format = VK_FORMAT_UNDEFINED,
+  vkex::ThreadPool*     p_thread_pool     = nullptr,
+  MipGenerator*         p_mip_generator   = nullptr);
+
+// If p_mip_generator is set and bitmap only has level 0, the full MIP
+// chain is generated on the GPU. Formats the generator doesn't support
+// get their MIPs on the CPU instead.
+vkex::Result CreateTexture(
+  const vkex::Bitmap&   bitmap,
+  vkex::Queue           queue,
+  bool                  host_visible,
+  vkex::Texture*        p_texture,
+  MipGenerator*         p_mip_generator = nullptr);
+
+// Uploads on the application's transfer queue without waiting. The texture
+// is owned by the graphics queue from the next SubmitRender on and must not
+// be used by command buffers submitted before then.
+vkex::Result CreateTextureAsync(
+  const vkex::Bitmap&   bitmap,
+  vkex::Application*    p_application,
+  bool                  host_visible,
+  vkex::Texture*        p_texture,
+  vkex::TransferToken*  p_token = nullptr);
+
+// Decodes all images concurrently on p_thread_pool with 
+// vkex::BitmapBatchLoader and uploads each one as soon as it's ready. 
+// Textures are returned in the same order as image_file_paths. Per file
+// timings of the slowest images are logged.
+vkex::Result CreateTextures(
+  const std::vector<vkex::fs::path>& image_file_paths,
+  vkex::Queue                        queue,
+  bool                               host_visible,
+  vkex::ThreadPool*                  p_thread_pool,
+  std::vector<vkex::Texture>*        p_textures,
+  uint64_t                           memory_ceiling = 0);
 
 } // namespace asset_util
 
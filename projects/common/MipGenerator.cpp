@@ -0,0 +1,375 @@
+/*
+ Copyright 2018-2019 Google Inc.
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+ http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+*/
+
+#include "MipGenerator.h"
+
+#include <algorithm>
+
+namespace asset_util {
+
+// Must match numthreads in GenerateMips.hlsl
+const uint32_t kGroupSize = 8;
+
+// =================================================================================================
+// MipGenerator
+// =================================================================================================
+MipGenerator::MipGenerator(vkex::Device device, uint32_t max_sets)
+  : m_device(device),
+    m_max_sets(max_sets)
+{
+  VKEX_ASSERT(m_device != nullptr);
+}
+
+MipGenerator::~MipGenerator()
+{
+  m_device->WaitIdle();
+
+  for (auto& resources : m_resources) {
+    DestroyResources(resources);
+  }
+  m_resources.clear();
+
+  if (m_pipeline != nullptr) {
+    m_device->DestroyComputePipeline(m_pipeline);
+  }
+  if (m_pipeline_layout != nullptr) {
+    m_device->DestroyPipelineLayout(m_pipeline_layout);
+  }
+  if (m_descriptor_pool != nullptr) {
+    m_device->DestroyDescriptorPool(m_descriptor_pool);
+  }
+  if (m_descriptor_set_layout != nullptr) {
+    m_device->DestroyDescriptorSetLayout(m_descriptor_set_layout);
+  }
+  if (m_shader_program != nullptr) {
+    m_device->DestroyShaderProgram(m_shader_program);
+  }
+}
+
+vkex::Result MipGenerator::Initialize(const std::vector<uint8_t>& spv_cs)
+{
+  if (spv_cs.empty()) {
+    return vkex::Result::Success;
+  }
+
+  // Shader program
+  {
+    VKEX_CALL(vkex::CreateShaderProgram(m_device, spv_cs, &m_shader_program));
+  }
+
+  // Descriptor set layout
+  {
+    const vkex::ShaderInterface&        shader_interface = m_shader_program->GetInterface();
+    vkex::DescriptorSetLayoutCreateInfo create_info      = ToVkexCreateInfo(shader_interface.GetSet(0));
+    VKEX_CALL(m_device->CreateDescriptorSetLayout(create_info, &m_descriptor_set_layout));
+  }
+
+  // Descriptor pool, sets are freed individually
+  {
+    const vkex::ShaderInterface&   shader_interface = m_shader_program->GetInterface();
+    vkex::DescriptorPoolCreateInfo create_info      = {};
+    create_info.flags.bits.free_descriptor_set      = true;
+    create_info.max_sets                            = m_max_sets;
+    create_info.pool_sizes                          = m_max_sets * shader_interface.GetDescriptorPoolSizes();
+    VKEX_CALL(m_device->CreateDescriptorPool(create_info, &m_descriptor_pool));
+  }
+
+  // Pipeline layout
+  {
+    vkex::PipelineLayoutCreateInfo create_info = {};
+    create_info.descriptor_set_layouts.push_back(vkex::ToVulkan(m_descriptor_set_layout));
+    VKEX_CALL(m_device->CreatePipelineLayout(create_info, &m_pipeline_layout));
+  }
+
+  // Pipeline
+  {
+    vkex::ComputePipelineCreateInfo create_info = {};
+    create_info.shader_program                  = m_shader_program;
+    create_info.pipeline_layout                 = m_pipeline_layout;
+    VKEX_CALL(m_device->CreateComputePipeline(create_info, &m_pipeline));
+  }
+
+  return vkex::Result::Success;
+}
+
+bool MipGenerator::SupportsBlit(VkFormat format) const
+{
+  const VkFormatFeatureFlags required =
+    VK_FORMAT_FEATURE_BLIT_SRC_BIT |
+    VK_FORMAT_FEATURE_BLIT_DST_BIT |
+    VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+
+  VkFormatProperties properties = m_device->GetPhysicalDevice()->GetFormatProperties(format);
+  return ((properties.optimalTilingFeatures & required) == required);
+}
+
+bool MipGenerator::SupportsCompute(VkFormat format) const
+{
+  if (m_pipeline == nullptr) {
+    return false;
+  }
+
+  const VkPhysicalDeviceFeatures& features = m_device->GetPhysicalDevice()->GetPhysicalDeviceFeatures().features;
+  if (!features.shaderStorageImageReadWithoutFormat || !features.shaderStorageImageWriteWithoutFormat) {
+    return false;
+  }
+
+  VkFormatProperties properties = m_device->GetPhysicalDevice()->GetFormatProperties(format);
+  return ((properties.optimalTilingFeatures & VK_FORMAT_FEATURE_STORAGE_IMAGE_BIT) != 0);
+}
+
+bool MipGenerator::IsSupported(VkFormat format) const
+{
+  return SupportsBlit(format) || SupportsCompute(format);
+}
+
+vkex::ImageUsageFlags MipGenerator::GetRequiredUsage(VkFormat format) const
+{
+  vkex::ImageUsageFlags usage_flags = {};
+  if (SupportsBlit(format)) {
+    usage_flags.bits.transfer_src = true;
+  }
+  else if (SupportsCompute(format)) {
+    usage_flags.bits.storage = true;
+  }
+  return usage_flags;
+}
+
+vkex::Result MipGenerator::Record(
+  vkex::Image           image,
+  VkImageLayout         old_layout,
+  VkImageLayout         new_layout,
+  VkPipelineStageFlags  new_pipeline_stage,
+  vkex::TransferBatch*  p_transfer_batch,
+  uint64_t*             p_id)
+{
+  VKEX_ASSERT(image != nullptr);
+  VKEX_ASSERT(p_transfer_batch != nullptr);
+  VKEX_ASSERT(p_id != nullptr);
+
+  *p_id = 0;
+
+  if (SupportsBlit(image->GetFormat())) {
+    p_transfer_batch->Record([image, old_layout, new_layout, new_pipeline_stage](vkex::CommandBuffer command_buffer) {
+      command_buffer->CmdGenerateMips(image, old_layout, new_layout, new_pipeline_stage);
+    });
+    return vkex::Result::Success;
+  }
+
+  if (SupportsCompute(image->GetFormat())) {
+    return RecordCompute(image, old_layout, new_layout, new_pipeline_stage, p_transfer_batch, p_id);
+  }
+
+  return vkex::Result::ErrorImageFormatNotSupported;
+}
+
+vkex::Result MipGenerator::RecordCompute(
+  vkex::Image           image,
+  VkImageLayout         old_layout,
+  VkImageLayout         new_layout,
+  VkPipelineStageFlags  new_pipeline_stage,
+  vkex::TransferBatch*  p_transfer_batch,
+  uint64_t*             p_id)
+{
+  // Per level views only cover 2D images with a single layer
+  if ((image->GetImageType() != VK_IMAGE_TYPE_2D) || (image->GetArrayLayers() != 1)) {
+    return vkex::Result::ErrorImageFormatNotSupported;
+  }
+
+  // Free up sets from earlier batches before allocating more
+  VKEX_CALL(Collect());
+
+  std::lock_guard<std::mutex> lock(m_mutex);
+
+  Resources resources = {};
+  resources.id        = m_next_id++;
+
+  const uint32_t mip_levels = image->GetMipLevels();
+  for (uint32_t level = 0; level < mip_levels; ++level) {
+    vkex::ImageViewCreateInfo create_info        = {};
+    create_info.image                            = image;
+    create_info.view_type                        = VK_IMAGE_VIEW_TYPE_2D;
+    create_info.format                           = image->GetFormat();
+    create_info.samples                          = VK_SAMPLE_COUNT_1_BIT;
+    create_info.components                       = vkex::ComponentMappingRGBA();
+    create_info.subresource_range.aspectMask     = image->GetAspectFlags();
+    create_info.subresource_range.baseMipLevel   = level;
+    create_info.subresource_range.levelCount     = 1;
+    create_info.subresource_range.baseArrayLayer = 0;
+    create_info.subresource_range.layerCount     = 1;
+    vkex::ImageView view = nullptr;
+    vkex::Result vkex_result = m_device->CreateImageView(create_info, &view);
+    if (!vkex_result) {
+      DestroyResources(resources);
+      return vkex_result;
+    }
+    resources.views.push_back(view);
+  }
+
+  for (uint32_t level = 1; level < mip_levels; ++level) {
+    vkex::DescriptorSetAllocateInfo allocate_info = {};
+    allocate_info.layouts.push_back(m_descriptor_set_layout);
+    vkex::DescriptorSet descriptor_set = nullptr;
+    vkex::Result vkex_result = m_descriptor_pool->AllocateDescriptorSet(allocate_info, &descriptor_set);
+    if (!vkex_result) {
+      DestroyResources(resources);
+      return vkex_result;
+    }
+    resources.descriptor_sets.push_back(descriptor_set);
+
+    VkDescriptorImageInfo image_infos[2] = {};
+    image_infos[0].imageView    = *resources.views[level - 1];
+    image_infos[0].imageLayout  = VK_IMAGE_LAYOUT_GENERAL;
+    image_infos[1].imageView    = *resources.views[level];
+    image_infos[1].imageLayout  = VK_IMAGE_LAYOUT_GENERAL;
+    descriptor_set->UpdateDescriptors(0, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 0, 1, &image_infos[0]);
+    descriptor_set->UpdateDescriptors(1, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 0, 1, &image_infos[1]);
+  }
+
+  std::vector<VkDescriptorSet> vk_descriptor_sets;
+  for (auto& descriptor_set : resources.descriptor_sets) {
+    vk_descriptor_sets.push_back(*descriptor_set);
+  }
+
+  vkex::ComputePipeline pipeline        = m_pipeline;
+  VkPipelineLayout      pipeline_layout = *m_pipeline_layout;
+  VkExtent3D            extent          = image->GetExtent();
+  p_transfer_batch->Record([=](vkex::CommandBuffer command_buffer) {
+    command_buffer->CmdTransitionImageLayout(
+      image,
+      old_layout,
+      VK_IMAGE_LAYOUT_GENERAL,
+      VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+
+    command_buffer->CmdBindPipeline(pipeline);
+    for (uint32_t level = 1; level < mip_levels; ++level) {
+      // Previous level's writes, or the upload for level 0, become readable
+      VkMemoryBarrier barrier = { VK_STRUCTURE_TYPE_MEMORY_BARRIER };
+      barrier.srcAccessMask   = VK_ACCESS_SHADER_WRITE_BIT;
+      barrier.dstAccessMask   = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+      command_buffer->CmdPipelineBarrier(
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        0,
+        1, &barrier,
+        0, nullptr,
+        0, nullptr);
+
+      command_buffer->CmdBindDescriptorSets(
+        VK_PIPELINE_BIND_POINT_COMPUTE,
+        pipeline_layout,
+        0,
+        1,
+        &vk_descriptor_sets[level - 1],
+        0,
+        nullptr);
+
+      uint32_t width  = std::max(extent.width  >> level, 1U);
+      uint32_t height = std::max(extent.height >> level, 1U);
+      command_buffer->CmdDispatch(
+        (width  + kGroupSize - 1) / kGroupSize,
+        (height + kGroupSize - 1) / kGroupSize,
+        1);
+    }
+
+    command_buffer->CmdTransitionImageLayout(
+      image,
+      VK_IMAGE_LAYOUT_GENERAL,
+      new_layout,
+      new_pipeline_stage);
+  });
+
+  *p_id = resources.id;
+  m_resources.push_back(std::move(resources));
+
+  return vkex::Result::Success;
+}
+
+void MipGenerator::Track(uint64_t id, const vkex::TransferToken& token)
+{
+  if (id == 0) {
+    return;
+  }
+
+  std::lock_guard<std::mutex> lock(m_mutex);
+
+  for (auto& resources : m_resources) {
+    if (resources.id == id) {
+      VKEX_ASSERT(!resources.tracked);
+      resources.tracked = true;
+      resources.token   = token;
+      break;
+    }
+  }
+}
+
+vkex::Result MipGenerator::Discard(uint64_t id)
+{
+  if (id == 0) {
+    return vkex::Result::Success;
+  }
+
+  std::lock_guard<std::mutex> lock(m_mutex);
+
+  auto it = std::find_if(
+    m_resources.begin(),
+    m_resources.end(),
+    [id](const Resources& resources) { return resources.id == id; });
+  if (it == m_resources.end()) {
+    return vkex::Result::Success;
+  }
+
+  // Nothing was submitted, so nothing on the GPU uses them
+  VKEX_ASSERT(!it->tracked);
+  vkex::Result vkex_result = DestroyResources(*it);
+  m_resources.erase(it);
+  return vkex_result;
+}
+
+vkex::Result MipGenerator::Collect()
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+
+  auto it = m_resources.begin();
+  while (it != m_resources.end()) {
+    if (it->tracked && it->token.IsComplete()) {
+      VKEX_CALL(DestroyResources(*it));
+      it = m_resources.erase(it);
+    }
+    else {
+      ++it;
+    }
+  }
+
+  return vkex::Result::Success;
+}
+
+vkex::Result MipGenerator::DestroyResources(Resources& resources)
+{
+  for (auto& descriptor_set : resources.descriptor_sets) {
+    m_descriptor_pool->FreeDescriptorSet(descriptor_set);
+  }
+  resources.descriptor_sets.clear();
+
+  for (auto& view : resources.views) {
+    VKEX_CALL(m_device->DestroyImageView(view));
+  }
+  resources.views.clear();
+
+  return vkex::Result::Success;
+}
+
+} // namespace asset_util
@@ -0,0 +1,120 @@
+/*
+ Copyright 2018-2019 Google Inc.
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+ http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+*/
+
+#ifndef __COMMON_MIP_GENERATOR_H__
+#define __COMMON_MIP_GENERATOR_H__
+
+#include "vkex/Application.h"
+
+namespace asset_util {
+
+/** @class MipGenerator
+ *
+ * Fills MIP levels 1 and up from level 0 on the GPU.
+ *
+ * Formats that can be linearly filtered and blitted use a chain of
+ * CmdBlitImage calls. Anything else that can be a storage image uses a
+ * 2x2 box downsample compute shader, one dispatch per level. The compute
+ * shader accesses images without a format qualifier, so it needs the
+ * shaderStorageImageReadWithoutFormat and shaderStorageImageWriteWithoutFormat
+ * device features.
+ *
+ * Commands are added to a TransferBatch, which must be submitted on a
+ * queue that supports graphics, or compute if only the compute path is
+ * used. Per level views and descriptor sets used by the compute path are
+ * kept under the id Record() returns. Collect() destroys them once the
+ * token passed to Track() has completed, Discard() destroys them right
+ * away if the batch is never submitted.
+ *
+ * All functions are thread safe.
+ *
+ */
+class MipGenerator {
+public:
+  // max_sets is the number of compute levels that can be in flight
+  MipGenerator(vkex::Device device, uint32_t max_sets = 256);
+  // Waits for the device and destroys everything
+  ~MipGenerator();
+
+  MipGenerator(const MipGenerator&) = delete;
+  MipGenerator& operator=(const MipGenerator&) = delete;
+
+  // spv_cs is GenerateMips.cs.spv. If it's empty only the blit path is
+  // available.
+  vkex::Result  Initialize(const std::vector<uint8_t>& spv_cs);
+
+  bool          SupportsBlit(VkFormat format) const;
+  bool          SupportsCompute(VkFormat format) const;
+  bool          IsSupported(VkFormat format) const;
+
+  // Usage the image needs on top of transfer_dst and sampled
+  vkex::ImageUsageFlags GetRequiredUsage(VkFormat format) const;
+
+  // All levels of image must be in old_layout, they end up in new_layout.
+  // The image needs the usage from GetRequiredUsage(). p_id receives the
+  // id to pass to Track() or Discard(), 0 if nothing needs tracking.
+  vkex::Result  Record(
+    vkex::Image           image,
+    VkImageLayout         old_layout,
+    VkImageLayout         new_layout,
+    VkPipelineStageFlags  new_pipeline_stage,
+    vkex::TransferBatch*  p_transfer_batch,
+    uint64_t*             p_id);
+
+  // Call once the batch has been submitted, with the token Submit() returned
+  void          Track(uint64_t id, const vkex::TransferToken& token);
+
+  // Call instead of Track() if the batch wasn't submitted
+  vkex::Result  Discard(uint64_t id);
+
+  // Destroys views and descriptor sets of completed batches
+  vkex::Result  Collect();
+
+private:
+  struct Resources {
+    uint64_t                            id                = 0;
+    bool                                tracked           = false;
+    vkex::TransferToken                 token;
+    std::vector<vkex::ImageView>        views;
+    std::vector<vkex::DescriptorSet>    descriptor_sets;
+  };
+
+  vkex::Result  RecordCompute(
+    vkex::Image           image,
+    VkImageLayout         old_layout,
+    VkImageLayout         new_layout,
+    VkPipelineStageFlags  new_pipeline_stage,
+    vkex::TransferBatch*  p_transfer_batch,
+    uint64_t*             p_id);
+
+  vkex::Result  DestroyResources(Resources& resources);
+
+private:
+  vkex::Device              m_device                = nullptr;
+  uint32_t                  m_max_sets              = 0;
+  vkex::ShaderProgram       m_shader_program        = nullptr;
+  vkex::DescriptorSetLayout m_descriptor_set_layout = nullptr;
+  vkex::DescriptorPool      m_descriptor_pool       = nullptr;
+  vkex::PipelineLayout      m_pipeline_layout       = nullptr;
+  vkex::ComputePipeline     m_pipeline              = nullptr;
+  std::mutex                m_mutex;
+  uint64_t                  m_next_id               = 1;
+  std::vector<Resources>    m_resources;
+};
+
+} // namespace asset_util
+
+#endif // __COMMON_MIP_GENERATOR_H__
@@ -0,0 +1,384 @@
+/*
+ Copyright 2018-2019 Google Inc.
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+ http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+*/
+
+#include "TextureStreamer.h"
+#include "AssetUtil.h"
+
+#include <algorithm>
+
+namespace asset_util {
+
+// =================================================================================================
+// TextureStreamer
+// =================================================================================================
+TextureStreamer::TextureStreamer(
+  vkex::Application*  p_application,
+  vkex::ThreadPool*   p_thread_pool,
+  uint64_t            upload_budget,
+  uint64_t            memory_ceiling)
+  : m_application(p_application),
+    m_thread_pool(p_thread_pool),
+    m_upload_budget(upload_budget),
+    m_loader(p_thread_pool, memory_ceiling)
+{
+  VKEX_ASSERT(m_application != nullptr);
+}
+
+TextureStreamer::~TextureStreamer()
+{
+  // Decoded bitmaps hold charges that decodes still running may be
+  // waiting on, return them before waiting for the workers, which call
+  // back into the streamer.
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_shutting_down = true;
+    for (auto& entry : m_entries) {
+      entry.bitmap.reset();
+      entry.charge.Release();
+    }
+  }
+  m_loader.WaitIdle();
+
+  vkex::Device device = m_application->GetDevice();
+  device->WaitIdle();
+
+  for (auto& entry : m_entries) {
+    if (entry.texture != nullptr) {
+      device->DestroyTexture(entry.texture);
+    }
+  }
+  m_entries.clear();
+
+  if (m_placeholder != nullptr) {
+    device->DestroyTexture(m_placeholder);
+    m_placeholder = nullptr;
+  }
+}
+
+vkex::Result TextureStreamer::Initialize()
+{
+  // 2x2 grey checker
+  const uint8_t pixels[] = {
+    0x80, 0x80, 0x80, 0xFF,   0x40, 0x40, 0x40, 0xFF,
+    0x40, 0x40, 0x40, 0xFF,   0x80, 0x80, 0x80, 0xFF,
+  };
+  vkex::Bitmap bitmap(2, 2, VK_FORMAT_R8G8B8A8_UNORM, 1, pixels);
+  if (!bitmap.IsValid()) {
+    return vkex::Result::ErrorImageLoadFailed;
+  }
+
+  return CreateTexture(bitmap, m_application->GetGraphicsQueue(), false, &m_placeholder);
+}
+
+TextureStreamer::Handle TextureStreamer::Request(const vkex::fs::path& file_path, int32_t priority)
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+
+  Handle handle = kInvalidHandle;
+  if (!m_free_handles.empty()) {
+    handle = m_free_handles.back();
+    m_free_handles.pop_back();
+  }
+  else {
+    handle = vkex::CountU32(m_entries);
+    m_entries.emplace_back();
+  }
+
+  Entry& entry    = m_entries[handle];
+  entry.file_path = file_path;
+  entry.priority  = priority;
+  entry.state     = STATE_QUEUED;
+
+  return handle;
+}
+
+void TextureStreamer::SetPriority(Handle handle, int32_t priority)
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+
+  VKEX_ASSERT(handle < m_entries.size());
+  m_entries[handle].priority = priority;
+}
+
+void TextureStreamer::Release(Handle handle)
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+
+  VKEX_ASSERT((handle < m_entries.size()) && (m_entries[handle].state != STATE_FREE));
+  Entry& entry = m_entries[handle];
+  entry.released = true;
+}
+
+bool TextureStreamer::IsResident(Handle handle) const
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+
+  VKEX_ASSERT(handle < m_entries.size());
+  return (m_entries[handle].state == STATE_RESIDENT);
+}
+
+bool TextureStreamer::IsFailed(Handle handle) const
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+
+  VKEX_ASSERT(handle < m_entries.size());
+  return (m_entries[handle].state == STATE_FAILED);
+}
+
+vkex::Texture TextureStreamer::GetTexture(Handle handle) const
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+
+  VKEX_ASSERT(handle < m_entries.size());
+  const Entry& entry = m_entries[handle];
+  return (entry.state == STATE_RESIDENT) ? entry.texture : m_placeholder;
+}
+
+uint32_t TextureStreamer::GetPendingCount() const
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+
+  uint32_t count = 0;
+  for (auto& entry : m_entries) {
+    bool pending = (entry.state == STATE_QUEUED) ||
+                   (entry.state == STATE_DECODING) ||
+                   (entry.state == STATE_DECODED) ||
+                   (entry.state == STATE_UPLOADING);
+    count += pending ? 1 : 0;
+  }
+  return count;
+}
+
+vkex::Result TextureStreamer::Update(std::vector<Handle>* p_resident)
+{
+  return Step(m_upload_budget, p_resident);
+}
+
+vkex::Result TextureStreamer::WaitIdle(std::vector<Handle>* p_resident)
+{
+  while (GetPendingCount() > 0) {
+    // Without a budget every decoded entry is uploaded and its charge
+    // returned, so decodes waiting on the memory ceiling can go ahead
+    vkex::Result vkex_result = Step(0, p_resident);
+    if (!vkex_result) {
+      return vkex_result;
+    }
+
+    // Waiting on the loader here could deadlock, a decode may need the
+    // charge of one that finishes in the meantime. Wait for the next
+    // decode instead, but only while no decoded entry holds a charge,
+    // and upload it on the next Step().
+    std::vector<vkex::TransferToken> tokens;
+    {
+      std::unique_lock<std::mutex> lock(m_mutex);
+      bool decoded  = false;
+      bool decoding = false;
+      for (auto& entry : m_entries) {
+        decoded  |= (entry.state == STATE_DECODED);
+        decoding |= (entry.state == STATE_DECODING);
+      }
+      if (decoded) {
+        continue;
+      }
+      if (decoding) {
+        uint64_t decoded_count = m_decoded_count;
+        m_decoded_cv.wait(lock, [this, decoded_count]() { return m_decoded_count != decoded_count; });
+        continue;
+      }
+
+      for (auto& entry : m_entries) {
+        if (entry.state == STATE_UPLOADING) {
+          tokens.push_back(entry.token);
+        }
+      }
+    }
+    for (auto& token : tokens) {
+      vkex_result = token.Wait();
+      if (!vkex_result) {
+        return vkex_result;
+      }
+    }
+  }
+
+  // Pick up the last uploads
+  return Step(0, p_resident);
+}
+
+void TextureStreamer::OnDecoded(vkex::BitmapBatchLoader::LoadResult& result)
+{
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    ++m_decoded_count;
+
+    // Left in result, the bitmap and its charge go away with it
+    if (m_shutting_down) {
+      return;
+    }
+
+    Entry& entry = m_entries[result.index];
+    if ((result.result != vkex::Result::Success) || !result.bitmap) {
+      VKEX_LOG_ERROR("Texture streaming failed to load " << result.file_path);
+      entry.state = STATE_FAILED;
+    }
+    else {
+      entry.bitmap = std::move(result.bitmap);
+      entry.charge = std::move(result.charge);
+      entry.state  = STATE_DECODED;
+    }
+  }
+  m_decoded_cv.notify_all();
+}
+
+vkex::Result TextureStreamer::DestroyEntry(Handle handle)
+{
+  Entry& entry = m_entries[handle];
+  // Frames in flight may still sample the texture
+  m_application->GetDevice()->DestroyDeferred(entry.texture);
+
+  entry = Entry();
+  m_free_handles.push_back(handle);
+
+  return vkex::Result::Success;
+}
+
+vkex::Result TextureStreamer::Step(uint64_t upload_budget, std::vector<Handle>* p_resident)
+{
+  // Swap in completed uploads and destroy released entries nothing uses
+  std::vector<Handle> decoded;
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    for (Handle handle = 0; handle < vkex::CountU32(m_entries); ++handle) {
+      Entry& entry = m_entries[handle];
+      if ((entry.state == STATE_UPLOADING) && entry.token.IsComplete()) {
+        entry.state = STATE_RESIDENT;
+        if (!entry.released && (p_resident != nullptr)) {
+          p_resident->push_back(handle);
+        }
+      }
+
+      bool idle = (entry.state == STATE_QUEUED) ||
+                  (entry.state == STATE_DECODED) ||
+                  (entry.state == STATE_RESIDENT) ||
+                  (entry.state == STATE_FAILED);
+      if (entry.released && idle) {
+        vkex::Result vkex_result = DestroyEntry(handle);
+        if (!vkex_result) {
+          return vkex_result;
+        }
+        continue;
+      }
+
+      if (entry.state == STATE_DECODED) {
+        decoded.push_back(handle);
+      }
+    }
+
+    std::stable_sort(
+      decoded.begin(),
+      decoded.end(),
+      [this](Handle a, Handle b) { return m_entries[a].priority > m_entries[b].priority; });
+  }
+
+  // Upload, only this thread touches decoded entries. The first upload
+  // always goes out so images bigger than the budget still make progress.
+  uint64_t uploaded_size = 0;
+  for (Handle handle : decoded) {
+    Entry& entry = m_entries[handle];
+    {
+      // Release() may have been called since the entry was collected,
+      // drop the Bitmap instead of uploading it. The entry is destroyed
+      // on the next Step().
+      std::lock_guard<std::mutex> lock(m_mutex);
+      if (entry.released) {
+        entry.bitmap.reset();
+        entry.charge.Release();
+        continue;
+      }
+    }
+
+    uint64_t size = entry.bitmap->GetDataSizeAllLevels();
+    if ((upload_budget > 0) && (uploaded_size > 0) && ((uploaded_size + size) > upload_budget)) {
+      break;
+    }
+
+    vkex::Texture       texture = nullptr;
+    vkex::TransferToken token;
+    vkex::Result vkex_result = CreateTextureAsync(*entry.bitmap, m_application, false, &texture, &token);
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    // Bitmap data has been copied to staging
+    entry.bitmap.reset();
+    entry.charge.Release();
+    if (!vkex_result) {
+      VKEX_LOG_ERROR("Texture streaming failed to upload " << entry.file_path);
+      if (texture != nullptr) {
+        m_application->GetDevice()->DestroyTexture(texture);
+      }
+      entry.state = STATE_FAILED;
+      continue;
+    }
+    entry.texture = texture;
+    entry.token   = token;
+    entry.state   = STATE_UPLOADING;
+    uploaded_size += size;
+  }
+
+  // Keep the loader fed, highest priority first
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    const uint32_t max_in_flight = 2 * std::max<uint32_t>(m_thread_pool->GetThreadCount(), 1);
+    uint32_t in_flight = 0;
+    std::vector<Handle> queued;
+    for (Handle handle = 0; handle < vkex::CountU32(m_entries); ++handle) {
+      const Entry& entry = m_entries[handle];
+      if ((entry.state == STATE_DECODING) || (entry.state == STATE_DECODED)) {
+        ++in_flight;
+      }
+      else if ((entry.state == STATE_QUEUED) && !entry.released) {
+        queued.push_back(handle);
+      }
+    }
+
+    std::stable_sort(
+      queued.begin(),
+      queued.end(),
+      [this](Handle a, Handle b) { return m_entries[a].priority > m_entries[b].priority; });
+
+    for (Handle handle : queued) {
+      if (in_flight >= max_in_flight) {
+        break;
+      }
+
+      Entry& entry = m_entries[handle];
+      entry.state  = STATE_DECODING;
+
+      vkex::BitmapBatchLoader::LoadRequest request = {};
+      request.file_path   = entry.file_path;
+      request.level_count = 0;
+      request.mip_filter  = vkex::Bitmap::MipFilterBox;
+      m_loader.Load(handle, request, [this](vkex::BitmapBatchLoader::LoadResult& result) {
+        OnDecoded(result);
+      });
+      ++in_flight;
+    }
+  }
+
+  return vkex::Result::Success;
+}
+
+} // namespace asset_util
@@ -0,0 +1,138 @@
+/*
+ Copyright 2018-2019 Google Inc.
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+ http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+*/
+
+#ifndef __COMMON_TEXTURE_STREAMER_H__
+#define __COMMON_TEXTURE_STREAMER_H__
+
+#include "vkex/Application.h"
+#include "vkex/BitmapBatchLoader.h"
+#include "vkex/ThreadPool.h"
+
+namespace asset_util {
+
+/** @class TextureStreamer
+ *
+ * Loads textures in the background. Request() returns a handle right away
+ * and GetTexture() returns a shared placeholder until the texture is
+ * resident.
+ *
+ * File reads, decode and MIP generation run on the thread pool through a
+ * vkex::BitmapBatchLoader. Decoded images are uploaded from Update() on
+ * the application's transfer queue, highest priority first, until the
+ * per frame byte budget is used up. A texture becomes resident once its
+ * upload has completed, Update() reports it so descriptors can be
+ * rewritten.
+ *
+ * Only as many images as there are worker threads, times two, are decoding
+ * or waiting for upload at once, so priorities also decide decode order.
+ *
+ * Everything except the worker side of the loader runs on the thread
+ * calling Update().
+ *
+ */
+class TextureStreamer {
+public:
+  using Handle = uint32_t;
+
+  static const Handle kInvalidHandle = UINT32_MAX;
+
+  // p_application and p_thread_pool must outlive the streamer.
+  // upload_budget is in bytes per Update(), 0 is unlimited.
+  TextureStreamer(
+    vkex::Application*  p_application,
+    vkex::ThreadPool*   p_thread_pool,
+    uint64_t            upload_budget   = 8 * 1024 * 1024,
+    uint64_t            memory_ceiling  = 0);
+  // Waits for outstanding work and destroys every texture
+  ~TextureStreamer();
+
+  TextureStreamer(const TextureStreamer&) = delete;
+  TextureStreamer& operator=(const TextureStreamer&) = delete;
+
+  // Creates the placeholder texture
+  vkex::Result  Initialize();
+
+  // Higher priorities are decoded and uploaded first
+  Handle        Request(const vkex::fs::path& file_path, int32_t priority = 0);
+  void          SetPriority(Handle handle, int32_t priority);
+
+  // Hands the texture to CDevice::DestroyDeferred on the next Update
+  void          Release(Handle handle);
+
+  bool          IsResident(Handle handle) const;
+  bool          IsFailed(Handle handle) const;
+  vkex::Texture GetTexture(Handle handle) const;
+  vkex::Texture GetPlaceholder() const { return m_placeholder; }
+
+  // Call once per frame before recording. Handles that became resident
+  // are appended to p_resident.
+  vkex::Result  Update(std::vector<Handle>* p_resident = nullptr);
+
+  // Finishes every request regardless of the budget
+  vkex::Result  WaitIdle(std::vector<Handle>* p_resident = nullptr);
+
+  uint64_t      GetUploadBudget() const { return m_upload_budget; }
+  void          SetUploadBudget(uint64_t upload_budget) { m_upload_budget = upload_budget; }
+  uint32_t      GetPendingCount() const;
+
+private:
+  enum State {
+    STATE_FREE = 0,
+    STATE_QUEUED,
+    STATE_DECODING,
+    STATE_DECODED,
+    STATE_UPLOADING,
+    STATE_RESIDENT,
+    STATE_FAILED,
+  };
+
+  struct Entry {
+    vkex::fs::path                    file_path;
+    int32_t                           priority      = 0;
+    State                             state         = STATE_FREE;
+    bool                              released      = false;
+    std::unique_ptr<vkex::Bitmap>     bitmap;
+    // Held against the loader's memory ceiling while bitmap is alive
+    vkex::BitmapBatchLoader::Charge   charge;
+    vkex::Texture                     texture       = nullptr;
+    vkex::TransferToken               token;
+  };
+
+  vkex::Result  Step(uint64_t upload_budget, std::vector<Handle>* p_resident);
+  void          OnDecoded(vkex::BitmapBatchLoader::LoadResult& result);
+  vkex::Result  DestroyEntry(Handle handle);
+
+private:
+  vkex::Application*                m_application   = nullptr;
+  vkex::ThreadPool*                 m_thread_pool   = nullptr;
+  uint64_t                          m_upload_budget = 0;
+  vkex::BitmapBatchLoader           m_loader;
+  vkex::Texture                     m_placeholder   = nullptr;
+  // Entries are only added or reused on the Update() thread, workers
+  // write decode results under m_mutex.
+  mutable std::mutex                m_mutex;
+  std::vector<Entry>                m_entries;
+  std::vector<Handle>               m_free_handles;
+  // Signaled with m_decoded_count bumped whenever a decode finishes
+  std::condition_variable           m_decoded_cv;
+  uint64_t                          m_decoded_count = 0;
+  // Set by the destructor, late decode results are dropped
+  bool                              m_shutting_down = false;
+};
+
+} // namespace asset_util
+
+#endif // __COMMON_TEXTURE_STREAMER_H__
@@ -0,0 +1,203 @@
+/*
+ Copyright 2018-2019 Google Inc.
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+ http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+*/
+
+//
+// Checks that BitmapBatchLoader keeps decoded memory under its ceiling
+// while the consumer holds on to results.
+//
+// Usage: loader_stress [image count] [ceiling MiB]
+//
+// JPGs of mixed sizes are written next to the working directory and
+// loaded with full mip chains twice: once waiting on futures in request
+// order, once through callbacks with results handed to a consumer that
+// keeps a few of them around as if they were waiting for upload. The bytes
+// held in Bitmaps and the loader's peak charge are compared against the
+// ceiling. An image bigger than the ceiling on its own may exceed it, by
+// itself. Exits with EXIT_FAILURE if either goes over.
+//
+
+#include "vkex/BitmapBatchLoader.h"
+#include "vkex/ThreadPool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <random>
+#include <string>
+#include <thread>
+
+using LoadResult = vkex::BitmapBatchLoader::LoadResult;
+
+// Bytes held in Bitmaps the consumer has received and not dropped yet
+static std::atomic<uint64_t> s_resident_size(0);
+static std::atomic<uint64_t> s_peak_resident_size(0);
+static std::atomic<uint64_t> s_max_charged_size(0);
+
+static void UpdateMax(std::atomic<uint64_t>* p_value, uint64_t value)
+{
+  uint64_t current = p_value->load();
+  while ((value > current) && !p_value->compare_exchange_weak(current, value)) {
+  }
+}
+
+static void OnReceived(const LoadResult& result)
+{
+  if (result.bitmap) {
+    uint64_t size = s_resident_size.fetch_add(result.bitmap->GetDataSizeAllLevels()) + result.bitmap->GetDataSizeAllLevels();
+    UpdateMax(&s_peak_resident_size, size);
+  }
+  UpdateMax(&s_max_charged_size, result.charged_size);
+}
+
+// Pretends to upload, then drops the Bitmap and its charge
+static void Consume(LoadResult* p_result, std::mt19937* p_rng)
+{
+  std::this_thread::sleep_for(std::chrono::microseconds((*p_rng)() % 2000));
+  if (p_result->bitmap) {
+    s_resident_size.fetch_sub(p_result->bitmap->GetDataSizeAllLevels());
+  }
+  p_result->bitmap.reset();
+  p_result->charge.Release();
+}
+
+static bool WriteImages(uint32_t image_count, std::vector<vkex::fs::path>* p_paths)
+{
+  std::mt19937 rng(1);
+  for (uint32_t i = 0; i < image_count; ++i) {
+    uint32_t width  = 64u << (rng() % 6);
+    uint32_t height = 64u << (rng() % 6);
+    std::vector<uint8_t> pixels(static_cast<size_t>(width) * height * 4);
+    for (size_t j = 0; j < pixels.size(); ++j) {
+      pixels[j] = static_cast<uint8_t>((j / 4) + (rng() & 0xF));
+    }
+
+    vkex::fs::path path = "loader_stress_" + std::to_string(i) + ".jpg";
+    if (!vkex::Bitmap::WriteJPG(path, width, height, 4, width * 4, pixels.data())) {
+      fprintf(stderr, "Failed to write %s\n", path.c_str());
+      return false;
+    }
+    p_paths->push_back(path);
+  }
+  return true;
+}
+
+static vkex::BitmapBatchLoader::LoadRequest MakeRequest(const vkex::fs::path& path)
+{
+  vkex::BitmapBatchLoader::LoadRequest request = {};
+  request.file_path   = path;
+  request.level_count = 0;
+  request.mip_filter  = vkex::Bitmap::MipFilterBox;
+  return request;
+}
+
+static bool Check(const char* name, const vkex::BitmapBatchLoader& loader, uint64_t ceiling)
+{
+  uint64_t limit         = std::max(ceiling, s_max_charged_size.load());
+  uint64_t peak_resident = s_peak_resident_size.load();
+  uint64_t peak_charged  = loader.GetPeakChargedSize();
+  bool     passed        = (peak_resident <= limit) && (peak_charged <= limit) && (loader.GetChargedSize() == 0);
+  printf("%-10s : peak resident %8.2f MiB, peak charged %8.2f MiB, limit %8.2f MiB : %s\n",
+    name,
+    peak_resident / (1024.0 * 1024.0),
+    peak_charged / (1024.0 * 1024.0),
+    limit / (1024.0 * 1024.0),
+    passed ? "ok" : "FAILED");
+  return passed;
+}
+
+int main(int argc, char** argv)
+{
+  uint32_t image_count = (argc > 1) ? static_cast<uint32_t>(std::max(1, atoi(argv[1]))) : 64;
+  uint64_t ceiling     = static_cast<uint64_t>((argc > 2) ? std::max(1, atoi(argv[2])) : 32) * 1024 * 1024;
+
+  std::vector<vkex::fs::path> paths;
+  if (!WriteImages(image_count, &paths)) {
+    return EXIT_FAILURE;
+  }
+
+  vkex::ThreadPool thread_pool;
+  std::mt19937     rng(2);
+  bool             passed = true;
+
+  // Futures, consumed in request order
+  {
+    s_peak_resident_size = 0;
+    s_max_charged_size   = 0;
+    vkex::BitmapBatchLoader loader(&thread_pool, ceiling);
+    std::vector<std::future<LoadResult>> futures;
+    for (uint32_t i = 0; i < image_count; ++i) {
+      futures.push_back(loader.Load(i, MakeRequest(paths[i])));
+    }
+    for (auto& future : futures) {
+      LoadResult result = future.get();
+      OnReceived(result);
+      Consume(&result, &rng);
+    }
+    passed &= Check("in order", loader, ceiling);
+  }
+
+  // Callbacks, the consumer holds up to four results at a time
+  {
+    s_peak_resident_size = 0;
+    s_max_charged_size   = 0;
+    vkex::BitmapBatchLoader loader(&thread_pool, ceiling);
+    std::mutex              mutex;
+    std::condition_variable cv;
+    std::deque<LoadResult>  received;
+    for (uint32_t i = 0; i < image_count; ++i) {
+      loader.Load(i, MakeRequest(paths[i]), [&](LoadResult& result) {
+        OnReceived(result);
+        std::lock_guard<std::mutex> lock(mutex);
+        received.push_back(std::move(result));
+        cv.notify_one();
+      });
+    }
+
+    // Held results are flushed when four have piled up or nothing else
+    // has arrived, waiting with charges held could stall the loader.
+    std::deque<LoadResult> held;
+    uint32_t               received_count = 0;
+    while ((received_count < image_count) || !held.empty()) {
+      bool flush = (held.size() >= 4) || (received_count == image_count);
+      {
+        std::unique_lock<std::mutex> lock(mutex);
+        if (!flush && received.empty() && !held.empty()) {
+          flush = true;
+        }
+        else if (!flush) {
+          cv.wait(lock, [&]() { return !received.empty(); });
+          held.push_back(std::move(received.front()));
+          received.pop_front();
+          ++received_count;
+        }
+      }
+      if (flush) {
+        for (auto& result : held) {
+          Consume(&result, &rng);
+        }
+        held.clear();
+      }
+    }
+    loader.WaitIdle();
+    passed &= Check("callbacks", loader, ceiling);
+  }
+
+  return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
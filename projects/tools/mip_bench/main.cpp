@@ -0,0 +1,185 @@
+/*
+ Copyright 2018-2019 Google Inc.
+ 
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+ 
+ http://www.apache.org/licenses/LICENSE-2.0
+ 
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+*/
+
+//
+// Compares read throughput of uncompressed and chunked LZ MIP files.
+//
+// Usage: mip_bench [file.mip] [iterations]
+//
+// Without a file a 4096x4096 RGBA8 image with a full mip chain is 
+// synthesized. Both variants are written next to the working directory and
+// each reader is timed over the given number of iterations. The first 
+// iteration warms the page cache, drop caches between runs to measure cold
+// reads.
+//
+
+#include "vkex/MIPFile.h"
+#include "vkex/ThreadPool.h"
+#include "vkex/Timer.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+
+static const char* k_uncompressed_path = "mip_bench_uncompressed.mip";
+static const char* k_compressed_path   = "mip_bench_compressed.mip";
+
+// Smooth gradients with a little noise, roughly what albedo content looks like
+static void SynthesizeMIPFile(uint32_t width, uint32_t height, MIPFile* p_mip_file)
+{
+  *p_mip_file = {};
+  p_mip_file->pixel_format = MIP_PIXEL_FORMAT_R8G8B8A8_UINT;
+
+  uint64_t data_size = 0;
+  uint32_t level     = 0;
+  while (level < MAX_MIP_LEVELS) {
+    MIPInfo& info    = p_mip_file->infos[level];
+    info.level       = level;
+    info.width       = width;
+    info.height      = height;
+    info.row_stride  = width * 4;
+    info.data_offset = data_size;
+    info.data_size   = static_cast<uint64_t>(info.row_stride) * height;
+    data_size += info.data_size;
+    ++level;
+    if ((width == 1) && (height == 1)) {
+      break;
+    }
+    width  = std::max<uint32_t>(1, width / 2);
+    height = std::max<uint32_t>(1, height / 2);
+  }
+  p_mip_file->level_count = level;
+
+  p_mip_file->data.resize(static_cast<size_t>(data_size));
+  uint32_t seed = 1;
+  for (uint32_t level = 0; level < p_mip_file->level_count; ++level) {
+    const MIPInfo& info   = p_mip_file->infos[level];
+    uint8_t*       p_data = p_mip_file->data.data() + info.data_offset;
+    for (uint32_t y = 0; y < info.height; ++y) {
+      for (uint32_t x = 0; x < info.width; ++x) {
+        seed = (seed * 1103515245) + 12345;
+        uint8_t  noise   = static_cast<uint8_t>((seed >> 16) & 0x3);
+        uint8_t* p_texel = p_data + (y * info.row_stride) + (x * 4);
+        p_texel[0] = static_cast<uint8_t>(((x * 255) / info.width) + noise);
+        p_texel[1] = static_cast<uint8_t>(((y * 255) / info.height) + noise);
+        p_texel[2] = static_cast<uint8_t>((((x + y) * 127) / (info.width + info.height)) + noise);
+        p_texel[3] = 255;
+      }
+    }
+  }
+}
+
+// Returns the average time in milliseconds, or a negative value on failure
+static double TimeLoad(uint32_t iterations, const std::function<bool(MIPFile*)>& load)
+{
+  double total_ms = 0.0;
+  for (uint32_t i = 0; i < iterations; ++i) {
+    MIPFile mip_file = {};
+    vkex::Timer timer;
+    timer.Start();
+    bool loaded = load(&mip_file);
+    timer.Stop();
+    if (!loaded) {
+      return -1.0;
+    }
+    total_ms += timer.Millis();
+  }
+  return total_ms / static_cast<double>(iterations);
+}
+
+static void PrintResult(const char* name, double ms, uint64_t data_size, uint64_t file_size)
+{
+  double mb_per_sec = (static_cast<double>(data_size) / (1024.0 * 1024.0)) / (ms / 1000.0);
+  printf("%-28s : %8.2f ms, %8.1f MB/s (file %.1f MB)\n", 
+    name, ms, mb_per_sec, static_cast<double>(file_size) / (1024.0 * 1024.0));
+}
+
+static uint64_t GetFileSize(const char* file_path)
+{
+  FILE* p_file = fopen(file_path, "rb");
+  if (p_file == nullptr) {
+    return 0;
+  }
+  fseek(p_file, 0, SEEK_END);
+  uint64_t size = static_cast<uint64_t>(ftell(p_file));
+  fclose(p_file);
+  return size;
+}
+
+int main(int argc, char** argv)
+{
+  uint32_t iterations = (argc > 2) ? static_cast<uint32_t>(std::max(1, atoi(argv[2]))) : 5;
+
+  MIPFile source = {};
+  if (argc > 1) {
+    if (!MIPLoadFile(argv[1], &source)) {
+      fprintf(stderr, "Failed to load %s\n", argv[1]);
+      return EXIT_FAILURE;
+    }
+  }
+  else {
+    SynthesizeMIPFile(4096, 4096, &source);
+  }
+
+  vkex::ThreadPool thread_pool;
+
+  vkex::Timer timer;
+  timer.Start();
+  bool written = MIPWriteFile(k_uncompressed_path, source) &&
+                 MIPWriteFileCompressed(k_compressed_path, source, MIP_DEFAULT_CHUNK_SIZE, &thread_pool);
+  timer.Stop();
+  if (!written) {
+    fprintf(stderr, "Failed to write benchmark files\n");
+    return EXIT_FAILURE;
+  }
+  printf("Wrote test files in %.2f ms, %u threads\n", timer.Millis(), thread_pool.GetThreadCount());
+
+  const uint64_t data_size         = static_cast<uint64_t>(source.data.size());
+  const uint64_t uncompressed_size = GetFileSize(k_uncompressed_path);
+  const uint64_t compressed_size   = GetFileSize(k_compressed_path);
+
+  double uncompressed_ms = TimeLoad(iterations, [](MIPFile* p_mip_file) {
+    return MIPLoadFile(k_uncompressed_path, p_mip_file);
+  });
+  double compressed_ms = TimeLoad(iterations, [](MIPFile* p_mip_file) {
+    return MIPLoadFile(k_compressed_path, p_mip_file);
+  });
+  double compressed_parallel_ms = TimeLoad(iterations, [&thread_pool](MIPFile* p_mip_file) {
+    return MIPLoadFile(k_compressed_path, p_mip_file, &thread_pool);
+  });
+  if ((uncompressed_ms < 0.0) || (compressed_ms < 0.0) || (compressed_parallel_ms < 0.0)) {
+    fprintf(stderr, "Failed to load benchmark files\n");
+    return EXIT_FAILURE;
+  }
+
+  // Round trip check
+  MIPFile loaded = {};
+  if (!MIPLoadFile(k_compressed_path, &loaded, &thread_pool) || (loaded.data != source.data)) {
+    fprintf(stderr, "Compressed file doesn't match the source data\n");
+    return EXIT_FAILURE;
+  }
+
+  PrintResult("Uncompressed", uncompressed_ms, data_size, uncompressed_size);
+  PrintResult("Chunked LZ", compressed_ms, data_size, compressed_size);
+  PrintResult("Chunked LZ (thread pool)", compressed_parallel_ms, data_size, compressed_size);
+
+  remove(k_uncompressed_path);
+  remove(k_compressed_path);
+
+  return EXIT_SUCCESS;
+}
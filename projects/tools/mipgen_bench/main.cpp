@@ -0,0 +1,165 @@
+/*
+ Copyright 2018-2019 Google Inc.
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+ http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+*/
+
+//
+// Compares Bitmap mip chain generation with the box and Kaiser filters
+// against stb_image_resize's Catmull-Rom.
+//
+// Usage: mipgen_bench [iterations]
+//
+// Builds full mip chains for synthesized 1K, 4K and 8K RGBA8 images and
+// 1K and 4K RGBA32F images, 8K float would need over 2 GiB. Each filter is
+// timed on the calling thread and on a ThreadPool. Creating a Bitmap with
+// one level is timed separately and subtracted so only mip generation is
+// reported.
+//
+
+#include "vkex/Bitmap.h"
+#include "vkex/ThreadPool.h"
+#include "vkex/Timer.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+struct BenchImage {
+  const char*           name;
+  VkFormat              format;
+  uint32_t              size;
+  uint32_t              texel_size;
+  std::vector<uint8_t>  data;
+};
+
+// Smooth gradients with a little noise, roughly what albedo content looks like
+static void SynthesizeImage(BenchImage* p_image)
+{
+  const uint32_t size      = p_image->size;
+  const bool     is_float  = (p_image->format == VK_FORMAT_R32G32B32A32_SFLOAT);
+  p_image->data.resize(static_cast<size_t>(size) * size * p_image->texel_size);
+
+  uint32_t seed = 1;
+  for (uint32_t y = 0; y < size; ++y) {
+    for (uint32_t x = 0; x < size; ++x) {
+      seed = (seed * 1103515245) + 12345;
+      uint32_t noise = (seed >> 16) & 0x3;
+      uint32_t values[4] = {
+        ((x * 255) / size) + noise,
+        ((y * 255) / size) + noise,
+        (((x + y) * 127) / (2 * size)) + noise,
+        255
+      };
+      size_t offset = ((static_cast<size_t>(y) * size) + x) * p_image->texel_size;
+      for (uint32_t c = 0; c < 4; ++c) {
+        if (is_float) {
+          float value = static_cast<float>(std::min<uint32_t>(values[c], 255)) / 255.0f;
+          std::memcpy(p_image->data.data() + offset + (c * sizeof(float)), &value, sizeof(float));
+        }
+        else {
+          p_image->data[offset + c] = static_cast<uint8_t>(std::min<uint32_t>(values[c], 255));
+        }
+      }
+    }
+  }
+}
+
+// Returns the average time in milliseconds, or a negative value on failure
+static double TimeCreate(
+  const BenchImage&       image,
+  uint32_t                level_count,
+  vkex::Bitmap::MipFilter mip_filter,
+  vkex::ThreadPool*       p_thread_pool,
+  uint32_t                iterations)
+{
+  double total_ms = 0.0;
+  for (uint32_t i = 0; i < iterations; ++i) {
+    vkex::Timer timer;
+    timer.Start();
+    vkex::Bitmap bitmap(
+      image.size,
+      image.size,
+      image.format,
+      level_count,
+      image.data.data(),
+      image.size * image.texel_size,
+      image.size,
+      mip_filter,
+      p_thread_pool);
+    timer.Stop();
+    if (!bitmap.IsValid()) {
+      return -1.0;
+    }
+    total_ms += timer.Millis();
+  }
+  return total_ms / static_cast<double>(iterations);
+}
+
+int main(int argc, char** argv)
+{
+  uint32_t iterations = (argc > 1) ? static_cast<uint32_t>(std::max(1, atoi(argv[1]))) : 3;
+
+  vkex::ThreadPool thread_pool;
+
+  std::vector<BenchImage> images = {
+    { "RGBA8",   VK_FORMAT_R8G8B8A8_UNORM,       1024, 4 },
+    { "RGBA8",   VK_FORMAT_R8G8B8A8_UNORM,       4096, 4 },
+    { "RGBA8",   VK_FORMAT_R8G8B8A8_UNORM,       8192, 4 },
+    { "RGBA32F", VK_FORMAT_R32G32B32A32_SFLOAT,  1024, 16 },
+    { "RGBA32F", VK_FORMAT_R32G32B32A32_SFLOAT,  4096, 16 },
+  };
+
+  struct {
+    const char*             name;
+    vkex::Bitmap::MipFilter filter;
+  } filters[] = {
+    { "stb Catmull-Rom", vkex::Bitmap::MipFilterCatmullRom },
+    { "box",             vkex::Bitmap::MipFilterBox },
+    { "Kaiser",          vkex::Bitmap::MipFilterKaiser },
+  };
+
+  printf("%u iterations, %u pool threads\n", iterations, thread_pool.GetThreadCount());
+  for (auto& image : images) {
+    SynthesizeImage(&image);
+
+    uint32_t level_count = 0;
+    vkex::Bitmap::CalculateMipLevelCount(image.size, image.size, &level_count);
+
+    double base_ms = TimeCreate(image, 1, vkex::Bitmap::MipFilterBox, nullptr, iterations);
+    if (base_ms < 0.0) {
+      fprintf(stderr, "Failed to create %s %ux%u\n", image.name, image.size, image.size);
+      return EXIT_FAILURE;
+    }
+
+    for (auto& filter : filters) {
+      double single_ms = TimeCreate(image, level_count, filter.filter, nullptr, iterations);
+      double pool_ms   = TimeCreate(image, level_count, filter.filter, &thread_pool, iterations);
+      if ((single_ms < 0.0) || (pool_ms < 0.0)) {
+        fprintf(stderr, "Failed to generate %s mips for %s %ux%u\n", filter.name, image.name, image.size, image.size);
+        return EXIT_FAILURE;
+      }
+      printf("%-8s %5u : %-16s : %9.2f ms, %9.2f ms on pool\n",
+        image.name, image.size, filter.name,
+        std::max(0.0, single_ms - base_ms), std::max(0.0, pool_ms - base_ms));
+    }
+
+    // Only one image is resident at a time
+    image.data.clear();
+    image.data.shrink_to_fit();
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,416 @@
+/*
+ Copyright 2018-2019 Google Inc.
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+ http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+*/
+
+//
+// Measures what slab allocating wrapper objects saves on a descriptor heavy
+// workload.
+//
+// Usage: slab_bench [count] [rounds]
+//
+// The wrapper pass stands in for descriptor sets: count objects the size of
+// a CDescriptorSet are created, every one is touched the way a descriptor
+// update does, and all of them are destroyed, rounds times. Objects are
+// allocated individually with std::make_unique between unrelated heap
+// allocations, as CreateObject used to, and from vkex::ObjectStorage. Heap
+// allocations are counted by replacing operator new and cache misses are
+// read from perf events where the kernel allows it. Create times include
+// the unrelated allocations, which are the same for both.
+//
+// If a Vulkan device is available the device pass allocates, updates and
+// frees count real descriptor sets each round and reports the allocations
+// per set after the first round.
+//
+
+#include "vkex/vkex.h"
+#include "vkex/Timer.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <random>
+#include <vector>
+
+#if defined(__linux__)
+# include <linux/perf_event.h>
+# include <sys/ioctl.h>
+# include <sys/syscall.h>
+# include <unistd.h>
+#endif
+
+// =================================================================================================
+// Allocation counting
+// =================================================================================================
+static std::atomic<uint64_t> s_allocation_count(0);
+
+void* operator new(size_t size)
+{
+  s_allocation_count.fetch_add(1, std::memory_order_relaxed);
+  void* p = malloc(size > 0 ? size : 1);
+  if (p == nullptr) {
+    throw std::bad_alloc();
+  }
+  return p;
+}
+
+void* operator new[](size_t size)
+{
+  return operator new(size);
+}
+
+void operator delete(void* p) noexcept
+{
+  free(p);
+}
+
+void operator delete[](void* p) noexcept
+{
+  free(p);
+}
+
+void operator delete(void* p, size_t) noexcept
+{
+  free(p);
+}
+
+void operator delete[](void* p, size_t) noexcept
+{
+  free(p);
+}
+
+// =================================================================================================
+// Cache miss counter
+// =================================================================================================
+class CacheMissCounter {
+public:
+  CacheMissCounter() {
+#if defined(__linux__)
+    perf_event_attr attr = {};
+    attr.type           = PERF_TYPE_HARDWARE;
+    attr.size           = sizeof(attr);
+    attr.config         = PERF_COUNT_HW_CACHE_MISSES;
+    attr.disabled       = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv     = 1;
+    m_fd = static_cast<int>(syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0));
+#endif
+  }
+
+  ~CacheMissCounter() {
+#if defined(__linux__)
+    if (m_fd >= 0) {
+      close(m_fd);
+    }
+#endif
+  }
+
+  bool IsAvailable() const {
+    return (m_fd >= 0);
+  }
+
+  void Start() {
+#if defined(__linux__)
+    if (m_fd >= 0) {
+      ioctl(m_fd, PERF_EVENT_IOC_RESET, 0);
+      ioctl(m_fd, PERF_EVENT_IOC_ENABLE, 0);
+    }
+#endif
+  }
+
+  uint64_t Stop() {
+    uint64_t count = 0;
+#if defined(__linux__)
+    if (m_fd >= 0) {
+      ioctl(m_fd, PERF_EVENT_IOC_DISABLE, 0);
+      if (read(m_fd, &count, sizeof(count)) != sizeof(count)) {
+        count = 0;
+      }
+    }
+#endif
+    return count;
+  }
+
+private:
+  int m_fd = -1;
+};
+
+// =================================================================================================
+// Wrapper pass
+// =================================================================================================
+struct FakeDescriptorSet : public vkex::IStoredObject {
+  uint64_t  vk_object = 0;
+  uint32_t  update_count = 0;
+  uint8_t   payload[sizeof(vkex::CDescriptorSet) - 12];
+};
+
+struct PassResult {
+  double    create_ms;
+  double    update_ms;
+  double    destroy_ms;
+  uint64_t  allocations;
+  uint64_t  cache_misses;
+};
+
+// Touches the object the way UpdateDescriptor() does, the handle and the
+// tracked binding state
+static void UpdateObject(FakeDescriptorSet* p_object)
+{
+  p_object->vk_object    += 1;
+  p_object->update_count += 1;
+  p_object->payload[p_object->update_count % sizeof(p_object->payload)] += 1;
+}
+
+// Unrelated allocations interleaved with object creation, like the
+// strings and vectors a loader creates alongside descriptor sets
+static void AllocateNoise(std::mt19937* p_rng, std::vector<std::unique_ptr<uint8_t[]>>* p_noise)
+{
+  size_t size = 16 + ((*p_rng)() % 512);
+  p_noise->emplace_back(new uint8_t[size]);
+}
+
+static void PrintResult(const char* name, uint32_t count, uint32_t rounds, const PassResult& result, bool has_cache_misses)
+{
+  printf("%-28s : create %8.2f ms, update %8.2f ms, destroy %8.2f ms, %.2f allocations per object",
+    name, result.create_ms, result.update_ms, result.destroy_ms,
+    static_cast<double>(result.allocations) / (static_cast<double>(count) * rounds));
+  if (has_cache_misses) {
+    printf(", %.2f cache misses per update", static_cast<double>(result.cache_misses) / (static_cast<double>(count) * rounds));
+  }
+  printf("\n");
+}
+
+static PassResult BenchMakeUnique(uint32_t count, uint32_t rounds, CacheMissCounter* p_counter)
+{
+  PassResult result = {};
+  std::mt19937 rng(1);
+  std::vector<std::unique_ptr<uint8_t[]>> noise;
+  noise.reserve(count);
+  std::vector<std::unique_ptr<FakeDescriptorSet>> objects;
+  objects.reserve(count);
+
+  vkex::Timer timer;
+  for (uint32_t round = 0; round < rounds; ++round) {
+    uint64_t allocation_count = s_allocation_count.load();
+    timer.Start();
+    for (uint32_t i = 0; i < count; ++i) {
+      objects.push_back(std::make_unique<FakeDescriptorSet>());
+      AllocateNoise(&rng, &noise);
+    }
+    timer.Stop();
+    result.create_ms   += timer.Millis();
+    result.allocations += s_allocation_count.load() - allocation_count - count;
+
+    p_counter->Start();
+    timer.Start();
+    for (auto& object : objects) {
+      UpdateObject(object.get());
+    }
+    timer.Stop();
+    result.cache_misses += p_counter->Stop();
+    result.update_ms    += timer.Millis();
+
+    std::shuffle(objects.begin(), objects.end(), rng);
+    timer.Start();
+    objects.clear();
+    timer.Stop();
+    result.destroy_ms += timer.Millis();
+    noise.clear();
+  }
+
+  return result;
+}
+
+static PassResult BenchObjectStorage(uint32_t count, uint32_t rounds, CacheMissCounter* p_counter)
+{
+  PassResult result = {};
+  std::mt19937 rng(1);
+  std::vector<std::unique_ptr<uint8_t[]>> noise;
+  noise.reserve(count);
+  vkex::ObjectStorage<FakeDescriptorSet> storage;
+  std::vector<FakeDescriptorSet*> objects;
+  objects.reserve(count);
+
+  vkex::Timer timer;
+  for (uint32_t round = 0; round < rounds; ++round) {
+    uint64_t allocation_count = s_allocation_count.load();
+    timer.Start();
+    for (uint32_t i = 0; i < count; ++i) {
+      objects.push_back(storage.Insert(storage.Allocate()));
+      AllocateNoise(&rng, &noise);
+    }
+    timer.Stop();
+    result.create_ms   += timer.Millis();
+    result.allocations += s_allocation_count.load() - allocation_count - count;
+
+    p_counter->Start();
+    timer.Start();
+    for (auto& object : objects) {
+      UpdateObject(object);
+    }
+    timer.Stop();
+    result.cache_misses += p_counter->Stop();
+    result.update_ms    += timer.Millis();
+
+    std::shuffle(objects.begin(), objects.end(), rng);
+    timer.Start();
+    for (auto& object : objects) {
+      storage.Remove(object);
+    }
+    timer.Stop();
+    result.destroy_ms += timer.Millis();
+    objects.clear();
+    noise.clear();
+  }
+
+  return result;
+}
+
+// =================================================================================================
+// Device pass
+// =================================================================================================
+static bool BenchDescriptorSets(uint32_t count, uint32_t rounds)
+{
+  vkex::Instance instance = nullptr;
+  {
+    vkex::InstanceCreateInfo create_info = {};
+    create_info.application_info.application_name = "slab_bench";
+    create_info.enable_swapchain                  = false;
+    if (!vkex::CreateInstanceVKEX(create_info, &instance)) {
+      return false;
+    }
+  }
+
+  vkex::PhysicalDevice physical_device = instance->FindPhysicalDevice(vkex::PhysicalDeviceCriteria());
+  if (physical_device == nullptr) {
+    vkex::DestroyInstanceVKEX(instance);
+    return false;
+  }
+
+  vkex::Device device = nullptr;
+  {
+    vkex::DeviceQueueCreateInfo queue_create_info = {};
+    queue_create_info.queue_type         = VK_QUEUE_GRAPHICS_BIT;
+    queue_create_info.queue_family_index = 0;
+    queue_create_info.queue_count        = 1;
+
+    vkex::DeviceCreateInfo create_info = {};
+    create_info.physical_device = physical_device;
+    create_info.safe_values     = true;
+    create_info.queue_create_infos.push_back(queue_create_info);
+    if (!instance->CreateDevice(create_info, &device)) {
+      vkex::DestroyInstanceVKEX(instance);
+      return false;
+    }
+  }
+
+  vkex::Buffer              buffer = nullptr;
+  vkex::DescriptorSetLayout layout = nullptr;
+  vkex::DescriptorPool      pool   = nullptr;
+  bool succeeded = true;
+  {
+    vkex::BufferCreateInfo create_info           = {};
+    create_info.size                             = 256;
+    create_info.usage_flags.bits.uniform_buffer  = true;
+    create_info.committed                        = true;
+    create_info.memory_usage                     = VMA_MEMORY_USAGE_GPU_ONLY;
+    succeeded = succeeded && !!device->CreateBuffer(create_info, &buffer);
+  }
+  if (succeeded) {
+    VkDescriptorSetLayoutBinding binding = {};
+    binding.binding         = 0;
+    binding.descriptorType  = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+    binding.descriptorCount = 1;
+    binding.stageFlags      = VK_SHADER_STAGE_ALL;
+    vkex::DescriptorSetLayoutCreateInfo create_info = {};
+    create_info.bindings.push_back(binding);
+    succeeded = !!device->CreateDescriptorSetLayout(create_info, &layout);
+  }
+  if (succeeded) {
+    vkex::DescriptorPoolCreateInfo create_info        = {};
+    create_info.flags.bits.free_descriptor_set        = true;
+    create_info.max_sets                              = count;
+    create_info.pool_sizes.uniform_buffer             = count;
+    succeeded = !!device->CreateDescriptorPool(create_info, &pool);
+  }
+
+  vkex::DescriptorSetAllocateInfo allocate_info = {};
+  allocate_info.layouts.push_back(layout);
+
+  uint64_t warm_allocations = 0;
+  double   total_ms         = 0.0;
+  std::vector<vkex::DescriptorSet> descriptor_sets(count);
+  for (uint32_t round = 0; (round < rounds) && succeeded; ++round) {
+    uint64_t allocation_count = s_allocation_count.load();
+    vkex::Timer timer;
+    timer.Start();
+    for (uint32_t i = 0; (i < count) && succeeded; ++i) {
+      succeeded = !!pool->AllocateDescriptorSet(allocate_info, &descriptor_sets[i]);
+      if (succeeded) {
+        descriptor_sets[i]->UpdateDescriptor(0, buffer);
+      }
+    }
+    for (auto& descriptor_set : descriptor_sets) {
+      pool->FreeDescriptorSet(descriptor_set);
+    }
+    timer.Stop();
+    if (round > 0) {
+      warm_allocations += s_allocation_count.load() - allocation_count;
+      total_ms         += timer.Millis();
+    }
+  }
+
+  if (succeeded && (rounds > 1)) {
+    double set_count = static_cast<double>(count) * (rounds - 1);
+    printf("%-28s : %8.2f ms per round, %.2f allocations per set after warm-up\n",
+      "CDescriptorSet", total_ms / (rounds - 1), static_cast<double>(warm_allocations) / set_count);
+  }
+  else if (!succeeded) {
+    fprintf(stderr, "Descriptor set pass failed\n");
+  }
+
+  // Destroys everything else
+  instance->DestroyDevice(device);
+  vkex::DestroyInstanceVKEX(instance);
+
+  return true;
+}
+
+int main(int argc, char** argv)
+{
+  uint32_t count  = (argc > 1) ? static_cast<uint32_t>(std::max(1, atoi(argv[1]))) : 100000;
+  uint32_t rounds = (argc > 2) ? static_cast<uint32_t>(std::max(2, atoi(argv[2]))) : 8;
+
+  CacheMissCounter counter;
+  printf("%u objects of %u bytes, %u rounds\n",
+    count, static_cast<uint32_t>(sizeof(FakeDescriptorSet)), rounds);
+  if (!counter.IsAvailable()) {
+    printf("perf events unavailable, cache misses not measured\n");
+  }
+
+  PassResult make_unique_result = BenchMakeUnique(count, rounds, &counter);
+  PassResult storage_result     = BenchObjectStorage(count, rounds, &counter);
+  PrintResult("std::make_unique", count, rounds, make_unique_result, counter.IsAvailable());
+  PrintResult("vkex::ObjectStorage", count, rounds, storage_result, counter.IsAvailable());
+
+  if (!BenchDescriptorSets(count, rounds)) {
+    printf("No Vulkan device, skipped descriptor sets\n");
+  }
+
+  return EXIT_SUCCESS;
+}
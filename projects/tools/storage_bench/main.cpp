@@ -0,0 +1,201 @@
+/*
+ Copyright 2018-2019 Google Inc.
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+ http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+*/
+
+//
+// Measures object create/destroy churn through vkex's object storage.
+//
+// Usage: storage_bench [count]
+//
+// Creates count objects (default 100000) and destroys them in random order.
+// The storage itself is timed against the linear search and erase that the
+// device used before, then count buffers are created and destroyed through
+// a headless device. The device pass is skipped if no Vulkan device is
+// available. Buffers aren't committed so the timings are handle creation
+// and storage, not memory allocation.
+//
+
+#include "vkex/vkex.h"
+#include "vkex/Timer.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <numeric>
+#include <random>
+#include <vector>
+
+struct StoredValue : public vkex::IStoredObject {
+  uint32_t value = 0;
+};
+
+static std::vector<uint32_t> ShuffledOrder(uint32_t count)
+{
+  std::vector<uint32_t> order(count);
+  std::iota(order.begin(), order.end(), 0);
+  std::mt19937 rng(1);
+  std::shuffle(order.begin(), order.end(), rng);
+  return order;
+}
+
+static void PrintResult(const char* name, uint32_t count, double create_ms, double destroy_ms)
+{
+  printf("%-28s : create %9.2f ms, destroy %9.2f ms (%.1f ns per destroy)\n",
+    name, create_ms, destroy_ms, (destroy_ms * 1000000.0) / static_cast<double>(count));
+}
+
+// Find and erase over a vector, what DestroyObject did before ObjectStorage
+static void BenchVectorStorage(uint32_t count, const std::vector<uint32_t>& order)
+{
+  std::vector<std::unique_ptr<StoredValue>> storage;
+  std::vector<StoredValue*> handles(count);
+
+  vkex::Timer timer;
+  timer.Start();
+  for (uint32_t i = 0; i < count; ++i) {
+    std::unique_ptr<StoredValue> object = std::make_unique<StoredValue>();
+    object->value = i;
+    handles[i] = object.get();
+    storage.push_back(std::move(object));
+  }
+  timer.Stop();
+  double create_ms = timer.Millis();
+
+  timer.Start();
+  for (uint32_t i : order) {
+    StoredValue* handle = handles[i];
+    auto it = std::find_if(storage.begin(), storage.end(),
+      [handle](const std::unique_ptr<StoredValue>& elem) -> bool {
+        return elem.get() == handle; });
+    storage.erase(it);
+  }
+  timer.Stop();
+  double destroy_ms = timer.Millis();
+
+  PrintResult("std::vector", count, create_ms, destroy_ms);
+}
+
+static void BenchObjectStorage(uint32_t count, const std::vector<uint32_t>& order)
+{
+  vkex::ObjectStorage<StoredValue> storage;
+  std::vector<StoredValue*> handles(count);
+
+  vkex::Timer timer;
+  timer.Start();
+  for (uint32_t i = 0; i < count; ++i) {
+    vkex::ObjectStorage<StoredValue>::Pointer object = storage.Allocate();
+    object->value = i;
+    handles[i] = storage.Insert(std::move(object));
+  }
+  timer.Stop();
+  double create_ms = timer.Millis();
+
+  timer.Start();
+  for (uint32_t i : order) {
+    storage.Remove(handles[i]);
+  }
+  timer.Stop();
+  double destroy_ms = timer.Millis();
+
+  PrintResult("vkex::ObjectStorage", count, create_ms, destroy_ms);
+}
+
+static bool BenchDeviceBuffers(uint32_t count, const std::vector<uint32_t>& order)
+{
+  vkex::Instance instance = nullptr;
+  {
+    vkex::InstanceCreateInfo create_info = {};
+    create_info.application_info.application_name = "storage_bench";
+    create_info.enable_swapchain                  = false;
+    if (!vkex::CreateInstanceVKEX(create_info, &instance)) {
+      return false;
+    }
+  }
+
+  vkex::PhysicalDevice physical_device = instance->FindPhysicalDevice(vkex::PhysicalDeviceCriteria());
+  if (physical_device == nullptr) {
+    vkex::DestroyInstanceVKEX(instance);
+    return false;
+  }
+
+  vkex::Device device = nullptr;
+  {
+    vkex::DeviceQueueCreateInfo queue_create_info = {};
+    queue_create_info.queue_type         = VK_QUEUE_GRAPHICS_BIT;
+    queue_create_info.queue_family_index = 0;
+    queue_create_info.queue_count        = 1;
+
+    vkex::DeviceCreateInfo create_info = {};
+    create_info.physical_device = physical_device;
+    create_info.safe_values     = true;
+    create_info.queue_create_infos.push_back(queue_create_info);
+    if (!instance->CreateDevice(create_info, &device)) {
+      vkex::DestroyInstanceVKEX(instance);
+      return false;
+    }
+  }
+
+  vkex::BufferCreateInfo create_info           = {};
+  create_info.size                             = 256;
+  create_info.usage_flags.bits.uniform_buffer  = true;
+  create_info.committed                        = false;
+
+  std::vector<vkex::Buffer> buffers(count);
+  bool succeeded = true;
+
+  vkex::Timer timer;
+  timer.Start();
+  for (uint32_t i = 0; (i < count) && succeeded; ++i) {
+    succeeded = !!device->CreateBuffer(create_info, &buffers[i]);
+  }
+  timer.Stop();
+  double create_ms = timer.Millis();
+
+  if (succeeded) {
+    timer.Start();
+    for (uint32_t i : order) {
+      device->DestroyBuffer(buffers[i]);
+    }
+    timer.Stop();
+    double destroy_ms = timer.Millis();
+
+    PrintResult("CDevice buffers", count, create_ms, destroy_ms);
+  }
+  else {
+    fprintf(stderr, "Failed to create buffers\n");
+  }
+
+  // Destroys whatever is left
+  instance->DestroyDevice(device);
+  vkex::DestroyInstanceVKEX(instance);
+
+  return true;
+}
+
+int main(int argc, char** argv)
+{
+  uint32_t count = (argc > 1) ? static_cast<uint32_t>(std::max(1, atoi(argv[1]))) : 100000;
+
+  std::vector<uint32_t> order = ShuffledOrder(count);
+
+  BenchVectorStorage(count, order);
+  BenchObjectStorage(count, order);
+  if (!BenchDeviceBuffers(count, order)) {
+    printf("No Vulkan device, skipped device buffers\n");
+  }
+
+  return EXIT_SUCCESS;
+}
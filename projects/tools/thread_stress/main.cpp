@@ -0,0 +1,288 @@
+/*
+ Copyright 2018-2019 Google Inc.
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+ http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+*/
+
+//
+// Stress test for creating and destroying device objects from many threads.
+//
+// Usage: thread_stress [threads] [objects per thread] [rounds]
+//
+// Each round every thread creates buffers, images, samplers, fences and
+// semaphores and allocates command buffers from its own command pool.
+// Then every thread destroys the objects another thread created, in random
+// order, while creating a new set of its own. Exits with EXIT_FAILURE if
+// any create or destroy fails.
+//
+// Needs no window or GPU, run it under a software ICD such as lavapipe or
+// SwiftShader to get repeatable results on CI machines:
+//
+//   VK_ICD_FILENAMES=/usr/share/vulkan/icd.d/lvp_icd.x86_64.json thread_stress
+//
+// Build with -fsanitize=thread to check the storage for races.
+//
+
+#include "vkex/vkex.h"
+#include "vkex/Timer.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <thread>
+#include <vector>
+
+struct ThreadObjects {
+  vkex::CommandPool                 command_pool = nullptr;
+  std::vector<vkex::CommandBuffer>  command_buffers;
+  std::vector<vkex::Buffer>         buffers;
+  std::vector<vkex::Image>          images;
+  std::vector<vkex::Sampler>        samplers;
+  std::vector<vkex::Fence>          fences;
+  std::vector<vkex::Semaphore>      semaphores;
+};
+
+static std::atomic<uint32_t> s_failure_count(0);
+
+static void Check(vkex::Result vkex_result, const char* what)
+{
+  if (!vkex_result) {
+    if (s_failure_count.fetch_add(1) == 0) {
+      fprintf(stderr, "%s failed: %d\n", what, static_cast<int>(vkex_result.GetValue()));
+    }
+  }
+}
+
+static void CreateObjects(vkex::Device device, uint32_t count, ThreadObjects* p_objects)
+{
+  // Command pools are externally synchronized, each thread gets its own
+  if (p_objects->command_pool == nullptr) {
+    vkex::CommandPoolCreateInfo create_info = {};
+    create_info.flags.bits.reset_command_buffer = true;
+    create_info.queue_family_index              = 0;
+    Check(device->CreateCommandPool(create_info, &p_objects->command_pool), "CreateCommandPool");
+    if (p_objects->command_pool == nullptr) {
+      return;
+    }
+  }
+
+  for (uint32_t i = 0; i < count; ++i) {
+    {
+      vkex::BufferCreateInfo create_info           = {};
+      create_info.size                             = 256 * (1 + (i % 16));
+      create_info.usage_flags.bits.uniform_buffer  = true;
+      create_info.committed                        = true;
+      create_info.memory_usage                     = VMA_MEMORY_USAGE_GPU_ONLY;
+      vkex::Buffer buffer = nullptr;
+      Check(device->CreateBuffer(create_info, &buffer), "CreateBuffer");
+      if (buffer != nullptr) {
+        p_objects->buffers.push_back(buffer);
+      }
+    }
+    {
+      vkex::ImageCreateInfo create_info     = {};
+      create_info.image_type                = VK_IMAGE_TYPE_2D;
+      create_info.format                    = VK_FORMAT_R8G8B8A8_UNORM;
+      create_info.extent                    = { 64, 64, 1 };
+      create_info.mip_levels                = 1;
+      create_info.array_layers              = 1;
+      create_info.samples                   = VK_SAMPLE_COUNT_1_BIT;
+      create_info.tiling                    = VK_IMAGE_TILING_OPTIMAL;
+      create_info.usage_flags.bits.sampled  = true;
+      create_info.sharing_mode              = VK_SHARING_MODE_EXCLUSIVE;
+      create_info.initial_layout            = VK_IMAGE_LAYOUT_UNDEFINED;
+      create_info.committed                 = true;
+      create_info.memory_usage              = VMA_MEMORY_USAGE_GPU_ONLY;
+      vkex::Image image = nullptr;
+      Check(device->CreateImage(create_info, &image), "CreateImage");
+      if (image != nullptr) {
+        p_objects->images.push_back(image);
+      }
+    }
+    {
+      vkex::SamplerCreateInfo create_info = {};
+      create_info.mag_filter      = VK_FILTER_LINEAR;
+      create_info.min_filter      = VK_FILTER_LINEAR;
+      create_info.mipmap_mode     = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+      create_info.address_mode_u  = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+      create_info.address_mode_v  = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+      create_info.address_mode_w  = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+      vkex::Sampler sampler = nullptr;
+      Check(device->CreateSampler(create_info, &sampler), "CreateSampler");
+      if (sampler != nullptr) {
+        p_objects->samplers.push_back(sampler);
+      }
+    }
+    {
+      vkex::FenceCreateInfo create_info = {};
+      vkex::Fence fence = nullptr;
+      Check(device->CreateFence(create_info, &fence), "CreateFence");
+      if (fence != nullptr) {
+        p_objects->fences.push_back(fence);
+      }
+    }
+    {
+      vkex::SemaphoreCreateInfo create_info = {};
+      vkex::Semaphore semaphore = nullptr;
+      Check(device->CreateSemaphore(create_info, &semaphore), "CreateSemaphore");
+      if (semaphore != nullptr) {
+        p_objects->semaphores.push_back(semaphore);
+      }
+    }
+    {
+      vkex::CommandBufferAllocateInfo allocate_info = {};
+      allocate_info.command_buffer_count = 1;
+      vkex::CommandBuffer command_buffer = nullptr;
+      Check(p_objects->command_pool->AllocateCommandBuffer(allocate_info, &command_buffer), "AllocateCommandBuffer");
+      if (command_buffer != nullptr) {
+        p_objects->command_buffers.push_back(command_buffer);
+      }
+    }
+  }
+}
+
+template <typename HandleT, typename DestroyFnT>
+static void DestroyShuffled(std::vector<HandleT>* p_handles, std::mt19937* p_rng, DestroyFnT destroy)
+{
+  std::shuffle(p_handles->begin(), p_handles->end(), *p_rng);
+  for (auto& handle : *p_handles) {
+    destroy(handle);
+  }
+  p_handles->clear();
+}
+
+// Destroys objects created by another thread. Command buffers are freed by
+// the thread that owns their pool.
+static void DestroyObjects(vkex::Device device, uint32_t seed, ThreadObjects* p_objects)
+{
+  std::mt19937 rng(seed);
+  DestroyShuffled(&p_objects->buffers, &rng, [device](vkex::Buffer object) {
+    Check(device->DestroyBuffer(object), "DestroyBuffer"); });
+  DestroyShuffled(&p_objects->images, &rng, [device](vkex::Image object) {
+    Check(device->DestroyImage(object), "DestroyImage"); });
+  DestroyShuffled(&p_objects->samplers, &rng, [device](vkex::Sampler object) {
+    Check(device->DestroySampler(object), "DestroySampler"); });
+  DestroyShuffled(&p_objects->fences, &rng, [device](vkex::Fence object) {
+    Check(device->DestroyFence(object), "DestroyFence"); });
+  DestroyShuffled(&p_objects->semaphores, &rng, [device](vkex::Semaphore object) {
+    Check(device->DestroySemaphore(object), "DestroySemaphore"); });
+}
+
+static void FreeCommandBuffers(ThreadObjects* p_objects)
+{
+  if (p_objects->command_pool != nullptr) {
+    p_objects->command_pool->FreeCommandBuffers(&p_objects->command_buffers);
+  }
+  p_objects->command_buffers.clear();
+}
+
+template <typename Fn>
+static void RunThreads(uint32_t thread_count, Fn fn)
+{
+  std::vector<std::thread> threads;
+  for (uint32_t i = 0; i < thread_count; ++i) {
+    threads.emplace_back(fn, i);
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+}
+
+int main(int argc, char** argv)
+{
+  uint32_t thread_count = (argc > 1) ? static_cast<uint32_t>(std::max(1, atoi(argv[1]))) : 8;
+  uint32_t object_count = (argc > 2) ? static_cast<uint32_t>(std::max(1, atoi(argv[2]))) : 1000;
+  uint32_t round_count  = (argc > 3) ? static_cast<uint32_t>(std::max(1, atoi(argv[3]))) : 4;
+
+  vkex::Instance instance = nullptr;
+  {
+    vkex::InstanceCreateInfo create_info = {};
+    create_info.application_info.application_name = "thread_stress";
+    create_info.enable_swapchain                  = false;
+    if (!vkex::CreateInstanceVKEX(create_info, &instance)) {
+      fprintf(stderr, "Failed to create instance\n");
+      return EXIT_FAILURE;
+    }
+  }
+
+  vkex::PhysicalDevice physical_device = instance->FindPhysicalDevice(vkex::PhysicalDeviceCriteria());
+  if (physical_device == nullptr) {
+    fprintf(stderr, "No Vulkan device\n");
+    vkex::DestroyInstanceVKEX(instance);
+    return EXIT_FAILURE;
+  }
+
+  vkex::Device device = nullptr;
+  {
+    vkex::DeviceQueueCreateInfo queue_create_info = {};
+    queue_create_info.queue_type         = VK_QUEUE_GRAPHICS_BIT;
+    queue_create_info.queue_family_index = 0;
+    queue_create_info.queue_count        = 1;
+
+    vkex::DeviceCreateInfo create_info = {};
+    create_info.physical_device = physical_device;
+    create_info.safe_values     = true;
+    create_info.queue_create_infos.push_back(queue_create_info);
+    if (!instance->CreateDevice(create_info, &device)) {
+      fprintf(stderr, "Failed to create device\n");
+      vkex::DestroyInstanceVKEX(instance);
+      return EXIT_FAILURE;
+    }
+  }
+
+  printf("%s: %u threads, %u objects per thread, %u rounds\n",
+    physical_device->GetDeviceName(), thread_count, object_count, round_count);
+
+  std::vector<ThreadObjects> current(thread_count);
+  std::vector<ThreadObjects> previous(thread_count);
+
+  vkex::Timer timer;
+  timer.Start();
+
+  RunThreads(thread_count, [&](uint32_t thread_index) {
+    CreateObjects(device, object_count, &current[thread_index]);
+  });
+
+  for (uint32_t round = 0; round < round_count; ++round) {
+    for (uint32_t i = 0; i < thread_count; ++i) {
+      FreeCommandBuffers(&current[i]);
+      std::swap(current[i], previous[i]);
+      current[i].command_pool = previous[i].command_pool;
+    }
+
+    // Each thread creates a new set while destroying its neighbour's
+    RunThreads(thread_count, [&](uint32_t thread_index) {
+      uint32_t neighbour = (thread_index + 1) % thread_count;
+      CreateObjects(device, object_count, &current[thread_index]);
+      DestroyObjects(device, (round * thread_count) + thread_index, &previous[neighbour]);
+    });
+  }
+
+  RunThreads(thread_count, [&](uint32_t thread_index) {
+    FreeCommandBuffers(&current[thread_index]);
+    DestroyObjects(device, thread_index, &current[thread_index]);
+    Check(device->DestroyCommandPool(current[thread_index].command_pool), "DestroyCommandPool");
+  });
+
+  timer.Stop();
+
+  instance->DestroyDevice(device);
+  vkex::DestroyInstanceVKEX(instance);
+
+  uint32_t failure_count = s_failure_count.load();
+  printf("%s in %.2f ms, %u failures\n", (failure_count == 0) ? "Passed" : "FAILED", timer.Millis(), failure_count);
+
+  return (failure_count == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
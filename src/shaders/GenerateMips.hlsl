@@ -0,0 +1,42 @@
+/*
+ Copyright 2018-2019 Google Inc.
+ 
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+ 
+ http://www.apache.org/licenses/LICENSE-2.0
+ 
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+*/
+
+#include "Common.h"
+
+// Previous MIP level and the level being written. Neither has a format
+// qualifier so any storage image format works.
+RWTexture2D<float4> Src : register(u0);
+RWTexture2D<float4> Dst : register(u1);
+
+// 2x2 box filter, edge texels are repeated for odd sized sources
+[numthreads(8, 8, 1)]
+void csmain(uint3 tid : SV_DispatchThreadID)
+{
+  uint2 dst_size;
+  Dst.GetDimensions(dst_size.x, dst_size.y);
+  if (any(tid.xy >= dst_size)) {
+    return;
+  }
+
+  uint2 src_size;
+  Src.GetDimensions(src_size.x, src_size.y);
+
+  uint2 p0 = min(tid.xy * 2, src_size - 1);
+  uint2 p1 = min(p0 + 1, src_size - 1);
+
+  float4 color = Src[p0] + Src[uint2(p1.x, p0.y)] + Src[uint2(p0.x, p1.y)] + Src[p1];
+  Dst[tid.xy] = 0.25 * color;
+}
@@ -16,6 +16,7 @@
 
 #include "vkex/Application.h"
 #include "vkex/Bitmap.h"
+#include "vkex/PixelConvert.h"
 #include "vkex/Util.h"
 #include "vkex/VulkanUtil.h"
 
@@ -28,6 +29,7 @@
 #include <examples/imgui_impl_glfw.h>
 #include <examples/imgui_impl_vulkan.h>
 
+#include <algorithm>
 #include <map>
 
 namespace vkex {
@@ -41,6 +43,7 @@ const VkAttachmentLoadOp  kDefaultDepthLoadOp     = VK_ATTACHMENT_LOAD_OP_CLEAR;
 const VkAttachmentStoreOp kDefaultDepthStoreOp    = VK_ATTACHMENT_STORE_OP_STORE;
 const VkAttachmentLoadOp  kDefaultStencilLoadOp   = VK_ATTACHMENT_LOAD_OP_CLEAR;
 const VkAttachmentStoreOp kDefaultStencilStoreOp  = VK_ATTACHMENT_STORE_OP_STORE;
+const VkDeviceSize        kDefaultConstantAllocatorSize = 1024 * 1024;
 
 enum {
   kDefaultPhysicalDeviceIndex = 0,
@@ -337,11 +340,12 @@ Application::RenderData::~RenderData()
 {
 }
 
-vkex::Result Application::RenderData::InternalCreate(vkex::Device device, uint32_t frame_index, vkex::CommandBuffer cmd)
+vkex::Result Application::RenderData::InternalCreate(vkex::Device device, uint32_t frame_index, vkex::CommandBuffer cmd, vkex::CommandBuffer acquire_cmd, VkDeviceSize constant_allocator_size)
 {
   m_device = device;
   m_frame_index = frame_index;
   m_work_cmd = cmd;
+  m_acquire_cmd = acquire_cmd;
 
   // Work complete semaphore
   {
@@ -370,6 +374,18 @@ vkex::Result Application::RenderData::InternalCreate(vkex::Device device, uint32
     }
   }
 
+  // Constant allocator
+  {
+    vkex::Result vkex_result = vkex::Result::Undefined;
+    VKEX_RESULT_CALL(
+      vkex_result,
+      m_constant_allocator.Initialize(m_device, constant_allocator_size)
+    );
+    if (!vkex_result) {
+      return vkex_result;
+    }
+  }
+
   return vkex::Result::Success;
 }
 
@@ -399,6 +415,18 @@ vkex::Result Application::RenderData::InternalDestroy()
     }
   }
 
+  // Constant allocator
+  {
+    vkex::Result vkex_result = vkex::Result::Undefined;
+    VKEX_RESULT_CALL(
+      vkex_result,
+      m_constant_allocator.Destroy()
+    );
+    if (!vkex_result) {
+      return vkex_result;
+    }
+  }
+
   return vkex::Result::Success;
 }
        
@@ -790,6 +818,22 @@ vkex::Result Application::InitializeVkexDevice()
     }
   }
 
+  // Find transfer only queue, uploads use the graphics queue if there isn't one
+  uint32_t transfer_queue_family_index = UINT32_MAX;
+  {
+    auto& queue_family_properties = physical_device->GetQueueFamilyProperties();
+    const uint32_t count = CountU32(queue_family_properties);
+    for (uint32_t i = 0; i < count; ++i) {
+      auto& properties = queue_family_properties[i].queueFamilyProperties;
+      bool transfer_only = (properties.queueFlags & VK_QUEUE_TRANSFER_BIT) &&
+                           !(properties.queueFlags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT));
+      if (transfer_only && (properties.queueCount > 0)) {
+        transfer_queue_family_index = i;
+        break;
+      }
+    }
+  }
+
   // Device
   {
     vkex::DeviceQueueCreateInfo queue_create_info = {};
@@ -798,9 +842,18 @@ vkex::Result Application::InitializeVkexDevice()
     queue_create_info.queue_count = 1;
 
     vkex::DeviceCreateInfo device_create_info = {};
-    device_create_info.physical_device  = physical_device;
-    device_create_info.safe_values      = true;
+    device_create_info.physical_device              = physical_device;
+    device_create_info.safe_values                  = true;
+    device_create_info.host_allocator.enable        = m_configuration.host_memory.enable;
+    device_create_info.host_allocator.command_arena = m_configuration.host_memory.command_arena;
     device_create_info.queue_create_infos.push_back(queue_create_info);
+    if (transfer_queue_family_index != UINT32_MAX) {
+      vkex::DeviceQueueCreateInfo transfer_queue_create_info = {};
+      transfer_queue_create_info.queue_type = VK_QUEUE_TRANSFER_BIT;
+      transfer_queue_create_info.queue_family_index = transfer_queue_family_index;
+      transfer_queue_create_info.queue_count = 1;
+      device_create_info.queue_create_infos.push_back(transfer_queue_create_info);
+    }
     vkex::Result vkex_result = vkex::Result::Undefined;
     VKEX_RESULT_CALL(
       vkex_result,
@@ -851,7 +904,7 @@ vkex::Result Application::InitializeVkexDevice()
         vkex_result,
         m_device->GetQueue(
           VK_QUEUE_TRANSFER_BIT, 
-          graphics_queue_family_index, 
+          (transfer_queue_family_index != UINT32_MAX) ? transfer_queue_family_index : graphics_queue_family_index, 
           kDefaultQueueIndex, 
           &m_transfer_queue)
       );
@@ -911,6 +964,49 @@ vkex::Result Application::InitializeVkexDevice()
   return vkex::Result::Success;
 }
 
+vkex::Result Application::CreateVkexImageMemoryPool(VkFormat format, VkImageUsageFlags usage, VmaPool* p_pool)
+{
+  VkImageCreateInfo image_create_info = { VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO };
+  //image_create_info.flags                 = m_create_info.create_flags;
+  image_create_info.imageType             = VK_IMAGE_TYPE_2D;
+  image_create_info.format                = format;
+  image_create_info.extent                = { m_configuration.window.width, m_configuration.window.height, 1 };
+  image_create_info.mipLevels             = 1;
+  image_create_info.arrayLayers           = 1;
+  image_create_info.samples               = VK_SAMPLE_COUNT_1_BIT;
+  image_create_info.tiling                = VK_IMAGE_TILING_OPTIMAL;
+  image_create_info.usage                 = usage;
+  image_create_info.sharingMode           = VK_SHARING_MODE_EXCLUSIVE;
+  image_create_info.queueFamilyIndexCount = 0;
+  image_create_info.pQueueFamilyIndices   = nullptr;
+  image_create_info.initialLayout         = VK_IMAGE_LAYOUT_UNDEFINED;
+
+  VmaAllocationCreateInfo allocate_info = {};
+  allocate_info.usage = VMA_MEMORY_USAGE_GPU_ONLY; 
+
+  VmaPoolCreateInfo create_info = {};
+  VkResult vk_result = vmaFindMemoryTypeIndexForImageInfo(
+    GetDevice()->GetVmaAllocator(),
+    &image_create_info,
+    &allocate_info,
+    &create_info.memoryTypeIndex);
+  VKEX_ASSERT_MSG(vk_result == VK_SUCCESS, "Unable to find memory type for swapchain image memory pool");
+  if (vk_result != VK_SUCCESS) {
+    return vkex::Result(vk_result);
+  }
+
+  vk_result = vmaCreatePool(
+    GetDevice()->GetVmaAllocator(),
+    &create_info,
+    p_pool);
+  VKEX_ASSERT_MSG(vk_result == VK_SUCCESS, "Failed to create swapchain image memory pool");
+  if (vk_result != VK_SUCCESS) {
+    return vkex::Result(vk_result);
+  }
+
+  return vkex::Result::Success;
+}
+
 vkex::Result Application::InitializeVkexSwapchainImageMemoryPool()
 {
   // 
@@ -927,213 +1023,80 @@ vkex::Result Application::InitializeVkexSwapchainImageMemoryPool()
   //
   // To avoid these validation warnings, swapchain DSV images
   // uses a separate memory pool.
+  //
+  // In headless mode the offscreen color targets are allocated
+  // from this pool and the depth/stencil targets get a pool of
+  // their own, the memory types for the two formats may differ.
   // 
 
-  if (m_configuration.swapchain.depth_stencil_format != VK_FORMAT_UNDEFINED) {
+  bool has_depth_stencil = (m_configuration.swapchain.depth_stencil_format != VK_FORMAT_UNDEFINED);
+  if (IsApplicationModeHeadless()) {
+    // Usage matches InitializeVkexHeadlessTargets()
     ImageUsageFlags usage = {};
-    usage.bits.transfer_src = true;
-    usage.bits.transfer_dst = true;
-    usage.bits.sampled      = true;
-    usage.bits.depth_stencil_attachment = true;
-
-    VkImageCreateInfo image_create_info = { VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO };
-    //image_create_info.flags                 = m_create_info.create_flags;
-    image_create_info.imageType             = VK_IMAGE_TYPE_2D;
-    image_create_info.format                = m_configuration.swapchain.depth_stencil_format;
-    image_create_info.extent                = { m_configuration.window.width, m_configuration.window.height, 1 };
-    image_create_info.mipLevels             = 1;
-    image_create_info.arrayLayers           = 1;
-    image_create_info.samples               = VK_SAMPLE_COUNT_1_BIT;
-    image_create_info.tiling                = VK_IMAGE_TILING_OPTIMAL;
-    image_create_info.usage                 = usage.flags;
-    image_create_info.sharingMode           = VK_SHARING_MODE_EXCLUSIVE;
-    image_create_info.queueFamilyIndexCount = 0;
-    image_create_info.pQueueFamilyIndices   = nullptr;
-    image_create_info.initialLayout         = VK_IMAGE_LAYOUT_UNDEFINED;
-
-    VmaAllocationCreateInfo allocate_info = {};
-    allocate_info.usage = VMA_MEMORY_USAGE_GPU_ONLY; 
-
-    VmaPoolCreateInfo create_info = {};
-    VkResult vk_result = vmaFindMemoryTypeIndexForImageInfo(
-      GetDevice()->GetVmaAllocator(),
-      &image_create_info,
-      &allocate_info,
-      &create_info.memoryTypeIndex);
-    VKEX_ASSERT_MSG(vk_result == VK_SUCCESS, "Unable to find memory type for swapchain image memory pool");
-    if (vk_result != VK_SUCCESS) {
-      return vkex::Result(vk_result);
-    }
-
-    vk_result = vmaCreatePool(
-      GetDevice()->GetVmaAllocator(),
-      &create_info,
+    usage.bits.transfer_src     = true;
+    usage.bits.transfer_dst     = true;
+    usage.bits.sampled          = true;
+    usage.bits.color_attachment = true;
+    vkex::Result vkex_result = CreateVkexImageMemoryPool(
+      m_configuration.swapchain.color_format,
+      usage.flags,
       &m_swapchain_image_memory_pool);
-    VKEX_ASSERT_MSG(vk_result == VK_SUCCESS, "Failed to create swapchain image memory pool");
-    if (vk_result != VK_SUCCESS) {
-      return vkex::Result(vk_result);
-    }
-  }
-
-  return vkex::Result::Success;
-}
-
-vkex::Result Application::InitializeVkexSwapchain()
-{
-  // Surface
-  {
-    vkex::SurfaceCreateInfo surface_create_info = {};
-    surface_create_info.physical_device = m_device->GetPhysicalDevice();
-#if defined(VKEX_GGP)
-    // Nothing to do
-#elif defined(VKEX_LINUX)
-# if defined(VKEX_LINUX_WAYLAND)
-#   error "not implemented"
-# elif defined(VKEX_LINUX_XCB)
-    surface_create_info.connection = XGetXCBConnection(glfwGetX11Display());
-    surface_create_info.window = glfwGetX11Window(m_window);
-# elif defined(VKEX_LINUX_XLIB)
-#   error "not implemented"
-# endif
-#elif defined(VKEX_WIN32)
-    surface_create_info.hinstance = ::GetModuleHandle(nullptr);
-    surface_create_info.hwnd = glfwGetWin32Window(m_window);
-#endif
-    vkex::Result vkex_result = vkex::Result::Undefined;
-    VKEX_RESULT_CALL(
-      vkex_result,
-      m_instance->CreateSurface(surface_create_info, &m_surface)
-    );
     if (!vkex_result) {
       return vkex_result;
     }
-  }
-
-  // Image count
-  {
-    auto& vk_surface_capabilities = m_surface->GetVkSurfaceCapabilities2();
-    uint32_t min_image_count = vk_surface_capabilities.surfaceCapabilities.minImageCount;
-    uint32_t max_image_count = vk_surface_capabilities.surfaceCapabilities.maxImageCount;
-
-    uint32_t image_count = m_configuration.swapchain.image_count;
-    if (image_count == 0) {
-      image_count = m_configuration.frame_count;
-    }
-    image_count = std::max(std::min(image_count, max_image_count), min_image_count);
-    if (image_count != m_configuration.swapchain.image_count) {
-      if (m_configuration.swapchain.image_count != 0) {
-        VKEX_LOG_WARN("Swapchain image count readjusted from " << 
-                       m_configuration.swapchain.image_count << " to " << image_count);
-      }
-      m_configuration.swapchain.image_count = image_count;
-    }
-  }
-
-  // Extents
-  {
-    bool requested_window_extents_changed = false;
-    auto& vk_surface_capabilities = m_surface->GetVkSurfaceCapabilities2();
-    {
-        uint32_t max_width = vk_surface_capabilities.surfaceCapabilities.maxImageExtent.width;
-        uint32_t max_height = vk_surface_capabilities.surfaceCapabilities.maxImageExtent.height;
-        if ((max_width < m_configuration.window.width) || (max_height < m_configuration.window.height)) {
-            VKEX_LOG_WARN("Swapchain extents readjusted from "
-                << m_configuration.window.width << "x" << m_configuration.window.height
-                << " to "
-                << max_width << "x" << max_height);
-            requested_window_extents_changed = true;
-        }
-        m_configuration.window.width = std::min(m_configuration.window.width, max_width);
-        m_configuration.window.height = std::min(m_configuration.window.height, max_height);
-    }
 
-    {
-        uint32_t min_width = vk_surface_capabilities.surfaceCapabilities.minImageExtent.width;
-        uint32_t min_height = vk_surface_capabilities.surfaceCapabilities.minImageExtent.height;
-        if ((min_width > m_configuration.window.width) || (min_height > m_configuration.window.height)) {
-            VKEX_LOG_WARN("Swapchain extents readjusted from "
-                << m_configuration.window.width << "x" << m_configuration.window.height
-                << " to "
-                << min_width << "x" << min_height);
-            requested_window_extents_changed = true;
-        }
-        m_configuration.window.width = std::max(m_configuration.window.width, min_width);
-        m_configuration.window.height = std::max(m_configuration.window.height, min_height);
-    }
-
-    if (requested_window_extents_changed) {
-        VKEX_LOG_WARN("GLFW window size readjusted to match swapchain extents");
-        glfwSetWindowSize(m_window, m_configuration.window.width, m_configuration.window.height);
-    }
-  }
-
-  // Swapchain memory pool (interesting comments inside implementation)
-  {
-    vkex::Result vkex_result = InitializeVkexSwapchainImageMemoryPool();
-    if (!vkex_result) {
+    if (has_depth_stencil) {
+      usage = {};
+      usage.bits.sampled                  = true;
+      usage.bits.depth_stencil_attachment = true;
+      vkex_result = CreateVkexImageMemoryPool(
+        m_configuration.swapchain.depth_stencil_format,
+        usage.flags,
+        &m_depth_stencil_image_memory_pool);
+      if (!vkex_result) {
         return vkex_result;
+      }
     }
   }
-
-  // Swapchain
-  {
-    vkex::SwapchainCreateInfo swapchain_create_info = {};
-    swapchain_create_info.surface               = m_surface;
-    swapchain_create_info.image_count           = m_configuration.swapchain.image_count;
-    swapchain_create_info.color_format          = m_configuration.swapchain.color_format;
-    swapchain_create_info.color_space           = m_configuration.swapchain.color_space;
-    swapchain_create_info.depth_stencil_format  = m_configuration.swapchain.depth_stencil_format;
-    swapchain_create_info.width                 = m_configuration.window.width;
-    swapchain_create_info.height                = m_configuration.window.height;
-    swapchain_create_info.present_mode          = m_configuration.swapchain.present_mode;
-    swapchain_create_info.queue                 = m_present_queue;
-    swapchain_create_info.image_memory_pool     = m_swapchain_image_memory_pool;
-    vkex::Result vkex_result = vkex::Result::Undefined;
-    VKEX_RESULT_CALL(
-      vkex_result,
-      m_device->CreateSwapchain(swapchain_create_info, &m_swapchain)
-    );
+  else if (has_depth_stencil) {
+    ImageUsageFlags usage = {};
+    usage.bits.transfer_src             = true;
+    usage.bits.transfer_dst             = true;
+    usage.bits.sampled                  = true;
+    usage.bits.depth_stencil_attachment = true;
+    vkex::Result vkex_result = CreateVkexImageMemoryPool(
+      m_configuration.swapchain.depth_stencil_format,
+      usage.flags,
+      &m_swapchain_image_memory_pool);
     if (!vkex_result) {
       return vkex_result;
     }
   }
 
-  // Transition swapchain color images to VK_IMAGE_LAYOUT_PRESENT_SRC_KHR
-  // Transition swapchain depth/stencil images to VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
+  return vkex::Result::Success;
+}
+
+vkex::Result Application::InitializeVkexFrameTargets(
+  const std::vector<vkex::Image>& color_images,
+  const std::vector<vkex::Image>& depth_stencil_images)
+{
+  // Transition color images to the present layout
+  // Transition depth/stencil images to VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
   {
-    uint32_t image_count = m_swapchain->GetImageCount();
+    uint32_t image_count = CountU32(color_images);
     for (uint32_t image_index = 0; image_index < image_count; ++image_index) {
       // Color 
-      vkex::Image image = nullptr;
-      // Get color image
-      vkex::Result vkex_result = vkex::Result::Undefined;
-      VKEX_RESULT_CALL(
-        vkex_result,
-        m_swapchain->GetColorImage(image_index, &image);
-      );
-      if (!vkex_result) {
-        return vkex_result;
-      }
+      vkex::Image image = color_images[image_index];
       // Transition
-      vkex_result = vkex::Result::Undefined;
       VKEX_CALL(vkex::TransitionImageLayout(m_graphics_queue,
           image,
           image->GetInitialLayout(),
-          VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
+          GetPresentLayout(),
           VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT));
       // Depth/stencil
-      if (m_swapchain->HasDepthStencil()) {
-        // Get depth/stencil image
-        vkex::Result vkex_result = vkex::Result::Undefined;
-        VKEX_RESULT_CALL(
-          vkex_result,
-          m_swapchain->GetDepthStencilImage(image_index, &image);
-        );
-        if (!vkex_result) {
-          return vkex_result;
-        }
+      if (!depth_stencil_images.empty()) {
+        image = depth_stencil_images[image_index];
         // Transition
-        vkex_result = vkex::Result::Undefined;
         VKEX_CALL(vkex::TransitionImageLayout(m_graphics_queue,
             image,
             image->GetInitialLayout(),
@@ -1145,20 +1108,10 @@ vkex::Result Application::InitializeVkexSwapchain()
 
   // Color image views
   {
-    uint32_t image_count = m_swapchain->GetImageCount();
+    uint32_t image_count = CountU32(color_images);
     for (uint32_t image_index = 0; image_index < image_count; ++image_index) {
       // Get image
-      vkex::Image image = nullptr;
-      {
-        vkex::Result vkex_result = vkex::Result::Undefined;
-        VKEX_RESULT_CALL(
-          vkex_result,
-          m_swapchain->GetColorImage(image_index, &image);
-        );
-        if (!vkex_result) {
-          return vkex_result;
-        }
-      }
+      vkex::Image image = color_images[image_index];
       // Create image view
       {
         // Image format
@@ -1195,21 +1148,11 @@ vkex::Result Application::InitializeVkexSwapchain()
   }
 
   // Depth stencil image views
-  if (m_configuration.swapchain.depth_stencil_format != VK_FORMAT_UNDEFINED) {
-    uint32_t image_count = m_swapchain->GetImageCount();
+  if (!depth_stencil_images.empty()) {
+    uint32_t image_count = CountU32(color_images);
     for (uint32_t image_index = 0; image_index < image_count; ++image_index) {
       // Get image
-      vkex::Image image = nullptr;
-      {
-        vkex::Result vkex_result = vkex::Result::Undefined;
-        VKEX_RESULT_CALL(
-          vkex_result,
-          m_swapchain->GetDepthStencilImage(image_index, &image);
-        );
-        if (!vkex_result) {
-          return vkex_result;
-        }
-      }
+      vkex::Image image = depth_stencil_images[image_index];
       // Create image view
       {
         // Image format
@@ -1247,7 +1190,7 @@ vkex::Result Application::InitializeVkexSwapchain()
 
   // Render passes
   {
-    uint32_t image_count = m_swapchain->GetImageCount();
+    uint32_t image_count = CountU32(color_images);
     for (uint32_t image_index = 0; image_index < image_count; ++image_index) {
       // RTV
       vkex::RenderTargetView rtv = nullptr;
@@ -1260,9 +1203,9 @@ vkex::Result Application::InitializeVkexSwapchain()
         create_info.samples        = image_view->GetSamples();
         create_info.load_op        = m_configuration.swapchain.color_load_op;
         create_info.store_op       = m_configuration.swapchain.color_store_op;
-        create_info.initial_layout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+        create_info.initial_layout = GetPresentLayout();
         create_info.render_layout  = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-        create_info.final_layout   = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+        create_info.final_layout   = GetPresentLayout();
         create_info.clear_value    = m_configuration.swapchain.rtv_clear_value;
         create_info.attachment     = image_view;
         create_info.resolve        = nullptr;
@@ -1329,27 +1272,174 @@ vkex::Result Application::InitializeVkexSwapchain()
     }
   }
 
-  // Screenshot buffer
-  if (m_configuration.enable_screen_shot) {
-    uint64_t size = vkex::RoundUp<uint64_t>(m_configuration.window.width, 4) *
-                    vkex::RoundUp<uint64_t>(m_configuration.window.height, 4) *
-                    vkex::FormatSize(m_configuration.swapchain.color_format);
-    // Create info
-    vkex::BufferCreateInfo buffer_create_info        = {};
-    buffer_create_info.size                          = size;
-    buffer_create_info.usage_flags.bits.transfer_dst = true;
-    buffer_create_info.memory_usage                  = VMA_MEMORY_USAGE_GPU_TO_CPU;
-    // Create buffer
+  return vkex::Result::Success;
+}
+
+vkex::Result Application::InitializeVkexSwapchain()
+{
+  // Surface
+  {
+    vkex::SurfaceCreateInfo surface_create_info = {};
+    surface_create_info.physical_device = m_device->GetPhysicalDevice();
+#if defined(VKEX_GGP)
+    // Nothing to do
+#elif defined(VKEX_LINUX)
+# if defined(VKEX_LINUX_WAYLAND)
+#   error "not implemented"
+# elif defined(VKEX_LINUX_XCB)
+    surface_create_info.connection = XGetXCBConnection(glfwGetX11Display());
+    surface_create_info.window = glfwGetX11Window(m_window);
+# elif defined(VKEX_LINUX_XLIB)
+#   error "not implemented"
+# endif
+#elif defined(VKEX_WIN32)
+    surface_create_info.hinstance = ::GetModuleHandle(nullptr);
+    surface_create_info.hwnd = glfwGetWin32Window(m_window);
+#endif
     vkex::Result vkex_result = vkex::Result::Undefined;
     VKEX_RESULT_CALL(
       vkex_result,
-      m_device->CreateBuffer(buffer_create_info, &m_screenshot_buffer)
+      m_instance->CreateSurface(surface_create_info, &m_surface)
     );
     if (!vkex_result) {
       return vkex_result;
     }
   }
 
+  // Image count
+  {
+    auto& vk_surface_capabilities = m_surface->GetVkSurfaceCapabilities2();
+    uint32_t min_image_count = vk_surface_capabilities.surfaceCapabilities.minImageCount;
+    uint32_t max_image_count = vk_surface_capabilities.surfaceCapabilities.maxImageCount;
+
+    uint32_t image_count = m_configuration.swapchain.image_count;
+    if (image_count == 0) {
+      image_count = m_configuration.frame_count;
+    }
+    image_count = std::max(std::min(image_count, max_image_count), min_image_count);
+    if (image_count != m_configuration.swapchain.image_count) {
+      if (m_configuration.swapchain.image_count != 0) {
+        VKEX_LOG_WARN("Swapchain image count readjusted from " << 
+                       m_configuration.swapchain.image_count << " to " << image_count);
+      }
+      m_configuration.swapchain.image_count = image_count;
+    }
+  }
+
+  // Extents
+  {
+    bool requested_window_extents_changed = false;
+    auto& vk_surface_capabilities = m_surface->GetVkSurfaceCapabilities2();
+    {
+        uint32_t max_width = vk_surface_capabilities.surfaceCapabilities.maxImageExtent.width;
+        uint32_t max_height = vk_surface_capabilities.surfaceCapabilities.maxImageExtent.height;
+        if ((max_width < m_configuration.window.width) || (max_height < m_configuration.window.height)) {
+            VKEX_LOG_WARN("Swapchain extents readjusted from "
+                << m_configuration.window.width << "x" << m_configuration.window.height
+                << " to "
+                << max_width << "x" << max_height);
+            requested_window_extents_changed = true;
+        }
+        m_configuration.window.width = std::min(m_configuration.window.width, max_width);
+        m_configuration.window.height = std::min(m_configuration.window.height, max_height);
+    }
+
+    {
+        uint32_t min_width = vk_surface_capabilities.surfaceCapabilities.minImageExtent.width;
+        uint32_t min_height = vk_surface_capabilities.surfaceCapabilities.minImageExtent.height;
+        if ((min_width > m_configuration.window.width) || (min_height > m_configuration.window.height)) {
+            VKEX_LOG_WARN("Swapchain extents readjusted from "
+                << m_configuration.window.width << "x" << m_configuration.window.height
+                << " to "
+                << min_width << "x" << min_height);
+            requested_window_extents_changed = true;
+        }
+        m_configuration.window.width = std::max(m_configuration.window.width, min_width);
+        m_configuration.window.height = std::max(m_configuration.window.height, min_height);
+    }
+
+    if (requested_window_extents_changed) {
+        VKEX_LOG_WARN("GLFW window size readjusted to match swapchain extents");
+        glfwSetWindowSize(m_window, m_configuration.window.width, m_configuration.window.height);
+    }
+  }
+
+  // Swapchain memory pool (interesting comments inside implementation)
+  {
+    vkex::Result vkex_result = InitializeVkexSwapchainImageMemoryPool();
+    if (!vkex_result) {
+        return vkex_result;
+    }
+  }
+
+  // Swapchain
+  {
+    vkex::SwapchainCreateInfo swapchain_create_info = {};
+    swapchain_create_info.surface               = m_surface;
+    swapchain_create_info.image_count           = m_configuration.swapchain.image_count;
+    swapchain_create_info.color_format          = m_configuration.swapchain.color_format;
+    swapchain_create_info.color_space           = m_configuration.swapchain.color_space;
+    swapchain_create_info.depth_stencil_format  = m_configuration.swapchain.depth_stencil_format;
+    swapchain_create_info.width                 = m_configuration.window.width;
+    swapchain_create_info.height                = m_configuration.window.height;
+    swapchain_create_info.present_mode          = m_configuration.swapchain.present_mode;
+    swapchain_create_info.queue                 = m_present_queue;
+    swapchain_create_info.image_memory_pool     = m_swapchain_image_memory_pool;
+    vkex::Result vkex_result = vkex::Result::Undefined;
+    VKEX_RESULT_CALL(
+      vkex_result,
+      m_device->CreateSwapchain(swapchain_create_info, &m_swapchain)
+    );
+    if (!vkex_result) {
+      return vkex_result;
+    }
+  }
+
+  // Frame targets
+  {
+    std::vector<vkex::Image> color_images;
+    std::vector<vkex::Image> depth_stencil_images;
+    uint32_t image_count = m_swapchain->GetImageCount();
+    for (uint32_t image_index = 0; image_index < image_count; ++image_index) {
+      // Color
+      vkex::Image image = nullptr;
+      vkex::Result vkex_result = vkex::Result::Undefined;
+      VKEX_RESULT_CALL(
+        vkex_result,
+        m_swapchain->GetColorImage(image_index, &image);
+      );
+      if (!vkex_result) {
+        return vkex_result;
+      }
+      color_images.push_back(image);
+      // Depth/stencil
+      if (m_swapchain->HasDepthStencil()) {
+        vkex_result = vkex::Result::Undefined;
+        VKEX_RESULT_CALL(
+          vkex_result,
+          m_swapchain->GetDepthStencilImage(image_index, &image);
+        );
+        if (!vkex_result) {
+          return vkex_result;
+        }
+        depth_stencil_images.push_back(image);
+      }
+    }
+
+    vkex::Result vkex_result = InitializeVkexFrameTargets(color_images, depth_stencil_images);
+    if (!vkex_result) {
+      return vkex_result;
+    }
+  }
+
+  // Screenshot buffers
+  {
+    vkex::Result vkex_result = InitializeScreenShotBuffers();
+    if (!vkex_result) {
+      return vkex_result;
+    }
+  }
+
   // Log swapchain creation
   {
     VKEX_LOG_INFO("");
@@ -1366,6 +1456,136 @@ vkex::Result Application::InitializeVkexSwapchain()
   return vkex::Result::Success;
 }
 
+vkex::Result Application::InitializeVkexHeadlessTargets()
+{
+  // Memory pools for the color and depth/stencil targets
+  {
+    vkex::Result vkex_result = InitializeVkexSwapchainImageMemoryPool();
+    if (!vkex_result) {
+        return vkex_result;
+    }
+  }
+
+  uint32_t queue_family_index = m_graphics_queue->GetVkQueueFamilyIndex();
+
+  // Color images
+  {
+    vkex::ImageUsageFlags usage = {};
+    usage.bits.transfer_src     = true;
+    usage.bits.transfer_dst     = true;
+    usage.bits.sampled          = true;
+    usage.bits.color_attachment = true;
+    for (uint32_t i = 0; i < m_configuration.headless.image_count; ++i) {
+      vkex::ImageCreateInfo image_create_info = {};
+      image_create_info.create_flags          = 0;
+      image_create_info.image_type            = VK_IMAGE_TYPE_2D;
+      image_create_info.format                = m_configuration.swapchain.color_format;
+      image_create_info.extent                = { m_configuration.window.width, m_configuration.window.height, 1 };
+      image_create_info.mip_levels            = 1;
+      image_create_info.array_layers          = 1;
+      image_create_info.samples               = VK_SAMPLE_COUNT_1_BIT;
+      image_create_info.tiling                = VK_IMAGE_TILING_OPTIMAL;
+      image_create_info.usage_flags           = usage;
+      image_create_info.sharing_mode          = VK_SHARING_MODE_EXCLUSIVE;
+      image_create_info.queue_family_indices  = { queue_family_index };
+      image_create_info.initial_layout        = VK_IMAGE_LAYOUT_UNDEFINED;
+      image_create_info.committed             = true;
+      image_create_info.memory_usage          = VMA_MEMORY_USAGE_GPU_ONLY;
+      image_create_info.memory_pool           = m_swapchain_image_memory_pool;
+      image_create_info.vk_object             = VK_NULL_HANDLE;
+      vkex::Image image = nullptr;
+      vkex::Result vkex_result = vkex::Result::Undefined;
+      VKEX_RESULT_CALL(
+        vkex_result,
+        m_device->CreateImage(image_create_info, &image)
+      );
+      if (!vkex_result) {
+        return vkex_result;
+      }
+
+      m_headless_color_images.push_back(image);
+    }
+  }
+
+  // Depth stencil images
+  if (m_configuration.swapchain.depth_stencil_format != VK_FORMAT_UNDEFINED) {
+    vkex::ImageUsageFlags usage = {};
+    usage.bits.sampled                  = true;
+    usage.bits.depth_stencil_attachment = true;
+    for (uint32_t i = 0; i < m_configuration.headless.image_count; ++i) {
+      vkex::ImageCreateInfo image_create_info = {};
+      image_create_info.create_flags          = 0;
+      image_create_info.image_type            = VK_IMAGE_TYPE_2D;
+      image_create_info.format                = m_configuration.swapchain.depth_stencil_format;
+      image_create_info.extent                = { m_configuration.window.width, m_configuration.window.height, 1 };
+      image_create_info.mip_levels            = 1;
+      image_create_info.array_layers          = 1;
+      image_create_info.samples               = VK_SAMPLE_COUNT_1_BIT;
+      image_create_info.tiling                = VK_IMAGE_TILING_OPTIMAL;
+      image_create_info.usage_flags           = usage;
+      image_create_info.sharing_mode          = VK_SHARING_MODE_EXCLUSIVE;
+      image_create_info.queue_family_indices  = { queue_family_index };
+      image_create_info.initial_layout        = VK_IMAGE_LAYOUT_UNDEFINED;
+      image_create_info.committed             = true;
+      image_create_info.memory_usage          = VMA_MEMORY_USAGE_GPU_ONLY;
+      image_create_info.memory_pool           = m_depth_stencil_image_memory_pool;
+      image_create_info.vk_object             = VK_NULL_HANDLE;
+      vkex::Image image = nullptr;
+      vkex::Result vkex_result = vkex::Result::Undefined;
+      VKEX_RESULT_CALL(
+        vkex_result,
+        m_device->CreateImage(image_create_info, &image)
+      );
+      if (!vkex_result) {
+        return vkex_result;
+      }
+
+      m_headless_depth_stencil_images.push_back(image);
+    }
+  }
+
+  // Image views and render passes
+  {
+    vkex::Result vkex_result = InitializeVkexFrameTargets(m_headless_color_images, m_headless_depth_stencil_images);
+    if (!vkex_result) {
+      return vkex_result;
+    }
+  }
+
+  // Readback buffers
+  {
+    vkex::Result vkex_result = InitializeScreenShotBuffers();
+    if (!vkex_result) {
+      return vkex_result;
+    }
+  }
+
+  // Raw frame stream
+  if (m_configuration.headless.output == HEADLESS_OUTPUT_RAW_STREAM) {
+    fs::path file_path = m_configuration.headless.output_path.empty() 
+                         ? (GetApplicationPath().parent() / "frames.raw") 
+                         : fs::path(m_configuration.headless.output_path);
+    m_raw_frame_stream.open(file_path.c_str(), std::ios::binary | std::ios::trunc);
+    if (!m_raw_frame_stream.is_open()) {
+      VKEX_LOG_ERROR("Unable to open raw frame stream: " << file_path);
+      return vkex::Result::ErrorOpenFileFailed;
+    }
+  }
+
+  // Log headless target creation
+  {
+    VKEX_LOG_INFO("");
+    VKEX_LOG_INFO("Headless targets created");
+    VKEX_LOG_INFO("   " << "Image Count      : " << m_configuration.headless.image_count);
+    VKEX_LOG_INFO("   " << "Format           : " << vkex::ToString(m_configuration.swapchain.color_format));
+    VKEX_LOG_INFO("   " << "Size             : " << m_configuration.window.width << "x" << m_configuration.window.height);
+    VKEX_LOG_INFO("   " << "Frame Limit      : " << m_configuration.frame_limit);
+    VKEX_LOG_INFO("");
+  }
+
+  return vkex::Result::Success;
+}
+
 vkex::Result Application::InitializeVkexPerFrameRenderData()
 {
   // Command pool
@@ -1403,6 +1623,22 @@ vkex::Result Application::InitializeVkexPerFrameRenderData()
       cmd->End();
     }
   }
+  // Command buffers for acquiring ownership of async uploads
+  std::vector<vkex::CommandBuffer> acquire_command_buffers;
+  {
+    vkex::CommandBufferAllocateInfo command_buffer_allocate_info = {};
+    command_buffer_allocate_info.command_buffer_count = m_configuration.frame_count;
+    vkex::Result vkex_result = vkex::Result::Undefined;
+    VKEX_RESULT_CALL(
+      vkex_result,
+      m_render_command_pool->AllocateCommandBuffers(
+        command_buffer_allocate_info,
+        &acquire_command_buffers);
+    );
+    if (!vkex_result) {
+      return vkex_result;
+    }
+  }
 
   // Per frame data
   for (uint32_t frame_index = 0; frame_index < m_configuration.frame_count; ++frame_index) {
@@ -1414,10 +1650,11 @@ vkex::Result Application::InitializeVkexPerFrameRenderData()
       }
 
       vkex::CommandBuffer cmd = command_buffers[frame_index];
+      vkex::CommandBuffer acquire_cmd = acquire_command_buffers[frame_index];
       vkex::Result vkex_result = vkex::Result::Undefined;
       VKEX_RESULT_CALL(
         vkex_result,
-        data->InternalCreate(m_device, frame_index, cmd)
+        data->InternalCreate(m_device, frame_index, cmd, acquire_cmd, m_configuration.constant_allocator_size)
       );
       if (!vkex_result) {
         return vkex_result;
@@ -1485,6 +1722,28 @@ vkex::Result Application::InitializeVkexPerFramePresentData()
     }
   }
 
+  // Screenshot command buffers and encoder
+  if (HasScreenShotRing()) {
+    std::vector<vkex::CommandBuffer> screen_shot_command_buffers;
+    vkex::CommandBufferAllocateInfo command_buffer_allocate_info = {};
+    command_buffer_allocate_info.command_buffer_count = CountU32(m_screen_shot_slots);
+    vkex::Result vkex_result = vkex::Result::Undefined;
+    VKEX_RESULT_CALL(
+      vkex_result,
+      m_present_command_pool->AllocateCommandBuffers(
+        command_buffer_allocate_info,
+        &screen_shot_command_buffers);
+    );
+    if (!vkex_result) {
+      return vkex_result;
+    }
+    for (size_t i = 0; i < m_screen_shot_slots.size(); ++i) {
+      m_screen_shot_slots[i]->command_buffer = screen_shot_command_buffers[i];
+    }
+
+    m_screen_shot_encoder = std::make_unique<vkex::ThreadPool>(1);
+  }
+
   return vkex::Result::Success;
 }
 
@@ -1498,6 +1757,8 @@ vkex::Result Application::InitializeVkex()
     instance_create_info.debug_utils.message_severity       = m_configuration.graphics_debug.message_severity;
     instance_create_info.debug_utils.message_type           = m_configuration.graphics_debug.message_type;
     instance_create_info.enable_swapchain                   = (m_configuration.mode == APPLICATION_MODE_WINDOW) ? true : false;
+    instance_create_info.host_allocator.enable              = m_configuration.host_memory.enable;
+    instance_create_info.host_allocator.command_arena       = m_configuration.host_memory.command_arena;
 
     vkex::Result vkex_result = vkex::Result::Undefined;
     VKEX_RESULT_CALL(
@@ -1525,6 +1786,14 @@ vkex::Result Application::InitializeVkex()
     }
   }
 
+  // Headless targets
+  if (IsApplicationModeHeadless()) {
+    vkex::Result vkex_result = InitializeVkexHeadlessTargets();
+    if (!vkex_result) {
+      return vkex_result;
+    }
+  }
+
   // Per frame render data
   {
     vkex::Result vkex_result = InitializeVkexPerFrameRenderData();
@@ -1533,8 +1802,8 @@ vkex::Result Application::InitializeVkex()
     }
   }
 
-  // Per frame present data
-  if (IsApplicationModeWindow()) {
+  // Per frame present data, headless mode presents to the offscreen targets
+  {
     vkex::Result vkex_result = InitializeVkexPerFramePresentData();
     if (!vkex_result) {
       return vkex_result;
@@ -1546,6 +1815,23 @@ vkex::Result Application::InitializeVkex()
 
 vkex::Result Application::InitializeImGui()
 {
+  // Headless mode has no platform or Vulkan binding, applications can
+  // still make ImGui calls and the draw data is discarded.
+  if (IsApplicationModeHeadless()) {
+    IMGUI_CHECKVERSION();
+    ImGui::CreateContext();
+    ImGuiIO& io = ImGui::GetIO();
+    io.DisplaySize = ImVec2(
+      static_cast<float>(m_configuration.window.width),
+      static_cast<float>(m_configuration.window.height));
+    // Builds the font atlas, NewFrame asserts without it
+    unsigned char* p_pixels = nullptr;
+    int width = 0;
+    int height = 0;
+    io.Fonts->GetTexDataAsRGBA32(&p_pixels, &width, &height);
+    return vkex::Result::Success;
+  }
+
   // Setup Dear ImGui binding
   IMGUI_CHECKVERSION();
   ImGui::CreateContext();
@@ -1667,7 +1953,7 @@ vkex::Result Application::InternalCreate()
   }
 
   // ImGui
-  if (IsApplicationModeWindow()) {
+  {
     vkex::Result vkex_result = InitializeImGui();
     if (!vkex_result) {
       return vkex_result;
@@ -1685,11 +1971,18 @@ vkex::Result Application::DestroyVkexSwapchainImageMemoryPool()
       m_swapchain_image_memory_pool);
     m_swapchain_image_memory_pool = VK_NULL_HANDLE;
   }
+
+  if (m_depth_stencil_image_memory_pool != VK_NULL_HANDLE) {
+    vmaDestroyPool(
+      GetDevice()->GetVmaAllocator(),
+      m_depth_stencil_image_memory_pool);
+    m_depth_stencil_image_memory_pool = VK_NULL_HANDLE;
+  }
   
   return vkex::Result::Success;
 }
 
-vkex::Result Application::DestroyVkexSwapchain()
+vkex::Result Application::DestroyVkexFrameTargets()
 {
   // Render passes
   for (auto& render_pass : m_render_passes) {
@@ -1717,7 +2010,7 @@ vkex::Result Application::DestroyVkexSwapchain()
   }
   m_color_image_views.clear();
 
-  // Color image views
+  // Depth stencil image views
   for (auto& image_view : m_depth_stencil_image_views) {
     vkex::Result vkex_result = vkex::Result::Undefined;
     VKEX_RESULT_CALL(
@@ -1730,6 +2023,19 @@ vkex::Result Application::DestroyVkexSwapchain()
   }
   m_depth_stencil_image_views.clear();
 
+  return vkex::Result::Success;
+}
+
+vkex::Result Application::DestroyVkexSwapchain()
+{
+  // Render passes and image views
+  {
+    vkex::Result vkex_result = DestroyVkexFrameTargets();
+    if (!vkex_result) {
+      return vkex_result;
+    }
+  }
+
   // Swapchain
   VkSwapchainKHR vk_swapchain = VK_NULL_HANDLE;
   if (m_swapchain != nullptr) {
@@ -1756,13 +2062,9 @@ vkex::Result Application::DestroyVkexSwapchain()
     }
   }
 
-  // Screenshot buffer
-  if (m_screenshot_buffer) {
-    vkex::Result vkex_result = vkex::Result::Undefined;
-    VKEX_RESULT_CALL(
-      vkex_result,
-      m_device->DestroyBuffer(m_screenshot_buffer)
-    );
+  // Screenshot buffers
+  {
+    vkex::Result vkex_result = DestroyScreenShotBuffers();
     if (!vkex_result) {
       return vkex_result;
     }
@@ -1775,6 +2077,50 @@ vkex::Result Application::DestroyVkexSwapchain()
   return vkex::Result::Success;
 }
 
+vkex::Result Application::DestroyVkexHeadlessTargets()
+{
+  // Readback buffers, flushes pending frames to the stream
+  {
+    vkex::Result vkex_result = DestroyScreenShotBuffers();
+    if (!vkex_result) {
+      return vkex_result;
+    }
+  }
+
+  if (m_raw_frame_stream.is_open()) {
+    m_raw_frame_stream.close();
+  }
+
+  // Render passes and image views
+  {
+    vkex::Result vkex_result = DestroyVkexFrameTargets();
+    if (!vkex_result) {
+      return vkex_result;
+    }
+  }
+
+  // Images
+  for (auto& image : m_headless_depth_stencil_images) {
+    vkex::Result vkex_result = vkex::Result::Undefined;
+    VKEX_RESULT_CALL(vkex_result, m_device->DestroyImage(image));
+    if (!vkex_result) {
+      return vkex_result;
+    }
+  }
+  m_headless_depth_stencil_images.clear();
+
+  for (auto& image : m_headless_color_images) {
+    vkex::Result vkex_result = vkex::Result::Undefined;
+    VKEX_RESULT_CALL(vkex_result, m_device->DestroyImage(image));
+    if (!vkex_result) {
+      return vkex_result;
+    }
+  }
+  m_headless_color_images.clear();
+
+  return vkex::Result::Success;
+}
+
 vkex::Result Application::DestroyImGui()
 {
   if (m_imgui_descriptor_pool != nullptr) {
@@ -1791,6 +2137,9 @@ vkex::Result Application::DestroyImGui()
       return vkex_result;
     }
   }
+  else if (IsApplicationModeHeadless() && (ImGui::GetCurrentContext() != nullptr)) {
+    ImGui::DestroyContext();
+  }
 
   return vkex::Result::Success;
 }
@@ -1813,8 +2162,16 @@ vkex::Result Application::InternalDestroy()
     }
   }
 
+  // Headless targets
+  if (IsApplicationModeHeadless()) {
+    vkex::Result vkex_result = DestroyVkexHeadlessTargets();
+    if (!vkex_result) {
+      return vkex_result;
+    }
+  }
+
   // Swapchain memory pool
-  if (IsApplicationModeWindow()) {
+  {
     vkex::Result vkex_result = DestroyVkexSwapchainImageMemoryPool();
     if (!vkex_result) {
       return vkex_result;
@@ -1834,6 +2191,10 @@ vkex::Result Application::InternalDestroy()
     }
   }
 
+  // Screenshot encoder, the swapchain destroy above already flushed it
+  m_screen_shot_encoder.reset();
+  m_screen_shot_slots.clear();
+
   // Render data
   {
     for (auto& data : m_per_frame_render_data) {
@@ -1846,7 +2207,7 @@ vkex::Result Application::InternalDestroy()
   }
   
   // Present data
-  if (IsApplicationModeWindow()) {
+  {
     for (auto& data : m_per_frame_present_data) {
       vkex::Result vkex_result = data->InternalDestroy();
       if (!vkex_result) {
@@ -1994,6 +2355,26 @@ vkex::Result Application::CheckConfiguration()
     m_configuration.frame_count = kDefaultInFlightFrameCount;
   }
 
+  if (m_configuration.constant_allocator_size == 0) {
+    m_configuration.constant_allocator_size = kDefaultConstantAllocatorSize;
+  }
+
+  // A slot is held for frame_count frames until its copy is fenced, the
+  // extra slots cover the time spent encoding.
+  if (m_configuration.screen_shot.ring_size == 0) {
+    m_configuration.screen_shot.ring_size = m_configuration.frame_count + 2;
+  }
+
+  // A target is reused frame_count frames after it was presented, at
+  // which point ProcessFrameFence has waited on its work.
+  if (m_configuration.headless.image_count < m_configuration.frame_count) {
+    if (m_configuration.headless.image_count != 0) {
+      VKEX_LOG_WARN("Headless image count readjusted from " << 
+                     m_configuration.headless.image_count << " to " << m_configuration.frame_count);
+    }
+    m_configuration.headless.image_count = m_configuration.frame_count;
+  }
+
   return vkex::Result::Success;
 }
 
@@ -2079,15 +2460,20 @@ vkex::Result vkex::Application::ProcessRenderFence(Application::RenderData * p_d
         return vkex::Result(vk_result);
     }
 
+    // Semaphores waited on by the frame's submission can be signaled again
+    if (!p_data->m_upload_semaphores.empty()) {
+        m_transfer_upload_manager.load()->RecycleSemaphores(p_data->m_upload_semaphores);
+        p_data->m_upload_semaphores.clear();
+    }
+
+    // Constants written for the frame are no longer read
+    p_data->m_constant_allocator.Reset();
+
     return vkex::Result::Success;
 }
 
 vkex::Result Application::ProcessFrameFence(Application::PresentData* p_data)
 {
-  if (!IsApplicationModeWindow()) {
-    return vkex::Result::ErrorInvalidApplicationMode;
-  }
-  
   VkResult vk_result = InvalidValue<VkResult>::Value;
   VKEX_VULKAN_RESULT_CALL(
     vk_result,
@@ -2096,6 +2482,19 @@ vkex::Result Application::ProcessFrameFence(Application::PresentData* p_data)
   if (vk_result != VK_SUCCESS) {
     return vkex::Result(vk_result);
   }
+
+  // Screenshot copies submitted with this frame's present work are done
+  ProcessScreenShots(p_data);
+
+  // Both fences of the frame that last used this slot have been waited on,
+  // so objects retired during that frame or earlier are no longer in use.
+  if (m_elapsed_frame_count >= m_configuration.frame_count) {
+    uint64_t completed_frame = m_elapsed_frame_count - m_configuration.frame_count;
+    vkex::Result vkex_result = m_device->DestroyRetired(completed_frame);
+    if (!vkex_result) {
+      return vkex_result;
+    }
+  }
   
   vk_result = InvalidValue<VkResult>::Value;
   VKEX_VULKAN_RESULT_CALL(
@@ -2371,7 +2770,9 @@ void Application::SetCursorMode(vkex::CursorMode cursor_mode)
 void Application::DrawImGui(vkex::CommandBuffer cmd)
 {
     ImGui::Render();
-    ImGui_ImplVulkan_RenderDrawData(ImGui::GetDrawData(), *cmd);
+    if (IsApplicationModeWindow()) {
+      ImGui_ImplVulkan_RenderDrawData(ImGui::GetDrawData(), *cmd);
+    }
 }
 
 vkex::Result Application::SubmitRender(Application::RenderData* p_current_render_data, Application::PresentData* p_current_present_data)
@@ -2412,9 +2813,45 @@ vkex::Result Application::SubmitRender(Application::RenderData* p_current_render
       vk_wait_dst_stage_masks.push_back(vk_dst_stage_mask);
     }
   }
-
-  // Command buffers
-  std::vector<VkCommandBuffer>      vk_command_buffers      = { vk_command_buffer };
+
+  // Constants written for this frame
+  {
+    vkex::Result vkex_result = p_current_render_data->m_constant_allocator.Flush();
+    if (!vkex_result) {
+      return vkex_result;
+    }
+  }
+
+  // Command buffers
+  std::vector<VkCommandBuffer>      vk_command_buffers      = {};
+
+  // Async uploads, the acquire barriers run ahead of the render work
+  vkex::UploadManager transfer_upload_manager = m_transfer_upload_manager.load();
+  if ((transfer_upload_manager != nullptr) && transfer_upload_manager->HasPendingHandoffs(m_graphics_queue)) {
+    vkex::CommandBuffer acquire_cmd = p_current_render_data->m_acquire_cmd;
+    vkex::Result vkex_result = acquire_cmd->Begin(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+    if (!vkex_result) {
+      return vkex_result;
+    }
+    vkex_result = transfer_upload_manager->AcquireHandoffs(
+      m_graphics_queue,
+      acquire_cmd,
+      &p_current_render_data->m_upload_semaphores);
+    if (!vkex_result) {
+      return vkex_result;
+    }
+    vkex_result = acquire_cmd->End();
+    if (!vkex_result) {
+      return vkex_result;
+    }
+
+    for (const auto& semaphore : p_current_render_data->m_upload_semaphores) {
+      vk_wait_semaphores.push_back(semaphore->GetVkObject());
+      vk_wait_dst_stage_masks.push_back(semaphore->GetWaitDstStageMask());
+    }
+    vk_command_buffers.push_back(*acquire_cmd);
+  }
+  vk_command_buffers.push_back(vk_command_buffer);
 
   // Signal semaphores
   std::vector<VkSemaphore>          vk_signal_semaphores    = { vk_work_complete_semaphore };
@@ -2454,10 +2891,6 @@ vkex::Result Application::SubmitRender(Application::RenderData* p_current_render
 
 vkex::Result Application::SubmitPresent(Application::PresentData* p_data)
 {
-  if (IsApplicationModeHeadless()) {
-    return vkex::Result::ErrorInvalidApplicationMode;
-  }
-
   // Vulkan objects
   VkSemaphore vk_image_acquired_semaphore             = *(p_data->GetImageAcquiredSemaphore());
   VkCommandBuffer vk_command_buffer                   = *(p_data->GetCommandBuffer());
@@ -2465,17 +2898,29 @@ vkex::Result Application::SubmitPresent(Application::PresentData* p_data)
   VkSemaphore vk_work_complete_for_render_semaphore   = *(p_data->GetWorkCompleteForRenderSemaphore());
   VkSemaphore vk_work_complete_for_present_semaphore  = *(p_data->GetWorkCompleteForPresentSemaphore());
   VkFence vk_work_complete_fence                      = *(p_data->GetWorkCompleteFence());
-  VkSwapchainKHR vk_swapchain                         = *m_swapchain;
   uint32_t vk_swapchain_image_index                   = m_current_swapchain_image_index;
 
   // Submit present work
   {
     // Containers
-    std::vector<VkSemaphore> vk_wait_semaphores           = { vk_image_acquired_semaphore };
+    std::vector<VkSemaphore> vk_wait_semaphores           = {};
     std::vector<VkCommandBuffer> vk_command_buffers       = { vk_command_buffer };
-    std::vector<VkPipelineStageFlags> vk_pipeline_stages  = { vk_pipeline_stage };
-    std::vector<VkSemaphore> vk_signal_semaphores         = { vk_work_complete_for_render_semaphore, vk_work_complete_for_present_semaphore };
+    std::vector<VkPipelineStageFlags> vk_pipeline_stages  = {};
+    std::vector<VkSemaphore> vk_signal_semaphores         = { vk_work_complete_for_render_semaphore };
+
+    // Headless targets aren't acquired or presented
+    if (IsApplicationModeWindow()) {
+      vk_wait_semaphores.push_back(vk_image_acquired_semaphore);
+      vk_pipeline_stages.push_back(vk_pipeline_stage);
+      vk_signal_semaphores.push_back(vk_work_complete_for_present_semaphore);
+    }
     
+    // Screenshot copy goes into the same submission
+    VkCommandBuffer vk_screen_shot_command_buffer = RecordScreenShot(p_data);
+    if (vk_screen_shot_command_buffer != VK_NULL_HANDLE) {
+      vk_command_buffers.push_back(vk_screen_shot_command_buffer);
+    }
+
     // Add wait for render work if submitted
     if (m_render_submitted) {
       VkSemaphore vk_render_work_completed_semaphore = *(m_current_render_data->GetWorkCompleteSemaphore());
@@ -2509,8 +2954,9 @@ vkex::Result Application::SubmitPresent(Application::PresentData* p_data)
   }
 
   // Submit present request
-  {
+  if (IsApplicationModeWindow()) {
     // Containers
+    VkSwapchainKHR vk_swapchain                       = *m_swapchain;
     std::vector<VkSemaphore> vk_wait_semaphores       = { vk_work_complete_for_present_semaphore };
     std::vector<VkSwapchainKHR> vk_swapchains         = { vk_swapchain };
     std::vector<uint32_t> vk_swapchain_image_indices  = { vk_swapchain_image_index };
@@ -2560,114 +3006,6 @@ vkex::Result Application::SubmitPresent(Application::PresentData* p_data)
     }
   }
 
-  // Write screenshot if flag is set and option is not disabled
-  if (m_screen_shot && m_configuration.enable_screen_shot) {
-    // Wait for queue idle
-    VkResult vk_result = InvalidValue<VkResult>::Value;
-    VKEX_VULKAN_RESULT_CALL(vk_result, vkex::QueueWaitIdle(*m_graphics_queue));
-
-    // Build command buffer
-    vkex::CommandBuffer command_buffer = p_data->GetCommandBuffer();
-    {
-      auto rtvs = p_data->GetRenderPass()->GetRtvs();
-      vkex::Image image = rtvs[0]->GetResource()->GetImage();
-      command_buffer->Begin();
-      // Transition image
-      command_buffer->CmdTransitionImageLayout(
-        *image, image->GetAspectFlags(), 
-        0, 
-        image->GetMipLevels(), 
-        0, 
-        image->GetArrayLayers(), 
-        VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
-        VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
-        VK_PIPELINE_STAGE_TRANSFER_BIT);
-      // Copy
-      VkBufferImageCopy region                = {};
-      region.bufferOffset                     = 0;
-      region.bufferRowLength                  = m_configuration.window.width;
-      region.bufferImageHeight                = m_configuration.window.height;
-      region.imageSubresource.aspectMask      = image->GetAspectFlags();
-      region.imageSubresource.mipLevel        = 0;
-      region.imageSubresource.baseArrayLayer  = 0;
-      region.imageSubresource.layerCount      = 1;
-      region.imageOffset                      = { 0, 0, 0 };
-      region.imageExtent                      = { m_configuration.window.width, m_configuration.window.height, 1 };
-      command_buffer->CmdCopyImageToBuffer(*image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, *m_screenshot_buffer, 1, &region);
-      // Transition image
-      command_buffer->CmdTransitionImageLayout(
-        *image, image->GetAspectFlags(), 
-        0, 
-        image->GetMipLevels(), 
-        0, 
-        image->GetArrayLayers(), 
-        VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, 
-        VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
-        VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT);
-      command_buffer->End();
-    }
-
-    // Get Vulkan command buffer handle
-    VkCommandBuffer vk_command_buffer = *command_buffer;
-
-    // Submit info
-    VkSubmitInfo vk_submit_info = { VK_STRUCTURE_TYPE_SUBMIT_INFO };
-    vk_submit_info.pWaitDstStageMask    = &vk_pipeline_stage;
-    vk_submit_info.commandBufferCount   = 1;
-    vk_submit_info.pCommandBuffers      = &vk_command_buffer;
-    
-    // Queue submit
-    vk_result = InvalidValue<VkResult>::Value;
-    VKEX_VULKAN_RESULT_CALL(
-      vk_result,
-      vkex::QueueSubmit(*m_graphics_queue, 1, &vk_submit_info, VK_NULL_HANDLE)
-    );
-    if (vk_result != VK_SUCCESS) {
-      return vkex::Result(vk_result);
-    }
-
-    // Wait for queue idle again
-    VKEX_VULKAN_RESULT_CALL(vk_result, vkex::QueueWaitIdle(*m_graphics_queue));
-
-    // Write image
-    {
-      std::stringstream file_name;
-      file_name << "screenshot_" << std::setfill('0') << std::setw(6) << m_elapsed_frame_count << ".jpg";
-      fs::path file_path = GetApplicationPath().parent() / file_name.str();
-      uint32_t component_count = FormatComponentCount(m_configuration.swapchain.color_format);
-      uint32_t pixel_stride = FormatSize(m_configuration.swapchain.color_format);
-      uint32_t row_stride = m_configuration.window.width * pixel_stride;
-
-      void* mapped_address = nullptr;
-      m_screenshot_buffer->MapMemory(&mapped_address);
-
-      // Swap channels and fill alpha
-      if (m_configuration.swapchain.color_format == VK_FORMAT_B8G8R8A8_UNORM) {
-        uint8_t* row = static_cast<uint8_t*>(mapped_address);
-        for (uint32_t y = 0; y < m_configuration.window.height; ++y) {
-          uint8_t* pixel = row;
-          for (uint32_t x = 0; x < m_configuration.window.width; ++x) {
-            std::swap(pixel[0], pixel[2]);
-            pixel += pixel_stride;
-          }
-          row += row_stride;
-        }
-      }
-      
-      // Write JPEG since STB's PNG write is *really* slow.
-      vkex::Result vkex_result = Bitmap::WriteJPG(
-        file_path,
-        m_configuration.window.width,
-        m_configuration.window.height,
-        component_count,
-        row_stride,
-        mapped_address);
-    }
-
-    // Clear screenshot flag
-    m_screen_shot = false;
-  }
-
   return vkex::Result::Success;
 }
 
@@ -2712,6 +3050,348 @@ vkex::Result Application::WaitAllQueuesIdle()
   return vkex::Result::Success;
 }
 
+bool Application::HasScreenShotRing() const
+{
+  bool has_headless_output = IsApplicationModeHeadless() && 
+                             (m_configuration.headless.output != HEADLESS_OUTPUT_NONE);
+  return m_configuration.enable_screen_shot || has_headless_output;
+}
+
+vkex::Result Application::InitializeScreenShotBuffers()
+{
+  if (!HasScreenShotRing()) {
+    return vkex::Result::Success;
+  }
+
+  // Slots outlive the swapchain, only the buffers depend on its size
+  if (m_screen_shot_slots.empty()) {
+    for (uint32_t i = 0; i < m_configuration.screen_shot.ring_size; ++i) {
+      m_screen_shot_slots.push_back(std::make_unique<ScreenShotSlot>());
+    }
+  }
+
+  uint64_t size = vkex::RoundUp<uint64_t>(m_configuration.window.width, 4) *
+                  vkex::RoundUp<uint64_t>(m_configuration.window.height, 4) *
+                  vkex::FormatSize(m_configuration.swapchain.color_format);
+  for (auto& slot : m_screen_shot_slots) {
+    // Create info
+    vkex::BufferCreateInfo buffer_create_info        = {};
+    buffer_create_info.size                          = size;
+    buffer_create_info.usage_flags.bits.transfer_dst = true;
+    buffer_create_info.memory_usage                  = VMA_MEMORY_USAGE_GPU_TO_CPU;
+    // Create buffer
+    vkex::Result vkex_result = vkex::Result::Undefined;
+    VKEX_RESULT_CALL(
+      vkex_result,
+      m_device->CreateBuffer(buffer_create_info, &slot->buffer)
+    );
+    if (!vkex_result) {
+      return vkex_result;
+    }
+  }
+
+  return vkex::Result::Success;
+}
+
+vkex::Result Application::DestroyScreenShotBuffers()
+{
+  FlushScreenShots();
+
+  for (auto& slot : m_screen_shot_slots) {
+    if (slot->buffer == nullptr) {
+      continue;
+    }
+    vkex::Result vkex_result = vkex::Result::Undefined;
+    VKEX_RESULT_CALL(
+      vkex_result,
+      m_device->DestroyBuffer(slot->buffer)
+    );
+    if (!vkex_result) {
+      return vkex_result;
+    }
+    slot->buffer = nullptr;
+  }
+
+  if (m_screen_shot_dropped_count > 0) {
+    VKEX_LOG_WARN("Screenshots skipped because every readback buffer was busy: " << m_screen_shot_dropped_count);
+    m_screen_shot_dropped_count = 0;
+  }
+
+  return vkex::Result::Success;
+}
+
+VkCommandBuffer Application::RecordScreenShot(Application::PresentData* p_data)
+{
+  if (m_screen_shot_slots.empty()) {
+    return VK_NULL_HANDLE;
+  }
+
+  // Headless output reads back every frame
+  HeadlessOutput headless_output = IsApplicationModeHeadless() 
+                                   ? m_configuration.headless.output 
+                                   : HEADLESS_OUTPUT_NONE;
+  bool is_output = (headless_output != HEADLESS_OUTPUT_NONE);
+
+  uint32_t frame_interval = m_configuration.screen_shot.frame_interval;
+  bool     is_interval    = m_configuration.enable_screen_shot && (frame_interval > 0) && ((m_elapsed_frame_count % frame_interval) == 0);
+  bool     is_requested   = m_configuration.enable_screen_shot && m_screen_shot;
+  if (!is_requested && !is_interval && !is_output) {
+    return VK_NULL_HANDLE;
+  }
+
+  // Never wait for a slot in window mode, the print screen request stays
+  // set and is retried next frame while interval captures are skipped.
+  // Headless output can't skip frames, it waits for the encoder instead.
+  // At most frame_count slots are pending on fences so draining the 
+  // encoder frees one.
+  ScreenShotSlot* p_slot = nullptr;
+  for (uint32_t attempt = 0; (attempt < 2) && (p_slot == nullptr); ++attempt) {
+    for (auto& slot : m_screen_shot_slots) {
+      if (slot->state.load(std::memory_order_acquire) == ScreenShotSlot::STATE_FREE) {
+        p_slot = slot.get();
+        break;
+      }
+    }
+    if ((p_slot != nullptr) || !is_output) {
+      break;
+    }
+    m_screen_shot_encoder->WaitIdle();
+  }
+  if (p_slot == nullptr) {
+    if (!is_requested) {
+      ++m_screen_shot_dropped_count;
+    }
+    return VK_NULL_HANDLE;
+  }
+
+  fs::path output_dir = GetApplicationPath().parent();
+  std::stringstream file_name;
+  if (is_output) {
+    if (!m_configuration.headless.output_path.empty()) {
+      output_dir = fs::path(m_configuration.headless.output_path);
+    }
+    file_name << "frame_" << std::setfill('0') << std::setw(6) << m_elapsed_frame_count << ".jpg";
+  }
+  else {
+    file_name << "screenshot_" << std::setfill('0') << std::setw(6) << m_elapsed_frame_count << ".jpg";
+  }
+  p_slot->file_path       = output_dir / file_name.str();
+  p_slot->frame_number    = m_elapsed_frame_count;
+  p_slot->raw             = (headless_output == HEADLESS_OUTPUT_RAW_STREAM);
+  p_slot->width           = m_configuration.window.width;
+  p_slot->height          = m_configuration.window.height;
+  p_slot->format          = m_configuration.swapchain.color_format;
+  p_slot->p_present_data  = p_data;
+
+  // Build command buffer, the application's present commands have already
+  // left the image in the present layout.
+  vkex::CommandBuffer command_buffer = p_slot->command_buffer;
+  {
+    auto rtvs = p_data->GetRenderPass()->GetRtvs();
+    vkex::Image image = rtvs[0]->GetResource()->GetImage();
+    VkImageLayout present_layout = GetPresentLayout();
+    command_buffer->Begin(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+    // Transition image. CmdTransitionImageLayout() waits on nothing when
+    // leaving the present layout, the copy has to wait for the render 
+    // pass's color writes. Headless targets are already in
+    // VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL but need the same wait.
+    VkImageMemoryBarrier image_barrier            = { VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER };
+    image_barrier.srcAccessMask                   = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+    image_barrier.dstAccessMask                   = VK_ACCESS_TRANSFER_READ_BIT;
+    image_barrier.oldLayout                       = present_layout;
+    image_barrier.newLayout                       = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+    image_barrier.srcQueueFamilyIndex             = VK_QUEUE_FAMILY_IGNORED;
+    image_barrier.dstQueueFamilyIndex             = VK_QUEUE_FAMILY_IGNORED;
+    image_barrier.image                           = *image;
+    image_barrier.subresourceRange.aspectMask     = image->GetAspectFlags();
+    image_barrier.subresourceRange.baseMipLevel   = 0;
+    image_barrier.subresourceRange.levelCount     = image->GetMipLevels();
+    image_barrier.subresourceRange.baseArrayLayer = 0;
+    image_barrier.subresourceRange.layerCount     = image->GetArrayLayers();
+    command_buffer->CmdPipelineBarrier(
+      VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+      VK_PIPELINE_STAGE_TRANSFER_BIT,
+      0,
+      0, nullptr,
+      0, nullptr,
+      1, &image_barrier);
+    // Copy
+    VkBufferImageCopy region                = {};
+    region.bufferOffset                     = 0;
+    region.bufferRowLength                  = p_slot->width;
+    region.bufferImageHeight                = p_slot->height;
+    region.imageSubresource.aspectMask      = image->GetAspectFlags();
+    region.imageSubresource.mipLevel        = 0;
+    region.imageSubresource.baseArrayLayer  = 0;
+    region.imageSubresource.layerCount      = 1;
+    region.imageOffset                      = { 0, 0, 0 };
+    region.imageExtent                      = { p_slot->width, p_slot->height, 1 };
+    command_buffer->CmdCopyImageToBuffer(*image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, *p_slot->buffer, 1, &region);
+    // Make the copy visible to the encoder once the fence signals
+    VkMemoryBarrier barrier = { VK_STRUCTURE_TYPE_MEMORY_BARRIER };
+    barrier.srcAccessMask   = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask   = VK_ACCESS_HOST_READ_BIT;
+    command_buffer->CmdPipelineBarrier(
+      VK_PIPELINE_STAGE_TRANSFER_BIT,
+      VK_PIPELINE_STAGE_HOST_BIT,
+      0,
+      1, &barrier,
+      0, nullptr,
+      0, nullptr);
+    // Transition image back. The next render pass's external dependency
+    // starts at VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, so its 
+    // writes wait for the copy to finish reading.
+    image_barrier.srcAccessMask = 0;
+    image_barrier.dstAccessMask = 0;
+    image_barrier.oldLayout     = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+    image_barrier.newLayout     = present_layout;
+    command_buffer->CmdPipelineBarrier(
+      VK_PIPELINE_STAGE_TRANSFER_BIT,
+      VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+      0,
+      0, nullptr,
+      0, nullptr,
+      1, &image_barrier);
+    command_buffer->End();
+  }
+
+  p_slot->state.store(ScreenShotSlot::STATE_PENDING, std::memory_order_release);
+
+  // Clear screenshot flag
+  if (is_requested) {
+    m_screen_shot = false;
+  }
+
+  return *command_buffer;
+}
+
+// Writes a JPEG to file_path, or appends the pixels to p_raw_stream if
+// it's not null
+static void WriteScreenShot(
+  const fs::path& file_path,
+  uint32_t        width,
+  uint32_t        height,
+  VkFormat        format,
+  vkex::Buffer    buffer,
+  std::ofstream*  p_raw_stream)
+{
+  uint32_t component_count = FormatComponentCount(format);
+  uint32_t pixel_stride = FormatSize(format);
+  uint32_t row_stride = width * pixel_stride;
+
+  void* mapped_address = nullptr;
+  VkResult vk_result = buffer->MapMemory(&mapped_address);
+  if (vk_result != VK_SUCCESS) {
+    VKEX_LOG_ERROR("Screenshot map failed: " << file_path);
+    return;
+  }
+
+  // Swap channels in place, the JPEG writer expects RGBA
+  VkFormat dst_format = VK_FORMAT_UNDEFINED;
+  switch (format) {
+    default: break;
+    case VK_FORMAT_B8G8R8A8_UNORM : dst_format = VK_FORMAT_R8G8B8A8_UNORM; break;
+    case VK_FORMAT_B8G8R8A8_SRGB  : dst_format = VK_FORMAT_R8G8B8A8_SRGB; break;
+  }
+  if (dst_format != VK_FORMAT_UNDEFINED) {
+    vkex::PixelConvert(
+      width,
+      height,
+      format,
+      row_stride,
+      mapped_address,
+      dst_format,
+      row_stride,
+      mapped_address);
+  }
+
+  if (p_raw_stream != nullptr) {
+    size_t size = static_cast<size_t>(row_stride) * static_cast<size_t>(height);
+    p_raw_stream->write(static_cast<const char*>(mapped_address), size);
+    if (!p_raw_stream->good()) {
+      VKEX_LOG_ERROR("Raw frame stream write failed");
+    }
+  }
+  else {
+    // Write JPEG since STB's PNG write is *really* slow.
+    vkex::Result vkex_result = Bitmap::WriteJPG(
+      file_path,
+      width,
+      height,
+      component_count,
+      row_stride,
+      mapped_address);
+    if (!vkex_result) {
+      VKEX_LOG_ERROR("Screenshot write failed: " << file_path);
+    }
+  }
+
+  buffer->UnmapMemory();
+}
+
+void Application::EncodeScreenShot(ScreenShotSlot* p_slot)
+{
+  // The encoder has a single thread so frames reach the raw stream in
+  // submission order
+  std::ofstream* p_raw_stream = p_slot->raw ? &m_raw_frame_stream : nullptr;
+  p_slot->p_present_data = nullptr;
+  p_slot->state.store(ScreenShotSlot::STATE_ENCODING, std::memory_order_release);
+  m_screen_shot_encoder->Submit([p_slot, p_raw_stream]() {
+    WriteScreenShot(p_slot->file_path, p_slot->width, p_slot->height, p_slot->format, p_slot->buffer, p_raw_stream);
+    p_slot->state.store(ScreenShotSlot::STATE_FREE, std::memory_order_release);
+  });
+}
+
+void Application::UpdateHostMemoryStats()
+{
+  vkex::HostAllocator* p_host_allocator = m_device->GetHostAllocator();
+  if (p_host_allocator == nullptr) {
+    return;
+  }
+
+  vkex::HostMemoryStats stats = {};
+  p_host_allocator->GetStats(&stats);
+  for (uint32_t i = 0; i < vkex::kHostAllocationScopeCount; ++i) {
+    vkex::HostScopeStats& frame_stats = m_host_memory_frame_stats[i];
+    frame_stats = stats.scopes[i];
+    frame_stats.allocation_count -= m_host_memory_stats.scopes[i].allocation_count;
+    frame_stats.allocated_bytes  -= m_host_memory_stats.scopes[i].allocated_bytes;
+  }
+  m_host_memory_stats = stats;
+}
+
+void Application::ProcessScreenShots(Application::PresentData* p_data)
+{
+  for (auto& slot : m_screen_shot_slots) {
+    if ((slot->p_present_data == p_data) && 
+        (slot->state.load(std::memory_order_acquire) == ScreenShotSlot::STATE_PENDING)) {
+      EncodeScreenShot(slot.get());
+    }
+  }
+}
+
+void Application::FlushScreenShots()
+{
+  // Oldest frame first
+  std::vector<ScreenShotSlot*> pending;
+  for (auto& slot : m_screen_shot_slots) {
+    if (slot->state.load(std::memory_order_acquire) == ScreenShotSlot::STATE_PENDING) {
+      pending.push_back(slot.get());
+    }
+  }
+  std::sort(
+    pending.begin(),
+    pending.end(),
+    [](const ScreenShotSlot* a, const ScreenShotSlot* b) {
+      return a->frame_number < b->frame_number; });
+  for (auto p_slot : pending) {
+    EncodeScreenShot(p_slot);
+  }
+  if (m_screen_shot_encoder) {
+    m_screen_shot_encoder->WaitIdle();
+  }
+}
+
 bool Application::IsRunning() const
 {
   bool is_running = m_running;
@@ -2725,6 +3405,10 @@ vkex::Result Application::Run(int argn, const char* const* argv)
 {
   // Add args
   DispatchCallAddArgs(m_args);
+  m_args.AddOptionInt("frames", "frames", "Exit after N frames");
+  m_args.AddFlag("headless", "headless", "Render offscreen without a window");
+  m_args.AddOptionString("memory-stats", "memory-stats", "Write memory statistics as JSON to this file at exit");
+  m_args.AddFlag("host-memory", "host-memory", "Track driver host allocations and show them in the memory panel");
 
   // Parse args
   {
@@ -2737,6 +3421,24 @@ vkex::Result Application::Run(int argn, const char* const* argv)
   // Call app configure
   DispatchCallConfigure(m_args, m_configuration);
 
+  // Command line overrides
+  {
+    int frames = 0;
+    if (m_args.GetInt("frames", "frames", &frames) && (frames > 0)) {
+      m_configuration.frame_limit = static_cast<uint64_t>(frames);
+    }
+    if (m_args.GetFlag("headless", "headless")) {
+      m_configuration.mode = APPLICATION_MODE_HEADLESS;
+    }
+    std::string memory_stats_path;
+    if (m_args.GetString("memory-stats", "memory-stats", &memory_stats_path) && !memory_stats_path.empty()) {
+      m_configuration.memory_stats.json_path = memory_stats_path;
+    }
+    if (m_args.GetFlag("host-memory", "host-memory")) {
+      m_configuration.host_memory.enable = true;
+    }
+  }
+
   // Check configuration
   vkex::Result vkex_result = CheckConfiguration();
   if (!vkex_result) {
@@ -2755,6 +3457,9 @@ vkex::Result Application::Run(int argn, const char* const* argv)
   if (IsApplicationModeWindow()) {
     glfwSetTime(0);
   }
+  else {
+    m_headless_start_timestamp = vkex::Timer::Timestamp();
+  }
   
   // -----------------------------------------------------------------------------------------------
   // Main loop [BEGIN]
@@ -2802,6 +3507,11 @@ vkex::Result Application::Run(int argn, const char* const* argv)
         return vkex_result;
       }
     }
+
+    // Objects passed to DestroyDeferred from here on are tagged with this frame
+    m_device->SetRetireValue(m_elapsed_frame_count);
+
+    UpdateHostMemoryStats();
     //m_current_render_data = m_per_frame_render_data[m_frame_index].get();
     //if (IsApplicationModeWindow()) {
     //  if (m_current_present_data != nullptr) {
@@ -2816,6 +3526,10 @@ vkex::Result Application::Run(int argn, const char* const* argv)
       ImGui_ImplGlfw_NewFrame();
       ImGui::NewFrame();
     }
+    else if (IsApplicationModeHeadless() && m_configuration.enable_imgui) {
+      ImGui::GetIO().DeltaTime = std::max(static_cast<float>(m_frame_elapsed_time), 1.0f / 1000000.0f);
+      ImGui::NewFrame();
+    }
 
     // Call app update
     {
@@ -2852,7 +3566,7 @@ vkex::Result Application::Run(int argn, const char* const* argv)
     }
 
     // Present data
-    if (IsApplicationModeWindow()) {
+    {
       vkex::Result vkex_result = ProcessFrameFence(m_current_present_data);
       if (!vkex_result) {
         return vkex_result;
@@ -2871,6 +3585,9 @@ vkex::Result Application::Run(int argn, const char* const* argv)
         return vkex_result;
       }
     }
+    else {
+      m_current_swapchain_image_index = static_cast<uint32_t>(m_elapsed_frame_count % m_render_passes.size());
+    }
 
     // Pace fames - if needed
     if (m_configuration.swapchain.paced_frame_rate > 0) {
@@ -2892,13 +3609,13 @@ vkex::Result Application::Run(int argn, const char* const* argv)
     }
 
     // Set present render pass
-    if (IsApplicationModeWindow()) {
+    {
       vkex::RenderPass render_pass = m_render_passes[m_current_swapchain_image_index];
       m_current_present_data->SetRenderPass(render_pass);
     }
 
     // Call app present
-    if (IsApplicationModeWindow()) {
+    {
       double start_time = GetElapsedTime();
       DispatchCallPresent(m_current_present_data);
       double end_time = GetElapsedTime();
@@ -2909,6 +3626,11 @@ vkex::Result Application::Run(int argn, const char* const* argv)
     m_elapsed_frame_count += 1;
     // In flight image index
     m_frame_index = (m_elapsed_frame_count % m_configuration.frame_count);
+
+    // Frame limit
+    if ((m_configuration.frame_limit > 0) && (m_elapsed_frame_count >= m_configuration.frame_limit)) {
+      Quit();
+    }
   }
   // -----------------------------------------------------------------------------------------------
   // Main loop [END]
@@ -2920,6 +3642,14 @@ vkex::Result Application::Run(int argn, const char* const* argv)
     return vkex_result;
   }
 
+  // Throughput
+  {
+    double elapsed_time = GetElapsedTime();
+    double frame_rate = (elapsed_time > 0) ? (static_cast<double>(m_elapsed_frame_count) / elapsed_time) : 0;
+    VKEX_LOG_INFO("");
+    VKEX_LOG_INFO("Rendered " << m_elapsed_frame_count << " frames in " << elapsed_time << " seconds (" << frame_rate << " FPS)");
+  }
+
   // Wait for device to become idle
   {
     VkResult vk_result = InvalidValue<VkResult>::Value;
@@ -2929,6 +3659,14 @@ vkex::Result Application::Run(int argn, const char* const* argv)
     }
   }
 
+  // Memory statistics, before anything is destroyed
+  if (!m_configuration.memory_stats.json_path.empty()) {
+    vkex_result = WriteMemoryStats(m_configuration.memory_stats.json_path);
+    if (!vkex_result) {
+      VKEX_LOG_ERROR("Unable to write memory statistics: " << m_configuration.memory_stats.json_path);
+    }
+  }
+
   // Call app destroy
   DispatchCallDestroy();
 
@@ -2962,7 +3700,10 @@ uint32_t Application::GetCurrentFrameIndex() const
 
 float Application::GetElapsedTime() const
 {
-  double elapsed_seconds = glfwGetTime();
+  // GLFW isn't initialized in headless mode
+  double elapsed_seconds = IsApplicationModeWindow() 
+                           ? glfwGetTime() 
+                           : vkex::Timer::TimestampToSeconds(vkex::Timer::Timestamp() - m_headless_start_timestamp);
   return static_cast<float>(elapsed_seconds);
 }
 
@@ -2990,11 +3731,52 @@ vkex::Queue Application::GetGraphicsQueue() const
   return m_graphics_queue;
 }
 
+vkex::Queue Application::GetTransferQueue() const
+{
+  return m_transfer_queue;
+}
+
+vkex::Result Application::SubmitAsyncUpload(vkex::TransferBatch* p_transfer_batch, vkex::TransferToken* p_token)
+{
+  VKEX_ASSERT(p_transfer_batch != nullptr);
+  if (p_transfer_batch == nullptr) {
+    return vkex::Result::ErrorUnexpectedNullPointer;
+  }
+
+  // SubmitRender only looks for handoffs once the manager exists
+  if (m_transfer_upload_manager.load() == nullptr) {
+    vkex::UploadManager upload_manager = nullptr;
+    vkex::Result vkex_result = m_device->GetUploadManager(m_transfer_queue, &upload_manager);
+    if (!vkex_result) {
+      return vkex_result;
+    }
+    m_transfer_upload_manager.store(upload_manager);
+  }
+
+  return p_transfer_batch->Submit(m_transfer_queue, m_graphics_queue, p_token);
+}
+
+VkImageLayout Application::GetPresentLayout() const
+{
+  // VK_IMAGE_LAYOUT_PRESENT_SRC_KHR needs VK_KHR_swapchain, headless
+  // targets are left ready for readback instead.
+  VkImageLayout layout = IsApplicationModeWindow() 
+                         ? VK_IMAGE_LAYOUT_PRESENT_SRC_KHR 
+                         : VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+  return layout;
+}
+
 vkex::Application::RenderData* Application::GetCurrentRenderData() const
 {
   return m_current_render_data;
 }
 
+vkex::Application::RenderData* Application::GetRenderData(uint32_t frame_index) const
+{
+  VKEX_ASSERT(frame_index < m_per_frame_render_data.size());
+  return m_per_frame_render_data[frame_index].get();
+}
+
 vkex::Application::PresentData* Application::GetCurrentPresentData() const
 {
   return m_current_present_data;
@@ -3213,4 +3995,138 @@ void Application::DrawDebugApplicationInfo()
   ImGui::End();
 }
 
+void Application::DrawDebugMemoryStats()
+{
+  if (!m_configuration.enable_imgui) {
+    return;
+  }
+
+  vkex::MemoryStats stats = {};
+  vkex::Result vkex_result = GetDevice()->GetMemoryStats(&stats);
+  if (!vkex_result) {
+    return;
+  }
+
+  const float kMiB = 1024.0f * 1024.0f;
+
+  if (ImGui::Begin("Memory")) {
+    // Heaps
+    {
+      ImGui::Text("Budget: %s", stats.budget_supported ? "VK_EXT_memory_budget" : "estimated");
+      for (uint32_t i = 0; i < CountU32(stats.heaps); ++i) {
+        const vkex::MemoryHeapStats& heap = stats.heaps[i];
+        bool device_local = (heap.flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT);
+        float fraction = (heap.budget > 0) ? (static_cast<float>(heap.usage) / static_cast<float>(heap.budget)) : 0.0f;
+
+        std::stringstream ss;
+        ss << std::fixed << std::setprecision(1) << (heap.usage / kMiB) << " / " << (heap.budget / kMiB) << " MiB";
+        ImGui::Text("Heap %u%s", i, device_local ? " (device local)" : "");
+        ImGui::ProgressBar(fraction, ImVec2(-1, 0), ss.str().c_str());
+      }
+    }
+
+    ImGui::Separator();
+
+    // Types
+    {
+      ImGui::Columns(4);
+      ImGui::Text("Type"); ImGui::NextColumn();
+      ImGui::Text("Allocations"); ImGui::NextColumn();
+      ImGui::Text("Used / Blocks (MiB)"); ImGui::NextColumn();
+      ImGui::Text("Fragmentation"); ImGui::NextColumn();
+      for (uint32_t i = 0; i < CountU32(stats.types); ++i) {
+        const vkex::MemoryTypeStats& type = stats.types[i];
+        if (type.blocks.block_count == 0) {
+          continue;
+        }
+        VkDeviceSize block_bytes = type.blocks.used_bytes + type.blocks.unused_bytes;
+        ImGui::Text("%u (heap %u)", i, type.heap_index); ImGui::NextColumn();
+        ImGui::Text("%u", type.blocks.allocation_count); ImGui::NextColumn();
+        ImGui::Text("%.1f / %.1f", type.blocks.used_bytes / kMiB, block_bytes / kMiB); ImGui::NextColumn();
+        ImGui::Text("%.0f%%", type.blocks.fragmentation * 100.0f); ImGui::NextColumn();
+      }
+      ImGui::Columns(1);
+    }
+
+    ImGui::Separator();
+
+    // Objects
+    {
+      ImGui::Columns(2);
+      {
+        ImGui::Text("Buffers");
+        ImGui::NextColumn();
+        ImGui::Text("%u, %.1f MiB", stats.buffers.count, stats.buffers.size / kMiB);
+        ImGui::NextColumn();
+      }
+      {
+        ImGui::Text("Images");
+        ImGui::NextColumn();
+        ImGui::Text("%u, %.1f MiB", stats.images.count, stats.images.size / kMiB);
+        ImGui::NextColumn();
+      }
+      {
+        ImGui::Text("Swapchain Pool Images");
+        ImGui::NextColumn();
+        ImGui::Text("%u, %.1f MiB", stats.pool_images.count, stats.pool_images.size / kMiB);
+        ImGui::NextColumn();
+      }
+      ImGui::Columns(1);
+    }
+
+    // Driver host allocations
+    if (GetDevice()->GetHostAllocator() != nullptr) {
+      const float kKiB = 1024.0f;
+
+      ImGui::Separator();
+      ImGui::Text("Host (arena %.1f KiB, %llu fallbacks)",
+        m_host_memory_stats.arena_capacity / kKiB,
+        static_cast<unsigned long long>(m_host_memory_stats.arena_fallback_count));
+      ImGui::Columns(4);
+      ImGui::Text("Scope"); ImGui::NextColumn();
+      ImGui::Text("Live (KiB)"); ImGui::NextColumn();
+      ImGui::Text("Peak (KiB)"); ImGui::NextColumn();
+      ImGui::Text("Last Frame (KiB)"); ImGui::NextColumn();
+      for (uint32_t i = 0; i < vkex::kHostAllocationScopeCount; ++i) {
+        const vkex::HostScopeStats& scope = m_host_memory_stats.scopes[i];
+        const vkex::HostScopeStats& frame = m_host_memory_frame_stats[i];
+        ImGui::Text("%s", vkex::HostAllocator::GetScopeName(i)); ImGui::NextColumn();
+        ImGui::Text("%llu, %.1f", static_cast<unsigned long long>(scope.live_count), scope.live_bytes / kKiB); ImGui::NextColumn();
+        ImGui::Text("%.1f", scope.peak_bytes / kKiB); ImGui::NextColumn();
+        ImGui::Text("%llu, %.1f", static_cast<unsigned long long>(frame.allocation_count), frame.allocated_bytes / kKiB); ImGui::NextColumn();
+      }
+      ImGui::Columns(1);
+    }
+
+    ImGui::Separator();
+
+    if (ImGui::Button("Write JSON")) {
+      WriteMemoryStats(m_configuration.memory_stats.json_path);
+    }
+  }
+  ImGui::End();
+}
+
+vkex::Result Application::WriteMemoryStats(const fs::path& file_path) const
+{
+  vkex::MemoryStats stats = {};
+  vkex::Result vkex_result = GetDevice()->GetMemoryStats(&stats);
+  if (!vkex_result) {
+    return vkex_result;
+  }
+
+  fs::path output_path = !file_path
+                         ? (GetApplicationPath().parent() / "memory_stats.json")
+                         : file_path;
+  std::ofstream os(output_path.c_str(), std::ios::trunc);
+  if (!os.is_open()) {
+    return vkex::Result::ErrorOpenFileFailed;
+  }
+  os << vkex::ToJson(stats);
+
+  VKEX_LOG_INFO("Memory statistics written to " << output_path);
+
+  return vkex::Result::Success;
+}
+
 } // namespace vkex
@@ -21,9 +21,11 @@
 #include <vkex/Bitmap.h>
 #include <vkex/Camera.h>
 #include <vkex/Cast.h>
+#include <vkex/ConstantAllocator.h>
 #include <vkex/FileSystem.h>
 #include <vkex/Geometry.h>
 #include <vkex/Instance.h>
+#include <vkex/ThreadPool.h>
 #include <vkex/Timer.h>
 #include <vkex/ToString.h>
 #include <vkex/Transform.h>
@@ -47,6 +49,8 @@
 
 #include <imgui.h>
 
+#include <atomic>
+#include <fstream>
 #include <mutex>
 #include <thread>
 #include <unordered_map>
@@ -207,6 +211,18 @@ enum ApplicationMode {
   APPLICATION_MODE_HEADLESS
 };
 
+/** @enum HeadlessOutput
+ *
+ */
+enum HeadlessOutput {
+  HEADLESS_OUTPUT_NONE = 0,
+  // One JPEG per frame
+  HEADLESS_OUTPUT_IMAGES,
+  // Frames appended to a single file as tightly packed rows in the color
+  // format, B8G8R8A8 is written as R8G8B8A8
+  HEADLESS_OUTPUT_RAW_STREAM,
+};
+
 /** @enum Joystick
  *
  */
@@ -281,6 +297,19 @@ struct Configuration {
   //
   uint32_t                    frame_count;
 
+  // Size of each in flight frame's constant allocator, see
+  // RenderData::GetConstantAllocator()
+  //
+  // Default: 0 (1 MiB)
+  //
+  VkDeviceSize                constant_allocator_size;
+
+  // Exit after this many frames, also set by --frames
+  //
+  // Default: 0 (no limit)
+  //
+  uint64_t                    frame_limit;
+
 
   // Window
   //
@@ -294,6 +323,30 @@ struct Configuration {
     CursorMode                cursor_mode;
   } window;
 
+  // Headless
+  //
+  // Ignored if application 'mode' is APPLICATION_MODE_WINDOW. Frames are
+  // rendered into a ring of offscreen color and depth/stencil targets 
+  // sized by 'window' and using the 'swapchain' formats, load/store ops
+  // and clear values. Output is read back through the screenshot ring
+  // without stalling the frame.
+  //
+  struct {
+    // Number of offscreen targets
+    //
+    // Default: 0 (frame_count)
+    // Bounds : [frame_count, ...]
+    uint32_t                  image_count;
+
+    // Default: HEADLESS_OUTPUT_NONE
+    HeadlessOutput            output;
+
+    // Directory for HEADLESS_OUTPUT_IMAGES, file for HEADLESS_OUTPUT_RAW_STREAM
+    //
+    // Default: empty (application directory, frames.raw)
+    std::string               output_path;
+  } headless;
+
   // Swapchain
   //
   // Ignored if application 'mode' is APPLICATION_MODE_WINDOW.
@@ -360,7 +413,46 @@ struct Configuration {
   bool                        enable_imgui;
 
   // Screenshot
+  //
+  // Frames are copied into a ring of readback buffers as part of the
+  // present submission and encoded to JPEG on a worker thread, so a
+  // capture never waits on the GPU. Continuous captures are skipped
+  // while every buffer in the ring is still in use.
+  //
   bool                        enable_screen_shot;
+  struct {
+    // Number of readback buffers
+    //
+    // Default: 0 (frame_count + 2)
+    uint32_t                  ring_size;
+
+    // Capture every Nth frame
+    //
+    // Default: 0 (print screen only)
+    uint32_t                  frame_interval;
+  } screen_shot;
+
+  // Memory statistics, see CDevice::GetMemoryStats()
+  struct {
+    // Written as JSON at exit, also set by --memory-stats
+    //
+    // Default: empty (not written)
+    std::string               json_path;
+  } memory_stats;
+
+  // Driver host allocations, see vkex::HostAllocator
+  struct {
+    // Counts the instance's and device's host allocations per scope and
+    // adds them to the memory panel, also set by --host-memory
+    //
+    // Default: false
+    bool                      enable;
+
+    // Serves command scope allocations from a linear arena
+    //
+    // Default: false
+    bool                      command_arena;
+  } host_memory;
 };
 
 /** @class Application
@@ -383,9 +475,12 @@ public:
     vkex::CommandBuffer           GetCommandBuffer() { return m_work_cmd; }
     vkex::Semaphore               GetWorkCompleteSemaphore() const { return m_work_complete_semaphore; }
     vkex::Fence                   GetWorkcompleteFence() const { return m_work_complete_fence; }
+    // Reset once the frame's fence has signaled. Flushed by SubmitRender(),
+    // apps that submit their own work must call Flush() before that.
+    vkex::ConstantAllocator*      GetConstantAllocator() { return &m_constant_allocator; }
   private:
     friend class vkex::Application;
-    vkex::Result InternalCreate(vkex::Device device, uint32_t frame_index, vkex::CommandBuffer cmd);
+    vkex::Result InternalCreate(vkex::Device device, uint32_t frame_index, vkex::CommandBuffer cmd, vkex::CommandBuffer acquire_cmd, VkDeviceSize constant_allocator_size);
     vkex::Result InternalDestroy();
     void SetPrevious(Application::RenderData* p_previous);
   private:
@@ -396,6 +491,10 @@ public:
     vkex::CommandBuffer           m_work_cmd                = nullptr;
     vkex::Semaphore               m_work_complete_semaphore = nullptr;
     vkex::Fence                   m_work_complete_fence     = nullptr;
+    // Acquires ownership of async uploads ahead of m_work_cmd
+    vkex::CommandBuffer           m_acquire_cmd             = nullptr;
+    std::vector<vkex::Semaphore>  m_upload_semaphores       = {};
+    vkex::ConstantAllocator       m_constant_allocator;
   };
 
   /** @class PresentData
@@ -600,9 +699,21 @@ public:
   //! @fn GetGraphicsQueue
   vkex::Queue GetGraphicsQueue() const;
 
+  //! @fn GetTransferQueue - Queue from a transfer only family if the device has one, otherwise the graphics queue
+  vkex::Queue GetTransferQueue() const;
+
+  //! @fn SubmitAsyncUpload - Submits p_transfer_batch on the transfer queue and hands what it writes to the graphics queue. The next SubmitRender waits for it and acquires ownership, it doesn't stall the CPU or graphics work submitted before then.
+  vkex::Result SubmitAsyncUpload(vkex::TransferBatch* p_transfer_batch, vkex::TransferToken* p_token = nullptr);
+
+  //! @fn GetPresentLayout - Layout the present render pass targets start and end in. PRESENT_SRC in window mode, TRANSFER_SRC_OPTIMAL in headless mode.
+  VkImageLayout GetPresentLayout() const;
+
   //! @fn GetCurrentRenderData()
   Application::RenderData* GetCurrentRenderData() const;
 
+  //! @fn GetRenderData - Render data for in flight frame frame_index, e.g. to bind its constant allocator's buffer in per frame descriptor sets.
+  Application::RenderData* GetRenderData(uint32_t frame_index) const;
+
   //! @fn GetCurrentPresentData()
   Application::PresentData* GetCurrentPresentData() const;
 
@@ -614,6 +725,12 @@ public:
   //! @fn DrawDebugApplicationInfo
   void DrawDebugApplicationInfo();
 
+  //! @fn DrawDebugMemoryStats - Per heap usage against budget, fragmentation and usage by object type.
+  void DrawDebugMemoryStats();
+
+  //! @fn WriteMemoryStats - Writes CDevice::GetMemoryStats() as JSON, an empty file_path writes memory_stats.json next to the application.
+  vkex::Result WriteMemoryStats(const fs::path& file_path = fs::path()) const;
+
 private:
   friend struct WindowEvents;
 
@@ -626,12 +743,21 @@ private:
   //! @fn InitializeVkexDevice
   vkex::Result InitializeVkexDevice();
 
+  //! @fn CreateVkexImageMemoryPool
+  vkex::Result CreateVkexImageMemoryPool(VkFormat format, VkImageUsageFlags usage, VmaPool* p_pool);
+
   //! @fn InitializeVkexSwapchainImageMemoryPool();
   vkex::Result InitializeVkexSwapchainImageMemoryPool();
 
   //! @fn InitializeVkexSwapchain
   vkex::Result InitializeVkexSwapchain();
 
+  //! @fn InitializeVkexFrameTargets
+  vkex::Result InitializeVkexFrameTargets(const std::vector<vkex::Image>& color_images, const std::vector<vkex::Image>& depth_stencil_images);
+
+  //! @fn InitializeVkexHeadlessTargets
+  vkex::Result InitializeVkexHeadlessTargets();
+
   //! @fn InitializeVkexPerFrameRenderData();
   vkex::Result InitializeVkexPerFrameRenderData();
 
@@ -650,9 +776,15 @@ private:
   //! @fn DestroyVkexSwapchain();
   vkex::Result DestroyVkexSwapchainImageMemoryPool();
 
+  //! @fn DestroyVkexFrameTargets
+  vkex::Result DestroyVkexFrameTargets();
+
   //! @fn DestroyVkexSwapchain();
   vkex::Result DestroyVkexSwapchain();
 
+  //! @fn DestroyVkexHeadlessTargets
+  vkex::Result DestroyVkexHeadlessTargets();
+
   //! @fn InitializeImgui
   vkex::Result DestroyImGui();
 
@@ -683,6 +815,9 @@ private:
   //! @fn UpdateCurrentPerFrameData
   vkex::Result UpdateCurrentPerFrameData();
 
+  //! @fn UpdateHostMemoryStats - Takes the device's host allocation traffic since the previous call as the last frame's
+  void UpdateHostMemoryStats();
+
   //! @fn ProcessRenderFence
   vkex::Result ProcessRenderFence(Application::RenderData* p_data);
 
@@ -695,6 +830,52 @@ private:
   //! @fn WaitAllQueuesIdle
   vkex::Result WaitAllQueuesIdle();
 
+  /** @struct ScreenShotSlot
+   *
+   */
+  struct ScreenShotSlot {
+    enum State : uint32_t {
+      STATE_FREE = 0,
+      // Copy submitted, waiting on the present data's work complete fence
+      STATE_PENDING,
+      // Owned by the encoder thread
+      STATE_ENCODING,
+    };
+
+    vkex::Buffer                buffer          = nullptr;
+    vkex::CommandBuffer         command_buffer  = nullptr;
+    Application::PresentData*   p_present_data  = nullptr;
+    uint64_t                    frame_number    = 0;
+    // Appended to the raw stream instead of written as a JPEG
+    bool                        raw             = false;
+    fs::path                    file_path;
+    uint32_t                    width           = 0;
+    uint32_t                    height          = 0;
+    VkFormat                    format          = VK_FORMAT_UNDEFINED;
+    std::atomic<uint32_t>       state{STATE_FREE};
+  };
+
+  //! @fn HasScreenShotRing
+  bool HasScreenShotRing() const;
+
+  //! @fn InitializeScreenShotBuffers
+  vkex::Result InitializeScreenShotBuffers();
+
+  //! @fn DestroyScreenShotBuffers
+  vkex::Result DestroyScreenShotBuffers();
+
+  //! @fn RecordScreenShot - Returns VK_NULL_HANDLE if no capture is due or every slot is busy
+  VkCommandBuffer RecordScreenShot(Application::PresentData* p_data);
+
+  //! @fn EncodeScreenShot - Hands a pending slot to the encoder thread
+  void EncodeScreenShot(ScreenShotSlot* p_slot);
+
+  //! @fn ProcessScreenShots - Hands slots whose copy was fenced by p_data to the encoder
+  void ProcessScreenShots(Application::PresentData* p_data);
+
+  //! @fn FlushScreenShots - Encodes all pending slots, queues must be idle
+  void FlushScreenShots();
+
 private:
   bool IsRunning() const;
 
@@ -728,9 +909,12 @@ protected:
   vkex::Queue                   m_graphics_queue = nullptr;
   vkex::Queue                   m_compute_queue = nullptr;
   vkex::Queue                   m_transfer_queue = nullptr;
+  std::atomic<vkex::UploadManager> m_transfer_upload_manager{nullptr};
   vkex::Queue                   m_present_queue = nullptr;
   vkex::Surface                 m_surface = nullptr;
   VmaPool                       m_swapchain_image_memory_pool = VK_NULL_HANDLE;
+  // Headless only, m_swapchain_image_memory_pool holds the color targets
+  VmaPool                       m_depth_stencil_image_memory_pool = VK_NULL_HANDLE;
   vkex::Swapchain               m_swapchain = nullptr;
   uint32_t                      m_current_swapchain_image_index = UINT32_MAX;
   std::vector<vkex::ImageView>  m_color_image_views;
@@ -761,10 +945,21 @@ protected:
   bool                          m_keys[kNumKeys] = {false};
 
   bool                          m_screen_shot = false;
-  vkex::Buffer                  m_screenshot_buffer = nullptr;
+  std::vector<std::unique_ptr<ScreenShotSlot>>  m_screen_shot_slots;
+  std::unique_ptr<vkex::ThreadPool>             m_screen_shot_encoder;
+  uint64_t                      m_screen_shot_dropped_count = 0;
+  std::ofstream                 m_raw_frame_stream;
+
+  uint64_t                      m_headless_start_timestamp = 0;
+  std::vector<vkex::Image>      m_headless_color_images;
+  std::vector<vkex::Image>      m_headless_depth_stencil_images;
 
   HistoryT<TimeRange, 100>      m_vk_queue_present_times;
   float                         m_average_vk_queue_present_time = 0;
+
+  // Device host allocations at the start of this frame and over the last one
+  vkex::HostMemoryStats         m_host_memory_stats = {};
+  vkex::HostScopeStats          m_host_memory_frame_stats[vkex::kHostAllocationScopeCount] = {};
 };
 
 } // namespace vkex
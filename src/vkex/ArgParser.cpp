@@ -270,7 +270,7 @@ bool ArgParser::GetFlag(const std::string& short_name, const std::string& long_n
     p_option = p_short;
   }
   if ((p_option == nullptr) && (p_long != nullptr)) {
-    p_option = p_short;
+    p_option = p_long;
   }
 
   if (p_option == nullptr) {
@@ -294,7 +294,7 @@ bool ArgParser::GetString(const std::string& short_name, const std::string& long
     p_option = p_short;
   }
   if ((p_option == nullptr) && (p_long != nullptr)) {
-    p_option = p_short;
+    p_option = p_long;
   }
 
   if (p_option == nullptr) {
@@ -322,7 +322,7 @@ bool ArgParser::GetInt(const std::string& short_name, const std::string& long_na
     p_option = p_short;
   }
   if ((p_option == nullptr) && (p_long != nullptr)) {
-    p_option = p_short;
+    p_option = p_long;
   }
 
   if (p_option == nullptr) {
@@ -350,7 +350,7 @@ bool ArgParser::GetFloat(const std::string& short_name, const std::string& long_
     p_option = p_short;
   }
   if ((p_option == nullptr) && (p_long != nullptr)) {
-    p_option = p_short;
+    p_option = p_long;
   }
 
   if (p_option == nullptr) {
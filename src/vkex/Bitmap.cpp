@@ -15,8 +15,101 @@
 */
 
 #include "vkex/Bitmap.h"
+#include "vkex/BlockCompress.h"
+#include "vkex/PixelConvert.h"
+#include "vkex/ThreadPool.h"
 #include "vkex/VulkanUtil.h"
 
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+
+// stb_image allocates decoded images and its working buffers through
+// these. One large block is kept per thread and handed out again, so a
+// thread decoding one image after another, e.g. a BitmapBatchLoader
+// worker, doesn't allocate and free the whole decoded image each time.
+namespace {
+
+struct alignas(16) StbiBlockHeader {
+  size_t capacity;
+};
+
+// Smaller blocks aren't worth keeping, bigger ones not worth holding on to
+const size_t kStbiScratchMinSize = 256 * 1024;
+const size_t kStbiScratchMaxSize = 64 * 1024 * 1024;
+
+struct StbiScratch {
+  StbiBlockHeader* p_block = nullptr;
+
+  ~StbiScratch() {
+    std::free(p_block);
+  }
+};
+
+thread_local StbiScratch t_stbi_scratch;
+
+void* StbiMalloc(size_t size)
+{
+  StbiBlockHeader* p_header = t_stbi_scratch.p_block;
+  if ((size >= kStbiScratchMinSize) && (p_header != nullptr) && (p_header->capacity >= size)) {
+    t_stbi_scratch.p_block = nullptr;
+    return p_header + 1;
+  }
+
+  p_header = static_cast<StbiBlockHeader*>(std::malloc(sizeof(StbiBlockHeader) + size));
+  if (p_header == nullptr) {
+    return nullptr;
+  }
+  p_header->capacity = size;
+  return p_header + 1;
+}
+
+void StbiFree(void* p_memory)
+{
+  if (p_memory == nullptr) {
+    return;
+  }
+
+  // Keep the biggest block seen on this thread
+  StbiBlockHeader* p_header = static_cast<StbiBlockHeader*>(p_memory) - 1;
+  StbiBlockHeader* p_cached = t_stbi_scratch.p_block;
+  bool keep = (p_header->capacity >= kStbiScratchMinSize) &&
+              (p_header->capacity <= kStbiScratchMaxSize) &&
+              ((p_cached == nullptr) || (p_cached->capacity < p_header->capacity));
+  if (keep) {
+    std::free(p_cached);
+    t_stbi_scratch.p_block = p_header;
+    return;
+  }
+  std::free(p_header);
+}
+
+void* StbiRealloc(void* p_memory, size_t size)
+{
+  if (p_memory == nullptr) {
+    return StbiMalloc(size);
+  }
+
+  const StbiBlockHeader* p_header = static_cast<const StbiBlockHeader*>(p_memory) - 1;
+  if (p_header->capacity >= size) {
+    return p_memory;
+  }
+
+  void* p_new = StbiMalloc(size);
+  if (p_new == nullptr) {
+    return nullptr;
+  }
+  std::memcpy(p_new, p_memory, p_header->capacity);
+  StbiFree(p_memory);
+  return p_new;
+}
+
+} // namespace
+
+#define STBI_MALLOC(size)           StbiMalloc(size)
+#define STBI_REALLOC(p, size)       StbiRealloc(p, size)
+#define STBI_FREE(p)                StbiFree(p)
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
 
@@ -26,8 +119,557 @@
 #define STB_IMAGE_RESIZE_IMPLEMENTATION
 #include "stb_image_resize.h"
 
+#if defined(VKEX_SIMD_SSE2)
+# include <emmintrin.h>
+#endif
+#if defined(VKEX_SIMD_AVX2) || defined(VKEX_SIMD_F16C)
+# include <immintrin.h>
+#endif
+
 namespace vkex {
 
+// =================================================================================================
+// MIP filter kernels
+// =================================================================================================
+
+// Kaiser-windowed sinc for a 2:1 reduction. Each destination texel is
+// centered between two source texels, so the taps sit at +/-0.5, +/-1.5, 
+// +/-2.5 and +/-3.5 source texels from the center.
+enum {
+  kKaiserTapCount = 8,
+  kKaiserTapStart = -3,
+};
+
+// Levels smaller than this are generated on the calling thread
+enum {
+  kMipMinParallelDataSize = 256 * 1024,
+  kMipMinBandRowCount     = 16,
+};
+
+static const float kKaiserAlpha  = 4.0f;
+static const float kKaiserRadius = 4.0f;
+
+static float BesselI0(float x)
+{
+  // Power series, converges quickly for the alpha values used here
+  float sum  = 1.0f;
+  float term = 1.0f;
+  float half_x = 0.5f * x;
+  for (int k = 1; k < 32; ++k) {
+    term *= (half_x / static_cast<float>(k));
+    float term_sq = term * term;
+    sum += term_sq;
+    if (term_sq < (sum * 1.0e-8f)) {
+      break;
+    }
+  }
+  return sum;
+}
+
+static void CalculateKaiserWeights(float* p_weights)
+{
+  const float pi = 3.14159265358979323846f;
+  float total = 0.0f;
+  for (int i = 0; i < kKaiserTapCount; ++i) {
+    // Distance from destination texel center in source texels
+    float x = static_cast<float>(i + kKaiserTapStart) - 0.5f;
+    // Low pass at half the source Nyquist frequency
+    float t    = 0.5f * x;
+    float sinc = (t == 0.0f) ? 1.0f : (std::sin(pi * t) / (pi * t));
+    // Window
+    float r      = x / kKaiserRadius;
+    float window = BesselI0(kKaiserAlpha * std::sqrt(std::max(0.0f, 1.0f - r * r))) / BesselI0(kKaiserAlpha);
+    p_weights[i] = sinc * window;
+    total += p_weights[i];
+  }
+  for (int i = 0; i < kKaiserTapCount; ++i) {
+    p_weights[i] /= total;
+  }
+}
+
+#if defined(VKEX_SIMD_SSE2)
+// Sums horizontally adjacent pixels of 16 vertically summed source bytes
+// (lo = bytes 0-7, hi = bytes 8-15). Returns 8 sums in destination order.
+static inline __m128i PairSumU16(__m128i lo, __m128i hi, uint32_t component_count)
+{
+  switch (component_count) {
+    case 1: {
+      const __m128i ones = _mm_set1_epi16(1);
+      return _mm_packs_epi32(_mm_madd_epi16(lo, ones), _mm_madd_epi16(hi, ones));
+    }
+    case 2: {
+      __m128i even = _mm_unpacklo_epi64(
+        _mm_shuffle_epi32(lo, _MM_SHUFFLE(2, 0, 2, 0)), 
+        _mm_shuffle_epi32(hi, _MM_SHUFFLE(2, 0, 2, 0)));
+      __m128i odd  = _mm_unpacklo_epi64(
+        _mm_shuffle_epi32(lo, _MM_SHUFFLE(3, 1, 3, 1)), 
+        _mm_shuffle_epi32(hi, _MM_SHUFFLE(3, 1, 3, 1)));
+      return _mm_add_epi16(even, odd);
+    }
+  }
+  return _mm_add_epi16(_mm_unpacklo_epi64(lo, hi), _mm_unpackhi_epi64(lo, hi));
+}
+
+// Sums horizontally adjacent pixels of 8 vertically summed source floats.
+// Returns 4 sums in destination order.
+static inline __m128 PairSumF32(__m128 v0, __m128 v1, uint32_t component_count)
+{
+  switch (component_count) {
+    case 1: {
+      return _mm_add_ps(
+        _mm_shuffle_ps(v0, v1, _MM_SHUFFLE(2, 0, 2, 0)), 
+        _mm_shuffle_ps(v0, v1, _MM_SHUFFLE(3, 1, 3, 1)));
+    }
+    case 2: {
+      return _mm_add_ps(_mm_movelh_ps(v0, v1), _mm_movehl_ps(v1, v0));
+    }
+  }
+  return _mm_add_ps(v0, v1);
+}
+#endif // defined(VKEX_SIMD_SSE2)
+
+#if defined(VKEX_SIMD_AVX2)
+// AVX2 version of PairSumU16 for 32 source bytes (v0 = bytes 0-15, v1 = 
+// bytes 16-31). Returns 16 sums in destination order.
+static inline __m256i PairSumU16x2(__m256i v0, __m256i v1, uint32_t component_count)
+{
+  __m256i sums;
+  switch (component_count) {
+    case 1: {
+      const __m256i ones = _mm256_set1_epi16(1);
+      sums = _mm256_packs_epi32(_mm256_madd_epi16(v0, ones), _mm256_madd_epi16(v1, ones));
+    }
+    break;
+    case 2: {
+      __m256i s0 = _mm256_add_epi16(
+        _mm256_shuffle_epi32(v0, _MM_SHUFFLE(2, 0, 2, 0)), 
+        _mm256_shuffle_epi32(v0, _MM_SHUFFLE(3, 1, 3, 1)));
+      __m256i s1 = _mm256_add_epi16(
+        _mm256_shuffle_epi32(v1, _MM_SHUFFLE(2, 0, 2, 0)), 
+        _mm256_shuffle_epi32(v1, _MM_SHUFFLE(3, 1, 3, 1)));
+      sums = _mm256_unpacklo_epi64(s0, s1);
+    }
+    break;
+    default: {
+      sums = _mm256_add_epi16(_mm256_unpacklo_epi64(v0, v1), _mm256_unpackhi_epi64(v0, v1));
+    }
+    break;
+  }
+  // All of the above operate within 128-bit lanes, fix up the order
+  return _mm256_permute4x64_epi64(sums, _MM_SHUFFLE(3, 1, 2, 0));
+}
+
+// AVX2 version of PairSumF32 for 16 source floats. Returns 8 sums in
+// destination order.
+static inline __m256 PairSumF32x2(__m256 v0, __m256 v1, uint32_t component_count)
+{
+  switch (component_count) {
+    case 1: {
+      __m256 sums = _mm256_add_ps(
+        _mm256_shuffle_ps(v0, v1, _MM_SHUFFLE(2, 0, 2, 0)),
+        _mm256_shuffle_ps(v0, v1, _MM_SHUFFLE(3, 1, 3, 1)));
+      return _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(sums), _MM_SHUFFLE(3, 1, 2, 0)));
+    }
+    case 2: {
+      __m256d d0 = _mm256_castps_pd(v0);
+      __m256d d1 = _mm256_castps_pd(v1);
+      __m256 sums = _mm256_add_ps(
+        _mm256_castpd_ps(_mm256_unpacklo_pd(d0, d1)),
+        _mm256_castpd_ps(_mm256_unpackhi_pd(d0, d1)));
+      return _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(sums), _MM_SHUFFLE(3, 1, 2, 0)));
+    }
+  }
+  return _mm256_add_ps(
+    _mm256_permute2f128_ps(v0, v1, 0x20), 
+    _mm256_permute2f128_ps(v0, v1, 0x31));
+}
+#endif // defined(VKEX_SIMD_AVX2)
+
+// 2x2 box filter for one destination row of 8-bit components. 
+// 'p_src_row_0' and 'p_src_row_1' must be exactly twice as wide as 'p_dst_row'.
+static void BoxFilterRowU8(
+  const uint8_t* p_src_row_0,
+  const uint8_t* p_src_row_1,
+  uint8_t*       p_dst_row,
+  uint32_t       dst_width,
+  uint32_t       component_count)
+{
+  const uint32_t dst_count = dst_width * component_count;
+  const bool     vector_ok = (component_count == 1) || (component_count == 2) || (component_count == 4);
+  uint32_t       i         = 0;
+#if defined(VKEX_SIMD_AVX2)
+  if (vector_ok) {
+    const __m256i two = _mm256_set1_epi16(2);
+    for (; (i + 16) <= dst_count; i += 16) {
+      const uint8_t* p_a = p_src_row_0 + (2 * i);
+      const uint8_t* p_b = p_src_row_1 + (2 * i);
+      __m256i v0 = _mm256_add_epi16(
+        _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p_a))),
+        _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p_b))));
+      __m256i v1 = _mm256_add_epi16(
+        _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p_a + 16))),
+        _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p_b + 16))));
+      __m256i sums   = PairSumU16x2(v0, v1, component_count);
+      __m256i avg    = _mm256_srli_epi16(_mm256_add_epi16(sums, two), 2);
+      __m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi16(avg, avg), _MM_SHUFFLE(3, 1, 2, 0));
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(p_dst_row + i), _mm256_castsi256_si128(packed));
+    }
+  }
+#endif
+#if defined(VKEX_SIMD_SSE2)
+  if (vector_ok) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i two  = _mm_set1_epi16(2);
+    for (; (i + 8) <= dst_count; i += 8) {
+      __m128i a    = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p_src_row_0 + (2 * i)));
+      __m128i b    = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p_src_row_1 + (2 * i)));
+      __m128i lo   = _mm_add_epi16(_mm_unpacklo_epi8(a, zero), _mm_unpacklo_epi8(b, zero));
+      __m128i hi   = _mm_add_epi16(_mm_unpackhi_epi8(a, zero), _mm_unpackhi_epi8(b, zero));
+      __m128i sums = PairSumU16(lo, hi, component_count);
+      __m128i avg  = _mm_srli_epi16(_mm_add_epi16(sums, two), 2);
+      _mm_storel_epi64(reinterpret_cast<__m128i*>(p_dst_row + i), _mm_packus_epi16(avg, avg));
+    }
+  }
+#endif
+  (void)vector_ok;
+  for (; i < dst_count; ++i) {
+    uint32_t x = i / component_count;
+    uint32_t c = i - (x * component_count);
+    uint32_t k0 = (2 * x * component_count) + c;
+    uint32_t k1 = k0 + component_count;
+    uint32_t sum = static_cast<uint32_t>(p_src_row_0[k0]) + static_cast<uint32_t>(p_src_row_1[k0]) +
+                   static_cast<uint32_t>(p_src_row_0[k1]) + static_cast<uint32_t>(p_src_row_1[k1]);
+    p_dst_row[i] = static_cast<uint8_t>((sum + 2) >> 2);
+  }
+}
+
+// 2x2 box filter for one destination row of 32-bit float components.
+static void BoxFilterRowF32(
+  const float* p_src_row_0,
+  const float* p_src_row_1,
+  float*       p_dst_row,
+  uint32_t     dst_width,
+  uint32_t     component_count)
+{
+  const uint32_t dst_count = dst_width * component_count;
+  const bool     vector_ok = (component_count == 1) || (component_count == 2) || (component_count == 4);
+  uint32_t       i         = 0;
+#if defined(VKEX_SIMD_AVX2)
+  if (vector_ok) {
+    const __m256 quarter = _mm256_set1_ps(0.25f);
+    for (; (i + 8) <= dst_count; i += 8) {
+      const float* p_a = p_src_row_0 + (2 * i);
+      const float* p_b = p_src_row_1 + (2 * i);
+      __m256 v0 = _mm256_add_ps(_mm256_loadu_ps(p_a), _mm256_loadu_ps(p_b));
+      __m256 v1 = _mm256_add_ps(_mm256_loadu_ps(p_a + 8), _mm256_loadu_ps(p_b + 8));
+      _mm256_storeu_ps(p_dst_row + i, _mm256_mul_ps(PairSumF32x2(v0, v1, component_count), quarter));
+    }
+  }
+#endif
+#if defined(VKEX_SIMD_SSE2)
+  if (vector_ok) {
+    const __m128 quarter = _mm_set1_ps(0.25f);
+    for (; (i + 4) <= dst_count; i += 4) {
+      const float* p_a = p_src_row_0 + (2 * i);
+      const float* p_b = p_src_row_1 + (2 * i);
+      __m128 v0 = _mm_add_ps(_mm_loadu_ps(p_a), _mm_loadu_ps(p_b));
+      __m128 v1 = _mm_add_ps(_mm_loadu_ps(p_a + 4), _mm_loadu_ps(p_b + 4));
+      _mm_storeu_ps(p_dst_row + i, _mm_mul_ps(PairSumF32(v0, v1, component_count), quarter));
+    }
+  }
+#endif
+  (void)vector_ok;
+  for (; i < dst_count; ++i) {
+    uint32_t x = i / component_count;
+    uint32_t c = i - (x * component_count);
+    uint32_t k0 = (2 * x * component_count) + c;
+    uint32_t k1 = k0 + component_count;
+    p_dst_row[i] = ((p_src_row_0[k0] + p_src_row_1[k0]) + (p_src_row_0[k1] + p_src_row_1[k1])) * 0.25f;
+  }
+}
+
+/** @class MipRowFilter
+ *
+ * Reduces a range of rows of an exact 2x MIP level using either the box or
+ * Kaiser kernel. Rows are independent of each other, so any row range 
+ * produces the same bytes as filtering the whole level at once.
+ *
+ */
+class MipRowFilter {
+public:
+  MipRowFilter(
+    vkex::ComponentType      component_type,
+    uint32_t                 component_count,
+    Bitmap::MipFilter        filter,
+    const Bitmap::Mip&       src_mip,
+    const uint8_t*           p_src_data,
+    const Bitmap::Mip&       dst_mip,
+    uint8_t*                 p_dst_data)
+    : m_component_type(component_type),
+      m_component_count(component_count),
+      m_filter(filter),
+      m_src_mip(src_mip),
+      m_p_src_data(p_src_data),
+      m_dst_mip(dst_mip),
+      m_p_dst_data(p_dst_data)
+  {
+    if (m_filter == Bitmap::MipFilterKaiser) {
+      CalculateKaiserWeights(m_kaiser_weights);
+    }
+  }
+
+  ~MipRowFilter() {}
+
+  static bool IsSupported(
+    vkex::ComponentType component_type, 
+    Bitmap::MipFilter   filter, 
+    const Bitmap::Mip&  src_mip, 
+    const Bitmap::Mip&  dst_mip)
+  {
+    bool is_filter = (filter == Bitmap::MipFilterBox) || (filter == Bitmap::MipFilterKaiser);
+    bool is_type   = (component_type == vkex::ComponentType::UINT8) || 
+                     (component_type == vkex::ComponentType::FLOAT16) || 
+                     (component_type == vkex::ComponentType::FLOAT32);
+    bool is_half   = (src_mip.width == (2 * dst_mip.width)) && (src_mip.height == (2 * dst_mip.height));
+    return is_filter && is_type && is_half;
+  }
+
+  void FilterRows(uint32_t dst_row_begin, uint32_t dst_row_end)
+  {
+    dst_row_end = std::min<uint32_t>(dst_row_end, m_dst_mip.height);
+    if (dst_row_begin >= dst_row_end) {
+      return;
+    }
+    if (m_filter == Bitmap::MipFilterKaiser) {
+      FilterRowsKaiser(dst_row_begin, dst_row_end);
+    }
+    else {
+      FilterRowsBox(dst_row_begin, dst_row_end);
+    }
+  }
+
+private:
+  const uint8_t* GetSrcRow(uint32_t y) const {
+    return m_p_src_data + (static_cast<uint64_t>(y) * m_src_mip.row_stride);
+  }
+
+  uint8_t* GetDstRow(uint32_t y) const {
+    return m_p_dst_data + (static_cast<uint64_t>(y) * m_dst_mip.row_stride);
+  }
+
+  void LoadRow(const uint8_t* p_src, float* p_dst, uint32_t count) const
+  {
+    switch (m_component_type) {
+      default: break;
+      case vkex::ComponentType::UINT8: {
+        for (uint32_t i = 0; i < count; ++i) {
+          p_dst[i] = static_cast<float>(p_src[i]);
+        }
+      }
+      break;
+      case vkex::ComponentType::FLOAT16: {
+        HalfToFloatRow(reinterpret_cast<const uint16_t*>(p_src), p_dst, count);
+      }
+      break;
+      case vkex::ComponentType::FLOAT32: {
+        std::memcpy(p_dst, p_src, count * sizeof(float));
+      }
+      break;
+    }
+  }
+
+  void StoreRow(const float* p_src, uint8_t* p_dst, uint32_t count) const
+  {
+    switch (m_component_type) {
+      default: break;
+      case vkex::ComponentType::UINT8: {
+        for (uint32_t i = 0; i < count; ++i) {
+          float value = std::min(255.0f, std::max(0.0f, p_src[i] + 0.5f));
+          p_dst[i] = static_cast<uint8_t>(value);
+        }
+      }
+      break;
+      case vkex::ComponentType::FLOAT16: {
+        FloatToHalfRow(p_src, reinterpret_cast<uint16_t*>(p_dst), count);
+      }
+      break;
+      case vkex::ComponentType::FLOAT32: {
+        std::memcpy(p_dst, p_src, count * sizeof(float));
+      }
+      break;
+    }
+  }
+
+  void FilterRowsBox(uint32_t dst_row_begin, uint32_t dst_row_end)
+  {
+    const uint32_t dst_width = m_dst_mip.width;
+    const uint32_t dst_count = dst_width * m_component_count;
+    const uint32_t src_count = 2 * dst_count;
+
+    if (m_component_type == vkex::ComponentType::UINT8) {
+      for (uint32_t y = dst_row_begin; y < dst_row_end; ++y) {
+        BoxFilterRowU8(GetSrcRow(2 * y), GetSrcRow(2 * y + 1), GetDstRow(y), dst_width, m_component_count);
+      }
+      return;
+    }
+
+    if (m_component_type == vkex::ComponentType::FLOAT32) {
+      for (uint32_t y = dst_row_begin; y < dst_row_end; ++y) {
+        BoxFilterRowF32(
+          reinterpret_cast<const float*>(GetSrcRow(2 * y)),
+          reinterpret_cast<const float*>(GetSrcRow(2 * y + 1)),
+          reinterpret_cast<float*>(GetDstRow(y)),
+          dst_width,
+          m_component_count);
+      }
+      return;
+    }
+
+    // FLOAT16 goes through 32-bit float rows
+    m_scratch.resize(2 * src_count + dst_count);
+    float* p_row_0 = m_scratch.data();
+    float* p_row_1 = p_row_0 + src_count;
+    float* p_dst   = p_row_1 + src_count;
+    for (uint32_t y = dst_row_begin; y < dst_row_end; ++y) {
+      LoadRow(GetSrcRow(2 * y), p_row_0, src_count);
+      LoadRow(GetSrcRow(2 * y + 1), p_row_1, src_count);
+      BoxFilterRowF32(p_row_0, p_row_1, p_dst, dst_width, m_component_count);
+      StoreRow(p_dst, GetDstRow(y), dst_count);
+    }
+  }
+
+  void FilterRowKaiserHorizontal(uint32_t src_row, float* p_src_row, float* p_out) const
+  {
+    const uint32_t src_width = m_src_mip.width;
+    const uint32_t dst_width = m_dst_mip.width;
+    const uint32_t src_count = src_width * m_component_count;
+    const uint32_t cc        = m_component_count;
+
+    LoadRow(GetSrcRow(src_row), p_src_row, src_count);
+    for (uint32_t x = 0; x < dst_width; ++x) {
+      for (uint32_t c = 0; c < cc; ++c) {
+        float sum = 0.0f;
+        for (int t = 0; t < kKaiserTapCount; ++t) {
+          int32_t sx = static_cast<int32_t>(2 * x) + kKaiserTapStart + t;
+          sx = std::min<int32_t>(std::max<int32_t>(sx, 0), static_cast<int32_t>(src_width) - 1);
+          sum += m_kaiser_weights[t] * p_src_row[(static_cast<uint32_t>(sx) * cc) + c];
+        }
+        p_out[(x * cc) + c] = sum;
+      }
+    }
+  }
+
+  void FilterRowsKaiser(uint32_t dst_row_begin, uint32_t dst_row_end)
+  {
+    const uint32_t src_height = m_src_mip.height;
+    const uint32_t dst_count  = m_dst_mip.width * m_component_count;
+    const uint32_t src_count  = m_src_mip.width * m_component_count;
+
+    // Horizontally filtered rows are kept in a ring of kKaiserTapCount rows,
+    // the most the vertical pass reads for one destination row. Source row
+    // r lives in slot r % kKaiserTapCount, each destination row moves the
+    // window down by two rows.
+    m_scratch.resize((kKaiserTapCount * dst_count) + src_count + dst_count);
+    float* p_ring    = m_scratch.data();
+    float* p_src_row = p_ring + (kKaiserTapCount * dst_count);
+    float* p_dst_row = p_src_row + src_count;
+
+    int32_t ring_rows[kKaiserTapCount];
+    std::fill(ring_rows, ring_rows + kKaiserTapCount, -1);
+
+    for (uint32_t y = dst_row_begin; y < dst_row_end; ++y) {
+      std::fill(p_dst_row, p_dst_row + dst_count, 0.0f);
+      for (int t = 0; t < kKaiserTapCount; ++t) {
+        int32_t sy = static_cast<int32_t>(2 * y) + kKaiserTapStart + t;
+        sy = std::min<int32_t>(std::max<int32_t>(sy, 0), static_cast<int32_t>(src_height) - 1);
+
+        uint32_t slot = static_cast<uint32_t>(sy) % kKaiserTapCount;
+        float*   p_in = p_ring + (slot * dst_count);
+        if (ring_rows[slot] != sy) {
+          FilterRowKaiserHorizontal(static_cast<uint32_t>(sy), p_src_row, p_in);
+          ring_rows[slot] = sy;
+        }
+
+        const float weight = m_kaiser_weights[t];
+        for (uint32_t i = 0; i < dst_count; ++i) {
+          p_dst_row[i] += weight * p_in[i];
+        }
+      }
+      StoreRow(p_dst_row, GetDstRow(y), dst_count);
+    }
+  }
+
+private:
+  vkex::ComponentType m_component_type  = vkex::ComponentType::UNDEFINED;
+  uint32_t            m_component_count = 0;
+  Bitmap::MipFilter   m_filter          = Bitmap::MipFilterBox;
+  Bitmap::Mip         m_src_mip         = {};
+  const uint8_t*      m_p_src_data      = nullptr;
+  Bitmap::Mip         m_dst_mip         = {};
+  uint8_t*            m_p_dst_data      = nullptr;
+  float               m_kaiser_weights[kKaiserTapCount] = {};
+  std::vector<float>  m_scratch;
+};
+
+// MIP files store integer formats as UINT, textures sample them normalized.
+// Unknown formats keep the historic RGBA8 behavior.
+static VkFormat ToVkFormat(MIPPixelFormat format)
+{
+  VkFormat vk_format = VK_FORMAT_R8G8B8A8_UNORM;
+  switch (format) {
+    default: break;
+    case MIP_PIXEL_FORMAT_R8_UINT            : vk_format = VK_FORMAT_R8_UNORM; break;
+    case MIP_PIXEL_FORMAT_R8G8_UINT          : vk_format = VK_FORMAT_R8G8_UNORM; break;
+    case MIP_PIXEL_FORMAT_R8G8B8_UINT        : vk_format = VK_FORMAT_R8G8B8_UNORM; break;
+    case MIP_PIXEL_FORMAT_R8G8B8A8_UINT      : vk_format = VK_FORMAT_R8G8B8A8_UNORM; break;
+    case MIP_PIXEL_FORMAT_R16_UINT           : vk_format = VK_FORMAT_R16_UNORM; break;
+    case MIP_PIXEL_FORMAT_R16G16_UINT        : vk_format = VK_FORMAT_R16G16_UNORM; break;
+    case MIP_PIXEL_FORMAT_R16G16B16_UINT     : vk_format = VK_FORMAT_R16G16B16_UNORM; break;
+    case MIP_PIXEL_FORMAT_R16G16B16A16_UINT  : vk_format = VK_FORMAT_R16G16B16A16_UNORM; break;
+    case MIP_PIXEL_FORMAT_R16_FLOAT          : vk_format = VK_FORMAT_R16_SFLOAT; break;
+    case MIP_PIXEL_FORMAT_R16G16_FLOAT       : vk_format = VK_FORMAT_R16G16_SFLOAT; break;
+    case MIP_PIXEL_FORMAT_R16G16B16_FLOAT    : vk_format = VK_FORMAT_R16G16B16_SFLOAT; break;
+    case MIP_PIXEL_FORMAT_R16G16B16A16_FLOAT : vk_format = VK_FORMAT_R16G16B16A16_SFLOAT; break;
+    case MIP_PIXEL_FORMAT_R32_FLOAT          : vk_format = VK_FORMAT_R32_SFLOAT; break;
+    case MIP_PIXEL_FORMAT_R32G32_FLOAT       : vk_format = VK_FORMAT_R32G32_SFLOAT; break;
+    case MIP_PIXEL_FORMAT_R32G32B32_FLOAT    : vk_format = VK_FORMAT_R32G32B32_SFLOAT; break;
+    case MIP_PIXEL_FORMAT_R32G32B32A32_FLOAT : vk_format = VK_FORMAT_R32G32B32A32_SFLOAT; break;
+    case MIP_PIXEL_FORMAT_BC1_RGBA_UNORM     : vk_format = VK_FORMAT_BC1_RGBA_UNORM_BLOCK; break;
+    case MIP_PIXEL_FORMAT_BC3_UNORM          : vk_format = VK_FORMAT_BC3_UNORM_BLOCK; break;
+    case MIP_PIXEL_FORMAT_BC4_UNORM          : vk_format = VK_FORMAT_BC4_UNORM_BLOCK; break;
+    case MIP_PIXEL_FORMAT_BC5_UNORM          : vk_format = VK_FORMAT_BC5_UNORM_BLOCK; break;
+    case MIP_PIXEL_FORMAT_BC7_UNORM          : vk_format = VK_FORMAT_BC7_UNORM_BLOCK; break;
+  }
+  return vk_format;
+}
+
+// =================================================================================================
+// stb_image helpers
+// =================================================================================================
+
+// Decode at the image's own channel count when PixelConvert can expand it
+// to RGBA8, which beats stb's per pixel expansion. Grey plus alpha is left
+// to stb.
+static int StbiRequiredChannels(int channels)
+{
+  return ((channels == 1) || (channels == 3) || (channels == 4)) ? 0 : 4;
+}
+
+static VkFormat StbiFormat(int channels)
+{
+  VkFormat format = VK_FORMAT_UNDEFINED;
+  switch (channels) {
+    default: break;
+    case 1: format = VK_FORMAT_R8_UNORM; break;
+    case 3: format = VK_FORMAT_R8G8B8_UNORM; break;
+    case 4: format = VK_FORMAT_R8G8B8A8_UNORM; break;
+  }
+  return format;
+}
+
+// =================================================================================================
+// Bitmap
+// =================================================================================================
 Bitmap::Bitmap()
 {
 }
@@ -39,8 +681,11 @@ Bitmap::Bitmap(
   uint32_t       level_count,
   const uint8_t* p_src_data,
   uint32_t       src_row_stride,
-  uint32_t       src_height)
-  : m_format(format)
+  uint32_t       src_height,
+  MipFilter      mip_filter,
+  ThreadPool*    p_thread_pool)
+  : m_format(format),
+    m_mip_filter(mip_filter)
 {
   VKEX_ASSERT_MSG(
     m_format != VK_FORMAT_UNDEFINED, "Cannot create image with format VK_FORMAT_UNDEFINED!");
@@ -54,8 +699,7 @@ Bitmap::Bitmap(
   }
   level_count = std::min<uint32_t>(level_count, vkex::Bitmap::MaxMipLevelCount);
   m_mips.resize(level_count);
-  GenerateMipLayouts(
-    width, height, m_component_count, m_component_size, level_count, m_mips.data());
+  GenerateMipLayouts(width, height, m_format, level_count, m_mips.data());
   // Allocate storage
   m_valid = AllocateStorage();
   if (!m_valid) {
@@ -68,7 +712,8 @@ Bitmap::Bitmap(
     if (!m_valid) {
       return;
     }
-    GenerateMips();
+    // Fails for block compressed formats with more than one level
+    m_valid = GenerateMips(p_thread_pool);
   }
 }
 
@@ -81,8 +726,11 @@ Bitmap::Bitmap(
   uint32_t       level_count,
   const uint8_t* p_src_data,
   uint32_t       src_row_stride,
-  uint32_t       src_height)
-  : m_format(format)
+  uint32_t       src_height,
+  MipFilter      mip_filter,
+  ThreadPool*    p_thread_pool)
+  : m_format(format),
+    m_mip_filter(mip_filter)
 {
   VKEX_ASSERT_MSG(m_format != VK_FORMAT_UNDEFINED, "Cannot create image with format VK_FORMAT_UNDEFINED!");
 
@@ -95,8 +743,7 @@ Bitmap::Bitmap(
   }
   level_count = std::min<uint32_t>(level_count, vkex::Bitmap::MaxMipLevelCount);
   m_mips.resize(level_count);
-  GenerateMipLayouts(
-    width, height, m_component_count, m_component_size, level_count, m_mips.data());
+  GenerateMipLayouts(width, height, m_format, level_count, m_mips.data());
   // Set storage
   m_data_size = storage_size;
   m_data      = p_storage;
@@ -107,13 +754,14 @@ Bitmap::Bitmap(
     if (!m_valid) {
       return;
     }
-    GenerateMips();
+    // Fails for block compressed formats with more than one level
+    m_valid = GenerateMips(p_thread_pool);
   }
 }
 
 Bitmap::Bitmap(const MIPFile& mip_file)
 {
-  m_format = VK_FORMAT_R8G8B8A8_UNORM;
+  m_format = ToVkFormat(static_cast<MIPPixelFormat>(mip_file.pixel_format));
 
   m_component_count = vkex::FormatComponentCount(m_format);
   m_component_size  = vkex::FormatComponentSize(m_format);
@@ -139,6 +787,68 @@ Bitmap::Bitmap(const MIPFile& mip_file)
   memcpy(m_storage.data(), mip_file.data.data(), m_data_size);
 }
 
+Bitmap::Bitmap(MIPFile&& mip_file)
+{
+  m_format = ToVkFormat(static_cast<MIPPixelFormat>(mip_file.pixel_format));
+
+  m_component_count = vkex::FormatComponentCount(m_format);
+  m_component_size  = vkex::FormatComponentSize(m_format);
+
+  m_mips.resize(mip_file.level_count);
+  uint64_t data_size = 0;
+  for (uint32_t level = 0; level < mip_file.level_count; ++level) {
+    Mip& mip = m_mips[level];
+    const MIPInfo& info = mip_file.infos[level];
+    mip.level       = info.level;
+    mip.data_offset = info.data_offset;
+    mip.data_size   = info.data_size;
+    mip.width       = info.width;
+    mip.height      = info.height;
+    mip.row_stride  = info.row_stride;
+    data_size = std::max<uint64_t>(data_size, info.data_offset + info.data_size);
+  }
+
+  if ((data_size == 0) || (data_size > static_cast<uint64_t>(mip_file.data.size()))) {
+    return;
+  }
+
+  m_storage.swap(mip_file.data);
+  m_data_size = static_cast<uint64_t>(m_storage.size());
+  m_data      = m_storage.data();
+  m_valid     = true;
+}
+
+Bitmap::Bitmap(const MIPMappedFile& mapped_file)
+{
+  if (!mapped_file.IsOpen()) {
+    return;
+  }
+
+  m_format = ToVkFormat(mapped_file.GetPixelFormat());
+
+  m_component_count = vkex::FormatComponentCount(m_format);
+  m_component_size  = vkex::FormatComponentSize(m_format);
+
+  m_mips.resize(mapped_file.GetLevelCount());
+  for (uint32_t level = 0; level < mapped_file.GetLevelCount(); ++level) {
+    Mip& mip = m_mips[level];
+    const MIPInfo& info = mapped_file.GetInfo(level);
+    mip.level       = info.level;
+    mip.data_offset = info.data_offset;
+    mip.data_size   = info.data_size;
+    mip.width       = info.width;
+    mip.height      = info.height;
+    mip.row_stride  = info.row_stride;
+  }
+
+  // Point at the mapping, MIPMappedFile has already validated that each
+  // level is inside the data section.
+  m_data_size = mapped_file.GetDataSize();
+  m_data      = mapped_file.GetData();
+  m_read_only = true;
+  m_valid     = (GetDataSizeAllLevels() <= m_data_size);
+}
+
 Bitmap::~Bitmap()
 {
 }
@@ -180,7 +890,9 @@ bool Bitmap::CopyToMip0(const uint8_t* p_src_data, uint32_t src_row_stride, uint
     return false;
   }
 
-  uint32_t dst_height     = mip.height;
+  // For block compressed formats rows are rows of blocks
+  uint32_t block_height   = vkex::FormatBlockHeight(m_format);
+  uint32_t dst_height     = (mip.height + block_height - 1) / block_height;
   uint32_t dst_row_stride = mip.row_stride;
 
   src_height     = (src_height == 0) ? dst_height : src_height;
@@ -204,68 +916,263 @@ bool Bitmap::CopyToMip0(const uint8_t* p_src_data, uint32_t src_row_stride, uint
   return true;
 }
 
-bool Bitmap::GenerateMips()
+bool Bitmap::CopyToMip0(VkFormat src_format, const uint8_t* p_src_data, uint32_t src_row_stride, uint32_t src_height)
+{
+  if (src_format == m_format) {
+    return CopyToMip0(p_src_data, src_row_stride, src_height);
+  }
+
+  Mip mip = {};
+  if ((p_src_data == nullptr) || (GetData() == nullptr) || !GetMipLayout(0, &mip)) {
+    return false;
+  }
+
+  src_height = (src_height == 0) ? mip.height : std::min<uint32_t>(src_height, mip.height);
+  vkex::Result vkex_result = vkex::PixelConvert(
+    mip.width,
+    src_height,
+    src_format,
+    src_row_stride,
+    p_src_data,
+    m_format,
+    mip.row_stride,
+    GetData());
+  return vkex_result == vkex::Result::Success;
+}
+
+void Bitmap::InitializeMip0(
+  VkFormat       src_format,
+  const uint8_t* p_src_data,
+  uint32_t       src_row_stride,
+  uint32_t       src_height,
+  ThreadPool*    p_thread_pool)
+{
+  m_valid = CopyToMip0(src_format, p_src_data, src_row_stride, src_height);
+  if (!m_valid) {
+    return;
+  }
+  m_valid = GenerateMips(p_thread_pool);
+}
+
+bool Bitmap::GenerateMips(ThreadPool* p_thread_pool)
 {
   uint32_t level_count = GetMipLevels();
+  if (level_count <= 1) {
+    return true;
+  }
+
+  // Block compressed data can't be filtered, use Compress() on an 
+  // uncompressed Bitmap instead.
+  if (vkex::FormatIsBlockCompressed(m_format)) {
+    return false;
+  }
+
   for (uint32_t dst_level = 1; dst_level < level_count; ++dst_level) {
-    uint32_t src_level = dst_level - 1;
-    // Source level data
-    const unsigned char* p_src_data = GetData(src_level);
-    if (p_src_data == nullptr) {
+    // Each level reads the previous one, GenerateMipLevel() doesn't return
+    // until every band of dst_level is written.
+    if (!GenerateMipLevel(dst_level, p_thread_pool)) {
       return false;
     }
-    // Destination level data
-    unsigned char* p_dst_data = GetData(dst_level);
-    if (p_dst_data == nullptr) {
-      return false;
+  }
+
+  return true;
+}
+
+bool Bitmap::GenerateMipLevel(uint32_t dst_level, ThreadPool* p_thread_pool)
+{
+  if (dst_level == 0) {
+    return false;
+  }
+  uint32_t src_level = dst_level - 1;
+  // Source level data
+  const unsigned char* p_src_data = GetData(src_level);
+  if (p_src_data == nullptr) {
+    return false;
+  }
+  // Destination level data
+  unsigned char* p_dst_data = GetData(dst_level);
+  if (p_dst_data == nullptr) {
+    return false;
+  }
+  // Source MIP data
+  Mip src_mip = {};
+  if (!GetMipLayout(src_level, &src_mip)) {
+    return false;
+  }
+  // Destination MIP data
+  Mip dst_mip = {};
+  if (!GetMipLayout(dst_level, &dst_mip)) {
+    return false;
+  }
+
+  vkex::ComponentType component_type = vkex::FormatComponentType(m_format);
+  if (!MipRowFilter::IsSupported(component_type, m_mip_filter, src_mip, dst_mip)) {
+    return ResizeMipLevel(src_mip, dst_mip);
+  }
+
+  // Small levels aren't worth the dispatch
+  uint32_t thread_count = (p_thread_pool != nullptr) ? p_thread_pool->GetThreadCount() : 0;
+  bool     is_parallel  = (thread_count > 1) && 
+                          (dst_mip.data_size >= kMipMinParallelDataSize) && 
+                          (dst_mip.height >= (2 * kMipMinBandRowCount));
+  if (!is_parallel) {
+    MipRowFilter row_filter(
+      component_type,
+      m_component_count,
+      m_mip_filter,
+      src_mip,
+      p_src_data,
+      dst_mip,
+      p_dst_data);
+    row_filter.FilterRows(0, dst_mip.height);
+    return true;
+  }
+
+  // A few bands per thread to even out the load
+  uint32_t band_row_count = (dst_mip.height + (4 * thread_count) - 1) / (4 * thread_count);
+  band_row_count = std::max<uint32_t>(band_row_count, kMipMinBandRowCount);
+  uint32_t band_count = (dst_mip.height + band_row_count - 1) / band_row_count;
+  p_thread_pool->ParallelFor(
+    band_count,
+    [&](uint32_t band) {
+      MipRowFilter row_filter(
+        component_type,
+        m_component_count,
+        m_mip_filter,
+        src_mip,
+        p_src_data,
+        dst_mip,
+        p_dst_data);
+      uint32_t row_begin = band * band_row_count;
+      row_filter.FilterRows(row_begin, row_begin + band_row_count);
+    });
+
+  return true;
+}
+
+bool Bitmap::ResizeMipLevel(const Mip& src_mip, const Mip& dst_mip)
+{
+  const unsigned char* p_src_data = GetData(src_mip.level);
+  unsigned char*       p_dst_data = GetData(dst_mip.level);
+  if ((p_src_data == nullptr) || (p_dst_data == nullptr)) {
+    return false;
+  }
+
+  const unsigned char* input_pixels           = reinterpret_cast<const unsigned char*>(p_src_data);
+  int                  input_w                = static_cast<int>(src_mip.width);
+  int                  input_h                = static_cast<int>(src_mip.height);
+  int                  input_stride_in_bytes  = static_cast<int>(src_mip.row_stride);
+  unsigned char*       output_pixels          = reinterpret_cast<unsigned char*>(p_dst_data);
+  int                  output_w               = static_cast<int>(dst_mip.width);
+  int                  output_h               = static_cast<int>(dst_mip.height);
+  int                  output_stride_in_bytes = static_cast<int>(dst_mip.row_stride);
+  int                  num_channels           = static_cast<int>(m_component_count);
+  int                  alpha_channel          = 0;
+  int                  flags                  = 0;
+  stbir_edge           edge_wrap_mode         = STBIR_EDGE_CLAMP;
+  stbir_filter         filter                 = STBIR_FILTER_CATMULLROM;
+  stbir_colorspace     space                  = STBIR_COLORSPACE_LINEAR;
+  void*                alloc_context          = nullptr;
+
+  int result = 0;
+  vkex::ComponentType component_type = vkex::FormatComponentType(m_format);
+  switch (component_type) {
+    default: {
+      result = stbir_resize_uint8_generic(
+        input_pixels,
+        input_w,
+        input_h,
+        input_stride_in_bytes,
+        output_pixels,
+        output_w,
+        output_h,
+        output_stride_in_bytes,
+        num_channels,
+        alpha_channel,
+        flags,
+        edge_wrap_mode,
+        filter,
+        space,
+        alloc_context);
     }
-    // Source MIP data
-    Mip src_mip = {};
-    if (!GetMipLayout(src_level, &src_mip)) {
-      return false;
+    break;
+
+    case vkex::ComponentType::UINT16: {
+      result = stbir_resize_uint16_generic(
+        reinterpret_cast<const stbir_uint16*>(input_pixels),
+        input_w,
+        input_h,
+        input_stride_in_bytes,
+        reinterpret_cast<stbir_uint16*>(output_pixels),
+        output_w,
+        output_h,
+        output_stride_in_bytes,
+        num_channels,
+        alpha_channel,
+        flags,
+        edge_wrap_mode,
+        filter,
+        space,
+        alloc_context);
     }
-    // Destination MIP data
-    Mip dst_mip = {};
-    if (!GetMipLayout(dst_level, &dst_mip)) {
-      return false;
+    break;
+
+    case vkex::ComponentType::FLOAT32: {
+      result = stbir_resize_float_generic(
+        reinterpret_cast<const float*>(input_pixels),
+        input_w,
+        input_h,
+        input_stride_in_bytes,
+        reinterpret_cast<float*>(output_pixels),
+        output_w,
+        output_h,
+        output_stride_in_bytes,
+        num_channels,
+        alpha_channel,
+        flags,
+        edge_wrap_mode,
+        filter,
+        space,
+        alloc_context);
     }
-
-    const unsigned char* input_pixels           = reinterpret_cast<const unsigned char*>(p_src_data);
-    int                  input_w                = static_cast<int>(src_mip.width);
-    int                  input_h                = static_cast<int>(src_mip.height);
-    int                  input_stride_in_bytes  = static_cast<int>(src_mip.row_stride);
-    unsigned char*       output_pixels          = reinterpret_cast<unsigned char*>(p_dst_data);
-    int                  output_w               = static_cast<int>(dst_mip.width);
-    int                  output_h               = static_cast<int>(dst_mip.height);
-    int                  output_stride_in_bytes = static_cast<int>(dst_mip.row_stride);
-    int                  num_channels           = static_cast<int>(m_component_count);
-    int                  alpha_channel          = 0;
-    int                  flags                  = 0;
-    stbir_edge           edge_wrap_mode         = STBIR_EDGE_CLAMP;
-    stbir_filter         filter                 = STBIR_FILTER_CATMULLROM;
-    stbir_colorspace     space                  = STBIR_COLORSPACE_LINEAR;
-    void*                alloc_context          = nullptr;
-
-    int result = stbir_resize_uint8_generic(
-      input_pixels,
-      input_w,
-      input_h,
-      input_stride_in_bytes,
-      output_pixels,
-      output_w,
-      output_h,
-      output_stride_in_bytes,
-      num_channels,
-      alpha_channel,
-      flags,
-      edge_wrap_mode,
-      filter,
-      space,
-      alloc_context);
-
-    if (result == 0) {
-      return false;
+    break;
+
+    case vkex::ComponentType::FLOAT16: {
+      // stb_image_resize has no half float path - widen to float and back
+      uint32_t src_count = src_mip.width * m_component_count;
+      uint32_t dst_count = dst_mip.width * m_component_count;
+      std::vector<float> src_floats(static_cast<size_t>(src_count) * src_mip.height);
+      std::vector<float> dst_floats(static_cast<size_t>(dst_count) * dst_mip.height);
+      for (uint32_t y = 0; y < src_mip.height; ++y) {
+        const uint16_t* p_row = reinterpret_cast<const uint16_t*>(input_pixels + (y * src_mip.row_stride));
+        HalfToFloatRow(p_row, src_floats.data() + (y * src_count), src_count);
+      }
+      result = stbir_resize_float_generic(
+        src_floats.data(),
+        input_w,
+        input_h,
+        static_cast<int>(src_count * sizeof(float)),
+        dst_floats.data(),
+        output_w,
+        output_h,
+        static_cast<int>(dst_count * sizeof(float)),
+        num_channels,
+        alpha_channel,
+        flags,
+        edge_wrap_mode,
+        filter,
+        space,
+        alloc_context);
+      for (uint32_t y = 0; y < dst_mip.height; ++y) {
+        uint16_t* p_row = reinterpret_cast<uint16_t*>(output_pixels + (y * dst_mip.row_stride));
+        FloatToHalfRow(dst_floats.data() + (y * dst_count), p_row, dst_count);
+      }
     }
+    break;
+  }
+
+  if (result == 0) {
+    return false;
   }
 
   return true;
@@ -276,6 +1183,11 @@ VkFormat Bitmap::GetFormat() const
   return m_format;
 }
 
+Bitmap::MipFilter Bitmap::GetMipFilter() const
+{
+  return m_mip_filter;
+}
+
 uint32_t Bitmap::GetComponentCount() const
 {
   return m_component_count;
@@ -359,7 +1271,13 @@ uint64_t Bitmap::GetDataSizeAllLevels() const
 
 uint8_t* Bitmap::GetData(uint32_t level)
 {
-  uint8_t* p_data = m_data;
+  // A mapped file is read only
+  VKEX_ASSERT(!m_read_only);
+  if (m_read_only) {
+    return nullptr;
+  }
+
+  uint8_t* p_data = const_cast<uint8_t*>(m_data);
   Mip      mip    = {};
   if ((p_data != nullptr) && GetMipLayout(level, &mip)) {
     p_data += mip.data_offset;
@@ -442,73 +1360,117 @@ void Bitmap::GenerateMipLayouts(
   }
 }
 
+void Bitmap::GenerateMipLayouts(
+  uint32_t           width,
+  uint32_t           height,
+  VkFormat           format,
+  const uint32_t     level_count,
+  vkex::Bitmap::Mip* p_mips
+)
+{
+  const uint32_t block_width  = vkex::FormatBlockWidth(format);
+  const uint32_t block_height = vkex::FormatBlockHeight(format);
+  const uint32_t block_size   = vkex::FormatBlockSize(format);
+
+  uint32_t level       = 0;
+  uint64_t data_offset = 0;
+  while ((width > 0) && (height > 0) && (level < level_count)) {
+    uint32_t row_stride = ((width + block_width - 1) / block_width) * block_size;
+    uint32_t row_count  = (height + block_height - 1) / block_height;
+    uint64_t data_size  = static_cast<uint64_t>(row_stride) * static_cast<uint64_t>(row_count);
+
+    Mip mip         = {};
+    mip.level       = level;
+    mip.data_offset = data_offset;
+    mip.data_size   = data_size;
+    mip.width       = width;
+    mip.height      = height;
+    mip.row_stride  = row_stride;
+    p_mips[level]   = mip;
+
+    // Increment level
+    level += 1;
+
+    // Increment data offset
+    data_offset += data_size;
+
+    // Divide width,height by 2
+    width >>= 1;
+    height >>= 1;
+  }
+}
+
 vkex::Result Bitmap::Create(
   const fs::path&                file_path,
   uint32_t                       level_count,
-  std::unique_ptr<vkex::Bitmap>* p_bitmap)
+  std::unique_ptr<vkex::Bitmap>* p_bitmap,
+  MipFilter                      mip_filter,
+  ThreadPool*                    p_thread_pool)
 {
-  int width             = 0;
-  int height            = 0;
-  int channels          = 0;
-  int required_channels = 4;
-  // Force 4 channels since some Vulkan implementations won't have 3 channel
-  // image support
-  unsigned char* p_image =
-    stbi_load(file_path.c_str(), &width, &height, &channels, required_channels);
-  if (p_image == nullptr) {
+  // Read once, stb would otherwise open and parse the header twice, for
+  // stbi_info and stbi_load
+  std::ifstream is(file_path.c_str(), std::ios::binary);
+  if (!is.is_open()) {
+    return vkex::Result::ErrorImageLoadFailed;
+  }
+  is.seekg(0, std::ios::end);
+  std::streamoff size = is.tellg();
+  if (size <= 0) {
+    return vkex::Result::ErrorImageLoadFailed;
+  }
+  std::vector<uint8_t> file_data(static_cast<size_t>(size));
+  is.seekg(0, std::ios::beg);
+  is.read(reinterpret_cast<char*>(file_data.data()), file_data.size());
+  if (!is.good()) {
     return vkex::Result::ErrorImageLoadFailed;
   }
 
-  VkFormat format     = VK_FORMAT_R8G8B8A8_UNORM;
-  uint32_t row_stride = static_cast<uint32_t>(width) * static_cast<uint32_t>(required_channels);
-  std::unique_ptr<vkex::Bitmap> bitmap = std::make_unique<vkex::Bitmap>(
-    static_cast<uint32_t>(width),
-    static_cast<uint32_t>(height),
-    format,
-    level_count,
-    p_image,
-    row_stride,
-    height);
-
-  stbi_image_free(p_image);
-  p_image = nullptr;
-
-  *p_bitmap = std::move(bitmap);
-
-  return vkex::Result::Success;
+  return Create(file_data.size(), file_data.data(), level_count, p_bitmap, mip_filter, p_thread_pool);
 }
 
 vkex::Result Bitmap::Create(
   size_t                         src_data_size,
   const uint8_t*                 p_src_data,
   uint32_t                       level_count,
-  std::unique_ptr<vkex::Bitmap>* p_bitmap)
+  std::unique_ptr<vkex::Bitmap>* p_bitmap,
+  MipFilter                      mip_filter,
+  ThreadPool*                    p_thread_pool)
 {
   int width             = 0;
   int height            = 0;
   int channels          = 0;
-  int required_channels = 4;
-  // Force 4 channels since some Vulkan implementations won't have 3 channel image support
+  stbi_info_from_memory(p_src_data, static_cast<int>(src_data_size), &width, &height, &channels);
+  int required_channels = StbiRequiredChannels(channels);
   unsigned char* p_image = stbi_load_from_memory(
     p_src_data, static_cast<int>(src_data_size), &width, &height, &channels, required_channels);
   if (p_image == nullptr) {
     return vkex::Result::ErrorImageLoadFailed;
   }
 
-  VkFormat format     = VK_FORMAT_R8G8B8A8_UNORM;
-  uint32_t row_stride = static_cast<uint32_t>(width) * static_cast<uint32_t>(required_channels);
+  // Force 4 channels since some Vulkan implementations won't have 3 channel image support
+  VkFormat format = VK_FORMAT_R8G8B8A8_UNORM;
   std::unique_ptr<vkex::Bitmap> bitmap = std::make_unique<vkex::Bitmap>(
     static_cast<uint32_t>(width),
     static_cast<uint32_t>(height),
     format,
     level_count,
-    p_image,
-    row_stride,
-    height);
+    nullptr,
+    0,
+    0,
+    mip_filter,
+    p_thread_pool);
+
+  int      src_channels   = (required_channels != 0) ? required_channels : channels;
+  uint32_t src_row_stride = static_cast<uint32_t>(width) * static_cast<uint32_t>(src_channels);
+  bitmap->InitializeMip0(StbiFormat(src_channels), p_image, src_row_stride, height, p_thread_pool);
 
   stbi_image_free(p_image);
   p_image = nullptr;
 
+  if (!bitmap->IsValid()) {
+    return vkex::Result::ErrorImageLoadFailed;
+  }
+
   *p_bitmap = std::move(bitmap);
 
   return vkex::Result::Success;
@@ -520,7 +1482,9 @@ vkex::Result Bitmap::Create(
   uint32_t                       level_count,
   std::unique_ptr<vkex::Bitmap>* p_bitmap,
   uint64_t                       storage_size,
-  uint8_t*                       p_storage)
+  uint8_t*                       p_storage,
+  MipFilter                      mip_filter,
+  ThreadPool*                    p_thread_pool)
 {
   // Check size
   {
@@ -540,16 +1504,16 @@ vkex::Result Bitmap::Create(
   int width             = 0;
   int height            = 0;
   int channels          = 0;
-  int required_channels = 4;
-  // Force 4 channels since some Vulkan implementations won't have 3 channel image support
+  stbi_info_from_memory(p_src_data, static_cast<int>(src_data_size), &width, &height, &channels);
+  int required_channels = StbiRequiredChannels(channels);
   unsigned char* p_image = stbi_load_from_memory(
     p_src_data, static_cast<int>(src_data_size), &width, &height, &channels, required_channels);
   if (p_image == nullptr) {
     return vkex::Result::ErrorImageLoadFailed;
   }
 
-  VkFormat format     = VK_FORMAT_R8G8B8A8_UNORM;
-  uint32_t row_stride = static_cast<uint32_t>(width) * static_cast<uint32_t>(required_channels);
+  // Force 4 channels since some Vulkan implementations won't have 3 channel image support
+  VkFormat format = VK_FORMAT_R8G8B8A8_UNORM;
   std::unique_ptr<vkex::Bitmap> bitmap = std::make_unique<vkex::Bitmap>(
     storage_size,
     p_storage,
@@ -557,13 +1521,159 @@ vkex::Result Bitmap::Create(
     static_cast<uint32_t>(height),
     format,
     level_count,
-    p_image,
-    row_stride,
-    height);
+    nullptr,
+    0,
+    0,
+    mip_filter,
+    p_thread_pool);
+
+  int      src_channels   = (required_channels != 0) ? required_channels : channels;
+  uint32_t src_row_stride = static_cast<uint32_t>(width) * static_cast<uint32_t>(src_channels);
+  bitmap->InitializeMip0(StbiFormat(src_channels), p_image, src_row_stride, height, p_thread_pool);
 
   stbi_image_free(p_image);
   p_image = nullptr;
 
+  if (!bitmap->IsValid()) {
+    return vkex::Result::ErrorImageLoadFailed;
+  }
+
+  *p_bitmap = std::move(bitmap);
+
+  return vkex::Result::Success;
+}
+
+vkex::Result Bitmap::CreateFromMIPFile(
+  const fs::path&                file_path,
+  uint32_t                       first_level,
+  uint32_t                       last_level,
+  std::unique_ptr<vkex::Bitmap>* p_bitmap,
+  ThreadPool*                    p_thread_pool)
+{
+  MIPFile mip_file = {};
+  if (!MIPLoadFileLevels(file_path.c_str(), first_level, last_level, &mip_file, p_thread_pool)) {
+    return vkex::Result::ErrorImageLoadFailed;
+  }
+
+  std::unique_ptr<vkex::Bitmap> bitmap = std::make_unique<vkex::Bitmap>(std::move(mip_file));
+  if (!bitmap->IsValid()) {
+    return vkex::Result::ErrorImageLoadFailed;
+  }
+
+  *p_bitmap = std::move(bitmap);
+
+  return vkex::Result::Success;
+}
+
+vkex::Result Bitmap::Compress(
+  const vkex::Bitmap&            src_bitmap,
+  VkFormat                       dst_format,
+  ThreadPool*                    p_thread_pool,
+  std::unique_ptr<vkex::Bitmap>* p_bitmap)
+{
+  using CompressFn = void(*)(const uint8_t*, uint8_t*);
+
+  CompressFn compress_fn = nullptr;
+  switch (dst_format) {
+    default: break;
+    case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+    case VK_FORMAT_BC1_RGBA_SRGB_BLOCK: compress_fn = vkex::CompressBlockBC1; break;
+    case VK_FORMAT_BC3_UNORM_BLOCK:
+    case VK_FORMAT_BC3_SRGB_BLOCK: compress_fn = vkex::CompressBlockBC3; break;
+    case VK_FORMAT_BC4_UNORM_BLOCK: compress_fn = vkex::CompressBlockBC4; break;
+    case VK_FORMAT_BC5_UNORM_BLOCK: compress_fn = vkex::CompressBlockBC5; break;
+    case VK_FORMAT_BC7_UNORM_BLOCK:
+    case VK_FORMAT_BC7_SRGB_BLOCK: compress_fn = vkex::CompressBlockBC7; break;
+  }
+  if (compress_fn == nullptr) {
+    return vkex::Result::ErrorImageFormatNotSupported;
+  }
+
+  const VkFormat src_format      = src_bitmap.GetFormat();
+  const uint32_t component_count = src_bitmap.GetComponentCount();
+  bool is_src_supported = (vkex::FormatComponentType(src_format) == vkex::ComponentType::UINT8) &&
+                          (component_count >= 1) && (component_count <= 4);
+  if (!is_src_supported) {
+    return vkex::Result::ErrorImageFormatNotSupported;
+  }
+
+  std::unique_ptr<vkex::Bitmap> bitmap = std::make_unique<vkex::Bitmap>(
+    src_bitmap.GetWidth(),
+    src_bitmap.GetHeight(),
+    dst_format,
+    src_bitmap.GetMipLevels());
+  if (!bitmap->IsValid()) {
+    return vkex::Result::ErrorImageLoadFailed;
+  }
+
+  // Input channels for the block functions: BC4 takes R, BC5 takes RG and
+  // the rest take RGBA.
+  const uint32_t dst_component_count = vkex::FormatComponentCount(dst_format) == 3 ? 4 : vkex::FormatComponentCount(dst_format);
+  const uint32_t block_size          = vkex::FormatBlockSize(dst_format);
+
+  // Work is split into bands of block rows across all levels, levels don't
+  // depend on each other.
+  struct Band {
+    uint32_t level;
+    uint32_t block_row_begin;
+    uint32_t block_row_end;
+  };
+  const uint32_t    kBandBlockRowCount = 8;
+  std::vector<Band> bands;
+  for (uint32_t level = 0; level < bitmap->GetMipLevels(); ++level) {
+    uint32_t block_row_count = (bitmap->GetHeight(level) + 3) / 4;
+    for (uint32_t row = 0; row < block_row_count; row += kBandBlockRowCount) {
+      bands.push_back(Band{ level, row, std::min<uint32_t>(row + kBandBlockRowCount, block_row_count) });
+    }
+  }
+
+  vkex::Bitmap* p_dst_bitmap = bitmap.get();
+  auto compress_band = [&](uint32_t band_index) {
+    const Band&    band           = bands[band_index];
+    Mip            src_mip        = {};
+    Mip            dst_mip        = {};
+    src_bitmap.GetMipLayout(band.level, &src_mip);
+    p_dst_bitmap->GetMipLayout(band.level, &dst_mip);
+    const uint8_t* p_src_data     = src_bitmap.GetData(band.level);
+    uint8_t*       p_dst_data     = p_dst_bitmap->GetData(band.level);
+    uint32_t       block_columns  = (src_mip.width + 3) / 4;
+    uint8_t        texels[16 * 4] = {};
+    for (uint32_t by = band.block_row_begin; by < band.block_row_end; ++by) {
+      uint8_t* p_dst_block = p_dst_data + (static_cast<uint64_t>(by) * dst_mip.row_stride);
+      for (uint32_t bx = 0; bx < block_columns; ++bx) {
+        // Gather a 4x4 block, clamping at the right and bottom edges
+        for (uint32_t ty = 0; ty < 4; ++ty) {
+          uint32_t       y     = std::min<uint32_t>((4 * by) + ty, src_mip.height - 1);
+          const uint8_t* p_row = p_src_data + (static_cast<uint64_t>(y) * src_mip.row_stride);
+          for (uint32_t tx = 0; tx < 4; ++tx) {
+            uint32_t       x       = std::min<uint32_t>((4 * bx) + tx, src_mip.width - 1);
+            const uint8_t* p_texel = p_row + (x * component_count);
+            uint8_t        rgba[4] = { 0, 0, 0, 255 };
+            for (uint32_t c = 0; c < component_count; ++c) {
+              rgba[c] = p_texel[c];
+            }
+            uint8_t* p_out = texels + ((4 * ty + tx) * dst_component_count);
+            for (uint32_t c = 0; c < dst_component_count; ++c) {
+              p_out[c] = rgba[c];
+            }
+          }
+        }
+        compress_fn(texels, p_dst_block);
+        p_dst_block += block_size;
+      }
+    }
+  };
+
+  uint32_t band_count = static_cast<uint32_t>(bands.size());
+  if (p_thread_pool != nullptr) {
+    p_thread_pool->ParallelFor(band_count, compress_band);
+  }
+  else {
+    for (uint32_t band_index = 0; band_index < band_count; ++band_index) {
+      compress_band(band_index);
+    }
+  }
+
   *p_bitmap = std::move(bitmap);
 
   return vkex::Result::Success;
@@ -576,7 +1686,9 @@ vkex::Result Bitmap::Create(
     int                            height,
     VkFormat                       format,
     uint32_t                       level_count,
-    std::unique_ptr<vkex::Bitmap>* p_bitmap)
+    std::unique_ptr<vkex::Bitmap>* p_bitmap,
+    MipFilter                      mip_filter,
+    ThreadPool*                    p_thread_pool)
 {
   const int required_channels = 4;
 
@@ -588,7 +1700,9 @@ vkex::Result Bitmap::Create(
     level_count,
     p_src_data,
     row_stride,
-    height);
+    height,
+    mip_filter,
+    p_thread_pool);
 
   *p_bitmap = std::move(bitmap);
 
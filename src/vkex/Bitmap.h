@@ -22,6 +22,8 @@
 
 namespace vkex {
 
+class ThreadPool;
+
 /** @class Bitmap
  *
  */
@@ -29,6 +31,20 @@ class Bitmap {
 public:
   enum { MaxMipLevelCount = 32 };
 
+  /** @enum MipFilter
+   *
+   * MipFilterBox and MipFilterKaiser are only used for levels that are an
+   * exact 2x reduction of the previous level and for UINT8, FLOAT16 and 
+   * FLOAT32 component types. Everything else falls back to Catmull-Rom
+   * through stb_image_resize.
+   *
+   */
+  enum MipFilter {
+    MipFilterCatmullRom = 0,
+    MipFilterBox        = 1,
+    MipFilterKaiser     = 2,
+  };
+
   struct Mip {
     uint32_t level;
     uint64_t data_offset;
@@ -39,6 +55,8 @@ public:
   };
 
   Bitmap();
+  // If p_thread_pool is not null, large MIP levels are generated in row 
+  // bands on the pool. The result is identical to the single threaded path.
   Bitmap(
     uint32_t       width,
     uint32_t       height,
@@ -46,7 +64,9 @@ public:
     uint32_t       level_count,
     const uint8_t* p_src_data     = nullptr,
     uint32_t       src_row_stride = 0,
-    uint32_t       src_height     = 0);
+    uint32_t       src_height     = 0,
+    MipFilter      mip_filter     = MipFilterCatmullRom,
+    ThreadPool*    p_thread_pool  = nullptr);
   Bitmap(
     uint64_t       storage_size,
     uint8_t*       p_storage,
@@ -56,12 +76,27 @@ public:
     uint32_t       level_count,
     const uint8_t* p_src_data     = nullptr,
     uint32_t       src_row_stride = 0,
-    uint32_t       src_height     = 0);
+    uint32_t       src_height     = 0,
+    MipFilter      mip_filter     = MipFilterCatmullRom,
+    ThreadPool*    p_thread_pool  = nullptr);
   Bitmap(
     const MIPFile& mip_file);
+  // Takes over mip_file.data as storage
+  Bitmap(
+    MIPFile&& mip_file);
+  // Wraps the mapped level data without copying it, mapped_file must 
+  // outlive the Bitmap. The Bitmap is read only, the non-const GetData()
+  // returns nullptr.
+  Bitmap(
+    const MIPMappedFile& mapped_file);
   ~Bitmap();
 
+  bool            IsValid() const { return m_valid; }
+  bool            OwnsStorage() const { return !m_storage.empty(); }
+  bool            IsReadOnly() const { return m_read_only; }
+
   VkFormat        GetFormat() const;
+  MipFilter       GetMipFilter() const;
   uint32_t        GetComponentCount() const;
   uint32_t        GetComponentSize() const;
 
@@ -90,18 +125,31 @@ public:
     const uint32_t     level_count,
     vkex::Bitmap::Mip* p_mips);
 
+  // Same as above but handles block compressed formats, row_stride is the 
+  // size of a row of blocks.
+  static void GenerateMipLayouts(
+    uint32_t           width,
+    uint32_t           height,
+    VkFormat           format,
+    const uint32_t     level_count,
+    vkex::Bitmap::Mip* p_mips);
+
   // Create Bitmap from file
   static vkex::Result Create(
     const fs::path&                 file_path, 
     uint32_t                        level_count, 
-    std::unique_ptr<vkex::Bitmap>*  p_bitmap);
+    std::unique_ptr<vkex::Bitmap>*  p_bitmap,
+    MipFilter                       mip_filter    = MipFilterCatmullRom,
+    ThreadPool*                     p_thread_pool = nullptr);
 
   // Create Bitmap from memory
   static vkex::Result Create(
     size_t                         src_data_size,
     const uint8_t*                 p_src_data,
     uint32_t                       level_count,
-    std::unique_ptr<vkex::Bitmap>* p_bitmap);
+    std::unique_ptr<vkex::Bitmap>* p_bitmap,
+    MipFilter                      mip_filter    = MipFilterCatmullRom,
+    ThreadPool*                    p_thread_pool = nullptr);
 
   // Create Bitmap from memory using storage provided
   static vkex::Result Create(
@@ -110,7 +158,28 @@ public:
     uint32_t                       level_count,
     std::unique_ptr<vkex::Bitmap>* p_bitmap,
     uint64_t                       storage_size,
-    uint8_t*                       p_storage);
+    uint8_t*                       p_storage,
+    MipFilter                      mip_filter    = MipFilterCatmullRom,
+    ThreadPool*                    p_thread_pool = nullptr);
+
+  // Create Bitmap from levels [first_level, last_level] of a MIP file, 
+  // first_level becomes level 0 of the Bitmap. Only those levels are read.
+  // Compressed chunks are decompressed on p_thread_pool if set.
+  static vkex::Result CreateFromMIPFile(
+    const fs::path&                file_path,
+    uint32_t                       first_level,
+    uint32_t                       last_level,
+    std::unique_ptr<vkex::Bitmap>* p_bitmap,
+    ThreadPool*                    p_thread_pool = nullptr);
+
+  // Compress all levels of an uncompressed 8-bit Bitmap into dst_format,
+  // which must be one of the BC1, BC3, BC4, BC5 or BC7 formats. Levels are
+  // split into bands of block rows and encoded on p_thread_pool if set.
+  static vkex::Result Compress(
+    const vkex::Bitmap&            src_bitmap,
+    VkFormat                       dst_format,
+    ThreadPool*                    p_thread_pool,
+    std::unique_ptr<vkex::Bitmap>* p_bitmap);
 
   // Create Bitmap from pre-loaded memory and format info
   static vkex::Result Create(
@@ -120,7 +189,9 @@ public:
       int height,
       VkFormat format,
       uint32_t                       level_count,
-      std::unique_ptr<vkex::Bitmap>* p_bitmap);
+      std::unique_ptr<vkex::Bitmap>* p_bitmap,
+      MipFilter                      mip_filter    = MipFilterCatmullRom,
+      ThreadPool*                    p_thread_pool = nullptr);
 
   static vkex::Result GetDataFootprint(
     const fs::path& file_path,
@@ -150,15 +221,29 @@ public:
 private:
   bool AllocateStorage();
   bool CopyToMip0(const uint8_t* p_src_data, uint32_t src_row_stride, uint32_t src_height);
-  bool GenerateMips();
+  // Converts from src_format with PixelConvert if it isn't the Bitmap's format
+  bool CopyToMip0(VkFormat src_format, const uint8_t* p_src_data, uint32_t src_row_stride, uint32_t src_height);
+  // Copies level 0, generates the remaining levels and sets the valid flag
+  void InitializeMip0(
+    VkFormat       src_format,
+    const uint8_t* p_src_data,
+    uint32_t       src_row_stride,
+    uint32_t       src_height,
+    ThreadPool*    p_thread_pool);
+  bool GenerateMips(ThreadPool* p_thread_pool);
+  bool GenerateMipLevel(uint32_t dst_level, ThreadPool* p_thread_pool);
+  bool ResizeMipLevel(const Mip& src_mip, const Mip& dst_mip);
 
 private:
   bool                 m_valid           = false;
   VkFormat             m_format          = VK_FORMAT_UNDEFINED;
+  MipFilter            m_mip_filter      = MipFilterCatmullRom;
   uint32_t             m_component_count = 0;
   uint32_t             m_component_size  = 0;
-  uint8_t*             m_data            = nullptr;
+  // Only written through when m_read_only is false
+  const uint8_t*       m_data            = nullptr;
   uint64_t             m_data_size       = 0;
+  bool                 m_read_only       = false;
   std::vector<uint8_t> m_storage;
   std::vector<Mip>     m_mips;
 };
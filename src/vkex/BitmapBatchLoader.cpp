@@ -0,0 +1,322 @@
+/*
+ Copyright 2018-2019 Google Inc.
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+ http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+*/
+
+#include "vkex/BitmapBatchLoader.h"
+#include "vkex/Log.h"
+#include "vkex/ThreadPool.h"
+#include "vkex/Timer.h"
+
+#include <algorithm>
+#include <fstream>
+
+namespace vkex {
+
+// Reads the whole file into p_data, reusing its capacity
+static bool ReadFile(const fs::path& file_path, std::vector<uint8_t>* p_data)
+{
+  std::ifstream is(file_path.c_str(), std::ios::binary);
+  if (!is.is_open()) {
+    return false;
+  }
+  is.seekg(0, std::ios::end);
+  std::streamoff size = is.tellg();
+  if (size <= 0) {
+    return false;
+  }
+  p_data->resize(static_cast<size_t>(size));
+  is.seekg(0, std::ios::beg);
+  is.read(reinterpret_cast<char*>(p_data->data()), p_data->size());
+  return is.good();
+}
+
+// =================================================================================================
+// BitmapBatchLoader::Charge
+// =================================================================================================
+BitmapBatchLoader::Charge::Charge(Charge&& other)
+  : m_loader(other.m_loader),
+    m_size(other.m_size)
+{
+  other.m_loader = nullptr;
+  other.m_size   = 0;
+}
+
+BitmapBatchLoader::Charge::~Charge()
+{
+  Release();
+}
+
+BitmapBatchLoader::Charge& BitmapBatchLoader::Charge::operator=(Charge&& other)
+{
+  if (this != &other) {
+    Release();
+    m_loader       = other.m_loader;
+    m_size         = other.m_size;
+    other.m_loader = nullptr;
+    other.m_size   = 0;
+  }
+  return *this;
+}
+
+void BitmapBatchLoader::Charge::Release()
+{
+  if ((m_loader != nullptr) && (m_size > 0)) {
+    m_loader->Release(m_size);
+  }
+  m_loader = nullptr;
+  m_size   = 0;
+}
+
+// =================================================================================================
+// BitmapBatchLoader
+// =================================================================================================
+BitmapBatchLoader::BitmapBatchLoader(ThreadPool* p_thread_pool, uint64_t memory_ceiling)
+  : m_thread_pool(p_thread_pool),
+    m_memory_ceiling(memory_ceiling)
+{
+  VKEX_ASSERT(m_thread_pool != nullptr);
+}
+
+BitmapBatchLoader::~BitmapBatchLoader()
+{
+  WaitIdle();
+
+  std::lock_guard<std::mutex> lock(m_mutex);
+  VKEX_ASSERT_MSG(m_charged_size == 0, "BitmapBatchLoader destroyed with charges outstanding");
+}
+
+void BitmapBatchLoader::Load(uint32_t index, const LoadRequest& request, CompletionFn completion_fn)
+{
+  // Submitted under the lock so the pool starts tasks in ticket order
+  std::lock_guard<std::mutex> lock(m_mutex);
+  ++m_pending_count;
+  uint64_t ticket = m_next_ticket++;
+
+  m_thread_pool->Submit([this, index, ticket, request, completion_fn]() mutable {
+    Process(index, ticket, request, completion_fn);
+    // Drop anything the callback holds on to, e.g. a result nobody waited
+    // for, while the loader is still alive to take back its charge.
+    completion_fn = nullptr;
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    --m_pending_count;
+    if (m_pending_count == 0) {
+      m_idle_cv.notify_all();
+    }
+  });
+}
+
+std::future<BitmapBatchLoader::LoadResult> BitmapBatchLoader::Load(uint32_t index, const LoadRequest& request)
+{
+  auto promise = std::make_shared<std::promise<LoadResult>>();
+  std::future<LoadResult> future = promise->get_future();
+  Load(index, request, [promise](LoadResult& result) {
+    promise->set_value(std::move(result));
+  });
+  return future;
+}
+
+std::vector<BitmapBatchLoader::LoadResult> BitmapBatchLoader::LoadAll(const std::vector<LoadRequest>& requests)
+{
+  std::vector<std::future<LoadResult>> futures;
+  futures.reserve(requests.size());
+  for (size_t i = 0; i < requests.size(); ++i) {
+    futures.push_back(Load(static_cast<uint32_t>(i), requests[i]));
+  }
+
+  std::vector<LoadResult> results;
+  results.reserve(requests.size());
+  for (auto& future : futures) {
+    LoadResult result = future.get();
+    // Later requests may be waiting on this charge
+    result.charge.Release();
+    results.push_back(std::move(result));
+  }
+  return results;
+}
+
+void BitmapBatchLoader::WaitIdle()
+{
+  std::unique_lock<std::mutex> lock(m_mutex);
+  m_idle_cv.wait(lock, [this]() { return m_pending_count == 0; });
+}
+
+uint64_t BitmapBatchLoader::GetChargedSize() const
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_charged_size;
+}
+
+uint64_t BitmapBatchLoader::GetPeakChargedSize() const
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_peak_charged_size;
+}
+
+void BitmapBatchLoader::Acquire(uint64_t ticket, uint64_t size)
+{
+  {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_memory_cv.wait(lock, [this, ticket, size]() {
+      if (ticket != m_granted_ticket) {
+        return false;
+      }
+      return (m_memory_ceiling == 0) ||
+             (size == 0) ||
+             (m_charged_size == 0) ||
+             ((m_charged_size + size) <= m_memory_ceiling);
+    });
+    ++m_granted_ticket;
+    m_charged_size += size;
+    m_peak_charged_size = std::max(m_peak_charged_size, m_charged_size);
+  }
+  // Wake the next ticket
+  m_memory_cv.notify_all();
+}
+
+void BitmapBatchLoader::Release(uint64_t size)
+{
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_charged_size -= size;
+  }
+  m_memory_cv.notify_all();
+}
+
+std::vector<uint8_t> BitmapBatchLoader::AcquireScratch()
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  if (m_scratch_buffers.empty()) {
+    return std::vector<uint8_t>();
+  }
+  std::vector<uint8_t> scratch = std::move(m_scratch_buffers.back());
+  m_scratch_buffers.pop_back();
+  return scratch;
+}
+
+void BitmapBatchLoader::ReleaseScratch(std::vector<uint8_t>&& scratch)
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  // At most one buffer per worker is ever in use
+  if (m_scratch_buffers.size() <= m_thread_pool->GetThreadCount()) {
+    m_scratch_buffers.push_back(std::move(scratch));
+  }
+}
+
+void BitmapBatchLoader::Process(uint32_t index, uint64_t ticket, const LoadRequest& request, const CompletionFn& completion_fn)
+{
+  LoadResult result = {};
+  result.index     = index;
+  result.file_path = request.file_path;
+
+  vkex::Timer timer;
+  timer.Start();
+
+  // Read
+  std::vector<uint8_t> scratch;
+  const uint8_t*       p_data    = request.p_data;
+  size_t               data_size = request.data_size;
+  if (p_data == nullptr) {
+    scratch = AcquireScratch();
+    if (!ReadFile(request.file_path, &scratch)) {
+      result.result = vkex::Result::ErrorImageLoadFailed;
+    }
+    p_data    = scratch.data();
+    data_size = scratch.size();
+  }
+  timer.Stop();
+  result.read_ms = timer.Millis();
+
+  // Charge the encoded data plus the decoder output and Bitmap storage
+  if (result.result == vkex::Result::Undefined) {
+    uint32_t width              = 0;
+    uint32_t height             = 0;
+    uint64_t bitmap_data_size   = 0;
+    result.result = Bitmap::GetDataFootprint(
+      data_size, p_data, request.level_count, &width, &height, nullptr, &bitmap_data_size);
+    if (result.result == vkex::Result::Success) {
+      uint64_t decoded_size = static_cast<uint64_t>(width) * static_cast<uint64_t>(height) * 4;
+      result.charged_size   = data_size + decoded_size + bitmap_data_size;
+
+      timer.Start();
+      Acquire(ticket, result.charged_size);
+      timer.Stop();
+      result.wait_ms = timer.Millis();
+
+      // Decode
+      timer.Start();
+      result.result = Bitmap::Create(
+        data_size,
+        p_data,
+        request.level_count,
+        &result.bitmap,
+        request.mip_filter,
+        m_thread_pool);
+      timer.Stop();
+      result.decode_ms = timer.Millis();
+    }
+  }
+
+  // Failed requests still have to pass their ticket on
+  if (result.charged_size == 0) {
+    Acquire(ticket, 0);
+  }
+
+  if (request.p_data == nullptr) {
+    ReleaseScratch(std::move(scratch));
+  }
+
+  // The encoded data and decoder output are gone, only the Bitmap stays
+  // charged until the caller releases it
+  if (result.charged_size > 0) {
+    uint64_t held_size = 0;
+    if ((result.result == vkex::Result::Success) && result.bitmap) {
+      held_size = std::min(result.bitmap->GetDataSizeAllLevels(), result.charged_size);
+    }
+    Release(result.charged_size - held_size);
+    result.charge.m_loader = this;
+    result.charge.m_size   = held_size;
+  }
+
+  if (completion_fn) {
+    completion_fn(result);
+  }
+}
+
+void BitmapBatchLoader::LogSlowest(const std::vector<LoadResult>& results, uint32_t count)
+{
+  std::vector<const LoadResult*> sorted;
+  sorted.reserve(results.size());
+  for (auto& result : results) {
+    sorted.push_back(&result);
+  }
+  std::sort(
+    sorted.begin(),
+    sorted.end(),
+    [](const LoadResult* a, const LoadResult* b) {
+      return (a->read_ms + a->decode_ms) > (b->read_ms + b->decode_ms); });
+
+  count = std::min<uint32_t>(count, static_cast<uint32_t>(sorted.size()));
+  for (uint32_t i = 0; i < count; ++i) {
+    const LoadResult* p_result = sorted[i];
+    VKEX_LOG_INFO(
+      "Bitmap load " << p_result->file_path << ": "
+      << "read " << p_result->read_ms << " ms, "
+      << "decode " << p_result->decode_ms << " ms, "
+      << "waited " << p_result->wait_ms << " ms");
+  }
+}
+
+} // namespace vkex
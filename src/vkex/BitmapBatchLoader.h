@@ -0,0 +1,164 @@
+/*
+ Copyright 2018-2019 Google Inc.
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+ http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+*/
+
+#ifndef __VKEX_BITMAP_BATCH_LOADER_H__
+#define __VKEX_BITMAP_BATCH_LOADER_H__
+
+#include "vkex/Bitmap.h"
+
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <mutex>
+
+namespace vkex {
+
+class ThreadPool;
+
+/** @class BitmapBatchLoader
+ *
+ * Decodes image files or in-memory blobs into Bitmaps concurrently on a
+ * ThreadPool.
+ *
+ * Each request is charged its encoded size plus its decoded footprint
+ * (decoder output and Bitmap storage for all levels) while it decodes.
+ * Once decoded the charge shrinks to the Bitmap storage and moves into
+ * LoadResult::charge, it's returned when the caller releases or destroys
+ * the charge. Keep it for as long as the Bitmap is resident, e.g. until
+ * its upload has been recorded.
+ *
+ * Requests are granted in the order Load() was called, and one only
+ * starts decoding once the total charge stays at or below the memory
+ * ceiling. The exception is a request arriving while nothing is charged,
+ * so a single oversized image still loads. Peak resident decode memory is
+ * therefore at most the ceiling, or the size of that one image. Recycled
+ * scratch buffers aren't charged while they're idle.
+ *
+ * A caller that waits for results in request order must release each
+ * charge before waiting on the next result, otherwise the next request
+ * can block on a charge that is never returned.
+ *
+ * File contents are read into scratch buffers that are recycled between
+ * requests instead of being allocated per file. The decoder output comes
+ * from a block stb_image's allocations keep per thread (see Bitmap.cpp),
+ * so a worker reuses it for its next image up to 64 MiB.
+ *
+ */
+class BitmapBatchLoader {
+public:
+  struct LoadRequest {
+    fs::path          file_path;
+    // If p_data is not null the blob is decoded and file_path is only
+    // used for reporting. The blob must stay valid until the request
+    // completes.
+    const uint8_t*    p_data      = nullptr;
+    size_t            data_size   = 0;
+    uint32_t          level_count = 1;
+    Bitmap::MipFilter mip_filter  = Bitmap::MipFilterCatmullRom;
+  };
+
+  // Returns its size to the loader's ceiling when released or destroyed.
+  // The loader must outlive it.
+  class Charge {
+  public:
+    Charge() {}
+    Charge(Charge&& other);
+    ~Charge();
+
+    Charge& operator=(Charge&& other);
+
+    uint64_t  GetSize() const { return m_size; }
+    void      Release();
+
+  private:
+    friend class BitmapBatchLoader;
+    BitmapBatchLoader*  m_loader = nullptr;
+    uint64_t            m_size   = 0;
+  };
+
+  struct LoadResult {
+    uint32_t                      index       = 0;
+    fs::path                      file_path;
+    vkex::Result                  result      = vkex::Result::Undefined;
+    std::unique_ptr<vkex::Bitmap> bitmap;
+    // Time spent waiting for the memory ceiling
+    double                        wait_ms     = 0;
+    double                        read_ms     = 0;
+    // Decode and MIP generation
+    double                        decode_ms   = 0;
+    // Charged while decoding
+    uint64_t                      charged_size = 0;
+    // Held for the Bitmap
+    Charge                        charge;
+  };
+
+  // Called on a worker thread, must be thread safe
+  using CompletionFn = std::function<void(LoadResult&)>;
+
+  // memory_ceiling of 0 is unlimited. p_thread_pool must outlive the
+  // loader.
+  BitmapBatchLoader(ThreadPool* p_thread_pool, uint64_t memory_ceiling = 0);
+  // Waits for all pending requests. Every Charge must have been
+  // released.
+  ~BitmapBatchLoader();
+
+  BitmapBatchLoader(const BitmapBatchLoader&) = delete;
+  BitmapBatchLoader& operator=(const BitmapBatchLoader&) = delete;
+
+  // index is passed through to LoadResult::index
+  void                      Load(uint32_t index, const LoadRequest& request, CompletionFn completion_fn);
+  std::future<LoadResult>   Load(uint32_t index, const LoadRequest& request);
+
+  // Loads all requests and blocks until done, results are in request
+  // order. The returned results don't hold charges, the ceiling only
+  // bounds how much is decoding at once.
+  std::vector<LoadResult>   LoadAll(const std::vector<LoadRequest>& requests);
+
+  // Blocks until every request issued so far has completed
+  void                      WaitIdle();
+
+  uint64_t                  GetMemoryCeiling() const { return m_memory_ceiling; }
+  uint64_t                  GetChargedSize() const;
+  uint64_t                  GetPeakChargedSize() const;
+
+  // Logs the slowest count results by read plus decode time
+  static void               LogSlowest(const std::vector<LoadResult>& results, uint32_t count);
+
+private:
+  void                      Process(uint32_t index, uint64_t ticket, const LoadRequest& request, const CompletionFn& completion_fn);
+  void                      Acquire(uint64_t ticket, uint64_t size);
+  void                      Release(uint64_t size);
+  std::vector<uint8_t>      AcquireScratch();
+  void                      ReleaseScratch(std::vector<uint8_t>&& scratch);
+
+private:
+  ThreadPool*                       m_thread_pool     = nullptr;
+  uint64_t                          m_memory_ceiling  = 0;
+  mutable std::mutex                m_mutex;
+  std::condition_variable           m_memory_cv;
+  std::condition_variable           m_idle_cv;
+  uint64_t                          m_charged_size    = 0;
+  uint64_t                          m_peak_charged_size = 0;
+  uint32_t                          m_pending_count   = 0;
+  // Requests acquire their charge in ticket order
+  uint64_t                          m_next_ticket     = 0;
+  uint64_t                          m_granted_ticket  = 0;
+  std::vector<std::vector<uint8_t>> m_scratch_buffers;
+};
+
+} // namespace vkex
+
+#endif // __VKEX_BITMAP_BATCH_LOADER_H__
@@ -0,0 +1,295 @@
+/*
+ Copyright 2018-2019 Google Inc.
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+ http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+*/
+
+#include "vkex/BlockCompress.h"
+
+#define STB_DXT_IMPLEMENTATION
+#include "stb_dxt.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace vkex {
+
+// =================================================================================================
+// BC1 - BC5
+// =================================================================================================
+void CompressBlockBC1(const uint8_t* p_rgba, uint8_t* p_dst)
+{
+  stb_compress_dxt_block(p_dst, p_rgba, 0, STB_DXT_HIGHQUAL);
+}
+
+void CompressBlockBC3(const uint8_t* p_rgba, uint8_t* p_dst)
+{
+  stb_compress_dxt_block(p_dst, p_rgba, 1, STB_DXT_HIGHQUAL);
+}
+
+void CompressBlockBC4(const uint8_t* p_r, uint8_t* p_dst)
+{
+  stb_compress_bc4_block(p_dst, p_r);
+}
+
+void CompressBlockBC5(const uint8_t* p_rg, uint8_t* p_dst)
+{
+  stb_compress_bc5_block(p_dst, p_rg);
+}
+
+// =================================================================================================
+// BC7
+// =================================================================================================
+static const uint32_t kBC7Weights4[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+/** @class BitWriter
+ *
+ */
+class BitWriter {
+public:
+  BitWriter(uint8_t* p_dst, uint32_t size)
+    : m_p_dst(p_dst)
+  {
+    std::memset(m_p_dst, 0, size);
+  }
+
+  ~BitWriter() {}
+
+  void Write(uint32_t value, uint32_t bit_count) {
+    for (uint32_t i = 0; i < bit_count; ++i) {
+      if ((value >> i) & 1) {
+        m_p_dst[m_bit >> 3] |= static_cast<uint8_t>(1 << (m_bit & 7));
+      }
+      ++m_bit;
+    }
+  }
+
+private:
+  uint8_t* m_p_dst = nullptr;
+  uint32_t m_bit   = 0;
+};
+
+struct BC7Mode6Endpoints {
+  uint32_t c7[2][4];   // 7-bit endpoint components
+  uint32_t p[2];       // p-bits
+  uint32_t c8[2][4];   // Unquantized 8-bit values
+};
+
+// Quantizes both endpoints to 7 bits plus a shared p-bit, picking the
+// p-bit with the lower error for each endpoint.
+static void QuantizeBC7Mode6(const float e[2][4], BC7Mode6Endpoints* p_endpoints)
+{
+  for (uint32_t n = 0; n < 2; ++n) {
+    float best_error = -1.0f;
+    for (uint32_t p = 0; p < 2; ++p) {
+      uint32_t c7[4];
+      uint32_t c8[4];
+      float    error = 0.0f;
+      for (uint32_t c = 0; c < 4; ++c) {
+        float v = (e[n][c] - static_cast<float>(p)) * 0.5f;
+        int   q = static_cast<int>(std::floor(v + 0.5f));
+        q     = std::min(127, std::max(0, q));
+        c7[c] = static_cast<uint32_t>(q);
+        c8[c] = (c7[c] << 1) | p;
+        float d = static_cast<float>(c8[c]) - e[n][c];
+        error += d * d;
+      }
+      if ((best_error < 0.0f) || (error < best_error)) {
+        best_error = error;
+        p_endpoints->p[n] = p;
+        for (uint32_t c = 0; c < 4; ++c) {
+          p_endpoints->c7[n][c] = c7[c];
+          p_endpoints->c8[n][c] = c8[c];
+        }
+      }
+    }
+  }
+}
+
+// Picks the closest palette entry for each texel, returns the total error
+static uint32_t SelectBC7Mode6Indices(const uint8_t* p_rgba, const BC7Mode6Endpoints& endpoints, uint32_t* p_indices)
+{
+  uint32_t palette[16][4];
+  for (uint32_t i = 0; i < 16; ++i) {
+    uint32_t w = kBC7Weights4[i];
+    for (uint32_t c = 0; c < 4; ++c) {
+      palette[i][c] = (((64 - w) * endpoints.c8[0][c]) + (w * endpoints.c8[1][c]) + 32) >> 6;
+    }
+  }
+
+  uint32_t total_error = 0;
+  for (uint32_t t = 0; t < 16; ++t) {
+    const uint8_t* p_texel    = p_rgba + (4 * t);
+    uint32_t       best_error = UINT32_MAX;
+    uint32_t       best_index = 0;
+    for (uint32_t i = 0; i < 16; ++i) {
+      uint32_t error = 0;
+      for (uint32_t c = 0; c < 4; ++c) {
+        int d = static_cast<int>(palette[i][c]) - static_cast<int>(p_texel[c]);
+        error += static_cast<uint32_t>(d * d);
+      }
+      if (error < best_error) {
+        best_error = error;
+        best_index = i;
+      }
+    }
+    p_indices[t] = best_index;
+    total_error += best_error;
+  }
+  return total_error;
+}
+
+void CompressBlockBC7(const uint8_t* p_rgba, uint8_t* p_dst)
+{
+  // Mean and covariance
+  float mean[4] = {};
+  for (uint32_t t = 0; t < 16; ++t) {
+    for (uint32_t c = 0; c < 4; ++c) {
+      mean[c] += static_cast<float>(p_rgba[(4 * t) + c]);
+    }
+  }
+  for (uint32_t c = 0; c < 4; ++c) {
+    mean[c] /= 16.0f;
+  }
+
+  float cov[4][4] = {};
+  for (uint32_t t = 0; t < 16; ++t) {
+    float d[4];
+    for (uint32_t c = 0; c < 4; ++c) {
+      d[c] = static_cast<float>(p_rgba[(4 * t) + c]) - mean[c];
+    }
+    for (uint32_t i = 0; i < 4; ++i) {
+      for (uint32_t j = 0; j < 4; ++j) {
+        cov[i][j] += d[i] * d[j];
+      }
+    }
+  }
+
+  // Principal axis by power iteration, seeded with the largest variance
+  float axis[4] = {};
+  {
+    uint32_t seed = 0;
+    for (uint32_t c = 1; c < 4; ++c) {
+      seed = (cov[c][c] > cov[seed][seed]) ? c : seed;
+    }
+    axis[seed] = 1.0f;
+    for (uint32_t iteration = 0; iteration < 8; ++iteration) {
+      float next[4] = {};
+      for (uint32_t i = 0; i < 4; ++i) {
+        for (uint32_t j = 0; j < 4; ++j) {
+          next[i] += cov[i][j] * axis[j];
+        }
+      }
+      float length = std::sqrt((next[0] * next[0]) + (next[1] * next[1]) + (next[2] * next[2]) + (next[3] * next[3]));
+      if (length < 1.0e-6f) {
+        break;
+      }
+      for (uint32_t c = 0; c < 4; ++c) {
+        axis[c] = next[c] / length;
+      }
+    }
+  }
+
+  // Initial endpoints from the extent of the texels along the axis
+  float min_t = 0.0f;
+  float max_t = 0.0f;
+  for (uint32_t t = 0; t < 16; ++t) {
+    float proj = 0.0f;
+    for (uint32_t c = 0; c < 4; ++c) {
+      proj += (static_cast<float>(p_rgba[(4 * t) + c]) - mean[c]) * axis[c];
+    }
+    min_t = std::min(min_t, proj);
+    max_t = std::max(max_t, proj);
+  }
+  float e[2][4];
+  for (uint32_t c = 0; c < 4; ++c) {
+    e[0][c] = std::min(255.0f, std::max(0.0f, mean[c] + (min_t * axis[c])));
+    e[1][c] = std::min(255.0f, std::max(0.0f, mean[c] + (max_t * axis[c])));
+  }
+
+  BC7Mode6Endpoints best_endpoints = {};
+  uint32_t          best_indices[16] = {};
+  uint32_t          best_error = UINT32_MAX;
+  for (uint32_t pass = 0; pass < 2; ++pass) {
+    BC7Mode6Endpoints endpoints = {};
+    uint32_t          indices[16] = {};
+    QuantizeBC7Mode6(e, &endpoints);
+    uint32_t error = SelectBC7Mode6Indices(p_rgba, endpoints, indices);
+    if (error < best_error) {
+      best_error     = error;
+      best_endpoints = endpoints;
+      std::memcpy(best_indices, indices, sizeof(indices));
+    }
+    if (best_error == 0) {
+      break;
+    }
+
+    // Least squares refit of the endpoints for the selected indices
+    float aa = 0.0f;
+    float ab = 0.0f;
+    float bb = 0.0f;
+    float ax[4] = {};
+    float bx[4] = {};
+    for (uint32_t t = 0; t < 16; ++t) {
+      float b = static_cast<float>(kBC7Weights4[indices[t]]) / 64.0f;
+      float a = 1.0f - b;
+      aa += a * a;
+      ab += a * b;
+      bb += b * b;
+      for (uint32_t c = 0; c < 4; ++c) {
+        float x = static_cast<float>(p_rgba[(4 * t) + c]);
+        ax[c] += a * x;
+        bx[c] += b * x;
+      }
+    }
+    float det = (aa * bb) - (ab * ab);
+    if (std::fabs(det) < 1.0e-6f) {
+      break;
+    }
+    float inv_det = 1.0f / det;
+    for (uint32_t c = 0; c < 4; ++c) {
+      e[0][c] = std::min(255.0f, std::max(0.0f, ((ax[c] * bb) - (bx[c] * ab)) * inv_det));
+      e[1][c] = std::min(255.0f, std::max(0.0f, ((bx[c] * aa) - (ax[c] * ab)) * inv_det));
+    }
+  }
+
+  // The anchor index has an implicit zero MSB. The weights are symmetric,
+  // so swapping the endpoints and inverting the indices is lossless.
+  if (best_indices[0] & 0x8) {
+    std::swap(best_endpoints.p[0], best_endpoints.p[1]);
+    for (uint32_t c = 0; c < 4; ++c) {
+      std::swap(best_endpoints.c7[0][c], best_endpoints.c7[1][c]);
+      std::swap(best_endpoints.c8[0][c], best_endpoints.c8[1][c]);
+    }
+    for (uint32_t t = 0; t < 16; ++t) {
+      best_indices[t] = 15 - best_indices[t];
+    }
+  }
+
+  BitWriter writer(p_dst, 16);
+  // Mode 6
+  writer.Write(1 << 6, 7);
+  for (uint32_t c = 0; c < 4; ++c) {
+    writer.Write(best_endpoints.c7[0][c], 7);
+    writer.Write(best_endpoints.c7[1][c], 7);
+  }
+  writer.Write(best_endpoints.p[0], 1);
+  writer.Write(best_endpoints.p[1], 1);
+  writer.Write(best_indices[0], 3);
+  for (uint32_t t = 1; t < 16; ++t) {
+    writer.Write(best_indices[t], 4);
+  }
+}
+
+} // namespace vkex
@@ -0,0 +1,65 @@
+/*
+ Copyright 2018-2019 Google Inc.
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+ http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+*/
+
+#ifndef __VKEX_BLOCK_COMPRESS_H__
+#define __VKEX_BLOCK_COMPRESS_H__
+
+#include <cstdint>
+
+namespace vkex {
+
+// All functions take a 4x4 block of texels in row order. p_rgba points to
+// 64 bytes (RGBA8), p_r to 16 bytes (R8) and p_rg to 32 bytes (RG8).
+
+/** @fn CompressBlockBC1
+ *
+ * Writes 8 bytes. Always uses 4 color mode, alpha is ignored.
+ *
+ */
+void CompressBlockBC1(const uint8_t* p_rgba, uint8_t* p_dst);
+
+/** @fn CompressBlockBC3
+ *
+ * Writes 16 bytes.
+ *
+ */
+void CompressBlockBC3(const uint8_t* p_rgba, uint8_t* p_dst);
+
+/** @fn CompressBlockBC4
+ *
+ * Writes 8 bytes.
+ *
+ */
+void CompressBlockBC4(const uint8_t* p_r, uint8_t* p_dst);
+
+/** @fn CompressBlockBC5
+ *
+ * Writes 16 bytes.
+ *
+ */
+void CompressBlockBC5(const uint8_t* p_rg, uint8_t* p_dst);
+
+/** @fn CompressBlockBC7
+ *
+ * Writes 16 bytes. Encodes mode 6 only (single subset, RGBA endpoints with
+ * p-bits, 4-bit indices), which is a good fit for most albedo content.
+ *
+ */
+void CompressBlockBC7(const uint8_t* p_rgba, uint8_t* p_dst);
+
+} // namespace vkex
+
+#endif // __VKEX_BLOCK_COMPRESS_H__
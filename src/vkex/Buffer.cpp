@@ -60,12 +60,18 @@ vkex::Result CBuffer::InternalCreate(
 {
   // Copy create info
   m_create_info = create_info;
+  m_p_allocator = p_allocator;
 
   // Buffer size must be greater than zero
   if (m_create_info.size <= 0) {
     return vkex::Result::ErrorBufferSizeMustBeGreaterThanZero;
   }
 
+  // Persistent maps need host visible memory
+  if (m_create_info.persistent_map && !IsMemoryHostVisible(m_create_info.memory_usage)) {
+    return vkex::Result::ErrorResourceIsNotHostVisible;
+  }
+
   // Create Vulkan buffer object
   {
     // Vulkan create info
@@ -127,7 +133,7 @@ vkex::Result CBuffer::InternalDestroy(const VkAllocationCallbacks* p_allocator)
 VkResult CBuffer::AllocateMemory()
 {
   m_vma_allocation_create_info = {};
-  m_vma_allocation_create_info.flags          = 0;
+  m_vma_allocation_create_info.flags          = m_create_info.persistent_map ? VMA_ALLOCATION_CREATE_MAPPED_BIT : 0;
   m_vma_allocation_create_info.usage          = m_create_info.memory_usage;
   m_vma_allocation_create_info.requiredFlags  = 0;
   m_vma_allocation_create_info.preferredFlags = 0;
@@ -145,15 +151,30 @@ VkResult CBuffer::AllocateMemory()
     return vk_result;
   }
 
+  VkMemoryPropertyFlags memory_property_flags = 0;
+  vmaGetMemoryTypeProperties(
+    m_device->GetVmaAllocator(),
+    m_vma_allocation_info.memoryType,
+    &memory_property_flags);
+  m_memory_coherent = ((memory_property_flags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) != 0) ||
+                      ((memory_property_flags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) == 0);
+
+  // Mapped by VMA for the lifetime of the allocation
+  if (m_create_info.persistent_map) {
+    m_mapped_address = m_vma_allocation_info.pMappedData;
+  }
+
   return VK_SUCCESS;
 }
 
 void CBuffer::FreeMemory()
 {
   if (m_vma_allocation != VK_NULL_HANDLE) {
-    if (IsMemoryMapped()) {
+    // Persistent maps are released with the allocation
+    if (IsMemoryMapped() && !m_create_info.persistent_map) {
       UnmapMemory();
-    }   
+    }
+    m_mapped_address = nullptr;
 
     vmaFreeMemory(
       m_device->GetVmaAllocator(),
@@ -182,6 +203,37 @@ VkResult CBuffer::BindMemory()
   return VK_SUCCESS;
 }
 
+VkResult CBuffer::Rebind()
+{
+  VKEX_ASSERT(m_vma_allocation != VK_NULL_HANDLE);
+
+  // Buffers can't be bound twice
+  if (m_vk_object != VK_NULL_HANDLE) {
+    vkex::DestroyBuffer(
+      *m_device,
+      m_vk_object,
+      m_p_allocator);
+
+    m_vk_object = VK_NULL_HANDLE;
+  }
+
+  VkResult vk_result = vkex::CreateBuffer(
+    *m_device,
+    &m_vk_create_info,
+    m_p_allocator,
+    &m_vk_object);
+  if (vk_result != VK_SUCCESS) {
+    return vk_result;
+  }
+
+  vmaGetAllocationInfo(
+    m_device->GetVmaAllocator(),
+    m_vma_allocation,
+    &m_vma_allocation_info);
+
+  return BindMemory();
+}
+
 VkResult CBuffer::MapMemory(void** pp_mapped_address)
 {
   bool has_allocation = (m_vma_allocation != VK_NULL_HANDLE);
@@ -214,6 +266,11 @@ VkResult CBuffer::MapMemory(void** pp_mapped_address)
 
 void CBuffer::UnmapMemory()
 {
+  // Stays mapped until the memory is freed
+  if (m_create_info.persistent_map) {
+    return;
+  }
+
   vmaUnmapMemory(
     m_device->GetVmaAllocator(),
     m_vma_allocation);
@@ -268,4 +325,64 @@ vkex::Result CBuffer::Copy(size_t size, const void* p_src)
   return vkex::Result::Success;
 }
 
+vkex::Result CBuffer::Write(VkDeviceSize offset, VkDeviceSize size, const void* p_src)
+{
+  bool is_host_visible = IsMemoryHostVisible(m_create_info.memory_usage);
+  VKEX_ASSERT_MSG(is_host_visible, "Buffer resource must be host visible for direct write!");
+  if (!is_host_visible) {
+    return vkex::Result::ErrorResourceIsNotHostVisible;
+  }
+
+  if ((offset + size) > GetSize()) {
+    return vkex::Result::ErrorResouceSizeIsInsufficient;
+  }
+
+  void* p_mapped_address = m_mapped_address;
+  if (p_mapped_address == nullptr) {
+    VkResult vk_result = MapMemory(&p_mapped_address);
+    if (vk_result != VK_SUCCESS) {
+      return vkex::Result(vk_result);
+    }
+  }
+
+  std::memcpy(static_cast<uint8_t*>(p_mapped_address) + offset, p_src, static_cast<size_t>(size));
+
+  return vkex::Result::Success;
+}
+
+vkex::Result CBuffer::Flush(VkDeviceSize offset, VkDeviceSize size)
+{
+  if (m_vma_allocation == VK_NULL_HANDLE) {
+    return vkex::Result::ErrorResourceIsNull;
+  }
+
+  if (!m_memory_coherent) {
+    // VMA rounds the range out to nonCoherentAtomSize
+    vmaFlushAllocation(
+      m_device->GetVmaAllocator(),
+      m_vma_allocation,
+      offset,
+      size);
+  }
+
+  return vkex::Result::Success;
+}
+
+vkex::Result CBuffer::Invalidate(VkDeviceSize offset, VkDeviceSize size)
+{
+  if (m_vma_allocation == VK_NULL_HANDLE) {
+    return vkex::Result::ErrorResourceIsNull;
+  }
+
+  if (!m_memory_coherent) {
+    vmaInvalidateAllocation(
+      m_device->GetVmaAllocator(),
+      m_vma_allocation,
+      offset,
+      size);
+  }
+
+  return vkex::Result::Success;
+}
+
 } // namespace vkex
\ No newline at end of file
@@ -39,6 +39,9 @@ struct BufferCreateInfo {
   bool                        committed;
   VmaMemoryUsage              memory_usage;
   VmaPool                     memory_pool;
+  // Maps the memory when it's allocated and keeps it mapped until it's
+  // freed, memory_usage must be host visible
+  bool                        persistent_map;
 };
 
 /** @class IBuffer
@@ -77,6 +80,20 @@ public:
     return m_create_info.usage_flags;
   }
 
+  /** @fn GetSharingMode
+   *
+   */
+  VkSharingMode GetSharingMode() const {
+    return m_create_info.sharing_mode;
+  }
+
+  /** @fn IsPersistentlyMapped
+   *
+   */
+  bool IsPersistentlyMapped() const {
+    return m_create_info.persistent_map;
+  }
+
 /** @fn IsCommitted
    *
    */
@@ -133,6 +150,22 @@ public:
    */
   bool IsMemoryMapped() const;
 
+  /** @fn GetMappedAddress
+   *
+   */
+  void* GetMappedAddress() const {
+    return m_mapped_address;
+  }
+
+  /** @fn IsMemoryCoherent
+   *
+   * False if host writes need Flush() and device writes need Invalidate().
+   *
+   */
+  bool IsMemoryCoherent() const {
+    return m_memory_coherent;
+  }
+
   /** @fn GetOffset
    *
    */
@@ -148,12 +181,44 @@ public:
    */
   vkex::Result Copy(size_t size, const void* p_src);
 
+  /** @fn Write
+   *
+   * Copies into the mapped memory at offset. Memory that isn't mapped yet
+   * is mapped and stays mapped. Doesn't flush, see Flush().
+   *
+   */
+  vkex::Result Write(VkDeviceSize offset, VkDeviceSize size, const void* p_src);
+
+  /** @fn Flush
+   *
+   * Makes host writes visible to the device, does nothing for coherent
+   * memory.
+   *
+   */
+  vkex::Result Flush(VkDeviceSize offset = 0, VkDeviceSize size = VK_WHOLE_SIZE);
+
+  /** @fn Invalidate
+   *
+   * Makes device writes visible to the host, does nothing for coherent
+   * memory.
+   *
+   */
+  vkex::Result Invalidate(VkDeviceSize offset = 0, VkDeviceSize size = VK_WHOLE_SIZE);
+
 private:
   friend class CDevice;
   friend class IObjectStorageFunctions;
 
   VkResult InitializeCommitted();
 
+  /** @fn Rebind
+   *
+   * Recreates the Vulkan buffer on the allocation's current memory after
+   * defragmentation has moved it.
+   *
+   */
+  VkResult Rebind();
+
   /** @fn InternalCreate
    *
    */
@@ -175,6 +240,97 @@ private:
   VmaAllocation               m_vma_allocation = VK_NULL_HANDLE;
   VmaAllocationInfo           m_vma_allocation_info = {};
   void*                       m_mapped_address = nullptr;
+  bool                        m_memory_coherent = true;
+  const VkAllocationCallbacks* m_p_allocator = nullptr;
+};
+
+/** @class MappedView
+ *
+ * Typed access to count elements of T at offset in a mapped buffer, so
+ * data can be written in place. Maps the buffer if it isn't mapped, it
+ * then stays mapped. The view doesn't own anything and must not outlive
+ * the buffer.
+ *
+ */
+template <typename T>
+class MappedView {
+public:
+  MappedView() {}
+
+  MappedView(vkex::Buffer buffer, VkDeviceSize offset = 0, size_t count = 1)
+    : m_buffer(buffer),
+      m_offset(offset),
+      m_count(count)
+  {
+    VKEX_ASSERT(m_buffer != nullptr);
+    VKEX_ASSERT_MSG(
+      (m_offset + (m_count * sizeof(T))) <= m_buffer->GetSize(),
+      "Mapped view exceeds buffer size!"
+    );
+
+    void* p_mapped_address = nullptr;
+    VkResult vk_result = m_buffer->MapMemory(&p_mapped_address);
+    VKEX_ASSERT_MSG(vk_result == VK_SUCCESS, "Mapped view failed to map buffer!");
+    if (vk_result == VK_SUCCESS) {
+      m_data = reinterpret_cast<T*>(static_cast<uint8_t*>(p_mapped_address) + m_offset);
+    }
+  }
+
+  /** @fn IsValid
+   *
+   */
+  bool IsValid() const {
+    return (m_data != nullptr);
+  }
+
+  /** @fn GetCount
+   *
+   */
+  size_t GetCount() const {
+    return m_count;
+  }
+
+  /** @fn GetData
+   *
+   */
+  T* GetData() const {
+    return m_data;
+  }
+
+  T& operator*() const {
+    VKEX_ASSERT(m_data != nullptr);
+    return *m_data;
+  }
+
+  T* operator->() const {
+    VKEX_ASSERT(m_data != nullptr);
+    return m_data;
+  }
+
+  T& operator[](size_t index) const {
+    VKEX_ASSERT(index < m_count);
+    return m_data[index];
+  }
+
+  /** @fn Flush
+   *
+   */
+  vkex::Result Flush() const {
+    return m_buffer->Flush(m_offset, m_count * sizeof(T));
+  }
+
+  /** @fn Invalidate
+   *
+   */
+  vkex::Result Invalidate() const {
+    return m_buffer->Invalidate(m_offset, m_count * sizeof(T));
+  }
+
+private:
+  vkex::Buffer  m_buffer = nullptr;
+  VkDeviceSize  m_offset = 0;
+  size_t        m_count = 0;
+  T*            m_data = nullptr;
 };
 
 } // namespace vkex
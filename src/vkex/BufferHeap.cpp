@@ -0,0 +1,312 @@
+/*
+ Copyright 2018-2019 Google Inc.
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+ http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+*/
+
+#include <vkex/BufferHeap.h>
+#include <vkex/Device.h>
+
+namespace vkex {
+
+const VkDeviceSize kDefaultBufferHeapBlockSize = 4 * 1024 * 1024;
+
+static VkDeviceSize AlignUp(VkDeviceSize value, VkDeviceSize alignment)
+{
+  return ((value + alignment - 1) / alignment) * alignment;
+}
+
+// =================================================================================================
+// BufferRange
+// =================================================================================================
+vkex::Result BufferRange::Write(VkDeviceSize offset, VkDeviceSize size, const void* p_src) const
+{
+  if (p_mapped_address == nullptr) {
+    return vkex::Result::ErrorResourceIsNotHostVisible;
+  }
+
+  if ((offset + size) > this->size) {
+    return vkex::Result::ErrorResouceSizeIsInsufficient;
+  }
+
+  std::memcpy(static_cast<uint8_t*>(p_mapped_address) + offset, p_src, static_cast<size_t>(size));
+
+  return buffer->Flush(this->offset + offset, size);
+}
+
+// =================================================================================================
+// BufferHeap
+// =================================================================================================
+vkex::Result BufferHeap::Initialize(vkex::Device device, const vkex::BufferHeapCreateInfo& create_info)
+{
+  VKEX_ASSERT(device != nullptr);
+  VKEX_ASSERT(m_device == nullptr);
+
+  m_device      = device;
+  m_create_info = create_info;
+  if (m_create_info.block_size == 0) {
+    m_create_info.block_size = kDefaultBufferHeapBlockSize;
+  }
+
+  // Every offset handed out has to suit every usage, the limits are
+  // powers of two. 16 covers index and vertex data.
+  const VkPhysicalDeviceLimits& limits = m_device->GetPhysicalDevice()->GetPhysicalDeviceLimits();
+  const BufferUsageFlags&       usage  = m_create_info.usage_flags;
+  m_alignment = 16;
+  if (usage.bits.uniform_buffer) {
+    m_alignment = std::max(m_alignment, limits.minUniformBufferOffsetAlignment);
+  }
+  if (usage.bits.storage_buffer) {
+    m_alignment = std::max(m_alignment, limits.minStorageBufferOffsetAlignment);
+  }
+  if (usage.bits.uniform_texel_buffer || usage.bits.storage_texel_buffer) {
+    m_alignment = std::max(m_alignment, limits.minTexelBufferOffsetAlignment);
+  }
+  m_create_info.block_size = AlignUp(m_create_info.block_size, m_alignment);
+
+  return vkex::Result::Success;
+}
+
+vkex::Result BufferHeap::Destroy()
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+
+  for (auto& block : m_blocks) {
+    if (!block) {
+      continue;
+    }
+    vkex::Result vkex_result = m_device->DestroyBuffer(block->buffer);
+    if (!vkex_result) {
+      return vkex_result;
+    }
+  }
+  m_blocks.clear();
+
+  return vkex::Result::Success;
+}
+
+vkex::Result BufferHeap::CreateBlock(VkDeviceSize size, bool dedicated, uint32_t* p_block_index)
+{
+  vkex::BufferCreateInfo create_info = {};
+  create_info.size                   = size;
+  create_info.usage_flags            = m_create_info.usage_flags;
+  create_info.committed              = true;
+  create_info.memory_usage           = m_create_info.memory_usage;
+  create_info.persistent_map         = IsMemoryHostVisible(m_create_info.memory_usage);
+
+  std::unique_ptr<Block> block = std::make_unique<Block>();
+  vkex::Result vkex_result = m_device->CreateBuffer(create_info, &block->buffer);
+  if (!vkex_result) {
+    return vkex_result;
+  }
+  block->p_mapped_address = static_cast<uint8_t*>(block->buffer->GetMappedAddress());
+  block->dedicated        = dedicated;
+  InsertFreeRange(block.get(), 0, size);
+
+  // Reuse the slot of a destroyed dedicated block
+  auto it = std::find(m_blocks.begin(), m_blocks.end(), nullptr);
+  if (it != m_blocks.end()) {
+    *it = std::move(block);
+    *p_block_index = static_cast<uint32_t>(it - m_blocks.begin());
+  }
+  else {
+    m_blocks.push_back(std::move(block));
+    *p_block_index = vkex::CountU32(m_blocks) - 1;
+  }
+
+  return vkex::Result::Success;
+}
+
+void BufferHeap::InsertFreeRange(Block* p_block, VkDeviceSize offset, VkDeviceSize size)
+{
+  p_block->free_by_offset[offset] = size;
+  p_block->free_by_size.emplace(size, offset);
+}
+
+void BufferHeap::RemoveFreeRange(Block* p_block, VkDeviceSize offset, VkDeviceSize size)
+{
+  p_block->free_by_offset.erase(offset);
+
+  auto range = p_block->free_by_size.equal_range(size);
+  for (auto it = range.first; it != range.second; ++it) {
+    if (it->second == offset) {
+      p_block->free_by_size.erase(it);
+      break;
+    }
+  }
+}
+
+bool BufferHeap::AllocateFromBlock(uint32_t block_index, VkDeviceSize size, VkDeviceSize alignment, vkex::BufferRange* p_range)
+{
+  Block* p_block = m_blocks[block_index].get();
+  if (p_block == nullptr) {
+    return false;
+  }
+
+  // Smallest free range that still fits once its offset is aligned
+  for (auto it = p_block->free_by_size.lower_bound(size); it != p_block->free_by_size.end(); ++it) {
+    VkDeviceSize free_offset = it->second;
+    VkDeviceSize free_size   = it->first;
+    VkDeviceSize offset      = AlignUp(free_offset, alignment);
+    VkDeviceSize padding     = offset - free_offset;
+    if ((padding + size) > free_size) {
+      continue;
+    }
+
+    RemoveFreeRange(p_block, free_offset, free_size);
+    if (padding > 0) {
+      InsertFreeRange(p_block, free_offset, padding);
+    }
+    VkDeviceSize remaining = free_size - padding - size;
+    if (remaining > 0) {
+      InsertFreeRange(p_block, offset + size, remaining);
+    }
+    p_block->used_size += size;
+
+    p_range->buffer           = p_block->buffer;
+    p_range->offset           = offset;
+    p_range->size             = size;
+    p_range->p_mapped_address = (p_block->p_mapped_address != nullptr) ? (p_block->p_mapped_address + offset) : nullptr;
+    p_range->block_index      = block_index;
+    return true;
+  }
+
+  return false;
+}
+
+vkex::Result BufferHeap::Allocate(VkDeviceSize size, VkDeviceSize alignment, vkex::BufferRange* p_range)
+{
+  VKEX_ASSERT(m_device != nullptr);
+  VKEX_ASSERT(p_range != nullptr);
+  VKEX_ASSERT((alignment > 0) && ((alignment & (alignment - 1)) == 0));
+
+  if (size == 0) {
+    return vkex::Result::ErrorBufferSizeMustBeGreaterThanZero;
+  }
+
+  // Rounding sizes keeps the free lists from filling up with slivers
+  alignment = std::max(alignment, m_alignment);
+  size      = AlignUp(size, m_alignment);
+
+  std::lock_guard<std::mutex> lock(m_mutex);
+
+  if (size > m_create_info.block_size) {
+    uint32_t block_index = UINT32_MAX;
+    vkex::Result vkex_result = CreateBlock(size, true, &block_index);
+    if (!vkex_result) {
+      return vkex_result;
+    }
+    bool allocated = AllocateFromBlock(block_index, size, alignment, p_range);
+    VKEX_ASSERT(allocated);
+    return allocated ? vkex::Result::Success : vkex::Result::ErrorAllocationFailed;
+  }
+
+  for (uint32_t block_index = 0; block_index < vkex::CountU32(m_blocks); ++block_index) {
+    if (m_blocks[block_index] && m_blocks[block_index]->dedicated) {
+      continue;
+    }
+    if (AllocateFromBlock(block_index, size, alignment, p_range)) {
+      return vkex::Result::Success;
+    }
+  }
+
+  uint32_t block_index = UINT32_MAX;
+  vkex::Result vkex_result = CreateBlock(m_create_info.block_size, false, &block_index);
+  if (!vkex_result) {
+    return vkex_result;
+  }
+  bool allocated = AllocateFromBlock(block_index, size, alignment, p_range);
+  VKEX_ASSERT(allocated);
+  return allocated ? vkex::Result::Success : vkex::Result::ErrorAllocationFailed;
+}
+
+void BufferHeap::Free(vkex::BufferRange* p_range)
+{
+  if ((p_range == nullptr) || !p_range->IsValid()) {
+    return;
+  }
+
+  std::lock_guard<std::mutex> lock(m_mutex);
+
+  VKEX_ASSERT(p_range->block_index < m_blocks.size());
+  Block* p_block = m_blocks[p_range->block_index].get();
+  VKEX_ASSERT((p_block != nullptr) && (p_block->buffer == p_range->buffer));
+
+  VkDeviceSize offset = p_range->offset;
+  VkDeviceSize size   = p_range->size;
+  p_block->used_size -= size;
+
+  if (p_block->dedicated) {
+    m_device->DestroyBuffer(p_block->buffer);
+    m_blocks[p_range->block_index].reset();
+    *p_range = vkex::BufferRange();
+    return;
+  }
+
+  // Merge with the free ranges on either side
+  auto next = p_block->free_by_offset.lower_bound(offset);
+  if ((next != p_block->free_by_offset.end()) && (next->first == (offset + size))) {
+    VkDeviceSize next_size = next->second;
+    RemoveFreeRange(p_block, next->first, next_size);
+    size += next_size;
+  }
+  auto prev = p_block->free_by_offset.lower_bound(offset);
+  if (prev != p_block->free_by_offset.begin()) {
+    --prev;
+    if ((prev->first + prev->second) == offset) {
+      VkDeviceSize prev_offset = prev->first;
+      VkDeviceSize prev_size   = prev->second;
+      RemoveFreeRange(p_block, prev_offset, prev_size);
+      offset = prev_offset;
+      size += prev_size;
+    }
+  }
+  InsertFreeRange(p_block, offset, size);
+
+  *p_range = vkex::BufferRange();
+}
+
+uint32_t BufferHeap::GetBlockCount() const
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+
+  uint32_t count = 0;
+  for (auto& block : m_blocks) {
+    count += block ? 1 : 0;
+  }
+  return count;
+}
+
+VkDeviceSize BufferHeap::GetAllocatedSize() const
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+
+  VkDeviceSize size = 0;
+  for (auto& block : m_blocks) {
+    size += block ? block->buffer->GetSize() : 0;
+  }
+  return size;
+}
+
+VkDeviceSize BufferHeap::GetUsedSize() const
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+
+  VkDeviceSize size = 0;
+  for (auto& block : m_blocks) {
+    size += block ? block->used_size : 0;
+  }
+  return size;
+}
+
+} // namespace vkex
@@ -0,0 +1,181 @@
+/*
+ Copyright 2018-2019 Google Inc.
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+ http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+*/
+
+#ifndef __VKEX_BUFFER_HEAP_H__
+#define __VKEX_BUFFER_HEAP_H__
+
+#include <vkex/Buffer.h>
+
+#include <map>
+#include <memory>
+#include <mutex>
+
+namespace vkex {
+
+// =================================================================================================
+// BufferHeap
+// =================================================================================================
+
+/** @struct BufferRange
+ *
+ * Part of one of a BufferHeap's buffers. p_mapped_address is nullptr if the
+ * heap's memory isn't host visible.
+ *
+ */
+struct BufferRange {
+  vkex::Buffer  buffer            = nullptr;
+  VkDeviceSize  offset            = 0;
+  VkDeviceSize  size              = 0;
+  void*         p_mapped_address  = nullptr;
+  uint32_t      block_index       = UINT32_MAX;
+
+  /** @fn IsValid
+   *
+   */
+  bool IsValid() const {
+    return (buffer != nullptr);
+  }
+
+  /** @fn Write
+   *
+   * Copies size bytes from p_src to offset within the range and flushes
+   * them. The heap's memory must be host visible.
+   *
+   */
+  vkex::Result Write(VkDeviceSize offset, VkDeviceSize size, const void* p_src) const;
+};
+
+/** @struct BufferHeapCreateInfo
+ *
+ */
+struct BufferHeapCreateInfo {
+  BufferUsageFlags  usage_flags;
+  VmaMemoryUsage    memory_usage;
+  // Size of each buffer, larger allocations get a buffer of their own.
+  // Default: 0 (4 MiB)
+  VkDeviceSize      block_size;
+};
+
+/** @class BufferHeap
+ *
+ * Suballocates small buffers out of a few large ones so that many small
+ * meshes and constant blocks don't each cost a VkBuffer and a VMA
+ * allocation. Every buffer the heap creates has the same usage and memory
+ * usage, so one heap is needed per usage/memory type combination.
+ *
+ * Allocations are best fit out of a per buffer free list with adjacent
+ * free ranges merged on Free(). Offsets are aligned to whatever the usage
+ * flags require, minUniformBufferOffsetAlignment for uniform buffers and so
+ * on. Host visible heaps are persistently mapped.
+ *
+ * Like destroying a buffer, a range must not be freed while the GPU may
+ * still be using it. All functions are thread safe.
+ *
+ */
+class BufferHeap {
+public:
+  BufferHeap() {}
+  ~BufferHeap() {}
+
+  BufferHeap(const BufferHeap&) = delete;
+  BufferHeap& operator=(const BufferHeap&) = delete;
+
+  /** @fn Initialize
+   *
+   */
+  vkex::Result Initialize(vkex::Device device, const vkex::BufferHeapCreateInfo& create_info);
+
+  /** @fn Destroy
+   *
+   * Destroys every buffer, outstanding ranges become invalid.
+   *
+   */
+  vkex::Result Destroy();
+
+  /** @fn Allocate
+   *
+   * alignment is on top of the alignment required by the heap's usage,
+   * it must be a power of two.
+   *
+   */
+  vkex::Result Allocate(VkDeviceSize size, VkDeviceSize alignment, vkex::BufferRange* p_range);
+
+  /** @fn Allocate
+   *
+   */
+  vkex::Result Allocate(VkDeviceSize size, vkex::BufferRange* p_range) {
+    return Allocate(size, 1, p_range);
+  }
+
+  /** @fn Free
+   *
+   * Resets *p_range.
+   *
+   */
+  void Free(vkex::BufferRange* p_range);
+
+  /** @fn GetAlignment
+   *
+   */
+  VkDeviceSize GetAlignment() const {
+    return m_alignment;
+  }
+
+  /** @fn GetBlockCount
+   *
+   */
+  uint32_t GetBlockCount() const;
+
+  /** @fn GetAllocatedSize
+   *
+   * Total size of the heap's buffers.
+   *
+   */
+  VkDeviceSize GetAllocatedSize() const;
+
+  /** @fn GetUsedSize
+   *
+   */
+  VkDeviceSize GetUsedSize() const;
+
+private:
+  struct Block {
+    vkex::Buffer                          buffer            = nullptr;
+    uint8_t*                              p_mapped_address  = nullptr;
+    VkDeviceSize                          used_size         = 0;
+    // Larger than block_size, destroyed as soon as it's empty
+    bool                                  dedicated         = false;
+    // Free ranges by offset and by size
+    std::map<VkDeviceSize, VkDeviceSize>  free_by_offset;
+    std::multimap<VkDeviceSize, VkDeviceSize> free_by_size;
+  };
+
+  vkex::Result  CreateBlock(VkDeviceSize size, bool dedicated, uint32_t* p_block_index);
+  bool          AllocateFromBlock(uint32_t block_index, VkDeviceSize size, VkDeviceSize alignment, vkex::BufferRange* p_range);
+  void          InsertFreeRange(Block* p_block, VkDeviceSize offset, VkDeviceSize size);
+  void          RemoveFreeRange(Block* p_block, VkDeviceSize offset, VkDeviceSize size);
+
+private:
+  vkex::Device                        m_device      = nullptr;
+  vkex::BufferHeapCreateInfo          m_create_info = {};
+  VkDeviceSize                        m_alignment   = 0;
+  mutable std::mutex                  m_mutex;
+  std::vector<std::unique_ptr<Block>> m_blocks;
+};
+
+} // namespace vkex
+
+#endif // __VKEX_BUFFER_HEAP_H__
@@ -1023,6 +1023,103 @@ void CCommandBuffer::CmdTransitionImageLayout(vkex::Texture texture, VkImageLayo
     newPipelineStage);
 }
 
+void CCommandBuffer::CmdGenerateMips(vkex::Image image, VkImageLayout oldLayout, VkImageLayout newLayout, VkPipelineStageFlags newPipelineStage)
+{
+  VkImage            vk_image    = image->GetVkObject();
+  VkImageAspectFlags aspectMask  = image->GetAspectFlags();
+  uint32_t           mipLevels   = image->GetMipLevels();
+  uint32_t           arrayLayers = image->GetArrayLayers();
+  VkExtent3D         extent      = image->GetExtent();
+
+  if (mipLevels > 1) {
+    // Levels being written, their contents are discarded
+    this->CmdTransitionImageLayout(
+      vk_image,
+      aspectMask,
+      1,
+      mipLevels - 1,
+      0,
+      arrayLayers,
+      VK_IMAGE_LAYOUT_UNDEFINED,
+      VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+      VK_PIPELINE_STAGE_TRANSFER_BIT);
+  }
+
+  for (uint32_t level = 1; level < mipLevels; ++level) {
+    // Previous level becomes the blit source once it's been written
+    this->CmdTransitionImageLayout(
+      vk_image,
+      aspectMask,
+      level - 1,
+      1,
+      0,
+      arrayLayers,
+      (level == 1) ? oldLayout : VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+      VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+      VK_PIPELINE_STAGE_TRANSFER_BIT);
+
+    VkImageBlit region                    = {};
+    region.srcSubresource.aspectMask      = aspectMask;
+    region.srcSubresource.mipLevel        = level - 1;
+    region.srcSubresource.baseArrayLayer  = 0;
+    region.srcSubresource.layerCount      = arrayLayers;
+    region.srcOffsets[1].x                = static_cast<int32_t>(std::max(extent.width  >> (level - 1), 1U));
+    region.srcOffsets[1].y                = static_cast<int32_t>(std::max(extent.height >> (level - 1), 1U));
+    region.srcOffsets[1].z                = static_cast<int32_t>(std::max(extent.depth  >> (level - 1), 1U));
+    region.dstSubresource.aspectMask      = aspectMask;
+    region.dstSubresource.mipLevel        = level;
+    region.dstSubresource.baseArrayLayer  = 0;
+    region.dstSubresource.layerCount      = arrayLayers;
+    region.dstOffsets[1].x                = static_cast<int32_t>(std::max(extent.width  >> level, 1U));
+    region.dstOffsets[1].y                = static_cast<int32_t>(std::max(extent.height >> level, 1U));
+    region.dstOffsets[1].z                = static_cast<int32_t>(std::max(extent.depth  >> level, 1U));
+    this->CmdBlitImage(
+      vk_image,
+      VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+      vk_image,
+      VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+      1,
+      &region,
+      VK_FILTER_LINEAR);
+  }
+
+  if (mipLevels == 1) {
+    this->CmdTransitionImageLayout(
+      vk_image,
+      aspectMask,
+      0,
+      1,
+      0,
+      arrayLayers,
+      oldLayout,
+      newLayout,
+      newPipelineStage);
+    return;
+  }
+
+  // Every level but the last one was a blit source
+  this->CmdTransitionImageLayout(
+    vk_image,
+    aspectMask,
+    0,
+    mipLevels - 1,
+    0,
+    arrayLayers,
+    VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+    newLayout,
+    newPipelineStage);
+  this->CmdTransitionImageLayout(
+    vk_image,
+    aspectMask,
+    mipLevels - 1,
+    1,
+    0,
+    arrayLayers,
+    VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+    newLayout,
+    newPipelineStage);
+}
+
 // =================================================================================================
 // CommandPool
 // =================================================================================================
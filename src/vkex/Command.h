@@ -37,7 +37,7 @@ struct CommandBufferCreateInfo {
 /** @class ICommandBuffer
  *
  */ 
-class CCommandBuffer {
+class CCommandBuffer : public IStoredObject {
 public:
   CCommandBuffer();
   ~CCommandBuffer();
@@ -155,6 +155,12 @@ public:
   void  CmdTransitionImageLayout(vkex::Image image, VkImageLayout oldLayout, VkImageLayout newLayout, VkPipelineStageFlags newPipelineStage, uint32_t baseMipLevel = 0, uint32_t levelCount = VKEX_ALL_MIP_LEVELS, uint32_t baseArrayLayer = 0, uint32_t layerCount = VKEX_ALL_ARRAY_LAYERS);
   void  CmdTransitionImageLayout(vkex::Texture texture, VkImageLayout oldLayout, VkImageLayout newLayout, VkPipelineStageFlags newPipelineStage, uint32_t baseMipLevel = 0, uint32_t levelCount = VKEX_ALL_MIP_LEVELS, uint32_t baseArrayLayer = 0, uint32_t layerCount = VKEX_ALL_ARRAY_LAYERS);
 
+  // Fills levels 1 and up from level 0 with a chain of linear blits. All
+  // levels must be in oldLayout and end up in newLayout. The format must
+  // support BLIT_SRC, BLIT_DST and SAMPLED_IMAGE_FILTER_LINEAR and the
+  // queue must support graphics.
+  void  CmdGenerateMips(vkex::Image image, VkImageLayout oldLayout, VkImageLayout newLayout, VkPipelineStageFlags newPipelineStage);
+
 private:
   friend class CCommandPool;
   friend class IObjectStorageFunctions;
@@ -204,6 +210,9 @@ struct CommandPoolCreateInfo {
 };
 
 /** @class ICommandPool
+ *
+ * The pool is externally synchronized: allocating, freeing and recording
+ * into its command buffers must happen on one thread at a time.
  *
  */ 
 class CCommandPool
@@ -291,7 +300,7 @@ private:
   vkex::CommandPoolCreateInfo                   m_create_info = {};
   VkCommandPoolCreateInfo                       m_vk_create_info = {};
   VkCommandPool                                 m_vk_object = VK_NULL_HANDLE;
-  std::vector<std::unique_ptr<CCommandBuffer>>  m_stored_command_buffers;
+  vkex::ObjectStorage<CCommandBuffer>           m_stored_command_buffers;
 };
 
 } // namespace vkex
@@ -42,6 +42,22 @@
 #include "vkex/ConfigMath.h"
 #include "vkex/Util.h"
 
+// SIMD instruction sets available at compile time. SSE2 is baseline on
+// x86-64, AVX2/F16C are only used if the compiler has been told to target
+// them (see VKEX_ENABLE_AVX2 in CMakeLists.txt).
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+# define VKEX_SIMD_SSE2
+#endif
+#if defined(__SSSE3__) || defined(__AVX2__)
+# define VKEX_SIMD_SSSE3
+#endif
+#if defined(__AVX2__)
+# define VKEX_SIMD_AVX2
+#endif
+#if defined(__F16C__) || (defined(_MSC_VER) && defined(__AVX2__))
+# define VKEX_SIMD_F16C
+#endif
+
 #define VKEX_MINIMUM_REQUIRED_VULKAN_VERSION  VK_MAKE_VERSION(1, 1, 0)
 #define VKEX_ALL_MIP_LEVELS                   0xFFFFFFFF
 #define VKEX_ALL_ARRAY_LAYERS                 0xFFFFFFFF
@@ -213,6 +229,7 @@ public:
     ErrorImageInfoFailed                                = -20001,
     ErrorImageStorageSizeInsufficient                   = -20002,
     ErrorImageWriteFailed                               = -20003,
+    ErrorImageFormatNotSupported                        = -20004,
   };
 
   Result() {}
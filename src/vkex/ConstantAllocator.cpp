@@ -0,0 +1,122 @@
+/*
+ Copyright 2018-2019 Google Inc.
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+ http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+*/
+
+#include <vkex/ConstantAllocator.h>
+#include <vkex/Device.h>
+
+namespace vkex {
+
+// =================================================================================================
+// ConstantAllocator
+// =================================================================================================
+vkex::Result ConstantAllocator::Initialize(vkex::Device device, VkDeviceSize size)
+{
+  VKEX_ASSERT(device != nullptr);
+  VKEX_ASSERT(m_buffer == nullptr);
+
+  m_device = device;
+
+  // Offsets have to suit either descriptor type, both limits are powers of two
+  const VkPhysicalDeviceLimits& limits = m_device->GetPhysicalDevice()->GetPhysicalDeviceLimits();
+  m_alignment = std::max<VkDeviceSize>(
+    std::max(limits.minUniformBufferOffsetAlignment, limits.minStorageBufferOffsetAlignment),
+    16);
+
+  // Dynamic offsets are 32-bit
+  size = std::min<VkDeviceSize>(size, UINT32_MAX);
+  size = (size / m_alignment) * m_alignment;
+  if (size == 0) {
+    return vkex::Result::ErrorBufferSizeMustBeGreaterThanZero;
+  }
+
+  vkex::BufferCreateInfo create_info          = {};
+  create_info.size                            = size;
+  create_info.usage_flags.bits.uniform_buffer = true;
+  create_info.usage_flags.bits.storage_buffer = true;
+  create_info.committed                       = true;
+  create_info.memory_usage                    = VMA_MEMORY_USAGE_CPU_TO_GPU;
+  create_info.persistent_map                  = true;
+  vkex::Result vkex_result = m_device->CreateBuffer(create_info, &m_buffer);
+  if (!vkex_result) {
+    return vkex_result;
+  }
+
+  m_mapped_address = static_cast<uint8_t*>(m_buffer->GetMappedAddress());
+  m_offset         = 0;
+
+  return vkex::Result::Success;
+}
+
+vkex::Result ConstantAllocator::Destroy()
+{
+  if (m_buffer != nullptr) {
+    vkex::Result vkex_result = m_device->DestroyBuffer(m_buffer);
+    if (!vkex_result) {
+      return vkex_result;
+    }
+    m_buffer = nullptr;
+  }
+
+  m_mapped_address = nullptr;
+  m_offset         = 0;
+
+  return vkex::Result::Success;
+}
+
+vkex::Result ConstantAllocator::Allocate(VkDeviceSize size, vkex::ConstantAllocation* p_allocation)
+{
+  VKEX_ASSERT(m_buffer != nullptr);
+  VKEX_ASSERT(p_allocation != nullptr);
+
+  // Rounding the size keeps every offset aligned with a single add
+  VkDeviceSize aligned_size = ((std::max<VkDeviceSize>(size, 1) + m_alignment - 1) / m_alignment) * m_alignment;
+  VkDeviceSize offset       = m_offset.fetch_add(aligned_size);
+  if ((offset + aligned_size) > m_buffer->GetSize()) {
+    return vkex::Result::ErrorResouceSizeIsInsufficient;
+  }
+
+  p_allocation->offset = static_cast<uint32_t>(offset);
+  p_allocation->p_data = m_mapped_address + offset;
+
+  return vkex::Result::Success;
+}
+
+vkex::Result ConstantAllocator::Flush()
+{
+  VkDeviceSize used_size = GetUsedSize();
+  if ((m_buffer == nullptr) || (used_size == 0)) {
+    return vkex::Result::Success;
+  }
+
+  return m_buffer->Flush(0, used_size);
+}
+
+void ConstantAllocator::Reset()
+{
+  m_offset = 0;
+}
+
+VkDeviceSize ConstantAllocator::GetSize() const
+{
+  return (m_buffer != nullptr) ? m_buffer->GetSize() : 0;
+}
+
+VkDeviceSize ConstantAllocator::GetUsedSize() const
+{
+  return std::min<VkDeviceSize>(m_offset.load(), GetSize());
+}
+
+} // namespace vkex
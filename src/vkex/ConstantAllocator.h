@@ -0,0 +1,146 @@
+/*
+ Copyright 2018-2019 Google Inc.
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+ http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+*/
+
+#ifndef __VKEX_CONSTANT_ALLOCATOR_H__
+#define __VKEX_CONSTANT_ALLOCATOR_H__
+
+#include <vkex/Config.h>
+#include <vkex/Traits.h>
+#include <vkex/VulkanUtil.h>
+
+#include <atomic>
+
+namespace vkex {
+
+// =================================================================================================
+// ConstantAllocator
+// =================================================================================================
+
+/** @struct ConstantAllocation
+ *
+ * offset is the dynamic offset to pass to CmdBindDescriptorSets, p_data
+ * is where to write the constants.
+ *
+ */
+struct ConstantAllocation {
+  uint32_t  offset = 0;
+  void*     p_data = nullptr;
+};
+
+/** @class ConstantAllocator
+ *
+ * Linear allocator over one persistently mapped uniform and storage
+ * buffer. Allocations are aligned to minUniformBufferOffsetAlignment and
+ * minStorageBufferOffsetAlignment and are only valid until Reset(), which
+ * the owner calls once the GPU is done with everything allocated since
+ * the last reset.
+ *
+ * The buffer is bound once through a UNIFORM_BUFFER_DYNAMIC or
+ * STORAGE_BUFFER_DYNAMIC descriptor, each draw passes its allocation's
+ * offset as the dynamic offset, so per draw constants don't create any
+ * Vulkan objects.
+ *
+ * Allocate() is thread safe, everything else isn't.
+ *
+ */
+class ConstantAllocator {
+public:
+  ConstantAllocator() {}
+  ~ConstantAllocator() {}
+
+  ConstantAllocator(const ConstantAllocator&) = delete;
+  ConstantAllocator& operator=(const ConstantAllocator&) = delete;
+
+  /** @fn Initialize
+   *
+   */
+  vkex::Result Initialize(vkex::Device device, VkDeviceSize size);
+
+  /** @fn Destroy
+   *
+   */
+  vkex::Result Destroy();
+
+  /** @fn Allocate
+   *
+   * Returns ErrorResouceSizeIsInsufficient if the buffer is full.
+   *
+   */
+  vkex::Result Allocate(VkDeviceSize size, vkex::ConstantAllocation* p_allocation);
+
+  /** @fn Allocate
+   *
+   * Returns nullptr if the buffer is full.
+   *
+   */
+  template <typename T>
+  T* Allocate(uint32_t* p_offset) {
+    vkex::ConstantAllocation allocation = {};
+    if (!Allocate(sizeof(T), &allocation)) {
+      return nullptr;
+    }
+    *p_offset = allocation.offset;
+    return static_cast<T*>(allocation.p_data);
+  }
+
+  /** @fn Flush
+   *
+   * Makes everything allocated since Reset() visible to the device,
+   * does nothing for coherent memory.
+   *
+   */
+  vkex::Result Flush();
+
+  /** @fn Reset
+   *
+   */
+  void Reset();
+
+  /** @fn GetBuffer
+   *
+   */
+  vkex::Buffer GetBuffer() const {
+    return m_buffer;
+  }
+
+  /** @fn GetAlignment
+   *
+   */
+  VkDeviceSize GetAlignment() const {
+    return m_alignment;
+  }
+
+  /** @fn GetSize
+   *
+   */
+  VkDeviceSize GetSize() const;
+
+  /** @fn GetUsedSize
+   *
+   */
+  VkDeviceSize GetUsedSize() const;
+
+private:
+  vkex::Device              m_device = nullptr;
+  vkex::Buffer              m_buffer = nullptr;
+  uint8_t*                  m_mapped_address = nullptr;
+  VkDeviceSize              m_alignment = 0;
+  std::atomic<VkDeviceSize> m_offset{0};
+};
+
+} // namespace vkex
+
+#endif // __VKEX_CONSTANT_ALLOCATOR_H__
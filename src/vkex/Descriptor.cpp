@@ -163,6 +163,11 @@ void CDescriptorSet::UpdateDescriptors(uint32_t binding, VkDescriptorType descri
 }
 
 vkex::Result CDescriptorSet::UpdateDescriptor(uint32_t binding, const vkex::Buffer buffer, uint32_t array_element)
+{
+  return UpdateDescriptor(binding, buffer, 0, buffer->GetSize(), array_element);
+}
+
+vkex::Result CDescriptorSet::UpdateDescriptor(uint32_t binding, const vkex::Buffer buffer, VkDeviceSize offset, VkDeviceSize range, uint32_t array_element)
 {
   const VkDescriptorSetLayoutBinding* p_descriptor_binding = FindDescriptorBinding(binding);
   if (p_descriptor_binding == nullptr) {
@@ -173,15 +178,17 @@ vkex::Result CDescriptorSet::UpdateDescriptor(uint32_t binding, const vkex::Buff
   bool is_storage_buffer = (descriptor_type == VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
   bool is_uniform_buffer = (descriptor_type == VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER);
   bool is_uniform_texel_buffer = (descriptor_type == VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER);
+  bool is_storage_buffer_dynamic = (descriptor_type == VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC);
+  bool is_uniform_buffer_dynamic = (descriptor_type == VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC);
 
-  if (!(is_storage_buffer || is_uniform_buffer || is_uniform_texel_buffer))  {
+  if (!(is_storage_buffer || is_uniform_buffer || is_uniform_texel_buffer || is_storage_buffer_dynamic || is_uniform_buffer_dynamic))  {
     return vkex::Result::ErrorInvalidDescriptorType;
   }
 
   VkDescriptorBufferInfo info  {};
   info.buffer = *buffer;
-  info.offset = 0;
-  info.range  = buffer->GetSize();
+  info.offset = offset;
+  info.range  = range;
 
   const uint32_t count = 1;
   UpdateDescriptors(
@@ -191,9 +198,47 @@ vkex::Result CDescriptorSet::UpdateDescriptor(uint32_t binding, const vkex::Buff
     count,
     &info);
 
+  // Remember the write in case defragmentation recreates the buffer
+  BufferBinding buffer_binding = { binding, array_element, descriptor_type, buffer, offset, range };
+  auto it = FindIf(
+    m_buffer_bindings,
+    [binding, array_element](const BufferBinding& elem) -> bool {
+      return (elem.binding == binding) && (elem.array_element == array_element);
+    });
+  if (it != std::end(m_buffer_bindings)) {
+    *it = buffer_binding;
+  }
+  else {
+    m_buffer_bindings.push_back(buffer_binding);
+  }
+
   return vkex::Result::Success;
 }
 
+bool CDescriptorSet::RefreshBufferDescriptors(const std::vector<vkex::Buffer>& buffers)
+{
+  bool refreshed = false;
+  for (auto& buffer_binding : m_buffer_bindings) {
+    if (!Contains(buffers, buffer_binding.buffer)) {
+      continue;
+    }
+
+    VkDescriptorBufferInfo info  {};
+    info.buffer = *(buffer_binding.buffer);
+    info.offset = buffer_binding.offset;
+    info.range  = buffer_binding.range;
+
+    UpdateDescriptors(
+      buffer_binding.binding,
+      buffer_binding.descriptor_type,
+      buffer_binding.array_element,
+      1,
+      &info);
+    refreshed = true;
+  }
+  return refreshed;
+}
+
 vkex::Result CDescriptorSet::UpdateDescriptor(uint32_t binding, const vkex::Texture texture, uint32_t array_element)
 {
   const VkDescriptorSetLayoutBinding* p_descriptor_binding = FindDescriptorBinding(binding);
@@ -517,4 +562,32 @@ void CDescriptorPool::FreeDescriptorSet(const vkex::DescriptorSet descriptor_set
     &descriptor_set);  
 }
 
+// =================================================================================================
+// Support functions
+// =================================================================================================
+vkex::Result SetDynamicBinding(uint32_t binding, vkex::DescriptorSetLayoutCreateInfo* p_create_info)
+{
+  VKEX_ASSERT(p_create_info != nullptr);
+
+  for (auto& elem : p_create_info->bindings) {
+    if (elem.binding != binding) {
+      continue;
+    }
+
+    if (elem.descriptorType == VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER) {
+      elem.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+    }
+    else if (elem.descriptorType == VK_DESCRIPTOR_TYPE_STORAGE_BUFFER) {
+      elem.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+    }
+    else if ((elem.descriptorType != VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC) &&
+             (elem.descriptorType != VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC)) {
+      return vkex::Result::ErrorInvalidDescriptorType;
+    }
+    return vkex::Result::Success;
+  }
+
+  return vkex::Result::ErrorInvalidDescriptorBinding;
+}
+
 } // namespace vkex
\ No newline at end of file
@@ -136,6 +136,14 @@ public:
    */
   vkex::Result UpdateDescriptor(uint32_t binding, const vkex::Buffer buffer, uint32_t array_element = 0);
 
+  /** @fn UpdateDescriptor
+   *
+   * For dynamic buffer descriptors range is the size one dynamic offset
+   * can see, offset is usually 0.
+   *
+   */
+  vkex::Result UpdateDescriptor(uint32_t binding, const vkex::Buffer buffer, VkDeviceSize offset, VkDeviceSize range, uint32_t array_element = 0);
+
   /** @fn UpdateDescriptor
    *
    */
@@ -148,6 +156,7 @@ public:
 
 private:
   friend class CDescriptorPool;
+  friend class CDevice;
   friend class IObjectStorageFunctions;
 
   /** @fn InternalCreate
@@ -173,9 +182,29 @@ private:
    */
   const VkDescriptorSetLayoutBinding* FindDescriptorBinding(uint32_t binding) const;
 
+  /** @fn RefreshBufferDescriptors
+   *
+   * Rewrites descriptors written with any of buffers, whose Vulkan objects
+   * were recreated by CDevice::DefragmentBuffers(). Returns true if any were.
+   *
+   */
+  bool RefreshBufferDescriptors(const std::vector<vkex::Buffer>& buffers);
+
 private:
+  // Written through UpdateDescriptor(), raw VkDescriptorBufferInfo writes
+  // aren't tracked
+  struct BufferBinding {
+    uint32_t          binding;
+    uint32_t          array_element;
+    VkDescriptorType  descriptor_type;
+    vkex::Buffer      buffer;
+    VkDeviceSize      offset;
+    VkDeviceSize      range;
+  };
+
   vkex::DescriptorPool          m_pool = nullptr;
   vkex::DescriptorSetCreateInfo m_create_info = {};
+  std::vector<BufferBinding>    m_buffer_bindings;
 };
 
 // =================================================================================================
@@ -200,6 +229,9 @@ struct DescriptorPoolCreateInfo {
 };
 
 /** @class IDescriptorPool
+ *
+ * The pool is externally synchronized: allocating and freeing its
+ * descriptor sets must happen on one thread at a time.
  *
  */ 
 class CDescriptorPool 
@@ -289,9 +321,21 @@ private:
   VkDescriptorPoolCreateInfo                    m_vk_create_info = {};
   std::vector<VkDescriptorPoolSize>             m_vk_descriptor_pool_sizes;
   VkDescriptorPool                              m_vk_object = VK_NULL_HANDLE;
-  std::vector<std::unique_ptr<CDescriptorSet>>  m_stored_descriptor_sets;
+  vkex::ObjectStorage<CDescriptorSet>           m_stored_descriptor_sets;
 };
 
+// =================================================================================================
+// Support functions
+// =================================================================================================
+
+/** @fn SetDynamicBinding
+ *
+ * Changes a UNIFORM_BUFFER or STORAGE_BUFFER binding to its dynamic type,
+ * reflection only ever produces the static types.
+ *
+ */
+vkex::Result SetDynamicBinding(uint32_t binding, vkex::DescriptorSetLayoutCreateInfo* p_create_info);
+
 } // namespace vkex
 
 #endif // __VKEX_DESCRIPTOR_H__
\ No newline at end of file
@@ -175,6 +175,13 @@ bool CPhysicalDevice::GetQueueFamilyProperties(
   return true;
 }
 
+VkFormatProperties CPhysicalDevice::GetFormatProperties(VkFormat format) const
+{
+  VkFormatProperties properties = {};
+  vkex::GetPhysicalDeviceFormatProperties(m_create_info.vk_object, format, &properties);
+  return properties;
+}
+
 VkBool32 CPhysicalDevice::SupportsPresent(uint32_t queue_family_index, const vkex::DisplayInfo& display_info) const
 {
 #if defined(VKEX_GGP)
@@ -296,6 +303,9 @@ vkex::Result CDevice::InitializeExtensions()
 #if ! defined(VKEX_WIN32)
     optional.push_back(VK_EXT_DEBUG_MARKER_EXTENSION_NAME);
 #endif
+#if defined(VK_EXT_memory_budget)
+    optional.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+#endif
 
     for (auto& name : optional) {
       // Check to make sure extension is available
@@ -314,6 +324,10 @@ vkex::Result CDevice::InitializeExtensions()
     }
   }
 
+#if defined(VK_EXT_memory_budget)
+  m_memory_budget_enabled = Contains(m_create_info.extensions, std::string(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME));
+#endif
+
   // Check extension names
   for (auto& name : m_create_info.extensions) {
     bool found = Contains(m_found_extensions, name);
@@ -448,6 +462,16 @@ vkex::Result CDevice::InternalCreate(
   // Copy create info
   m_create_info = create_info;
 
+  // Host allocator, used wherever the caller doesn't pass callbacks
+  if (m_create_info.host_allocator.enable) {
+    m_host_allocator = std::make_unique<vkex::HostAllocator>();
+    vkex::Result vkex_result = m_host_allocator->Initialize(m_create_info.host_allocator);
+    if (!vkex_result) {
+      return vkex_result;
+    }
+  }
+  p_allocator = GetAllocationCallbacks(p_allocator);
+
   // Check Vulkan API version number - VKEX requires at least Vulkan 1.1
   {
     uint32_t api_version = m_create_info.physical_device->GetApiVersion();
@@ -484,6 +508,12 @@ vkex::Result CDevice::InternalCreate(
     m_create_info.enabled_features.occlusionQueryPrecise    = VK_TRUE;
     m_create_info.enabled_features.pipelineStatisticsQuery  = VK_TRUE;
     m_create_info.enabled_features.samplerAnisotropy        = VK_TRUE;
+
+    // Optional, compute shaders that access storage images without a
+    // format qualifier need these
+    const VkPhysicalDeviceFeatures& supported = m_create_info.physical_device->GetPhysicalDeviceFeatures().features;
+    m_create_info.enabled_features.shaderStorageImageReadWithoutFormat  = supported.shaderStorageImageReadWithoutFormat;
+    m_create_info.enabled_features.shaderStorageImageWriteWithoutFormat = supported.shaderStorageImageWriteWithoutFormat;
   }
 
   // Create info
@@ -588,6 +618,7 @@ vkex::Result CDevice::InternalCreate(
     VmaAllocatorCreateInfo vma_allocator_create_info = {};
     vma_allocator_create_info.physicalDevice = *m_create_info.physical_device;
     vma_allocator_create_info.device = m_vk_object;
+    vma_allocator_create_info.pAllocationCallbacks = p_allocator;
 
     VkResult vk_result = InvalidValue<VkResult>::Value;
     VKEX_VULKAN_RESULT_CALL(
@@ -624,10 +655,24 @@ vkex::Result CDevice::InternalCreate(
 
 vkex::Result CDevice::DestroyAllStoredObjects(const VkAllocationCallbacks* p_allocator)
 { 
+  // Retired objects are destroyed through their Destroy function
+  {
+    vkex::Result vkex_result = DestroyAllRetired();
+    if (!vkex_result) {
+      return vkex_result;
+    }
+  }
+
+  // Upload managers own buffers, command pools and fences so they go first
+  VKEX_DESTROY_ALL_OBJECTS(vkex::UploadManager, m_stored_upload_managers, p_allocator);
+
   // Destroy VKEX objects
   VKEX_DESTROY_ALL_OBJECTS(vkex::ShaderProgram, m_stored_shader_programs, p_allocator);
   VKEX_DESTROY_ALL_OBJECTS(vkex::Texture, m_stored_textures, p_allocator);
 
+  // Swapchains destroy their depth images so they go before images
+  VKEX_DESTROY_ALL_OBJECTS(vkex::Swapchain, m_stored_swapchains, p_allocator);
+
   // Destroy Vulkan objects
   VKEX_DESTROY_ALL_OBJECTS(vkex::Buffer, m_stored_buffers, p_allocator);
   VKEX_DESTROY_ALL_OBJECTS(vkex::CommandPool, m_stored_command_pools, p_allocator);
@@ -647,7 +692,6 @@ vkex::Result CDevice::DestroyAllStoredObjects(const VkAllocationCallbacks* p_all
   VKEX_DESTROY_ALL_OBJECTS(vkex::Sampler, m_stored_samplers, p_allocator);
   VKEX_DESTROY_ALL_OBJECTS(vkex::Semaphore, m_stored_semaphores, p_allocator);
   VKEX_DESTROY_ALL_OBJECTS(vkex::ShaderModule, m_stored_shader_modules, p_allocator);
-  VKEX_DESTROY_ALL_OBJECTS(vkex::Swapchain, m_stored_swapchains, p_allocator);
 
   return vkex::Result::Success;
 }
@@ -656,6 +700,8 @@ vkex::Result CDevice::DestroyAllStoredObjects(const VkAllocationCallbacks* p_all
 
 vkex::Result CDevice::InternalDestroy(const VkAllocationCallbacks* p_allocator)
 {
+  p_allocator = GetAllocationCallbacks(p_allocator);
+
   // Wait for device idle
   {
     VkResult vk_result = InvalidValue<VkResult>::Value;
@@ -699,7 +745,7 @@ vkex::Result CDevice::GetQueue(
 {
   auto it = FindIf(
     m_stored_queues,
-    [queue_type, queue_family_index, queue_index](const std::unique_ptr<CQueue>& elem) -> bool {
+    [queue_type, queue_family_index, queue_index](const vkex::ObjectStorage<CQueue>::Pointer& elem) -> bool {
         // There should never be a null IQueue object
         VKEX_ASSERT_MSG(elem, "Null IQueue object encountered!");
         auto& elem_supported_queue_flags = elem->GetSupportedQueueFlags();
@@ -731,6 +777,331 @@ VkResult CDevice::WaitIdle()
   return VK_SUCCESS;
 }
 
+static vkex::MemoryBlockStats ToMemoryBlockStats(const VmaStatInfo& info)
+{
+  vkex::MemoryBlockStats stats = {};
+  stats.block_count        = info.blockCount;
+  stats.allocation_count   = info.allocationCount;
+  stats.unused_range_count = info.unusedRangeCount;
+  stats.used_bytes         = info.usedBytes;
+  stats.unused_bytes       = info.unusedBytes;
+  if ((info.unusedBytes > 0) && (info.unusedRangeCount > 0)) {
+    stats.fragmentation = 1.0f - (static_cast<float>(info.unusedRangeSizeMax) / static_cast<float>(info.unusedBytes));
+  }
+  return stats;
+}
+
+vkex::Result CDevice::GetMemoryStats(vkex::MemoryStats* p_stats) const
+{
+  VKEX_ASSERT(p_stats != nullptr);
+
+  *p_stats = vkex::MemoryStats();
+
+  VmaStats vma_stats = {};
+  vmaCalculateStats(m_vma_allocator, &vma_stats);
+
+  const VkPhysicalDeviceMemoryProperties& memory_properties = GetPhysicalDevice()->GetPhysicalDeviceMemoryProperties();
+
+  // Budget
+  VkDeviceSize heap_usage[VK_MAX_MEMORY_HEAPS]  = {};
+  VkDeviceSize heap_budget[VK_MAX_MEMORY_HEAPS] = {};
+#if defined(VK_EXT_memory_budget)
+  if (m_memory_budget_enabled) {
+    VkPhysicalDeviceMemoryBudgetPropertiesEXT budget_properties = { VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT };
+    VkPhysicalDeviceMemoryProperties2 properties_2 = { VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2 };
+    properties_2.pNext = &budget_properties;
+    vkex::GetPhysicalDeviceMemoryProperties2(GetPhysicalDevice()->GetVkObject(), &properties_2);
+
+    for (uint32_t i = 0; i < memory_properties.memoryHeapCount; ++i) {
+      heap_usage[i]  = budget_properties.heapUsage[i];
+      heap_budget[i] = budget_properties.heapBudget[i];
+    }
+    p_stats->budget_supported = true;
+  }
+#endif
+  if (!p_stats->budget_supported) {
+    for (uint32_t i = 0; i < memory_properties.memoryHeapCount; ++i) {
+      const VmaStatInfo& info = vma_stats.memoryHeap[i];
+      heap_usage[i]  = info.usedBytes + info.unusedBytes;
+      heap_budget[i] = (memory_properties.memoryHeaps[i].size * 8) / 10;
+    }
+  }
+
+  // Heaps and types
+  for (uint32_t i = 0; i < memory_properties.memoryHeapCount; ++i) {
+    vkex::MemoryHeapStats heap = {};
+    heap.size   = memory_properties.memoryHeaps[i].size;
+    heap.flags  = memory_properties.memoryHeaps[i].flags;
+    heap.usage  = heap_usage[i];
+    heap.budget = heap_budget[i];
+    heap.blocks = ToMemoryBlockStats(vma_stats.memoryHeap[i]);
+    p_stats->heaps.push_back(heap);
+  }
+  for (uint32_t i = 0; i < memory_properties.memoryTypeCount; ++i) {
+    vkex::MemoryTypeStats type = {};
+    type.heap_index     = memory_properties.memoryTypes[i].heapIndex;
+    type.property_flags = memory_properties.memoryTypes[i].propertyFlags;
+    type.blocks         = ToMemoryBlockStats(vma_stats.memoryType[i]);
+    p_stats->types.push_back(type);
+  }
+  p_stats->total = ToMemoryBlockStats(vma_stats.total);
+
+  // Objects
+  m_stored_buffers.ForEach([p_stats](const CBuffer* buffer) {
+    if (buffer->IsMemoryAllocated()) {
+      p_stats->buffers.count += 1;
+      p_stats->buffers.size  += buffer->m_vma_allocation_info.size;
+    }
+  });
+  m_stored_images.ForEach([p_stats](const CImage* image) {
+    if (image->IsMemoryAllocated()) {
+      vkex::MemoryObjectStats& objects = (image->GetMemoryPool() != VK_NULL_HANDLE) ? p_stats->pool_images : p_stats->images;
+      objects.count += 1;
+      objects.size  += image->m_vma_allocation_info.size;
+    }
+  });
+
+  return vkex::Result::Success;
+}
+
+vkex::Result CDevice::DefragmentBuffers(
+  vkex::Queue                   queue,
+  VkDeviceSize                  budget_bytes,
+  uint32_t                      budget_moves,
+  vkex::DefragmentationStats*   p_stats)
+{
+  VKEX_ASSERT(queue != nullptr);
+
+  if (p_stats != nullptr) {
+    *p_stats = vkex::DefragmentationStats();
+  }
+
+  // Buffers VMA can move without anyone holding on to their memory
+  std::vector<vkex::Buffer>  buffers;
+  std::vector<VmaAllocation> allocations;
+  m_stored_buffers.ForEach([&buffers, &allocations](CBuffer* buffer) {
+    bool movable = buffer->IsMemoryAllocated() &&
+                   !buffer->IsMemoryMapped() &&
+                   (buffer->GetMemoryPool() == VK_NULL_HANDLE);
+    if (movable) {
+      buffers.push_back(buffer);
+      allocations.push_back(buffer->m_vma_allocation);
+    }
+  });
+  if (allocations.empty()) {
+    return vkex::Result::Success;
+  }
+
+  // Nothing may be using the buffers while they move
+  {
+    VkResult vk_result = InvalidValue<VkResult>::Value;
+    VKEX_VULKAN_RESULT_CALL(vk_result, WaitIdle());
+    if (vk_result != VK_SUCCESS) {
+      return vkex::Result(vk_result);
+    }
+  }
+
+  const VkDeviceSize max_bytes = (budget_bytes > 0) ? budget_bytes : VK_WHOLE_SIZE;
+  const uint32_t     max_moves = (budget_moves > 0) ? budget_moves : UINT32_MAX;
+
+  std::vector<VkBool32> allocations_changed(allocations.size(), VK_FALSE);
+  VmaDefragmentationInfo2 defragmentation_info = {};
+  defragmentation_info.allocationCount          = CountU32(allocations);
+  defragmentation_info.pAllocations             = allocations.data();
+  defragmentation_info.pAllocationsChanged      = allocations_changed.data();
+  defragmentation_info.maxCpuBytesToMove        = max_bytes;
+  defragmentation_info.maxCpuAllocationsToMove  = max_moves;
+  defragmentation_info.maxGpuBytesToMove        = max_bytes;
+  defragmentation_info.maxGpuAllocationsToMove  = max_moves;
+
+  VmaDefragmentationStats   vma_stats = {};
+  VmaDefragmentationContext context   = VK_NULL_HANDLE;
+  VkResult                  begin_result = VK_SUCCESS;
+
+  // Copies are recorded by VMA into the batch's command buffer
+  {
+    vkex::TransferBatch batch;
+    batch.Record([&](vkex::CommandBuffer cmd) {
+      VkMemoryBarrier barrier = { VK_STRUCTURE_TYPE_MEMORY_BARRIER };
+      barrier.srcAccessMask = VK_ACCESS_MEMORY_WRITE_BIT;
+      barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+      cmd->CmdPipelineBarrier(VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+      defragmentation_info.commandBuffer = cmd->GetVkObject();
+      begin_result = vmaDefragmentationBegin(m_vma_allocator, &defragmentation_info, &vma_stats, &context);
+
+      barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+      barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+      cmd->CmdPipelineBarrier(VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+    });
+
+    vkex::TransferToken token;
+    vkex::Result vkex_result = batch.Submit(queue, &token);
+    if (!vkex_result) {
+      return vkex_result;
+    }
+    vkex_result = token.Wait();
+    if (!vkex_result) {
+      return vkex_result;
+    }
+  }
+
+  // VK_NOT_READY means there were GPU moves, which have now completed
+  if ((begin_result != VK_SUCCESS) && (begin_result != VK_NOT_READY)) {
+    return vkex::Result(begin_result);
+  }
+  if (context != VK_NULL_HANDLE) {
+    VkResult vk_result = vmaDefragmentationEnd(m_vma_allocator, context);
+    if (vk_result != VK_SUCCESS) {
+      return vkex::Result(vk_result);
+    }
+  }
+
+  // Recreate the moved buffers on their new memory
+  std::vector<vkex::Buffer> moved_buffers;
+  for (size_t i = 0; i < buffers.size(); ++i) {
+    if (allocations_changed[i] != VK_TRUE) {
+      continue;
+    }
+    VkResult vk_result = buffers[i]->Rebind();
+    if (vk_result != VK_SUCCESS) {
+      return vkex::Result(vk_result);
+    }
+    moved_buffers.push_back(buffers[i]);
+  }
+
+  // Point descriptors at the new Vulkan buffers
+  uint32_t descriptor_sets_updated = 0;
+  if (!moved_buffers.empty()) {
+    m_stored_descriptor_pools.ForEach([&moved_buffers, &descriptor_sets_updated](CDescriptorPool* pool) {
+      pool->m_stored_descriptor_sets.ForEach([&moved_buffers, &descriptor_sets_updated](CDescriptorSet* descriptor_set) {
+        if (descriptor_set->RefreshBufferDescriptors(moved_buffers)) {
+          ++descriptor_sets_updated;
+        }
+      });
+    });
+  }
+
+  if (p_stats != nullptr) {
+    p_stats->bytes_moved             = vma_stats.bytesMoved;
+    p_stats->bytes_freed             = vma_stats.bytesFreed;
+    p_stats->allocations_moved       = vma_stats.allocationsMoved;
+    p_stats->memory_blocks_freed     = vma_stats.deviceMemoryBlocksFreed;
+    p_stats->descriptor_sets_updated = descriptor_sets_updated;
+  }
+
+  return vkex::Result::Success;
+}
+
+static void WriteJson(std::ostream& os, const vkex::MemoryBlockStats& stats)
+{
+  os << "{ "
+     << "\"block_count\": " << stats.block_count << ", "
+     << "\"allocation_count\": " << stats.allocation_count << ", "
+     << "\"unused_range_count\": " << stats.unused_range_count << ", "
+     << "\"used_bytes\": " << stats.used_bytes << ", "
+     << "\"unused_bytes\": " << stats.unused_bytes << ", "
+     << "\"fragmentation\": " << stats.fragmentation
+     << " }";
+}
+
+static void WriteJson(std::ostream& os, const vkex::MemoryObjectStats& stats)
+{
+  os << "{ \"count\": " << stats.count << ", \"size\": " << stats.size << " }";
+}
+
+std::string ToJson(const vkex::MemoryStats& stats)
+{
+  std::stringstream ss;
+  ss << "{\n";
+  ss << "  \"budget_supported\": " << (stats.budget_supported ? "true" : "false") << ",\n";
+
+  ss << "  \"heaps\": [\n";
+  for (size_t i = 0; i < stats.heaps.size(); ++i) {
+    const vkex::MemoryHeapStats& heap = stats.heaps[i];
+    ss << "    { "
+       << "\"size\": " << heap.size << ", "
+       << "\"device_local\": " << ((heap.flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) ? "true" : "false") << ", "
+       << "\"usage\": " << heap.usage << ", "
+       << "\"budget\": " << heap.budget << ", "
+       << "\"blocks\": ";
+    WriteJson(ss, heap.blocks);
+    ss << " }" << (((i + 1) < stats.heaps.size()) ? "," : "") << "\n";
+  }
+  ss << "  ],\n";
+
+  ss << "  \"types\": [\n";
+  for (size_t i = 0; i < stats.types.size(); ++i) {
+    const vkex::MemoryTypeStats& type = stats.types[i];
+    ss << "    { "
+       << "\"heap_index\": " << type.heap_index << ", "
+       << "\"property_flags\": " << type.property_flags << ", "
+       << "\"blocks\": ";
+    WriteJson(ss, type.blocks);
+    ss << " }" << (((i + 1) < stats.types.size()) ? "," : "") << "\n";
+  }
+  ss << "  ],\n";
+
+  ss << "  \"total\": ";
+  WriteJson(ss, stats.total);
+  ss << ",\n";
+
+  ss << "  \"objects\": {\n";
+  ss << "    \"buffers\": ";
+  WriteJson(ss, stats.buffers);
+  ss << ",\n";
+  ss << "    \"images\": ";
+  WriteJson(ss, stats.images);
+  ss << ",\n";
+  ss << "    \"pool_images\": ";
+  WriteJson(ss, stats.pool_images);
+  ss << "\n";
+  ss << "  }\n";
+  ss << "}\n";
+
+  return ss.str();
+}
+
+vkex::Result CDevice::GetUploadManager(
+  vkex::Queue           queue,
+  vkex::UploadManager*  p_upload_manager
+)
+{
+  VKEX_ASSERT(queue != nullptr);
+  if (queue == nullptr) {
+    return vkex::Result::ErrorUnexpectedNullPointer;
+  }
+
+  std::lock_guard<std::mutex> lock(m_upload_manager_mutex);
+
+  auto it = FindIf(
+    m_stored_upload_managers,
+    [queue](const vkex::ObjectStorage<CUploadManager>::Pointer& elem) -> bool {
+      return elem->GetQueue() == queue; });
+  if (it != std::end(m_stored_upload_managers)) {
+    *p_upload_manager = it->get();
+    return vkex::Result::Success;
+  }
+
+  vkex::UploadManagerCreateInfo create_info = {};
+  create_info.queue         = queue;
+  create_info.staging_size  = 64 * 1024 * 1024;
+  create_info.batch_count   = 4;
+  vkex::Result vkex_result = CreateObject<CUploadManager>(
+    create_info,
+    nullptr,
+    m_stored_upload_managers,
+    &CUploadManager::SetDevice,
+    this,
+    p_upload_manager);
+
+  if (!vkex_result) {
+    return vkex_result;
+  }
+
+  return vkex::Result::Success;
+}
+
 vkex::Result CDevice::CreateBuffer(
   const vkex::BufferCreateInfo& create_info,
   vkex::Buffer*                 p_object,
@@ -739,7 +1110,7 @@ vkex::Result CDevice::CreateBuffer(
 {
   vkex::Result vkex_result = CreateObject<CBuffer>(
     create_info,
-    p_allocator,
+    GetAllocationCallbacks(p_allocator),
     m_stored_buffers,
     &CBuffer::SetDevice,
     this,
@@ -760,7 +1131,7 @@ vkex::Result CDevice::DestroyBuffer(
   vkex::Result vkex_result = DestroyObject<CBuffer>(
     m_stored_buffers,
     object,
-    p_allocator);
+    GetAllocationCallbacks(p_allocator));
 
   if (!vkex_result) {
     return vkex_result;
@@ -777,7 +1148,7 @@ vkex::Result CDevice::CreateCommandPool(
 {
   vkex::Result vkex_result = CreateObject<CCommandPool>(
     create_info,
-    p_allocator,
+    GetAllocationCallbacks(p_allocator),
     m_stored_command_pools,
     &CCommandPool::SetDevice,
     this,
@@ -798,7 +1169,7 @@ vkex::Result CDevice::DestroyCommandPool(
   vkex::Result vkex_result = DestroyObject<CCommandPool>(
     m_stored_command_pools,
     object,
-    p_allocator);
+    GetAllocationCallbacks(p_allocator));
 
   if (!vkex_result) {
     return vkex_result;
@@ -815,7 +1186,7 @@ vkex::Result CDevice::CreateComputePipeline(
 {
   vkex::Result vkex_result = CreateObject<CComputePipeline>(
     create_info,
-    p_allocator,
+    GetAllocationCallbacks(p_allocator),
     m_stored_compute_pipelines,
     &CComputePipeline::SetDevice,
     this,
@@ -836,7 +1207,7 @@ vkex::Result CDevice::DestroyComputePipeline(
   vkex::Result vkex_result = DestroyObject<CComputePipeline>(
     m_stored_compute_pipelines,
     object,
-    p_allocator);
+    GetAllocationCallbacks(p_allocator));
 
   if (!vkex_result) {
     return vkex_result;
@@ -857,7 +1228,7 @@ vkex::Result CDevice::CreateConstantBuffer(
 
   vkex::Result vkex_result = CreateObject<CBuffer>(
     use_create_info,
-    p_allocator,
+    GetAllocationCallbacks(p_allocator),
     m_stored_buffers,
     &CBuffer::SetDevice,
     this,
@@ -878,7 +1249,7 @@ vkex::Result CDevice::DestroyConstantBuffer(
   vkex::Result vkex_result = DestroyObject<CBuffer>(
     m_stored_buffers,
     object,
-    p_allocator);
+    GetAllocationCallbacks(p_allocator));
 
   if (!vkex_result) {
     return vkex_result;
@@ -895,7 +1266,7 @@ vkex::Result CDevice::CreateDepthStencilView(
 {
   vkex::Result vkex_result = CreateObject<CDepthStencilView>(
     create_info,
-    p_allocator,
+    GetAllocationCallbacks(p_allocator),
     m_stored_depth_stencil_views,
     &CDepthStencilView::SetDevice,
     this,
@@ -916,7 +1287,7 @@ vkex::Result CDevice::DestroyDepthStencilView(
   vkex::Result vkex_result = DestroyObject<CDepthStencilView>(
     m_stored_depth_stencil_views,
     object,
-    p_allocator);
+    GetAllocationCallbacks(p_allocator));
 
   if (!vkex_result) {
     return vkex_result;
@@ -933,7 +1304,7 @@ vkex::Result CDevice::CreateDescriptorSetLayout(
 {
   vkex::Result vkex_result = CreateObject<CDescriptorSetLayout>(
     create_info,
-    p_allocator,
+    GetAllocationCallbacks(p_allocator),
     m_stored_descriptor_set_layouts,
     &CDescriptorSetLayout::SetDevice,
     this,
@@ -954,7 +1325,7 @@ vkex::Result CDevice::DestroyDescriptorSetLayout(
   vkex::Result vkex_result = DestroyObject<CDescriptorSetLayout>(
     m_stored_descriptor_set_layouts,
     object,
-    p_allocator);
+    GetAllocationCallbacks(p_allocator));
 
   if (!vkex_result) {
     return vkex_result;
@@ -1025,7 +1396,7 @@ vkex::Result CDevice::CreateDescriptorPool(
 {
   vkex::Result vkex_result = CreateObject<CDescriptorPool>(
     create_info,
-    p_allocator,
+    GetAllocationCallbacks(p_allocator),
     m_stored_descriptor_pools,
     &CDescriptorPool::SetDevice,
     this,
@@ -1046,7 +1417,7 @@ vkex::Result CDevice::DestroyDescriptorPool(
   vkex::Result vkex_result = DestroyObject<CDescriptorPool>(
     m_stored_descriptor_pools,
     object,
-    p_allocator);
+    GetAllocationCallbacks(p_allocator));
 
   if (!vkex_result) {
     return vkex_result;
@@ -1063,7 +1434,7 @@ vkex::Result CDevice::CreateFence(
 {
   vkex::Result vkex_result = CreateObject<CFence>(
     create_info,
-    p_allocator,
+    GetAllocationCallbacks(p_allocator),
     m_stored_fences,
     &CFence::SetDevice,
     this,
@@ -1084,7 +1455,7 @@ vkex::Result CDevice::DestroyFence(
   vkex::Result vkex_result = DestroyObject<CFence>(
     m_stored_fences,
     object,
-    p_allocator);
+    GetAllocationCallbacks(p_allocator));
 
   if (!vkex_result) {
     return vkex_result;
@@ -1101,7 +1472,7 @@ vkex::Result CDevice::CreateGraphicsPipeline(
 {
   vkex::Result vkex_result = CreateObject<CGraphicsPipeline>(
     create_info,
-    p_allocator,
+    GetAllocationCallbacks(p_allocator),
     m_stored_graphics_pipelines,
     &CGraphicsPipeline::SetDevice,
     this,
@@ -1123,7 +1494,7 @@ vkex::Result CDevice::DestroyGraphicsPipeline(
   vkex::Result vkex_result = DestroyObject<CGraphicsPipeline>(
     m_stored_graphics_pipelines,
     object,
-    p_allocator);
+    GetAllocationCallbacks(p_allocator));
 
   if (!vkex_result) {
     return vkex_result;
@@ -1140,7 +1511,7 @@ vkex::Result CDevice::CreateImage(
 {
   vkex::Result vkex_result = CreateObject<CImage>(
     create_info,
-    p_allocator,
+    GetAllocationCallbacks(p_allocator),
     m_stored_images,
     &CImage::SetDevice,
     this,
@@ -1162,7 +1533,7 @@ vkex::Result CDevice::DestroyImage(
   vkex::Result vkex_result = DestroyObject<CImage>(
     m_stored_images,
     object,
-    p_allocator);
+    GetAllocationCallbacks(p_allocator));
 
   if (!vkex_result) {
     return vkex_result;
@@ -1179,7 +1550,7 @@ vkex::Result CDevice::CreateImageView(
 {
   vkex::Result vkex_result = CreateObject<CImageView>(
     create_info,
-    p_allocator,
+    GetAllocationCallbacks(p_allocator),
     m_stored_image_views,
     &CImageView::SetDevice,
     this,
@@ -1201,7 +1572,7 @@ vkex::Result CDevice::DestroyImageView(
   vkex::Result vkex_result = DestroyObject<CImageView>(
     m_stored_image_views,
     object,
-    p_allocator);
+    GetAllocationCallbacks(p_allocator));
 
   if (!vkex_result) {
     return vkex_result;
@@ -1222,7 +1593,7 @@ vkex::Result CDevice::CreateIndexBuffer(
 
   vkex::Result vkex_result = CreateObject<CBuffer>(
     use_create_info,
-    p_allocator,
+    GetAllocationCallbacks(p_allocator),
     m_stored_buffers,
     &CBuffer::SetDevice,
     this,
@@ -1243,7 +1614,7 @@ vkex::Result CDevice::DestroyIndexBuffer(
   vkex::Result vkex_result = DestroyObject<CBuffer>(
     m_stored_buffers,
     object,
-    p_allocator);
+    GetAllocationCallbacks(p_allocator));
 
   if (!vkex_result) {
     return vkex_result;
@@ -1264,7 +1635,7 @@ vkex::Result CDevice::CreateIndirectBuffer(
 
   vkex::Result vkex_result = CreateObject<CBuffer>(
     use_create_info,
-    p_allocator,
+    GetAllocationCallbacks(p_allocator),
     m_stored_buffers,
     &CBuffer::SetDevice,
     this,
@@ -1285,7 +1656,7 @@ vkex::Result CDevice::DestroyIndirectBuffer(
   vkex::Result vkex_result = DestroyObject<CBuffer>(
     m_stored_buffers,
     object,
-    p_allocator);
+    GetAllocationCallbacks(p_allocator));
 
   if (!vkex_result) {
     return vkex_result;
@@ -1302,7 +1673,7 @@ vkex::Result CDevice::CreatePipelineCache(
 {
   vkex::Result vkex_result = CreateObject<CPipelineCache>(
     create_info,
-    p_allocator,
+    GetAllocationCallbacks(p_allocator),
     m_stored_pipeline_caches,
     &CPipelineCache::SetDevice,
     this,
@@ -1323,7 +1694,7 @@ vkex::Result CDevice::DestroyPipelineCache(
   vkex::Result vkex_result = DestroyObject<CPipelineCache>(
     m_stored_pipeline_caches,
     object,
-    p_allocator);
+    GetAllocationCallbacks(p_allocator));
 
   if (!vkex_result) {
     return vkex_result;
@@ -1340,7 +1711,7 @@ vkex::Result CDevice::CreatePipelineLayout(
 {
   vkex::Result vkex_result = CreateObject<CPipelineLayout>(
     create_info,
-    p_allocator,
+    GetAllocationCallbacks(p_allocator),
     m_stored_pipeline_layouts,
     &CPipelineLayout::SetDevice,
     this,
@@ -1361,7 +1732,7 @@ vkex::Result CDevice::DestroyPipelineLayout(
   vkex::Result vkex_result = DestroyObject<CPipelineLayout>(
     m_stored_pipeline_layouts,
     object,
-    p_allocator);
+    GetAllocationCallbacks(p_allocator));
 
   if (!vkex_result) {
     return vkex_result;
@@ -1378,7 +1749,7 @@ vkex::Result CDevice::CreateQueryPool(
 {
   vkex::Result vkex_result = CreateObject<CQueryPool>(
     create_info,
-    p_allocator,
+    GetAllocationCallbacks(p_allocator),
     m_stored_query_pools,
     &CQueryPool::SetDevice,
     this,
@@ -1399,7 +1770,7 @@ vkex::Result CDevice::DestroyQueryPool(
   vkex::Result vkex_result = DestroyObject<CQueryPool>(
     m_stored_query_pools,
     object,
-    p_allocator);
+    GetAllocationCallbacks(p_allocator));
 
   if (!vkex_result) {
     return vkex_result;
@@ -1416,7 +1787,7 @@ vkex::Result CDevice::CreateRenderPass(
 {
   vkex::Result vkex_result = CreateObject<CRenderPass>(
     create_info,
-    p_allocator,
+    GetAllocationCallbacks(p_allocator),
     m_stored_render_passes,
     &CRenderPass::SetDevice,
     this,
@@ -1437,7 +1808,7 @@ vkex::Result CDevice::DestroyRenderPass(
   vkex::Result vkex_result = DestroyObject<CRenderPass>(
     m_stored_render_passes,
     object,
-    p_allocator);
+    GetAllocationCallbacks(p_allocator));
 
   if (!vkex_result) {
     return vkex_result;
@@ -1454,7 +1825,7 @@ vkex::Result CDevice::CreateRenderTargetView(
 {
   vkex::Result vkex_result = CreateObject<CRenderTargetView>(
     create_info,
-    p_allocator,
+    GetAllocationCallbacks(p_allocator),
     m_stored_render_target_views,
     &CRenderTargetView::SetDevice,
     this,
@@ -1475,7 +1846,7 @@ vkex::Result CDevice::DestroyRenderTargetView(
   vkex::Result vkex_result = DestroyObject<CRenderTargetView>(
     m_stored_render_target_views,
     object,
-    p_allocator);
+    GetAllocationCallbacks(p_allocator));
 
   if (!vkex_result) {
     return vkex_result;
@@ -1492,7 +1863,7 @@ vkex::Result CDevice::CreateSampler(
 {
   vkex::Result vkex_result = CreateObject<CSampler>(
     create_info,
-    p_allocator,
+    GetAllocationCallbacks(p_allocator),
     m_stored_samplers,
     &CSampler::SetDevice,
     this,
@@ -1513,7 +1884,7 @@ vkex::Result CDevice::DestroySampler(
   vkex::Result vkex_result = DestroyObject<CSampler>(
     m_stored_samplers,
     object,
-    p_allocator);
+    GetAllocationCallbacks(p_allocator));
 
   if (!vkex_result) {
     return vkex_result;
@@ -1530,7 +1901,7 @@ vkex::Result CDevice::CreateSemaphore(
 {
   vkex::Result vkex_result = CreateObject<CSemaphore>(
     create_info,
-    p_allocator,
+    GetAllocationCallbacks(p_allocator),
     m_stored_semaphores,
     &CSemaphore::SetDevice,
     this,
@@ -1551,7 +1922,7 @@ vkex::Result CDevice::DestroySemaphore(
   vkex::Result vkex_result = DestroyObject<CSemaphore>(
     m_stored_semaphores,
     object,
-    p_allocator);
+    GetAllocationCallbacks(p_allocator));
 
   if (!vkex_result) {
     return vkex_result;
@@ -1568,7 +1939,7 @@ vkex::Result CDevice::CreateShaderModule(
 {
   vkex::Result vkex_result = CreateObject<CShaderModule>(
     create_info,
-    p_allocator,
+    GetAllocationCallbacks(p_allocator),
     m_stored_shader_modules,
     &CShaderModule::SetDevice,
     this,
@@ -1589,7 +1960,7 @@ vkex::Result CDevice::DestroyShaderModule(
   vkex::Result vkex_result = DestroyObject<CShaderModule>(
     m_stored_shader_modules,
     object,
-    p_allocator);
+    GetAllocationCallbacks(p_allocator));
 
   if (!vkex_result) {
     return vkex_result;
@@ -1606,7 +1977,7 @@ vkex::Result CDevice::CreateShaderProgram(
 {
   vkex::Result vkex_result = CreateObject<CShaderProgram>(
     create_info,
-    p_allocator,
+    GetAllocationCallbacks(p_allocator),
     m_stored_shader_programs,
     &CShaderProgram::SetDevice,
     this,
@@ -1627,7 +1998,7 @@ vkex::Result CDevice::DestroyShaderProgram(
   vkex::Result vkex_result = DestroyObject<CShaderProgram>(
     m_stored_shader_programs,
     object,
-    p_allocator);
+    GetAllocationCallbacks(p_allocator));
 
   if (!vkex_result) {
     return vkex_result;
@@ -1648,7 +2019,7 @@ vkex::Result CDevice::CreateStorageBuffer(
 
   vkex::Result vkex_result = CreateObject<CBuffer>(
     use_create_info,
-    p_allocator,
+    GetAllocationCallbacks(p_allocator),
     m_stored_buffers,
     &CBuffer::SetDevice,
     this,
@@ -1669,7 +2040,7 @@ vkex::Result CDevice::DestroyStorageBuffer(
   vkex::Result vkex_result = DestroyObject<CBuffer>(
     m_stored_buffers,
     object,
-    p_allocator);
+    GetAllocationCallbacks(p_allocator));
 
   if (!vkex_result) {
     return vkex_result;
@@ -1686,7 +2057,7 @@ vkex::Result CDevice::CreateSwapchain(
 {
   vkex::Result vkex_result = CreateObject<CSwapchain>(
     create_info,
-    p_allocator,
+    GetAllocationCallbacks(p_allocator),
     m_stored_swapchains,
     &CSwapchain::SetDevice,
     this,
@@ -1707,7 +2078,7 @@ vkex::Result CDevice::DestroySwapchain(
   vkex::Result vkex_result = DestroyObject<CSwapchain>(
     m_stored_swapchains,
     object,
-    p_allocator);
+    GetAllocationCallbacks(p_allocator));
 
   if (!vkex_result) {
     return vkex_result;
@@ -1724,7 +2095,7 @@ vkex::Result CDevice::CreateTexture(
 {
   vkex::Result vkex_result = CreateObject<CTexture>(
     create_info,
-    p_allocator,
+    GetAllocationCallbacks(p_allocator),
     m_stored_textures,
     &CTexture::SetDevice,
     this,
@@ -1745,7 +2116,7 @@ vkex::Result CDevice::DestroyTexture(
   vkex::Result vkex_result = DestroyObject<CTexture>(
     m_stored_textures,
     object,
-    p_allocator);
+    GetAllocationCallbacks(p_allocator));
 
   if (!vkex_result) {
     return vkex_result;
@@ -1766,7 +2137,7 @@ vkex::Result CDevice::CreateVertexBuffer(
 
   vkex::Result vkex_result = CreateObject<CBuffer>(
     use_create_info,
-    p_allocator,
+    GetAllocationCallbacks(p_allocator),
     m_stored_buffers,
     &CBuffer::SetDevice,
     this,
@@ -1787,7 +2158,7 @@ vkex::Result CDevice::DestroyVertexBuffer(
   vkex::Result vkex_result = DestroyObject<CBuffer>(
     m_stored_buffers,
     object,
-    p_allocator);
+    GetAllocationCallbacks(p_allocator));
 
   if (!vkex_result) {
     return vkex_result;
@@ -1796,4 +2167,78 @@ vkex::Result CDevice::DestroyVertexBuffer(
   return vkex::Result::Success;
 }
 
+void CDevice::SetRetireValue(uint64_t value)
+{
+  VKEX_ASSERT(value >= m_retire_value.load());
+  m_retire_value = value;
+}
+
+void CDevice::Retire(std::function<vkex::Result()> destroy_fn)
+{
+  std::lock_guard<std::mutex> lock(m_retired_objects_mutex);
+  // Read under the lock so values stay ordered across threads
+  RetiredObject retired = {};
+  retired.value      = m_retire_value.load();
+  retired.destroy_fn = std::move(destroy_fn);
+  m_retired_objects.push_back(std::move(retired));
+}
+
+#define VKEX_DESTROY_DEFERRED(OBJ_TYPE, DESTROY_FN)                      \
+  void CDevice::DestroyDeferred(OBJ_TYPE object)                        \
+  {                                                                     \
+    if (object == nullptr) {                                            \
+      return;                                                           \
+    }                                                                   \
+    Retire([this, object]() -> vkex::Result {                           \
+      return DESTROY_FN(object); });                                    \
+  }
+
+VKEX_DESTROY_DEFERRED(vkex::Buffer, DestroyBuffer)
+VKEX_DESTROY_DEFERRED(vkex::ComputePipeline, DestroyComputePipeline)
+VKEX_DESTROY_DEFERRED(vkex::DepthStencilView, DestroyDepthStencilView)
+VKEX_DESTROY_DEFERRED(vkex::DescriptorPool, DestroyDescriptorPool)
+VKEX_DESTROY_DEFERRED(vkex::GraphicsPipeline, DestroyGraphicsPipeline)
+VKEX_DESTROY_DEFERRED(vkex::Image, DestroyImage)
+VKEX_DESTROY_DEFERRED(vkex::ImageView, DestroyImageView)
+VKEX_DESTROY_DEFERRED(vkex::RenderPass, DestroyRenderPass)
+VKEX_DESTROY_DEFERRED(vkex::RenderTargetView, DestroyRenderTargetView)
+VKEX_DESTROY_DEFERRED(vkex::Sampler, DestroySampler)
+VKEX_DESTROY_DEFERRED(vkex::Texture, DestroyTexture)
+
+#undef VKEX_DESTROY_DEFERRED
+
+vkex::Result CDevice::DestroyRetired(uint64_t completed_value)
+{
+  // Destroyed outside the lock, destroy functions can retire more objects
+  while (true) {
+    std::function<vkex::Result()> destroy_fn;
+    {
+      std::lock_guard<std::mutex> lock(m_retired_objects_mutex);
+      if (m_retired_objects.empty() || (m_retired_objects.front().value > completed_value)) {
+        break;
+      }
+      destroy_fn = std::move(m_retired_objects.front().destroy_fn);
+      m_retired_objects.pop_front();
+    }
+
+    vkex::Result vkex_result = destroy_fn();
+    if (!vkex_result) {
+      return vkex_result;
+    }
+  }
+
+  return vkex::Result::Success;
+}
+
+vkex::Result CDevice::DestroyAllRetired()
+{
+  return DestroyRetired(UINT64_MAX);
+}
+
+uint32_t CDevice::GetRetiredCount() const
+{
+  std::lock_guard<std::mutex> lock(m_retired_objects_mutex);
+  return static_cast<uint32_t>(m_retired_objects.size());
+}
+
 } // namespace vkex
\ No newline at end of file
@@ -20,6 +20,7 @@
 #include "vkex/Buffer.h"
 #include "vkex/Command.h"
 #include "vkex/Descriptor.h"
+#include "vkex/HostAllocator.h"
 #include "vkex/Image.h"
 #include "vkex/Pipeline.h"
 #include "vkex/QueryPool.h"
@@ -31,8 +32,12 @@
 #include "vkex/Sync.h"
 #include "vkex/Texture.h"
 #include "vkex/Traits.h"
+#include "vkex/UploadManager.h"
 #include "vkex/View.h"
 
+#include <deque>
+#include <functional>
+
 namespace vkex {
   
 // =================================================================================================
@@ -167,6 +172,11 @@ public:
     return m_vk_physical_device_memory_properties.memoryProperties;
   }
   
+  /** @fn GetFormatProperties
+   *
+   */
+  VkFormatProperties GetFormatProperties(VkFormat format) const;
+
   /** @fn SupportsPresent
    *
    */
@@ -239,9 +249,108 @@ struct DeviceCreateInfo {
   std::vector<std::string>              extensions;
   VkPhysicalDeviceFeatures              enabled_features;
   bool                                  safe_values;
+  HostAllocatorCreateInfo               host_allocator;
+};
+
+/** @struct MemoryBlockStats
+ *
+ * Totals over VMA's device memory blocks. fragmentation is 0 when all of
+ * the unused space is one range and approaches 1 as it's split into many
+ * small ones.
+ *
+ */
+struct MemoryBlockStats {
+  uint32_t                      block_count;
+  uint32_t                      allocation_count;
+  uint32_t                      unused_range_count;
+  VkDeviceSize                  used_bytes;
+  VkDeviceSize                  unused_bytes;
+  float                         fragmentation;
+};
+
+/** @struct MemoryHeapStats
+ *
+ */
+struct MemoryHeapStats {
+  VkDeviceSize                  size;
+  VkMemoryHeapFlags             flags;
+  // Process usage and budget from VK_EXT_memory_budget if it's enabled,
+  // otherwise VMA's block bytes and 80% of the heap size
+  VkDeviceSize                  usage;
+  VkDeviceSize                  budget;
+  MemoryBlockStats              blocks;
+};
+
+/** @struct MemoryTypeStats
+ *
+ */
+struct MemoryTypeStats {
+  uint32_t                      heap_index;
+  VkMemoryPropertyFlags         property_flags;
+  MemoryBlockStats              blocks;
+};
+
+/** @struct MemoryObjectStats
+ *
+ */
+struct MemoryObjectStats {
+  uint32_t                      count;
+  VkDeviceSize                  size;
+};
+
+/** @struct MemoryStats
+ *
+ */
+struct MemoryStats {
+  bool                          budget_supported;
+  std::vector<MemoryHeapStats>  heaps;
+  std::vector<MemoryTypeStats>  types;
+  MemoryBlockStats              total;
+  // Allocation sizes by object type. pool_images are images allocated from
+  // custom VMA pools, which is where Application puts swapchain images.
+  MemoryObjectStats             buffers;
+  MemoryObjectStats             images;
+  MemoryObjectStats             pool_images;
+};
+
+/** @fn ToJson
+ *
+ */
+std::string ToJson(const vkex::MemoryStats& stats);
+
+/** @struct DefragmentationStats
+ *
+ */
+struct DefragmentationStats {
+  VkDeviceSize                  bytes_moved;
+  VkDeviceSize                  bytes_freed;
+  uint32_t                      allocations_moved;
+  uint32_t                      memory_blocks_freed;
+  uint32_t                      descriptor_sets_updated;
 };
 
 /** @class IDevice
+ *
+ * Create* and Destroy* can be called from any thread. Each object type has
+ * its own sharded ObjectStorage and the Vulkan create and destroy calls
+ * run outside of its locks, so threads loading different resources don't
+ * serialize on the device. VMA is internally synchronized.
+ *
+ * What the Vulkan spec still requires the caller to synchronize:
+ *   - An object must not be destroyed while another thread uses or
+ *     destroys it.
+ *   - Command pools: allocating, freeing and resetting command buffers and
+ *     recording into any of the pool's command buffers. Use one pool per
+ *     thread.
+ *   - Descriptor pools: allocating, freeing and resetting descriptor sets.
+ *     Updating a descriptor set requires the set itself.
+ *   - Queues: submits, presents and waits. An UploadManager serializes its
+ *     own submits but not against other submits to the same queue.
+ *   - Fences and events being reset or set, swapchains while acquiring,
+ *     pipeline caches being merged into.
+ *
+ * DefragmentBuffers() and destroying the device must not run while other
+ * threads create or destroy objects.
  *
  */ 
 class CDevice
@@ -308,6 +417,56 @@ public:
     return m_vma_allocator;
   }
 
+  /** @fn GetHostAllocator
+   *
+   * nullptr unless DeviceCreateInfo::host_allocator.enable was set.
+   *
+   */
+  vkex::HostAllocator* GetHostAllocator() const {
+    return m_host_allocator.get();
+  }
+
+  /** @fn IsMemoryBudgetEnabled
+   *
+   */
+  bool IsMemoryBudgetEnabled() const {
+    return m_memory_budget_enabled;
+  }
+
+  /** @fn GetMemoryStats
+   *
+   * Walks every VMA block and every stored buffer and image, so it's meant
+   * for debug panels and reports rather than per frame decisions. Must not
+   * race with creating or destroying buffers and images.
+   *
+   */
+  vkex::Result GetMemoryStats(vkex::MemoryStats* p_stats) const;
+
+  /** @fn DefragmentBuffers
+   *
+   * Moves at most budget_bytes in at most budget_moves buffer allocations
+   * to compact VMA's memory blocks, 0 means no limit. Call it every so
+   * often with a small budget to defragment incrementally.
+   *
+   * Device local moves are copies recorded and submitted on queue, host
+   * visible ones are memmoves. Moved buffers keep their vkex::Buffer but
+   * get a new VkBuffer, descriptors written with UpdateDescriptor() are
+   * rewritten. Command buffers recorded before the call must not be
+   * submitted again.
+   *
+   * Waits for the device to go idle and for the copies to complete.
+   * Mapped buffers and buffers in custom pools are never moved. Images
+   * aren't either, so blocks that also hold images may stay fragmented:
+   * VMA can't relocate optimally tiled images and vkex doesn't track
+   * image layouts to copy them itself.
+   *
+   */
+  vkex::Result DefragmentBuffers(
+    vkex::Queue                   queue,
+    VkDeviceSize                  budget_bytes,
+    uint32_t                      budget_moves,
+    vkex::DefragmentationStats*   p_stats = nullptr);
+
   /** @fn GetQueue
    * 
    */
@@ -323,6 +482,17 @@ public:
    */
   VkResult WaitIdle();
 
+  /** @fn GetUploadManager
+   *
+   * Returns the upload manager for queue, it's created on first use and
+   * destroyed with the device.
+   *
+   */
+  vkex::Result GetUploadManager(
+    vkex::Queue           queue,
+    vkex::UploadManager*  p_upload_manager
+  );
+
   /** @fn CreateBuffer
    *
    */
@@ -799,6 +969,108 @@ public:
     const VkAllocationCallbacks*  p_allocator = nullptr
   );
 
+  /** @fn SetRetireValue
+   *
+   * Value that objects passed to DestroyDeferred() are tagged with, it
+   * must never decrease. Application sets it to the frame number at the
+   * start of every frame.
+   *
+   */
+  void SetRetireValue(uint64_t value);
+
+  /** @fn GetRetireValue
+   *
+   */
+  uint64_t GetRetireValue() const {
+    return m_retire_value.load();
+  }
+
+  /** @fn DestroyDeferred
+   *
+   * Destroys object once DestroyRetired() is called with a completed value
+   * greater or equal to the current retire value, i.e. once the GPU has
+   * finished the frame the object was retired in, so nothing has to wait
+   * for the device to go idle. The handle must not be used or destroyed
+   * again after this call. Work submitted outside of the frame, uploads
+   * for instance, has to be complete before the object is retired.
+   *
+   * Thread safe.
+   *
+   */
+  void DestroyDeferred(vkex::Buffer object);
+
+  /** @fn DestroyDeferred
+   *
+   */
+  void DestroyDeferred(vkex::ComputePipeline object);
+
+  /** @fn DestroyDeferred
+   *
+   */
+  void DestroyDeferred(vkex::DepthStencilView object);
+
+  /** @fn DestroyDeferred
+   *
+   */
+  void DestroyDeferred(vkex::DescriptorPool object);
+
+  /** @fn DestroyDeferred
+   *
+   */
+  void DestroyDeferred(vkex::GraphicsPipeline object);
+
+  /** @fn DestroyDeferred
+   *
+   */
+  void DestroyDeferred(vkex::Image object);
+
+  /** @fn DestroyDeferred
+   *
+   */
+  void DestroyDeferred(vkex::ImageView object);
+
+  /** @fn DestroyDeferred
+   *
+   */
+  void DestroyDeferred(vkex::RenderPass object);
+
+  /** @fn DestroyDeferred
+   *
+   */
+  void DestroyDeferred(vkex::RenderTargetView object);
+
+  /** @fn DestroyDeferred
+   *
+   */
+  void DestroyDeferred(vkex::Sampler object);
+
+  /** @fn DestroyDeferred
+   *
+   */
+  void DestroyDeferred(vkex::Texture object);
+
+  /** @fn DestroyRetired
+   *
+   * Destroys the objects retired with a value less than or equal to
+   * completed_value, the GPU must be done with that value's work.
+   *
+   */
+  vkex::Result DestroyRetired(uint64_t completed_value);
+
+  /** @fn DestroyAllRetired
+   *
+   * Destroys every retired object, the device must be idle.
+   *
+   */
+  vkex::Result DestroyAllRetired();
+
+  /** @fn GetRetiredCount
+   *
+   * Number of objects waiting to be destroyed.
+   *
+   */
+  uint32_t GetRetiredCount() const;
+
 private:
   friend class CInstance;
   friend class IObjectStorageFunctions;
@@ -818,6 +1090,15 @@ private:
    */
   vkex::Result InitializeQueues();
 
+  /** @fn GetAllocationCallbacks
+   *
+   * p_allocator, or the host allocator's callbacks if it's nullptr.
+   *
+   */
+  const VkAllocationCallbacks* GetAllocationCallbacks(const VkAllocationCallbacks* p_allocator) const {
+    return ((p_allocator == nullptr) && m_host_allocator) ? m_host_allocator->GetAllocationCallbacks() : p_allocator;
+  }
+
   /** @fn InternalCreate
    *
    */
@@ -836,6 +1117,11 @@ private:
    */
   vkex::Result InternalDestroy(const VkAllocationCallbacks* p_allocator);
 
+  /** @fn Retire
+   *
+   */
+  void Retire(std::function<vkex::Result()> destroy_fn);
+
   /** @fn SetInstance
    *
    */
@@ -852,30 +1138,44 @@ private:
   VkDeviceCreateInfo                    m_vk_create_info = {};
   VkDevice                              m_vk_object = VK_NULL_HANDLE;
   VmaAllocator                          m_vma_allocator = VK_NULL_HANDLE;
-
-  std::vector<std::unique_ptr<CBuffer>>               m_stored_buffers;
-  std::vector<std::unique_ptr<CCommandPool>>          m_stored_command_pools;
-  std::vector<std::unique_ptr<CComputePipeline>>      m_stored_compute_pipelines;
-  std::vector<std::unique_ptr<CDepthStencilView>>     m_stored_depth_stencil_views;
-  std::vector<std::unique_ptr<CDescriptorPool>>       m_stored_descriptor_pools;
-  std::vector<std::unique_ptr<CDescriptorSetLayout>>  m_stored_descriptor_set_layouts;
-  std::vector<std::unique_ptr<CEvent>>                m_stored_events;
-  std::vector<std::unique_ptr<CFence>>                m_stored_fences;
-  std::vector<std::unique_ptr<CGraphicsPipeline>>     m_stored_graphics_pipelines;
-  std::vector<std::unique_ptr<CImage>>                m_stored_images;
-  std::vector<std::unique_ptr<CImageView>>            m_stored_image_views;
-  std::vector<std::unique_ptr<CPipelineCache>>        m_stored_pipeline_caches;
-  std::vector<std::unique_ptr<CPipelineLayout>>       m_stored_pipeline_layouts;
-  std::vector<std::unique_ptr<CQueryPool>>            m_stored_query_pools;
-  std::vector<std::unique_ptr<CQueue>>                m_stored_queues;
-  std::vector<std::unique_ptr<CRenderPass>>           m_stored_render_passes;
-  std::vector<std::unique_ptr<CRenderTargetView>>     m_stored_render_target_views;
-  std::vector<std::unique_ptr<CSampler>>              m_stored_samplers;
-  std::vector<std::unique_ptr<CSemaphore>>            m_stored_semaphores;
-  std::vector<std::unique_ptr<CShaderModule>>         m_stored_shader_modules;
-  std::vector<std::unique_ptr<CShaderProgram>>        m_stored_shader_programs;
-  std::vector<std::unique_ptr<CSwapchain>>            m_stored_swapchains;
-  std::vector<std::unique_ptr<CTexture>>              m_stored_textures;
+  bool                                  m_memory_budget_enabled = false;
+  std::unique_ptr<vkex::HostAllocator>  m_host_allocator;
+
+  vkex::ObjectStorage<CBuffer>                        m_stored_buffers;
+  vkex::ObjectStorage<CCommandPool>                   m_stored_command_pools;
+  vkex::ObjectStorage<CComputePipeline>               m_stored_compute_pipelines;
+  vkex::ObjectStorage<CDepthStencilView>              m_stored_depth_stencil_views;
+  vkex::ObjectStorage<CDescriptorPool>                m_stored_descriptor_pools;
+  vkex::ObjectStorage<CDescriptorSetLayout>           m_stored_descriptor_set_layouts;
+  vkex::ObjectStorage<CEvent>                         m_stored_events;
+  vkex::ObjectStorage<CFence>                         m_stored_fences;
+  vkex::ObjectStorage<CGraphicsPipeline>              m_stored_graphics_pipelines;
+  vkex::ObjectStorage<CImage>                         m_stored_images;
+  vkex::ObjectStorage<CImageView>                     m_stored_image_views;
+  vkex::ObjectStorage<CPipelineCache>                 m_stored_pipeline_caches;
+  vkex::ObjectStorage<CPipelineLayout>                m_stored_pipeline_layouts;
+  vkex::ObjectStorage<CQueryPool>                     m_stored_query_pools;
+  vkex::ObjectStorage<CQueue>                         m_stored_queues;
+  vkex::ObjectStorage<CRenderPass>                    m_stored_render_passes;
+  vkex::ObjectStorage<CRenderTargetView>              m_stored_render_target_views;
+  vkex::ObjectStorage<CSampler>                       m_stored_samplers;
+  vkex::ObjectStorage<CSemaphore>                     m_stored_semaphores;
+  vkex::ObjectStorage<CShaderModule>                  m_stored_shader_modules;
+  vkex::ObjectStorage<CShaderProgram>                 m_stored_shader_programs;
+  vkex::ObjectStorage<CSwapchain>                     m_stored_swapchains;
+  vkex::ObjectStorage<CTexture>                       m_stored_textures;
+  vkex::ObjectStorage<CUploadManager>                 m_stored_upload_managers;
+  std::mutex                                          m_upload_manager_mutex;
+
+  struct RetiredObject {
+    uint64_t                        value;
+    std::function<vkex::Result()>   destroy_fn;
+  };
+
+  std::atomic<uint64_t>                               m_retire_value{0};
+  // Ordered by value
+  std::deque<RetiredObject>                           m_retired_objects;
+  mutable std::mutex                                  m_retired_objects_mutex;
 };
 
 } // namespace vkex
@@ -61,6 +61,7 @@ class CShaderProgram;
 class CSurface;
 class CSwapchain;
 class CTexture;
+class CUploadManager;
 
 struct DescriptorSetLayoutCreateInfo;
 
@@ -100,6 +101,7 @@ using ShaderProgram = typename std::add_pointer<CShaderProgram>::type;
 using Surface = typename std::add_pointer<CSurface>::type;
 using Swapchain = typename std::add_pointer<CSwapchain>::type;
 using Texture = typename std::add_pointer<CTexture>::type;
+using UploadManager = typename std::add_pointer<CUploadManager>::type;
 
 } // namespace vkex
 
@@ -0,0 +1,341 @@
+/*
+ Copyright 2018-2019 Google Inc.
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+ http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+*/
+
+#include <vkex/HostAllocator.h>
+#include <vkex/Log.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+namespace vkex {
+
+const size_t kDefaultHostArenaBlockSize = 64 * 1024;
+const size_t kDefaultHostArenaMaxSize   = 4 * 1024 * 1024;
+
+// Sits immediately in front of every allocation
+struct HostAllocator::Header {
+  void*     p_base;
+  size_t    size;
+  uint32_t  scope;
+  uint32_t  arena;
+};
+
+static uintptr_t AlignUp(uintptr_t value, size_t alignment)
+{
+  return (value + alignment - 1) & ~static_cast<uintptr_t>(alignment - 1);
+}
+
+// =================================================================================================
+// HostAllocator
+// =================================================================================================
+HostAllocator::~HostAllocator()
+{
+  for (uint32_t i = 0; i < kHostAllocationScopeCount; ++i) {
+    uint64_t live_count = m_scopes[i].live_count.load();
+    if (live_count > 0) {
+      VKEX_LOG_WARN("HostAllocator destroyed with " << live_count << " " << GetScopeName(i) << " allocations outstanding");
+    }
+  }
+}
+
+vkex::Result HostAllocator::Initialize(const vkex::HostAllocatorCreateInfo& create_info)
+{
+  m_create_info = create_info;
+  if (m_create_info.arena_block_size == 0) {
+    m_create_info.arena_block_size = kDefaultHostArenaBlockSize;
+  }
+  if (m_create_info.arena_max_size == 0) {
+    m_create_info.arena_max_size = kDefaultHostArenaMaxSize;
+  }
+  m_create_info.arena_max_size = std::max(m_create_info.arena_max_size, m_create_info.arena_block_size);
+
+  m_callbacks.pUserData             = this;
+  m_callbacks.pfnAllocation         = &HostAllocator::AllocationFunction;
+  m_callbacks.pfnReallocation       = &HostAllocator::ReallocationFunction;
+  m_callbacks.pfnFree               = &HostAllocator::FreeFunction;
+  m_callbacks.pfnInternalAllocation = &HostAllocator::InternalAllocationNotification;
+  m_callbacks.pfnInternalFree       = &HostAllocator::InternalFreeNotification;
+
+  return vkex::Result::Success;
+}
+
+void HostAllocator::AddAllocation(VkSystemAllocationScope scope, size_t size)
+{
+  VKEX_ASSERT(static_cast<uint32_t>(scope) < kHostAllocationScopeCount);
+  ScopeCounters& counters = m_scopes[scope];
+  counters.allocation_count.fetch_add(1, std::memory_order_relaxed);
+  counters.allocated_bytes.fetch_add(size, std::memory_order_relaxed);
+  counters.live_count.fetch_add(1, std::memory_order_relaxed);
+
+  uint64_t live_bytes = counters.live_bytes.fetch_add(size, std::memory_order_relaxed) + size;
+  uint64_t peak_bytes = counters.peak_bytes.load(std::memory_order_relaxed);
+  while ((live_bytes > peak_bytes) && !counters.peak_bytes.compare_exchange_weak(peak_bytes, live_bytes, std::memory_order_relaxed)) {
+  }
+}
+
+void HostAllocator::RemoveAllocation(VkSystemAllocationScope scope, size_t size)
+{
+  VKEX_ASSERT(static_cast<uint32_t>(scope) < kHostAllocationScopeCount);
+  ScopeCounters& counters = m_scopes[scope];
+  counters.live_count.fetch_sub(1, std::memory_order_relaxed);
+  counters.live_bytes.fetch_sub(size, std::memory_order_relaxed);
+}
+
+void* HostAllocator::AllocateFromArena(size_t size, size_t alignment)
+{
+  std::lock_guard<std::mutex> lock(m_arena_mutex);
+
+  // Only committed once the allocation fits, so a fallback doesn't skip
+  // the space left in the current block
+  const size_t required    = size + sizeof(Header) + alignment - 1;
+  size_t       block_index = m_arena_block_index;
+  size_t       offset      = m_arena_offset;
+  while (true) {
+    if (block_index >= m_arena_blocks.size()) {
+      // The chain only grows while commands stay outstanding, past the
+      // cap they go to the heap until the arena can be rewound
+      size_t block_size = std::max(m_create_info.arena_block_size, required);
+      if ((m_arena_capacity + block_size) > m_create_info.arena_max_size) {
+        ++m_arena_fallback_count;
+        return nullptr;
+      }
+
+      ArenaBlock block;
+      block.size = block_size;
+      block.data.reset(new (std::nothrow) uint8_t[block.size]);
+      if (!block.data) {
+        ++m_arena_fallback_count;
+        return nullptr;
+      }
+      m_arena_capacity += block.size;
+      m_arena_blocks.push_back(std::move(block));
+    }
+
+    ArenaBlock& block = m_arena_blocks[block_index];
+    uintptr_t   begin = reinterpret_cast<uintptr_t>(block.data.get());
+    uintptr_t   p     = AlignUp(begin + offset + sizeof(Header), alignment);
+    if ((p + size) <= (begin + block.size)) {
+      size_t end = static_cast<size_t>((p + size) - begin);
+      m_arena_block_index = block_index;
+      m_arena_used_size  += end - offset;
+      m_arena_offset      = end;
+      ++m_arena_live_count;
+      return reinterpret_cast<void*>(p);
+    }
+
+    ++block_index;
+    offset = 0;
+  }
+}
+
+void HostAllocator::FreeToArena()
+{
+  std::lock_guard<std::mutex> lock(m_arena_mutex);
+
+  VKEX_ASSERT(m_arena_live_count > 0);
+  --m_arena_live_count;
+  if (m_arena_live_count > 0) {
+    return;
+  }
+
+  // Nothing outstanding, rewind. If that took more than one block the
+  // next round gets a single block that fits everything it used, which
+  // stays under the cap since the blocks did.
+  if (m_arena_blocks.size() > 1) {
+    m_arena_blocks.clear();
+    m_arena_capacity = 0;
+
+    ArenaBlock block;
+    block.size = std::max(m_create_info.arena_block_size, m_arena_used_size);
+    block.data.reset(new (std::nothrow) uint8_t[block.size]);
+    if (block.data) {
+      m_arena_capacity = block.size;
+      m_arena_blocks.push_back(std::move(block));
+    }
+  }
+  m_arena_block_index = 0;
+  m_arena_offset      = 0;
+  m_arena_used_size   = 0;
+}
+
+void* HostAllocator::Allocate(size_t size, size_t alignment, VkSystemAllocationScope scope)
+{
+  if (size == 0) {
+    return nullptr;
+  }
+
+  VKEX_ASSERT((alignment > 0) && ((alignment & (alignment - 1)) == 0));
+  alignment = std::max(alignment, alignof(Header));
+
+  bool  arena    = m_create_info.command_arena && (scope == VK_SYSTEM_ALLOCATION_SCOPE_COMMAND);
+  void* p_base   = nullptr;
+  void* p_memory = nullptr;
+  if (arena) {
+    p_memory = AllocateFromArena(size, alignment);
+    // Full, the heap takes it instead
+    arena = (p_memory != nullptr);
+  }
+  if (!arena) {
+    p_base = std::malloc(size + sizeof(Header) + alignment - 1);
+    if (p_base != nullptr) {
+      p_memory = reinterpret_cast<void*>(AlignUp(reinterpret_cast<uintptr_t>(p_base) + sizeof(Header), alignment));
+    }
+  }
+  if (p_memory == nullptr) {
+    return nullptr;
+  }
+
+  Header* p_header = reinterpret_cast<Header*>(p_memory) - 1;
+  p_header->p_base = p_base;
+  p_header->size   = size;
+  p_header->scope  = static_cast<uint32_t>(scope);
+  p_header->arena  = arena ? 1 : 0;
+
+  AddAllocation(scope, size);
+
+  return p_memory;
+}
+
+void* HostAllocator::Reallocate(void* p_original, size_t size, size_t alignment, VkSystemAllocationScope scope)
+{
+  if (p_original == nullptr) {
+    return Allocate(size, alignment, scope);
+  }
+
+  if (size == 0) {
+    Free(p_original);
+    return nullptr;
+  }
+
+  // On failure the original allocation is left alone
+  void* p_memory = Allocate(size, alignment, scope);
+  if (p_memory == nullptr) {
+    return nullptr;
+  }
+
+  const Header* p_header = reinterpret_cast<const Header*>(p_original) - 1;
+  std::memcpy(p_memory, p_original, std::min(size, p_header->size));
+  Free(p_original);
+
+  return p_memory;
+}
+
+void HostAllocator::Free(void* p_memory)
+{
+  if (p_memory == nullptr) {
+    return;
+  }
+
+  const Header* p_header = reinterpret_cast<const Header*>(p_memory) - 1;
+  RemoveAllocation(static_cast<VkSystemAllocationScope>(p_header->scope), p_header->size);
+
+  if (p_header->arena) {
+    FreeToArena();
+  }
+  else {
+    std::free(p_header->p_base);
+  }
+}
+
+void HostAllocator::GetStats(vkex::HostMemoryStats* p_stats) const
+{
+  VKEX_ASSERT(p_stats != nullptr);
+
+  for (uint32_t i = 0; i < kHostAllocationScopeCount; ++i) {
+    const ScopeCounters& counters = m_scopes[i];
+    HostScopeStats&      stats    = p_stats->scopes[i];
+    stats.allocation_count = counters.allocation_count.load(std::memory_order_relaxed);
+    stats.allocated_bytes  = counters.allocated_bytes.load(std::memory_order_relaxed);
+    stats.live_count       = counters.live_count.load(std::memory_order_relaxed);
+    stats.live_bytes       = counters.live_bytes.load(std::memory_order_relaxed);
+    stats.peak_bytes       = counters.peak_bytes.load(std::memory_order_relaxed);
+    stats.internal_bytes   = counters.internal_bytes.load(std::memory_order_relaxed);
+  }
+
+  std::lock_guard<std::mutex> lock(m_arena_mutex);
+  p_stats->arena_capacity       = m_arena_capacity;
+  p_stats->arena_fallback_count = m_arena_fallback_count;
+}
+
+const char* HostAllocator::GetScopeName(uint32_t scope)
+{
+  switch (scope) {
+    default: break;
+    case VK_SYSTEM_ALLOCATION_SCOPE_COMMAND  : return "Command";
+    case VK_SYSTEM_ALLOCATION_SCOPE_OBJECT   : return "Object";
+    case VK_SYSTEM_ALLOCATION_SCOPE_CACHE    : return "Cache";
+    case VK_SYSTEM_ALLOCATION_SCOPE_DEVICE   : return "Device";
+    case VK_SYSTEM_ALLOCATION_SCOPE_INSTANCE : return "Instance";
+  }
+  return "Unknown";
+}
+
+VKAPI_ATTR void* VKAPI_CALL HostAllocator::AllocationFunction(
+  void*                   p_user_data,
+  size_t                  size,
+  size_t                  alignment,
+  VkSystemAllocationScope scope
+)
+{
+  return static_cast<HostAllocator*>(p_user_data)->Allocate(size, alignment, scope);
+}
+
+VKAPI_ATTR void* VKAPI_CALL HostAllocator::ReallocationFunction(
+  void*                   p_user_data,
+  void*                   p_original,
+  size_t                  size,
+  size_t                  alignment,
+  VkSystemAllocationScope scope
+)
+{
+  return static_cast<HostAllocator*>(p_user_data)->Reallocate(p_original, size, alignment, scope);
+}
+
+VKAPI_ATTR void VKAPI_CALL HostAllocator::FreeFunction(
+  void* p_user_data,
+  void* p_memory
+)
+{
+  static_cast<HostAllocator*>(p_user_data)->Free(p_memory);
+}
+
+VKAPI_ATTR void VKAPI_CALL HostAllocator::InternalAllocationNotification(
+  void*                     p_user_data,
+  size_t                    size,
+  VkInternalAllocationType  type,
+  VkSystemAllocationScope   scope
+)
+{
+  HostAllocator* p_allocator = static_cast<HostAllocator*>(p_user_data);
+  VKEX_ASSERT(static_cast<uint32_t>(scope) < kHostAllocationScopeCount);
+  p_allocator->m_scopes[scope].internal_bytes.fetch_add(size, std::memory_order_relaxed);
+}
+
+VKAPI_ATTR void VKAPI_CALL HostAllocator::InternalFreeNotification(
+  void*                     p_user_data,
+  size_t                    size,
+  VkInternalAllocationType  type,
+  VkSystemAllocationScope   scope
+)
+{
+  HostAllocator* p_allocator = static_cast<HostAllocator*>(p_user_data);
+  VKEX_ASSERT(static_cast<uint32_t>(scope) < kHostAllocationScopeCount);
+  p_allocator->m_scopes[scope].internal_bytes.fetch_sub(size, std::memory_order_relaxed);
+}
+
+} // namespace vkex
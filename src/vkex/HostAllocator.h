@@ -0,0 +1,177 @@
+/*
+ Copyright 2018-2019 Google Inc.
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+ http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+*/
+
+#ifndef __VKEX_HOST_ALLOCATOR_H__
+#define __VKEX_HOST_ALLOCATOR_H__
+
+#include "vkex/Config.h"
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+
+namespace vkex {
+
+// =================================================================================================
+// HostAllocator
+// =================================================================================================
+
+// VK_SYSTEM_ALLOCATION_SCOPE_COMMAND through VK_SYSTEM_ALLOCATION_SCOPE_INSTANCE
+const uint32_t kHostAllocationScopeCount = 5;
+
+/** @struct HostAllocatorCreateInfo
+ *
+ */
+struct HostAllocatorCreateInfo {
+  // Passes a HostAllocator's callbacks to Vulkan wherever nullptr was
+  // given for p_allocator.
+  // Default: false
+  bool    enable;
+  // Serves VK_SYSTEM_ALLOCATION_SCOPE_COMMAND allocations from a linear
+  // arena that is rewound whenever none of them are outstanding.
+  // Default: false
+  bool    command_arena;
+  // Default: 0 (64 KiB)
+  size_t  arena_block_size;
+  // Most bytes the arena's blocks may add up to. Allocations that don't
+  // fit come from malloc until the arena is rewound.
+  // Default: 0 (4 MiB)
+  size_t  arena_max_size;
+};
+
+/** @struct HostScopeStats
+ *
+ * allocation_count and allocated_bytes only ever grow, the difference
+ * between two GetStats() calls is the allocation traffic in between.
+ * Reallocations count as an allocation of the new size.
+ *
+ */
+struct HostScopeStats {
+  uint64_t  allocation_count;
+  uint64_t  allocated_bytes;
+  uint64_t  live_count;
+  uint64_t  live_bytes;
+  uint64_t  peak_bytes;
+  // Reported by the driver through pfnInternalAllocation
+  uint64_t  internal_bytes;
+};
+
+/** @struct HostMemoryStats
+ *
+ * scopes is indexed by VkSystemAllocationScope.
+ *
+ */
+struct HostMemoryStats {
+  HostScopeStats  scopes[kHostAllocationScopeCount];
+  // Bytes reserved by the command arena
+  uint64_t        arena_capacity;
+  // Command allocations that came from malloc because the arena was full,
+  // only ever grows
+  uint64_t        arena_fallback_count;
+};
+
+/** @class HostAllocator
+ *
+ * VkAllocationCallbacks that count what the driver allocates on the host
+ * per VkSystemAllocationScope. Allocations come from malloc with a small
+ * header in front that records their size and scope for the free.
+ *
+ * All callbacks are thread safe. The allocator must outlive every object
+ * created with its callbacks.
+ *
+ */
+class HostAllocator {
+public:
+  HostAllocator() {}
+  ~HostAllocator();
+
+  HostAllocator(const HostAllocator&) = delete;
+  HostAllocator& operator=(const HostAllocator&) = delete;
+
+  /** @fn Initialize
+   *
+   */
+  vkex::Result Initialize(const vkex::HostAllocatorCreateInfo& create_info);
+
+  /** @fn GetAllocationCallbacks
+   *
+   */
+  const VkAllocationCallbacks* GetAllocationCallbacks() const {
+    return &m_callbacks;
+  }
+
+  /** @fn GetStats
+   *
+   */
+  void GetStats(vkex::HostMemoryStats* p_stats) const;
+
+  /** @fn GetScopeName
+   *
+   */
+  static const char* GetScopeName(uint32_t scope);
+
+private:
+  struct Header;
+
+  struct ScopeCounters {
+    std::atomic<uint64_t> allocation_count{0};
+    std::atomic<uint64_t> allocated_bytes{0};
+    std::atomic<uint64_t> live_count{0};
+    std::atomic<uint64_t> live_bytes{0};
+    std::atomic<uint64_t> peak_bytes{0};
+    std::atomic<uint64_t> internal_bytes{0};
+  };
+
+  struct ArenaBlock {
+    std::unique_ptr<uint8_t[]>  data;
+    size_t                      size = 0;
+  };
+
+  void*   Allocate(size_t size, size_t alignment, VkSystemAllocationScope scope);
+  void*   Reallocate(void* p_original, size_t size, size_t alignment, VkSystemAllocationScope scope);
+  void    Free(void* p_memory);
+  void*   AllocateFromArena(size_t size, size_t alignment);
+  void    FreeToArena();
+  void    AddAllocation(VkSystemAllocationScope scope, size_t size);
+  void    RemoveAllocation(VkSystemAllocationScope scope, size_t size);
+
+  static VKAPI_ATTR void* VKAPI_CALL AllocationFunction(void* p_user_data, size_t size, size_t alignment, VkSystemAllocationScope scope);
+  static VKAPI_ATTR void* VKAPI_CALL ReallocationFunction(void* p_user_data, void* p_original, size_t size, size_t alignment, VkSystemAllocationScope scope);
+  static VKAPI_ATTR void VKAPI_CALL FreeFunction(void* p_user_data, void* p_memory);
+  static VKAPI_ATTR void VKAPI_CALL InternalAllocationNotification(void* p_user_data, size_t size, VkInternalAllocationType type, VkSystemAllocationScope scope);
+  static VKAPI_ATTR void VKAPI_CALL InternalFreeNotification(void* p_user_data, size_t size, VkInternalAllocationType type, VkSystemAllocationScope scope);
+
+private:
+  vkex::HostAllocatorCreateInfo m_create_info = {};
+  VkAllocationCallbacks         m_callbacks   = {};
+  ScopeCounters                 m_scopes[kHostAllocationScopeCount];
+
+  // Command arena, blocks are merged into one when the arena is rewound
+  mutable std::mutex            m_arena_mutex;
+  std::vector<ArenaBlock>       m_arena_blocks;
+  size_t                        m_arena_block_index     = 0;
+  size_t                        m_arena_offset          = 0;
+  // Sum of the blocks' sizes, at most arena_max_size
+  size_t                        m_arena_capacity        = 0;
+  // Bytes taken since the last rewind, padding included
+  size_t                        m_arena_used_size       = 0;
+  uint64_t                      m_arena_live_count      = 0;
+  uint64_t                      m_arena_fallback_count  = 0;
+};
+
+} // namespace vkex
+
+#endif // __VKEX_HOST_ALLOCATOR_H__
@@ -514,6 +514,16 @@ vkex::Result CInstance::InternalCreate(
   // Copy create info
   m_create_info = create_info;
 
+  // Host allocator, used wherever the caller doesn't pass callbacks
+  if (m_create_info.host_allocator.enable) {
+    m_host_allocator = std::make_unique<vkex::HostAllocator>();
+    vkex::Result vkex_result = m_host_allocator->Initialize(m_create_info.host_allocator);
+    if (!vkex_result) {
+      return vkex_result;
+    }
+  }
+  p_allocator = GetAllocationCallbacks(p_allocator);
+
   // Initialize loader
   vkex::VkexLoaderInitialize(vkex::LOAD_MODE_SO_DIRECT);
 
@@ -733,7 +743,7 @@ vkex::Result CInstance::InternalCreate(
 
 vkex::Result CInstance::InternalDestroy(const VkAllocationCallbacks* p_allocator)
 {
-  // Destroy all devices
+  // Destroy all devices, each resolves its own allocator
   for (auto& device : m_stored_devices) {
     vkex::Result vkex_result = device->InternalDestroy(p_allocator);
     if (!vkex_result) {
@@ -741,6 +751,8 @@ vkex::Result CInstance::InternalDestroy(const VkAllocationCallbacks* p_allocator
     }  
   }
 
+  p_allocator = GetAllocationCallbacks(p_allocator);
+
   // Destroy DebugUtils
   if (m_vk_messenger != VK_NULL_HANDLE) {
     vkex::DestroyDebugUtilsMessengerEXT(
@@ -894,7 +906,7 @@ vkex::Result CInstance::CreateSurface(
 {
   vkex::Result vkex_result = CreateObject<CSurface>(
     create_info,
-    p_allocator,
+    GetAllocationCallbacks(p_allocator),
     m_stored_surfaces,
     &CSurface::SetInstance,
     this,
@@ -915,7 +927,7 @@ vkex::Result CInstance::DestroySurface(
   vkex::Result vkex_result = DestroyObject<CSurface>(
     m_stored_surfaces,
     object,
-    p_allocator);
+    GetAllocationCallbacks(p_allocator));
 
   if (!vkex_result) {
     return vkex_result;
@@ -91,6 +91,7 @@ struct InstanceCreateInfo {
   std::vector<std::string>              extensions;
   DebugUtils                            debug_utils;
   bool                                  enable_swapchain;
+  HostAllocatorCreateInfo               host_allocator;
 };
 
 /** @class Instance
@@ -164,6 +165,16 @@ public:
     return m_create_info.enable_swapchain;
   }
 
+  /** @fn GetHostAllocator
+   *
+   * nullptr unless InstanceCreateInfo::host_allocator.enable was set.
+   * Devices have their own, see DeviceCreateInfo::host_allocator.
+   *
+   */
+  vkex::HostAllocator* GetHostAllocator() const {
+    return m_host_allocator.get();
+  }
+
   /** @fn CreateDevice
    *
    */
@@ -245,6 +256,15 @@ private:
    */
   vkex::Result InitializePhysicalDevices();
 
+  /** @fn GetAllocationCallbacks
+   *
+   * p_allocator, or the host allocator's callbacks if it's nullptr.
+   *
+   */
+  const VkAllocationCallbacks* GetAllocationCallbacks(const VkAllocationCallbacks* p_allocator) const {
+    return ((p_allocator == nullptr) && m_host_allocator) ? m_host_allocator->GetAllocationCallbacks() : p_allocator;
+  }
+
   /** @fn InternalCreate
    *
    */
@@ -279,6 +299,7 @@ private:
   VkInstance                            m_vk_object = VK_NULL_HANDLE;
   VkDebugUtilsMessengerEXT              m_vk_messenger = VK_NULL_HANDLE;
   bool                                  m_validation_layers_loaded = false;
+  std::unique_ptr<vkex::HostAllocator>  m_host_allocator;
 
   std::vector<std::unique_ptr<CPhysicalDevice>> m_stored_physical_devices;
   std::vector<std::unique_ptr<CDevice>>         m_stored_devices;
@@ -0,0 +1,277 @@
+/*
+ Copyright 2018-2019 Google Inc.
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+ http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+*/
+
+#include "vkex/LZCodec.h"
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+namespace vkex {
+
+enum {
+  kMinMatch      = 4,
+  kMaxOffset     = 65535,
+  kHashBits      = 14,
+  kHashSize      = 1 << kHashBits,
+  // Matches aren't started this close to the end of the input
+  kEndLiterals   = 5,
+  kNibbleMax     = 15,
+  // Size of the over-copy used for short literal runs and matches
+  kWildCopySize  = 24,
+};
+
+static inline uint32_t Load32(const uint8_t* p)
+{
+  uint32_t value;
+  std::memcpy(&value, p, sizeof(value));
+  return value;
+}
+
+static inline uint32_t Hash32(uint32_t value)
+{
+  return (value * 2654435761u) >> (32 - kHashBits);
+}
+
+// Writes the extra bytes of a length that didn't fit in a nibble
+static inline bool WriteLength(uint64_t length, uint8_t** pp_dst, const uint8_t* p_dst_end)
+{
+  uint8_t* p_dst = *pp_dst;
+  while (length >= 255) {
+    if (p_dst >= p_dst_end) {
+      return false;
+    }
+    *p_dst++ = 255;
+    length -= 255;
+  }
+  if (p_dst >= p_dst_end) {
+    return false;
+  }
+  *p_dst++ = static_cast<uint8_t>(length);
+  *pp_dst = p_dst;
+  return true;
+}
+
+static inline bool ReadLength(const uint8_t** pp_src, const uint8_t* p_src_end, uint64_t* p_length)
+{
+  const uint8_t* p_src = *pp_src;
+  uint8_t        value = 0;
+  do {
+    if (p_src >= p_src_end) {
+      return false;
+    }
+    value = *p_src++;
+    *p_length += value;
+  } while (value == 255);
+  *pp_src = p_src;
+  return true;
+}
+
+// Emits one sequence. match_length of 0 writes the trailing literals only.
+static bool WriteSequence(
+  const uint8_t*  p_literals,
+  uint64_t        literal_count,
+  uint32_t        offset,
+  uint64_t        match_length,
+  uint8_t**       pp_dst,
+  const uint8_t*  p_dst_end)
+{
+  uint8_t* p_dst = *pp_dst;
+  if (p_dst >= p_dst_end) {
+    return false;
+  }
+
+  uint64_t match_code = (match_length > 0) ? (match_length - kMinMatch) : 0;
+  uint8_t  token      = static_cast<uint8_t>(
+    (std::min<uint64_t>(literal_count, kNibbleMax) << 4) |
+    std::min<uint64_t>(match_code, kNibbleMax));
+  *p_dst++ = token;
+
+  if ((literal_count >= kNibbleMax) && !WriteLength(literal_count - kNibbleMax, &p_dst, p_dst_end)) {
+    return false;
+  }
+  if (static_cast<uint64_t>(p_dst_end - p_dst) < literal_count) {
+    return false;
+  }
+  if (literal_count > 0) {
+    std::memcpy(p_dst, p_literals, static_cast<size_t>(literal_count));
+    p_dst += literal_count;
+  }
+
+  if (match_length > 0) {
+    if ((p_dst_end - p_dst) < 2) {
+      return false;
+    }
+    *p_dst++ = static_cast<uint8_t>(offset & 0xFF);
+    *p_dst++ = static_cast<uint8_t>(offset >> 8);
+    if ((match_code >= kNibbleMax) && !WriteLength(match_code - kNibbleMax, &p_dst, p_dst_end)) {
+      return false;
+    }
+  }
+
+  *pp_dst = p_dst;
+  return true;
+}
+
+uint64_t LZCompressBound(uint64_t src_size)
+{
+  return src_size + (src_size / 255) + 16;
+}
+
+uint64_t LZCompress(const uint8_t* p_src, uint64_t src_size, uint8_t* p_dst, uint64_t dst_capacity)
+{
+  const uint8_t* p_src_end  = p_src + src_size;
+  uint8_t*       p_out      = p_dst;
+  const uint8_t* p_out_end  = p_dst + dst_capacity;
+  const uint8_t* p_anchor   = p_src;
+
+  if (src_size > (kMinMatch + kEndLiterals)) {
+    std::vector<uint32_t> table(kHashSize, 0);
+    const uint8_t* p_match_limit = p_src_end - kEndLiterals;
+    const uint8_t* p_ip          = p_src + 1;
+    uint32_t       misses        = 0;
+    while ((p_ip + kMinMatch) <= p_match_limit) {
+      uint32_t       sequence  = Load32(p_ip);
+      uint32_t       hash      = Hash32(sequence);
+      const uint8_t* p_ref     = p_src + table[hash];
+      table[hash] = static_cast<uint32_t>(p_ip - p_src);
+
+      bool is_match = (p_ref < p_ip) &&
+                      ((p_ip - p_ref) <= kMaxOffset) &&
+                      (Load32(p_ref) == sequence);
+      if (!is_match) {
+        // Skip faster through data that doesn't compress
+        p_ip += 1 + (misses++ >> 6);
+        continue;
+      }
+      misses = 0;
+
+      // Extend backwards over pending literals, then forwards
+      while ((p_ip > p_anchor) && (p_ref > p_src) && (p_ip[-1] == p_ref[-1])) {
+        --p_ip;
+        --p_ref;
+      }
+      const uint8_t* p_match_end = p_ip + kMinMatch;
+      const uint8_t* p_ref_end   = p_ref + kMinMatch;
+      while ((p_match_end < p_match_limit) && (*p_match_end == *p_ref_end)) {
+        ++p_match_end;
+        ++p_ref_end;
+      }
+
+      uint64_t literal_count = static_cast<uint64_t>(p_ip - p_anchor);
+      uint64_t match_length  = static_cast<uint64_t>(p_match_end - p_ip);
+      uint32_t offset        = static_cast<uint32_t>(p_ip - p_ref);
+      if (!WriteSequence(p_anchor, literal_count, offset, match_length, &p_out, p_out_end)) {
+        return 0;
+      }
+
+      p_ip     = p_match_end;
+      p_anchor = p_ip;
+      // Prime the table with the position just before the next search
+      if ((p_ip - 2) > p_src) {
+        table[Hash32(Load32(p_ip - 2))] = static_cast<uint32_t>((p_ip - 2) - p_src);
+      }
+    }
+  }
+
+  // Trailing literals
+  uint64_t literal_count = static_cast<uint64_t>(p_src_end - p_anchor);
+  if (!WriteSequence(p_anchor, literal_count, 0, 0, &p_out, p_out_end)) {
+    return 0;
+  }
+
+  return static_cast<uint64_t>(p_out - p_dst);
+}
+
+bool LZDecompress(const uint8_t* p_src, uint64_t src_size, uint8_t* p_dst, uint64_t dst_size)
+{
+  const uint8_t* p_ip      = p_src;
+  const uint8_t* p_ip_end  = p_src + src_size;
+  uint8_t*       p_op      = p_dst;
+  uint8_t*       p_op_end  = p_dst + dst_size;
+
+  while (p_ip < p_ip_end) {
+    uint8_t token = *p_ip++;
+
+    // Literals
+    uint64_t literal_count = token >> 4;
+    if ((literal_count == kNibbleMax) && !ReadLength(&p_ip, p_ip_end, &literal_count)) {
+      return false;
+    }
+    if ((static_cast<uint64_t>(p_ip_end - p_ip) < literal_count) ||
+        (static_cast<uint64_t>(p_op_end - p_op) < literal_count)) {
+      return false;
+    }
+    // Short runs are copied with a fixed size copy when there's room, the 
+    // bytes written past the run are overwritten by what follows.
+    if ((literal_count <= kWildCopySize) && ((p_ip_end - p_ip) >= kWildCopySize) && ((p_op_end - p_op) >= kWildCopySize)) {
+      std::memcpy(p_op, p_ip, kWildCopySize);
+    }
+    else if (literal_count > 0) {
+      std::memcpy(p_op, p_ip, static_cast<size_t>(literal_count));
+    }
+    p_ip += literal_count;
+    p_op += literal_count;
+
+    // End of stream
+    if (p_ip == p_ip_end) {
+      break;
+    }
+
+    // Match
+    if ((p_ip_end - p_ip) < 2) {
+      return false;
+    }
+    uint64_t offset = static_cast<uint64_t>(p_ip[0]) | (static_cast<uint64_t>(p_ip[1]) << 8);
+    p_ip += 2;
+    uint64_t match_length = token & 0xF;
+    if ((match_length == kNibbleMax) && !ReadLength(&p_ip, p_ip_end, &match_length)) {
+      return false;
+    }
+    match_length += kMinMatch;
+    if ((offset == 0) || (offset > static_cast<uint64_t>(p_op - p_dst)) ||
+        (static_cast<uint64_t>(p_op_end - p_op) < match_length)) {
+      return false;
+    }
+    const uint8_t* p_ref = p_op - offset;
+    if ((offset >= 8) && (match_length <= kWildCopySize) && ((p_op_end - p_op) >= kWildCopySize)) {
+      // 8 byte steps never read bytes the same step writes
+      std::memcpy(p_op,      p_ref,      8);
+      std::memcpy(p_op + 8,  p_ref + 8,  8);
+      std::memcpy(p_op + 16, p_ref + 16, 8);
+      p_op += match_length;
+    }
+    else if (offset >= match_length) {
+      std::memcpy(p_op, p_ref, static_cast<size_t>(match_length));
+      p_op += match_length;
+    }
+    else {
+      // Overlapping copy repeats the last 'offset' bytes. Each copy doubles
+      // the repeated span, so runs take log2(length / offset) copies.
+      uint64_t remaining = match_length;
+      while (remaining > 0) {
+        uint64_t span = std::min<uint64_t>(static_cast<uint64_t>(p_op - p_ref), remaining);
+        std::memcpy(p_op, p_ref, static_cast<size_t>(span));
+        p_op      += span;
+        remaining -= span;
+      }
+    }
+  }
+
+  return (p_op == p_op_end);
+}
+
+} // namespace vkex
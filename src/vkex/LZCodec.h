@@ -0,0 +1,66 @@
+/*
+ Copyright 2018-2019 Google Inc.
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+ http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+*/
+
+#ifndef __VKEX_LZ_CODEC_H__
+#define __VKEX_LZ_CODEC_H__
+
+#include <cstdint>
+
+namespace vkex {
+
+//
+// Byte oriented LZ77 codec in the spirit of LZ4: greedy hash chain-less
+// matching with a 64 KiB window. Decoding is a tight copy loop and is
+// typically bound by memory bandwidth, which is the point - it's meant for
+// assets that are read far more often than written.
+//
+// Stream format, repeated until the input is consumed:
+//
+//   token          : uint8_t, high nibble literal count, low nibble match
+//                    length - 4. A nibble of 15 means more length bytes
+//                    follow, each added until one is less than 255.
+//   literals       : literal count bytes
+//   offset         : uint16_t little endian, distance back to the match
+//   match length   : extra length bytes, as described for the token
+//
+// The last sequence only has literals.
+//
+
+/** @fn LZCompressBound
+ *
+ * Worst case compressed size for src_size bytes of input.
+ *
+ */
+uint64_t LZCompressBound(uint64_t src_size);
+
+/** @fn LZCompress
+ *
+ * Returns the compressed size, or 0 if dst_capacity is too small.
+ *
+ */
+uint64_t LZCompress(const uint8_t* p_src, uint64_t src_size, uint8_t* p_dst, uint64_t dst_capacity);
+
+/** @fn LZDecompress
+ *
+ * Returns false if the stream is malformed or doesn't decompress to
+ * exactly dst_size bytes.
+ *
+ */
+bool LZDecompress(const uint8_t* p_src, uint64_t src_size, uint8_t* p_dst, uint64_t dst_size);
+
+} // namespace vkex
+
+#endif // __VKEX_LZ_CODEC_H__
@@ -1,11 +1,38 @@
 #include "MIPFile.h"
 
+#include "vkex/LZCodec.h"
+#include "vkex/ThreadPool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
 #include <fstream>
 
+#if defined(_WIN32)
+# define VC_EXTRALEAN
+# define WIN32_LEAN_AND_MEAN
+# define NOMINMAX
+# include <Windows.h>
+#else
+# include <fcntl.h>
+# include <sys/mman.h>
+# include <sys/stat.h>
+# include <unistd.h>
+#endif
+
 const uint32_t kFileSignature = MIP_FILE_SIGNATURE;
 const uint32_t kDataSignature = MIP_DATA_SIGNATURE;
 const uint32_t kInfoSignature = MIP_INFO_SIGNATURE;
 
+// Size of the fixed part of the header: file signature, pixel format, level
+// count and reserved fields, as written by MIPWriteFile().
+static const uint64_t kHeaderSize   = sizeof(uint32_t) + sizeof(uint32_t) + sizeof(uint32_t) + (16 * sizeof(uint64_t));
+// Size of each serialized MIPInfo
+static const uint64_t kInfoSize     = sizeof(uint32_t) + sizeof(uint64_t) + sizeof(uint64_t) + sizeof(uint32_t) + sizeof(uint32_t) + sizeof(uint32_t);
+// Size of each serialized chunk table entry: data offset, compressed size 
+// and uncompressed size.
+static const uint64_t kChunkEntrySize = sizeof(uint64_t) + sizeof(uint32_t) + sizeof(uint32_t);
+
 static void StreamWrite(std::ostream& os, const char* data, size_t size)
 {
   os.write(data, size);
@@ -37,17 +64,28 @@ uint32_t MIPFormatComponentCount(MIPPixelFormat format)
     case MIP_PIXEL_FORMAT_R32G32_FLOAT       : count = 2; break;
     case MIP_PIXEL_FORMAT_R32G32B32_FLOAT    : count = 3; break;
     case MIP_PIXEL_FORMAT_R32G32B32A32_FLOAT : count = 4; break;
+    case MIP_PIXEL_FORMAT_BC1_RGBA_UNORM     : count = 4; break;
+    case MIP_PIXEL_FORMAT_BC3_UNORM          : count = 4; break;
+    case MIP_PIXEL_FORMAT_BC4_UNORM          : count = 1; break;
+    case MIP_PIXEL_FORMAT_BC5_UNORM          : count = 2; break;
+    case MIP_PIXEL_FORMAT_BC7_UNORM          : count = 4; break;
   }
   return count;
 }
 
-bool MIPWriteFile(const char* file_path, const MIPFile& mip_file)
+bool MIPFormatIsBlockCompressed(MIPPixelFormat format)
 {
-  std::ofstream os(file_path, std::ios::binary);
-  if (!os.is_open()) {
-    return false;
-  }
+  bool is_block = (format == MIP_PIXEL_FORMAT_BC1_RGBA_UNORM) ||
+                  (format == MIP_PIXEL_FORMAT_BC3_UNORM) ||
+                  (format == MIP_PIXEL_FORMAT_BC4_UNORM) ||
+                  (format == MIP_PIXEL_FORMAT_BC5_UNORM) ||
+                  (format == MIP_PIXEL_FORMAT_BC7_UNORM);
+  return is_block;
+}
 
+// Writes everything up to and including the data signature
+static void WriteHeader(std::ostream& os, const MIPFile& mip_file, const uint64_t* p_reserved)
+{
   // File signature
   StreamWrite(os, reinterpret_cast<const char*>(&kFileSignature), sizeof(kFileSignature));
   // Pixel format
@@ -55,7 +93,7 @@ bool MIPWriteFile(const char* file_path, const MIPFile& mip_file)
   // Level count
   StreamWrite(os, reinterpret_cast<const char*>(&mip_file.level_count), sizeof(mip_file.level_count));
   // Reserved
-  StreamWrite(os, reinterpret_cast<const char*>(&mip_file.reserved), sizeof(mip_file.reserved));
+  StreamWrite(os, reinterpret_cast<const char*>(p_reserved), sizeof(mip_file.reserved));
 
   // Write MIP infos
   {
@@ -74,19 +112,32 @@ bool MIPWriteFile(const char* file_path, const MIPFile& mip_file)
     }
   }
 
+  // Data Signature
+  StreamWrite(os, reinterpret_cast<const char*>(&kDataSignature), sizeof(kDataSignature));
+}
+
+bool MIPWriteFile(const char* file_path, const MIPFile& mip_file)
+{
+  std::ofstream os(file_path, std::ios::binary);
+  if (!os.is_open()) {
+    return false;
+  }
+
+  // Data is written uncompressed regardless of what the reserved fields 
+  // say, so the chunk fields are cleared.
+  uint64_t reserved[16];
+  std::memcpy(reserved, mip_file.reserved, sizeof(reserved));
+  reserved[MIP_RESERVED_VERSION]         = MIP_FILE_VERSION_UNCOMPRESSED;
+  reserved[MIP_RESERVED_CHUNK_SIZE]      = 0;
+  reserved[MIP_RESERVED_CHUNK_COUNT]     = 0;
+  reserved[MIP_RESERVED_COMPRESSED_SIZE] = 0;
+  WriteHeader(os, mip_file, reserved);
+
   // Data
-  {
-    // Data Signature
-    size_t file_offset = os.tellp();
-    StreamWrite(os, reinterpret_cast<const char*>(&kDataSignature), sizeof(kDataSignature));
-    // Data Size
-    const uint64_t data_size = static_cast<uint64_t>(mip_file.data.size());
-    file_offset = os.tellp();
-    // Data
-    if (data_size > 0) {
-      const char* data = reinterpret_cast<const char*>(mip_file.data.data());
-      StreamWrite(os, data, data_size);
-    }
+  const uint64_t data_size = static_cast<uint64_t>(mip_file.data.size());
+  if (data_size > 0) {
+    const char* data = reinterpret_cast<const char*>(mip_file.data.data());
+    StreamWrite(os, data, data_size);
   }
 
   os.close();
@@ -94,7 +145,95 @@ bool MIPWriteFile(const char* file_path, const MIPFile& mip_file)
   return true;
 }
 
-bool MIPLoadFile(const char* file_path, MIPFile* p_mip_file)
+bool MIPWriteFileCompressed(
+  const char*         file_path, 
+  const MIPFile&      mip_file, 
+  uint32_t            chunk_size, 
+  vkex::ThreadPool*   p_thread_pool)
+{
+  if ((chunk_size == 0) || (mip_file.level_count == 0) || (mip_file.level_count > MAX_MIP_LEVELS)) {
+    return false;
+  }
+
+  // Split each level into chunks, in level order
+  std::vector<uint64_t> chunk_src_offsets;
+  std::vector<uint32_t> chunk_sizes;
+  for (uint32_t level = 0; level < mip_file.level_count; ++level) {
+    const MIPInfo& info = mip_file.infos[level];
+    if ((info.data_offset > mip_file.data.size()) || (info.data_size > (mip_file.data.size() - info.data_offset))) {
+      return false;
+    }
+    for (uint64_t offset = 0; offset < info.data_size; offset += chunk_size) {
+      chunk_src_offsets.push_back(info.data_offset + offset);
+      chunk_sizes.push_back(static_cast<uint32_t>(std::min<uint64_t>(chunk_size, info.data_size - offset)));
+    }
+  }
+
+  // Chunks are independent so they compress in parallel
+  const uint32_t                    chunk_count = static_cast<uint32_t>(chunk_sizes.size());
+  std::vector<std::vector<uint8_t>> compressed(chunk_count);
+  auto compress_chunk = [&](uint32_t i) {
+    const uint8_t*        p_src   = mip_file.data.data() + chunk_src_offsets[i];
+    const uint32_t        size    = chunk_sizes[i];
+    std::vector<uint8_t>& chunk   = compressed[i];
+    chunk.resize(static_cast<size_t>(vkex::LZCompressBound(size)));
+    uint64_t compressed_size = vkex::LZCompress(p_src, size, chunk.data(), chunk.size());
+    // Store the chunk as is if compression doesn't help
+    if ((compressed_size == 0) || (compressed_size >= size)) {
+      chunk.assign(p_src, p_src + size);
+    }
+    else {
+      chunk.resize(static_cast<size_t>(compressed_size));
+    }
+  };
+  if (p_thread_pool != nullptr) {
+    p_thread_pool->ParallelFor(chunk_count, compress_chunk);
+  }
+  else {
+    for (uint32_t i = 0; i < chunk_count; ++i) {
+      compress_chunk(i);
+    }
+  }
+
+  // Chunk table, offsets are from the start of the data section
+  std::vector<MIPChunk> chunks(chunk_count);
+  uint64_t offset = chunk_count * kChunkEntrySize;
+  for (uint32_t i = 0; i < chunk_count; ++i) {
+    chunks[i].offset          = offset;
+    chunks[i].compressed_size = static_cast<uint32_t>(compressed[i].size());
+    chunks[i].size            = chunk_sizes[i];
+    offset += chunks[i].compressed_size;
+  }
+
+  std::ofstream os(file_path, std::ios::binary);
+  if (!os.is_open()) {
+    return false;
+  }
+
+  uint64_t reserved[16];
+  std::memcpy(reserved, mip_file.reserved, sizeof(reserved));
+  reserved[MIP_RESERVED_VERSION]         = MIP_FILE_VERSION_CHUNKED_LZ;
+  reserved[MIP_RESERVED_CHUNK_SIZE]      = chunk_size;
+  reserved[MIP_RESERVED_CHUNK_COUNT]     = chunk_count;
+  reserved[MIP_RESERVED_COMPRESSED_SIZE] = offset - (chunk_count * kChunkEntrySize);
+  WriteHeader(os, mip_file, reserved);
+
+  for (const auto& chunk : chunks) {
+    StreamWrite(os, reinterpret_cast<const char*>(&chunk.offset), sizeof(chunk.offset));
+    StreamWrite(os, reinterpret_cast<const char*>(&chunk.compressed_size), sizeof(chunk.compressed_size));
+    StreamWrite(os, reinterpret_cast<const char*>(&chunk.size), sizeof(chunk.size));
+  }
+  for (const auto& chunk : compressed) {
+    StreamWrite(os, reinterpret_cast<const char*>(chunk.data()), chunk.size());
+  }
+
+  bool valid = os.good();
+  os.close();
+
+  return valid;
+}
+
+bool MIPLoadFile(const char* file_path, MIPFile* p_mip_file, vkex::ThreadPool* p_thread_pool)
 {
   std::ifstream is(file_path, std::ios::binary);
   if (!is.is_open()) {
@@ -110,6 +249,16 @@ bool MIPLoadFile(const char* file_path, MIPFile* p_mip_file)
   // Reserved
   StreamRead(is, reinterpret_cast<char*>(&p_mip_file->reserved), sizeof(p_mip_file->reserved));
 
+  // Chunked files go through the positioned read path
+  const uint64_t version = p_mip_file->reserved[MIP_RESERVED_VERSION];
+  if (version == MIP_FILE_VERSION_CHUNKED_LZ) {
+    is.close();
+    return MIPLoadFileLevels(file_path, 0, UINT32_MAX, p_mip_file, p_thread_pool);
+  }
+  if (version != MIP_FILE_VERSION_UNCOMPRESSED) {
+    return false;
+  }
+
   // Load MIP infos
   uint64_t total_data_size = 0;
   {
@@ -148,6 +297,550 @@ bool MIPLoadFile(const char* file_path, MIPFile* p_mip_file)
   return true;
 }
 
-//bool LoadMIPFile(const char* file_path, MIPFile* p_mip_file)
-//{
-//}
+template <typename T>
+static T ReadValue(const uint8_t* p_src, uint64_t* p_offset)
+{
+  T value;
+  std::memcpy(&value, p_src + *p_offset, sizeof(T));
+  *p_offset += sizeof(T);
+  return value;
+}
+
+// Parses and validates the header and MIP info table of an in-memory file.
+// Fills everything in p_header except data. On success, p_data_offset 
+// receives the file offset of the data section.
+static bool ParseHeader(
+  const uint8_t* p_file_data,
+  uint64_t       file_size,
+  MIPFile*       p_header,
+  uint64_t*      p_data_offset)
+{
+  if (file_size < (kHeaderSize + sizeof(kInfoSignature))) {
+    return false;
+  }
+
+  uint64_t offset = 0;
+  std::memcpy(p_header->file_signature, p_file_data + offset, sizeof(p_header->file_signature));
+  if (ReadValue<uint32_t>(p_file_data, &offset) != kFileSignature) {
+    return false;
+  }
+  uint32_t pixel_format = ReadValue<uint32_t>(p_file_data, &offset);
+  uint32_t level_count  = ReadValue<uint32_t>(p_file_data, &offset);
+  if ((level_count == 0) || (level_count > MAX_MIP_LEVELS)) {
+    return false;
+  }
+  std::memcpy(p_header->reserved, p_file_data + offset, sizeof(p_header->reserved));
+  offset = kHeaderSize;
+
+  // Files from a newer writer can't be read
+  const uint64_t version = p_header->reserved[MIP_RESERVED_VERSION];
+  if (version > MIP_FILE_VERSION_LATEST) {
+    return false;
+  }
+
+  uint64_t table_end = offset + sizeof(kInfoSignature) + (level_count * kInfoSize) + sizeof(kDataSignature);
+  if (table_end > file_size) {
+    return false;
+  }
+  std::memcpy(p_header->info_signature, p_file_data + offset, sizeof(p_header->info_signature));
+  if (ReadValue<uint32_t>(p_file_data, &offset) != kInfoSignature) {
+    return false;
+  }
+  MIPInfo* p_infos = p_header->infos;
+  for (uint32_t level = 0; level < level_count; ++level) {
+    MIPInfo* p_info = &p_infos[level];
+    p_info->level       = ReadValue<uint32_t>(p_file_data, &offset);
+    p_info->data_offset = ReadValue<uint64_t>(p_file_data, &offset);
+    p_info->data_size   = ReadValue<uint64_t>(p_file_data, &offset);
+    p_info->width       = ReadValue<uint32_t>(p_file_data, &offset);
+    p_info->height      = ReadValue<uint32_t>(p_file_data, &offset);
+    p_info->row_stride  = ReadValue<uint32_t>(p_file_data, &offset);
+  }
+  std::memcpy(p_header->data_signature, p_file_data + offset, sizeof(p_header->data_signature));
+  if (ReadValue<uint32_t>(p_file_data, &offset) != kDataSignature) {
+    return false;
+  }
+
+  // Offsets in MIPInfo are into the uncompressed data. For chunked files
+  // the section holds the chunk table and compressed chunks instead.
+  uint64_t data_size = file_size - offset;
+  if (version == MIP_FILE_VERSION_CHUNKED_LZ) {
+    const uint64_t chunk_size = p_header->reserved[MIP_RESERVED_CHUNK_SIZE];
+    const uint64_t chunk_count = p_header->reserved[MIP_RESERVED_CHUNK_COUNT];
+    const uint64_t compressed_size = p_header->reserved[MIP_RESERVED_COMPRESSED_SIZE];
+    if ((chunk_size == 0) || (chunk_size > UINT32_MAX)) {
+      return false;
+    }
+    uint64_t expected_chunk_count = 0;
+    uint64_t uncompressed_size = 0;
+    for (uint32_t level = 0; level < level_count; ++level) {
+      expected_chunk_count += (p_infos[level].data_size + chunk_size - 1) / chunk_size;
+      uncompressed_size = std::max<uint64_t>(uncompressed_size, p_infos[level].data_offset + p_infos[level].data_size);
+    }
+    if (chunk_count != expected_chunk_count) {
+      return false;
+    }
+    if ((chunk_count * kChunkEntrySize) > data_size) {
+      return false;
+    }
+    if (compressed_size > (data_size - (chunk_count * kChunkEntrySize))) {
+      return false;
+    }
+    data_size = uncompressed_size;
+  }
+
+  for (uint32_t level = 0; level < level_count; ++level) {
+    const MIPInfo& info = p_infos[level];
+    if (info.level != level) {
+      return false;
+    }
+    uint32_t row_count = MIPFormatIsBlockCompressed(static_cast<MIPPixelFormat>(pixel_format)) ? ((info.height + 3) / 4) : info.height;
+    uint64_t min_size  = static_cast<uint64_t>(info.row_stride) * static_cast<uint64_t>(row_count);
+    if (info.data_size < min_size) {
+      return false;
+    }
+    if ((info.data_offset > data_size) || (info.data_size > (data_size - info.data_offset))) {
+      return false;
+    }
+  }
+
+  p_header->pixel_format = pixel_format;
+  p_header->level_count  = level_count;
+  *p_data_offset = offset;
+
+  return true;
+}
+
+// =================================================================================================
+// MIPMappedFile
+// =================================================================================================
+MIPMappedFile::MIPMappedFile()
+{
+}
+
+MIPMappedFile::~MIPMappedFile()
+{
+  Close();
+}
+
+bool MIPMappedFile::Open(const char* file_path)
+{
+  Close();
+
+#if defined(_WIN32)
+  HANDLE file_handle = CreateFileA(
+    file_path, 
+    GENERIC_READ, 
+    FILE_SHARE_READ, 
+    nullptr, 
+    OPEN_EXISTING, 
+    FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, 
+    nullptr);
+  if (file_handle == INVALID_HANDLE_VALUE) {
+    return false;
+  }
+  LARGE_INTEGER file_size = {};
+  if (!GetFileSizeEx(file_handle, &file_size) || (file_size.QuadPart == 0)) {
+    CloseHandle(file_handle);
+    return false;
+  }
+  HANDLE mapping_handle = CreateFileMappingA(file_handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+  if (mapping_handle == nullptr) {
+    CloseHandle(file_handle);
+    return false;
+  }
+  void* p_mapped = MapViewOfFile(mapping_handle, FILE_MAP_READ, 0, 0, 0);
+  if (p_mapped == nullptr) {
+    CloseHandle(mapping_handle);
+    CloseHandle(file_handle);
+    return false;
+  }
+  m_file_handle    = file_handle;
+  m_mapping_handle = mapping_handle;
+  m_mapped_data    = static_cast<const uint8_t*>(p_mapped);
+  m_mapped_size    = static_cast<uint64_t>(file_size.QuadPart);
+#else
+  int fd = open(file_path, O_RDONLY);
+  if (fd == -1) {
+    return false;
+  }
+  struct stat info = {};
+  if ((fstat(fd, &info) != 0) || (info.st_size <= 0)) {
+    close(fd);
+    return false;
+  }
+  size_t size     = static_cast<size_t>(info.st_size);
+  void*  p_mapped = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  // The mapping holds its own reference to the file
+  close(fd);
+  if (p_mapped == MAP_FAILED) {
+    return false;
+  }
+  m_mapped_data = static_cast<const uint8_t*>(p_mapped);
+  m_mapped_size = static_cast<uint64_t>(size);
+#endif
+
+  MIPFile  header      = {};
+  uint64_t data_offset = 0;
+  bool valid = ParseHeader(m_mapped_data, m_mapped_size, &header, &data_offset);
+  // Chunked files need to be decompressed, use MIPLoadFileLevels()
+  valid = valid && (header.reserved[MIP_RESERVED_VERSION] == MIP_FILE_VERSION_UNCOMPRESSED);
+  if (!valid) {
+    Close();
+    return false;
+  }
+  m_pixel_format = header.pixel_format;
+  m_level_count  = header.level_count;
+  std::memcpy(m_infos, header.infos, sizeof(m_infos));
+
+  m_data      = m_mapped_data + data_offset;
+  m_data_size = m_mapped_size - data_offset;
+
+#if !defined(_WIN32)
+  // Level data is typically read front to back into a staging buffer
+  madvise(const_cast<uint8_t*>(m_mapped_data), static_cast<size_t>(m_mapped_size), MADV_SEQUENTIAL);
+#endif
+
+  return true;
+}
+
+void MIPMappedFile::Close()
+{
+  if (m_mapped_data != nullptr) {
+#if defined(_WIN32)
+    UnmapViewOfFile(m_mapped_data);
+    CloseHandle(static_cast<HANDLE>(m_mapping_handle));
+    CloseHandle(static_cast<HANDLE>(m_file_handle));
+    m_mapping_handle = nullptr;
+    m_file_handle    = nullptr;
+#else
+    munmap(const_cast<uint8_t*>(m_mapped_data), static_cast<size_t>(m_mapped_size));
+#endif
+  }
+
+  m_mapped_data  = nullptr;
+  m_mapped_size  = 0;
+  m_pixel_format = MIP_PIXEL_FORMAT_UNDEFINED;
+  m_level_count  = 0;
+  m_data         = nullptr;
+  m_data_size    = 0;
+}
+
+const uint8_t* MIPMappedFile::GetLevelData(uint32_t level) const
+{
+  if (level >= m_level_count) {
+    return nullptr;
+  }
+  return m_data + m_infos[level].data_offset;
+}
+
+uint64_t MIPMappedFile::GetLevelDataSize(uint32_t level) const
+{
+  if (level >= m_level_count) {
+    return 0;
+  }
+  return m_infos[level].data_size;
+}
+
+// =================================================================================================
+// Positioned reads
+// =================================================================================================
+#if defined(_WIN32)
+using FileHandle = HANDLE;
+static const FileHandle kInvalidFileHandle = INVALID_HANDLE_VALUE;
+#else
+using FileHandle = int;
+static const FileHandle kInvalidFileHandle = -1;
+#endif
+
+static FileHandle OpenForRead(const char* file_path, uint64_t* p_file_size)
+{
+#if defined(_WIN32)
+  HANDLE handle = CreateFileA(
+    file_path, 
+    GENERIC_READ, 
+    FILE_SHARE_READ, 
+    nullptr, 
+    OPEN_EXISTING, 
+    FILE_ATTRIBUTE_NORMAL | FILE_FLAG_RANDOM_ACCESS, 
+    nullptr);
+  if (handle == INVALID_HANDLE_VALUE) {
+    return kInvalidFileHandle;
+  }
+  LARGE_INTEGER file_size = {};
+  if (!GetFileSizeEx(handle, &file_size)) {
+    CloseHandle(handle);
+    return kInvalidFileHandle;
+  }
+  *p_file_size = static_cast<uint64_t>(file_size.QuadPart);
+  return handle;
+#else
+  int fd = open(file_path, O_RDONLY);
+  if (fd == -1) {
+    return kInvalidFileHandle;
+  }
+  struct stat info = {};
+  if (fstat(fd, &info) != 0) {
+    close(fd);
+    return kInvalidFileHandle;
+  }
+  *p_file_size = static_cast<uint64_t>(info.st_size);
+  return fd;
+#endif
+}
+
+static void CloseFile(FileHandle handle)
+{
+#if defined(_WIN32)
+  CloseHandle(handle);
+#else
+  close(handle);
+#endif
+}
+
+// Reads exactly size bytes at offset without touching the file position
+static bool ReadAt(FileHandle handle, uint64_t offset, uint64_t size, uint8_t* p_dst)
+{
+  while (size > 0) {
+#if defined(_WIN32)
+    DWORD      chunk      = static_cast<DWORD>(std::min<uint64_t>(size, 0x40000000));
+    DWORD      read_count = 0;
+    OVERLAPPED overlapped = {};
+    overlapped.Offset     = static_cast<DWORD>(offset & 0xFFFFFFFF);
+    overlapped.OffsetHigh = static_cast<DWORD>(offset >> 32);
+    if (!ReadFile(handle, p_dst, chunk, &read_count, &overlapped) || (read_count == 0)) {
+      return false;
+    }
+#else
+    size_t  chunk      = static_cast<size_t>(std::min<uint64_t>(size, 0x40000000));
+    ssize_t read_count = pread(handle, p_dst, chunk, static_cast<off_t>(offset));
+    if (read_count <= 0) {
+      return false;
+    }
+#endif
+    offset += static_cast<uint64_t>(read_count);
+    size   -= static_cast<uint64_t>(read_count);
+    p_dst  += read_count;
+  }
+  return true;
+}
+
+// Reads and validates the header, returns the file offset of the data section
+static bool ReadHeader(FileHandle handle, uint64_t file_size, MIPFile* p_mip_file, uint64_t* p_data_offset)
+{
+  const uint64_t max_header_size = kHeaderSize + sizeof(kInfoSignature) + (MAX_MIP_LEVELS * kInfoSize) + sizeof(kDataSignature);
+  uint8_t        header[max_header_size];
+  uint64_t       header_size = std::min<uint64_t>(file_size, max_header_size);
+  if (!ReadAt(handle, 0, header_size, header)) {
+    return false;
+  }
+
+  return ParseHeader(header, file_size, p_mip_file, p_data_offset);
+}
+
+bool MIPLoadFileInfo(const char* file_path, MIPFile* p_mip_file)
+{
+  uint64_t   file_size = 0;
+  FileHandle handle    = OpenForRead(file_path, &file_size);
+  if (handle == kInvalidFileHandle) {
+    return false;
+  }
+
+  uint64_t data_offset = 0;
+  bool     valid       = ReadHeader(handle, file_size, p_mip_file, &data_offset);
+  CloseFile(handle);
+  p_mip_file->data.clear();
+
+  return valid;
+}
+
+// Reads the chunks for levels [first_level, last_level] of a chunked file 
+// and decompresses them into p_mip_file->data, which must already be sized 
+// and have its infos rebased.
+static bool ReadChunkedLevels(
+  FileHandle          handle,
+  uint64_t            data_offset,
+  const MIPFile&      header,
+  uint32_t            first_level,
+  uint32_t            last_level,
+  MIPFile*            p_mip_file,
+  vkex::ThreadPool*   p_thread_pool)
+{
+  const uint64_t chunk_size  = header.reserved[MIP_RESERVED_CHUNK_SIZE];
+  const uint64_t chunk_count = header.reserved[MIP_RESERVED_CHUNK_COUNT];
+
+  uint64_t first_chunk = 0;
+  for (uint32_t level = 0; level < first_level; ++level) {
+    first_chunk += (header.infos[level].data_size + chunk_size - 1) / chunk_size;
+  }
+
+  // Where each chunk goes in the output
+  std::vector<MIPChunk> chunks;
+  std::vector<uint64_t> chunk_dst_offsets;
+  for (uint32_t level = first_level; level <= last_level; ++level) {
+    const uint64_t level_size       = header.infos[level].data_size;
+    const uint64_t level_dst_offset = p_mip_file->infos[level - first_level].data_offset;
+    for (uint64_t offset = 0; offset < level_size; offset += chunk_size) {
+      chunk_dst_offsets.push_back(level_dst_offset + offset);
+    }
+  }
+  if (chunk_dst_offsets.empty()) {
+    return true;
+  }
+  if ((first_chunk + chunk_dst_offsets.size()) > chunk_count) {
+    return false;
+  }
+
+  // Chunk table entries for the requested levels
+  std::vector<uint8_t> table(static_cast<size_t>(chunk_dst_offsets.size() * kChunkEntrySize));
+  if (!ReadAt(handle, data_offset + (first_chunk * kChunkEntrySize), table.size(), table.data())) {
+    return false;
+  }
+  chunks.resize(chunk_dst_offsets.size());
+  uint64_t table_offset = 0;
+  for (auto& chunk : chunks) {
+    chunk.offset          = ReadValue<uint64_t>(table.data(), &table_offset);
+    chunk.compressed_size = ReadValue<uint32_t>(table.data(), &table_offset);
+    chunk.size            = ReadValue<uint32_t>(table.data(), &table_offset);
+  }
+
+  // Validate against the uncompressed layout and find the compressed range
+  const uint64_t section_size = (chunk_count * kChunkEntrySize) + header.reserved[MIP_RESERVED_COMPRESSED_SIZE];
+  uint64_t       read_begin   = UINT64_MAX;
+  uint64_t       read_end     = 0;
+  for (size_t i = 0; i < chunks.size(); ++i) {
+    const MIPChunk& chunk = chunks[i];
+    uint64_t expected_size = std::min<uint64_t>(chunk_size, p_mip_file->data.size() - chunk_dst_offsets[i]);
+    if ((i + 1) < chunks.size()) {
+      expected_size = std::min<uint64_t>(expected_size, chunk_dst_offsets[i + 1] - chunk_dst_offsets[i]);
+    }
+    if ((chunk.size != expected_size) || (chunk.compressed_size > chunk.size)) {
+      return false;
+    }
+    if ((chunk.offset > section_size) || (chunk.compressed_size > (section_size - chunk.offset))) {
+      return false;
+    }
+    read_begin = std::min<uint64_t>(read_begin, chunk.offset);
+    read_end   = std::max<uint64_t>(read_end, chunk.offset + chunk.compressed_size);
+  }
+
+  // Chunks for consecutive levels are stored back to back, so one read
+  // fetches everything.
+  std::vector<uint8_t> compressed(static_cast<size_t>(read_end - read_begin));
+  if (!ReadAt(handle, data_offset + read_begin, compressed.size(), compressed.data())) {
+    return false;
+  }
+
+  std::atomic<bool> valid(true);
+  auto decompress_chunk = [&](uint32_t i) {
+    const MIPChunk& chunk = chunks[i];
+    const uint8_t*  p_src = compressed.data() + (chunk.offset - read_begin);
+    uint8_t*        p_dst = p_mip_file->data.data() + chunk_dst_offsets[i];
+    // Chunks that didn't compress are stored as is
+    if (chunk.compressed_size == chunk.size) {
+      std::memcpy(p_dst, p_src, chunk.size);
+    }
+    else if (!vkex::LZDecompress(p_src, chunk.compressed_size, p_dst, chunk.size)) {
+      valid = false;
+    }
+  };
+
+  uint32_t count = static_cast<uint32_t>(chunks.size());
+  if (p_thread_pool != nullptr) {
+    p_thread_pool->ParallelFor(count, decompress_chunk);
+  }
+  else {
+    for (uint32_t i = 0; i < count; ++i) {
+      decompress_chunk(i);
+    }
+  }
+
+  return valid;
+}
+
+bool MIPLoadFileLevels(
+  const char*         file_path, 
+  uint32_t            first_level, 
+  uint32_t            last_level, 
+  MIPFile*            p_mip_file,
+  vkex::ThreadPool*   p_thread_pool)
+{
+  uint64_t   file_size = 0;
+  FileHandle handle    = OpenForRead(file_path, &file_size);
+  if (handle == kInvalidFileHandle) {
+    return false;
+  }
+
+  MIPFile  header      = {};
+  uint64_t data_offset = 0;
+  if (!ReadHeader(handle, file_size, &header, &data_offset)) {
+    CloseFile(handle);
+    return false;
+  }
+
+  last_level = std::min<uint32_t>(last_level, header.level_count - 1);
+  if (first_level > last_level) {
+    CloseFile(handle);
+    return false;
+  }
+
+  // Copy the header and rebase the requested levels to start at 0
+  std::memcpy(p_mip_file->file_signature, header.file_signature, sizeof(header.file_signature));
+  std::memcpy(p_mip_file->reserved, header.reserved, sizeof(header.reserved));
+  std::memcpy(p_mip_file->info_signature, header.info_signature, sizeof(header.info_signature));
+  std::memcpy(p_mip_file->data_signature, header.data_signature, sizeof(header.data_signature));
+  p_mip_file->pixel_format = header.pixel_format;
+  p_mip_file->level_count  = last_level - first_level + 1;
+  // Data is always returned uncompressed
+  p_mip_file->reserved[MIP_RESERVED_VERSION]         = MIP_FILE_VERSION_UNCOMPRESSED;
+  p_mip_file->reserved[MIP_RESERVED_CHUNK_SIZE]      = 0;
+  p_mip_file->reserved[MIP_RESERVED_CHUNK_COUNT]     = 0;
+  p_mip_file->reserved[MIP_RESERVED_COMPRESSED_SIZE] = 0;
+
+  uint64_t total_data_size = 0;
+  for (uint32_t level = first_level; level <= last_level; ++level) {
+    MIPInfo info     = header.infos[level];
+    info.level       = level - first_level;
+    info.data_offset = total_data_size;
+    p_mip_file->infos[info.level] = info;
+    total_data_size += info.data_size;
+  }
+  for (uint32_t level = p_mip_file->level_count; level < MAX_MIP_LEVELS; ++level) {
+    p_mip_file->infos[level] = {};
+  }
+
+  p_mip_file->data.resize(static_cast<size_t>(total_data_size));
+
+  if (header.reserved[MIP_RESERVED_VERSION] == MIP_FILE_VERSION_CHUNKED_LZ) {
+    bool valid = ReadChunkedLevels(handle, data_offset, header, first_level, last_level, p_mip_file, p_thread_pool);
+    CloseFile(handle);
+    if (!valid) {
+      p_mip_file->data.clear();
+    }
+    return valid;
+  }
+
+  // Only the requested levels are read. Levels written back to back
+  // are fetched with a single read.
+  uint32_t level = first_level;
+  bool     valid = true;
+  while (valid && (level <= last_level)) {
+    uint64_t read_offset = header.infos[level].data_offset;
+    uint64_t read_size   = header.infos[level].data_size;
+    uint32_t dst_level   = level - first_level;
+    ++level;
+    while ((level <= last_level) && (header.infos[level].data_offset == (read_offset + read_size))) {
+      read_size += header.infos[level].data_size;
+      ++level;
+    }
+    uint8_t* p_dst = p_mip_file->data.data() + p_mip_file->infos[dst_level].data_offset;
+    valid = ReadAt(handle, data_offset + read_offset, read_size, p_dst);
+  }
+  CloseFile(handle);
+
+  if (!valid) {
+    p_mip_file->data.clear();
+  }
+
+  return valid;
+}
@@ -7,7 +7,7 @@ Section                 | Type     | Count | # Bytes | Details
 MIP File Signature      | char     | 4     | 4       |'FPIM' aka MIPF backwards 
 Pixel Format            | uint32_t | 1     | 4       | See Pixel Format Table
 MIP Level Count         | uint32_t | 1     | 4       | N = Mip Level Count, N <= 32
-Reserved                | uint32_t | 16    | 64      | Reserved for future use
+Reserved                | uint64_t | 16    | 128     | See Reserved Fields
 MIP Info Signature      | char     | 4     | 4       |'IPIM' aka MIPI backwards
 MIP Infos for N Levels  | MIP Info | N     | N*36    | 
 MIP Data Signature      | char     | 4     | 4       |'DPIM' aka MIPD backwards
@@ -38,6 +38,42 @@ Data            | uint8_t  | N     | N       | Row Stride * Height
 --------------------------------------------------------------------------------
 
 
+Reserved Fields
+--------------------------------------------------------------------------------
+Index | Details
+--------------------------------------------------------------------------------
+0     | Version, 0 = uncompressed, 1 = chunked LZ
+1     | Chunk size in bytes (version 1)
+2     | Chunk count (version 1)
+3     | Total size of the compressed chunks in bytes (version 1)
+4-15  | Reserved for future use, must be 0
+--------------------------------------------------------------------------------
+
+
+Chunked LZ Data Section (version 1)
+--------------------------------------------------------------------------------
+Field           | Type      | Count | # Bytes | Details
+--------------------------------------------------------------------------------
+Chunk Table     | MIP Chunk | C     | C*16    | C = Chunk Count
+Chunk Data      | uint8_t   | -     | -       | Compressed chunks
+--------------------------------------------------------------------------------
+Each level is split into ceil(Data Size / Chunk Size) chunks, stored in level
+order. Data Offset and Data Size in the MIP infos still describe the 
+uncompressed data. Chunks are independent, so any level range can be read and
+decompressed without touching the others. See vkex/LZCodec.h for the stream
+format.
+
+
+MIP Chunk Structure
+--------------------------------------------------------------------------------
+Field           | Type     | Count | # Bytes | Details
+--------------------------------------------------------------------------------
+Data Offset     | uint64_t | 1     | 8       | From the start of the data section
+Compressed Size | uint32_t | 1     | 4       | Equal to Size if stored as is
+Size            | uint32_t | 1     | 4       | Uncompressed size
+--------------------------------------------------------------------------------
+
+
 Pixel Format Table
 --------------------------------------------------------------------------------
 Format ID | Type      | # Channels | # Bytes | Format Name
@@ -64,6 +100,14 @@ Format ID | Type      | # Channels | # Bytes | Format Name
 15        | float32_t | 3          | 12      | R32G32B32_FLOAT
 16        | float32_t | 4          | 32      | R32G32B32A32_FLOAT
 --------------------------------------------------------------------------------
+17        | block     | 4          | 8       | BC1_RGBA_UNORM
+18        | block     | 4          | 16      | BC3_UNORM
+19        | block     | 1          | 8       | BC4_UNORM
+20        | block     | 2          | 16      | BC5_UNORM
+21        | block     | 4          | 16      | BC7_UNORM
+--------------------------------------------------------------------------------
+For block formats # Bytes is per 4x4 block. Row Stride is the size of a row
+of blocks and Data Size is Row Stride * ((Height + 3) / 4).
 
 */
 
@@ -91,6 +135,11 @@ enum MIPPixelFormat {
   MIP_PIXEL_FORMAT_R32G32_FLOAT       = 14,
   MIP_PIXEL_FORMAT_R32G32B32_FLOAT    = 15,
   MIP_PIXEL_FORMAT_R32G32B32A32_FLOAT = 16,
+  MIP_PIXEL_FORMAT_BC1_RGBA_UNORM     = 17,
+  MIP_PIXEL_FORMAT_BC3_UNORM          = 18,
+  MIP_PIXEL_FORMAT_BC4_UNORM          = 19,
+  MIP_PIXEL_FORMAT_BC5_UNORM          = 20,
+  MIP_PIXEL_FORMAT_BC7_UNORM          = 21,
 };
 
 enum {
@@ -100,6 +149,24 @@ enum {
   MAX_MIP_LEVELS     = 32
 };
 
+enum MIPFileVersion {
+  MIP_FILE_VERSION_UNCOMPRESSED = 0,
+  MIP_FILE_VERSION_CHUNKED_LZ   = 1,
+  MIP_FILE_VERSION_LATEST       = MIP_FILE_VERSION_CHUNKED_LZ,
+};
+
+enum {
+  MIP_RESERVED_VERSION          = 0,
+  MIP_RESERVED_CHUNK_SIZE       = 1,
+  MIP_RESERVED_CHUNK_COUNT      = 2,
+  MIP_RESERVED_COMPRESSED_SIZE  = 3,
+  MIP_DEFAULT_CHUNK_SIZE        = 256 * 1024,
+};
+
+namespace vkex {
+class ThreadPool;
+} // namespace vkex
+
 struct MIPInfo {
   uint32_t level;
   uint64_t data_offset;
@@ -109,6 +176,12 @@ struct MIPInfo {
   uint32_t row_stride;
 };
 
+struct MIPChunk {
+  uint64_t offset;
+  uint32_t compressed_size;
+  uint32_t size;
+};
+
 struct MIPFile {
   char                  file_signature[4];
   uint32_t              pixel_format;
@@ -121,7 +194,69 @@ struct MIPFile {
 };
 
 uint32_t  MIPFormatComponentCount(MIPPixelFormat format);
+bool      MIPFormatIsBlockCompressed(MIPPixelFormat format);
 bool      MIPWriteFile(const char* file_path, const MIPFile& mip_file);
-bool      MIPLoadFile(const char* file_path, MIPFile* p_mip_file);
+// Writes a version 1 file. Chunks are compressed on p_thread_pool if one
+// is given.
+bool      MIPWriteFileCompressed(const char* file_path, const MIPFile& mip_file, uint32_t chunk_size = MIP_DEFAULT_CHUNK_SIZE, vkex::ThreadPool* p_thread_pool = nullptr);
+// Loaded data is always uncompressed. Chunks are decompressed on 
+// p_thread_pool if one is given.
+bool      MIPLoadFile(const char* file_path, MIPFile* p_mip_file, vkex::ThreadPool* p_thread_pool = nullptr);
+// Loads the header and MIP infos only, data is left empty
+bool      MIPLoadFileInfo(const char* file_path, MIPFile* p_mip_file);
+// Loads levels [first_level, last_level] with positioned reads. The result 
+// is rebased so first_level becomes level 0. last_level is clamped to the
+// last level in the file. For chunked files only the chunks of the 
+// requested levels are read.
+bool      MIPLoadFileLevels(const char* file_path, uint32_t first_level, uint32_t last_level, MIPFile* p_mip_file, vkex::ThreadPool* p_thread_pool = nullptr);
+
+/** @class MIPMappedFile
+ *
+ * Memory maps a MIP file and validates its header and MIP info table once.
+ * Level data is accessed in place, nothing is copied out of the page cache.
+ *
+ * The mapping is read only, writing through it faults.
+ *
+ * Only uncompressed (version 0) files can be mapped, Open() fails for 
+ * chunked files.
+ *
+ */
+class MIPMappedFile {
+public:
+  MIPMappedFile();
+  ~MIPMappedFile();
+
+  MIPMappedFile(const MIPMappedFile&) = delete;
+  MIPMappedFile& operator=(const MIPMappedFile&) = delete;
+
+  bool            Open(const char* file_path);
+  void            Close();
+  bool            IsOpen() const { return m_mapped_data != nullptr; }
+
+  MIPPixelFormat  GetPixelFormat() const { return static_cast<MIPPixelFormat>(m_pixel_format); }
+  uint32_t        GetLevelCount() const { return m_level_count; }
+  const MIPInfo&  GetInfo(uint32_t level) const { return m_infos[level]; }
+
+  // All level data, starting at level 0
+  const uint8_t*  GetData() const { return m_data; }
+  uint64_t        GetDataSize() const { return m_data_size; }
+
+  // Returns nullptr if level is out of range
+  const uint8_t*  GetLevelData(uint32_t level) const;
+  uint64_t        GetLevelDataSize(uint32_t level) const;
+
+private:
+  const uint8_t*  m_mapped_data = nullptr;
+  uint64_t        m_mapped_size = 0;
+#if defined(_WIN32)
+  void*           m_file_handle    = nullptr;
+  void*           m_mapping_handle = nullptr;
+#endif
+  uint32_t        m_pixel_format = MIP_PIXEL_FORMAT_UNDEFINED;
+  uint32_t        m_level_count  = 0;
+  MIPInfo         m_infos[MAX_MIP_LEVELS] = {};
+  const uint8_t*  m_data         = nullptr;
+  uint64_t        m_data_size    = 0;
+};
 
 #endif // MIPFILE_H
\ No newline at end of file
@@ -0,0 +1,482 @@
+/*
+ Copyright 2018-2019 Google Inc.
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+ http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+*/
+
+#include "vkex/PixelConvert.h"
+
+#include <cmath>
+#include <cstring>
+
+#if defined(VKEX_SIMD_SSE2)
+# include <emmintrin.h>
+#endif
+#if defined(VKEX_SIMD_SSSE3)
+# include <tmmintrin.h>
+#endif
+#if defined(VKEX_SIMD_AVX2) || defined(VKEX_SIMD_F16C)
+# include <immintrin.h>
+#endif
+
+namespace vkex {
+
+static inline uint32_t Load32(const uint8_t* p)
+{
+  uint32_t value;
+  std::memcpy(&value, p, sizeof(value));
+  return value;
+}
+
+static inline void Store32(uint8_t* p, uint32_t value)
+{
+  std::memcpy(p, &value, sizeof(value));
+}
+
+// =================================================================================================
+// Half floats
+// =================================================================================================
+float HalfToFloat(uint16_t value)
+{
+  uint32_t sign     = static_cast<uint32_t>(value & 0x8000) << 16;
+  uint32_t exponent = (value >> 10) & 0x1F;
+  uint32_t mantissa = value & 0x3FF;
+  uint32_t bits     = 0;
+  if (exponent == 0) {
+    if (mantissa == 0) {
+      bits = sign;
+    }
+    else {
+      // Denormal - renormalize
+      exponent = 127 - 15 + 1;
+      while ((mantissa & 0x400) == 0) {
+        mantissa <<= 1;
+        exponent -= 1;
+      }
+      mantissa &= 0x3FF;
+      bits = sign | (exponent << 23) | (mantissa << 13);
+    }
+  }
+  else if (exponent == 0x1F) {
+    bits = sign | 0x7F800000 | (mantissa << 13);
+  }
+  else {
+    bits = sign | ((exponent + (127 - 15)) << 23) | (mantissa << 13);
+  }
+  float result = 0.0f;
+  std::memcpy(&result, &bits, sizeof(result));
+  return result;
+}
+
+uint16_t FloatToHalf(float value)
+{
+  uint32_t bits = 0;
+  std::memcpy(&bits, &value, sizeof(bits));
+  uint32_t sign     = (bits >> 16) & 0x8000;
+  uint32_t exponent = (bits >> 23) & 0xFF;
+  uint32_t mantissa = bits & 0x7FFFFF;
+  // NaN/Inf
+  if (exponent == 0xFF) {
+    return static_cast<uint16_t>(sign | 0x7C00 | (mantissa ? 0x200 : 0));
+  }
+  int32_t half_exponent = static_cast<int32_t>(exponent) - 127 + 15;
+  // Overflow
+  if (half_exponent >= 0x1F) {
+    return static_cast<uint16_t>(sign | 0x7C00);
+  }
+  // Denormal or zero
+  if (half_exponent <= 0) {
+    if (half_exponent < -10) {
+      return static_cast<uint16_t>(sign);
+    }
+    mantissa |= 0x800000;
+    uint32_t shift    = static_cast<uint32_t>(14 - half_exponent);
+    uint32_t half     = mantissa >> shift;
+    uint32_t rem      = mantissa & ((1u << shift) - 1);
+    uint32_t halfway  = 1u << (shift - 1);
+    if ((rem > halfway) || ((rem == halfway) && (half & 1))) {
+      half += 1;
+    }
+    return static_cast<uint16_t>(sign | half);
+  }
+  // Normal - round to nearest even, carry may bump the exponent
+  uint32_t half = (static_cast<uint32_t>(half_exponent) << 10) | (mantissa >> 13);
+  uint32_t rem  = mantissa & 0x1FFF;
+  if ((rem > 0x1000) || ((rem == 0x1000) && (half & 1))) {
+    half += 1;
+  }
+  return static_cast<uint16_t>(sign | half);
+}
+
+#if defined(VKEX_SIMD_SSE2)
+// Halves in the low 16 bits of each lane to floats. Shifting the exponent
+// and mantissa into place and scaling by 2^112 rebiases normals and
+// renormalizes denormals in one multiply. Inf/NaN get their exponent
+// forced to 255. Matches HalfToFloat() unless denormals-are-zero is set.
+static inline __m128 HalfToFloat4(__m128i half)
+{
+  const __m128i mask_no_sign  = _mm_set1_epi32(0x7FFF);
+  const __m128  magic         = _mm_castsi128_ps(_mm_set1_epi32((254 - 15) << 23));
+  const __m128i max_finite    = _mm_set1_epi32(0x7BFF);
+  const __m128i exponent_255  = _mm_set1_epi32(255 << 23);
+
+  __m128i exponent_mantissa = _mm_and_si128(half, mask_no_sign);
+  __m128i sign              = _mm_slli_epi32(_mm_xor_si128(half, exponent_mantissa), 16);
+  __m128  scaled            = _mm_mul_ps(_mm_castsi128_ps(_mm_slli_epi32(exponent_mantissa, 13)), magic);
+  __m128i is_inf_nan        = _mm_cmpgt_epi32(exponent_mantissa, max_finite);
+  __m128i inf_nan_exponent  = _mm_and_si128(is_inf_nan, exponent_255);
+  return _mm_or_ps(scaled, _mm_castsi128_ps(_mm_or_si128(sign, inf_nan_exponent)));
+}
+
+// Floats to halves in the low 16 bits of each lane, round to nearest even.
+// Denormal results come from an add that lets the FPU do the rounding.
+// Matches FloatToHalf().
+static inline __m128i FloatToHalf4(__m128 value)
+{
+  const __m128i mask_sign     = _mm_set1_epi32(static_cast<int>(0x80000000));
+  const __m128i f32_infinity  = _mm_set1_epi32(255 << 23);
+  const __m128i f16_overflow  = _mm_set1_epi32((127 + 16) << 23);
+  const __m128i normal_min    = _mm_set1_epi32(113 << 23);
+  const __m128i denorm_magic  = _mm_set1_epi32(((127 - 15) + (23 - 10) + 1) << 23);
+  const __m128i rebias        = _mm_set1_epi32(((15 - 127) * (1 << 23)) + 0xFFF);
+  const __m128i one           = _mm_set1_epi32(1);
+  const __m128i half_infinity = _mm_set1_epi32(0x7C00);
+  const __m128i half_quiet    = _mm_set1_epi32(0x0200);
+
+  __m128i bits = _mm_castps_si128(value);
+  __m128i sign = _mm_and_si128(bits, mask_sign);
+  bits = _mm_xor_si128(bits, sign);
+
+  // Overflow, Inf and NaN
+  __m128i is_overflow = _mm_cmpgt_epi32(bits, _mm_sub_epi32(f16_overflow, one));
+  __m128i is_nan      = _mm_cmpgt_epi32(bits, f32_infinity);
+  __m128i inf_nan     = _mm_or_si128(half_infinity, _mm_and_si128(is_nan, half_quiet));
+
+  // Denormal or zero
+  __m128i is_denormal = _mm_cmpgt_epi32(normal_min, bits);
+  __m128  denormal_f  = _mm_add_ps(_mm_castsi128_ps(bits), _mm_castsi128_ps(denorm_magic));
+  __m128i denormal    = _mm_sub_epi32(_mm_castps_si128(denormal_f), denorm_magic);
+
+  // Normal
+  __m128i mantissa_odd = _mm_and_si128(_mm_srli_epi32(bits, 13), one);
+  __m128i normal       = _mm_add_epi32(_mm_add_epi32(bits, rebias), mantissa_odd);
+  normal = _mm_srli_epi32(normal, 13);
+
+  __m128i result = _mm_or_si128(_mm_and_si128(is_denormal, denormal), _mm_andnot_si128(is_denormal, normal));
+  result = _mm_or_si128(_mm_and_si128(is_overflow, inf_nan), _mm_andnot_si128(is_overflow, result));
+  return _mm_or_si128(result, _mm_srli_epi32(sign, 16));
+}
+#endif // defined(VKEX_SIMD_SSE2)
+
+void HalfToFloatRow(const uint16_t* p_src, float* p_dst, uint32_t count)
+{
+  uint32_t i = 0;
+#if defined(VKEX_SIMD_F16C)
+  for (; (i + 8) <= count; i += 8) {
+    __m128i h = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p_src + i));
+    _mm256_storeu_ps(p_dst + i, _mm256_cvtph_ps(h));
+  }
+#elif defined(VKEX_SIMD_SSE2)
+  const __m128i zero = _mm_setzero_si128();
+  for (; (i + 8) <= count; i += 8) {
+    __m128i h = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p_src + i));
+    _mm_storeu_ps(p_dst + i,     HalfToFloat4(_mm_unpacklo_epi16(h, zero)));
+    _mm_storeu_ps(p_dst + i + 4, HalfToFloat4(_mm_unpackhi_epi16(h, zero)));
+  }
+#endif
+  for (; i < count; ++i) {
+    p_dst[i] = HalfToFloat(p_src[i]);
+  }
+}
+
+void FloatToHalfRow(const float* p_src, uint16_t* p_dst, uint32_t count)
+{
+  uint32_t i = 0;
+#if defined(VKEX_SIMD_F16C)
+  for (; (i + 8) <= count; i += 8) {
+    __m128i h = _mm256_cvtps_ph(_mm256_loadu_ps(p_src + i), _MM_FROUND_TO_NEAREST_INT);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(p_dst + i), h);
+  }
+#elif defined(VKEX_SIMD_SSE2)
+  for (; (i + 8) <= count; i += 8) {
+    __m128i lo = FloatToHalf4(_mm_loadu_ps(p_src + i));
+    __m128i hi = FloatToHalf4(_mm_loadu_ps(p_src + i + 4));
+    // Sign extend so the signed saturating pack is exact
+    lo = _mm_srai_epi32(_mm_slli_epi32(lo, 16), 16);
+    hi = _mm_srai_epi32(_mm_slli_epi32(hi, 16), 16);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(p_dst + i), _mm_packs_epi32(lo, hi));
+  }
+#endif
+  for (; i < count; ++i) {
+    p_dst[i] = FloatToHalf(p_src[i]);
+  }
+}
+
+template <uint32_t ComponentCount>
+static void ConvertF32ToF16(const uint8_t* p_src, uint8_t* p_dst, uint32_t pixel_count)
+{
+  // Reads stay ahead of writes, so in place conversion is safe
+  FloatToHalfRow(
+    reinterpret_cast<const float*>(p_src),
+    reinterpret_cast<uint16_t*>(p_dst),
+    pixel_count * ComponentCount);
+}
+
+template <uint32_t ComponentCount>
+static void ConvertF16ToF32(const uint8_t* p_src, uint8_t* p_dst, uint32_t pixel_count)
+{
+  HalfToFloatRow(
+    reinterpret_cast<const uint16_t*>(p_src),
+    reinterpret_cast<float*>(p_dst),
+    pixel_count * ComponentCount);
+}
+
+// =================================================================================================
+// 8-bit kernels
+// =================================================================================================
+
+// Swaps bytes 0 and 2 of every pixel
+static void ConvertSwapRB(const uint8_t* p_src, uint8_t* p_dst, uint32_t pixel_count)
+{
+  uint32_t i = 0;
+#if defined(VKEX_SIMD_AVX2)
+  {
+    const __m256i mask_ga = _mm256_set1_epi32(static_cast<int>(0xFF00FF00));
+    const __m256i mask_rb = _mm256_set1_epi32(0x00FF00FF);
+    for (; (i + 8) <= pixel_count; i += 8) {
+      __m256i v  = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p_src + (4 * i)));
+      __m256i ga = _mm256_and_si256(v, mask_ga);
+      __m256i rb = _mm256_and_si256(v, mask_rb);
+      rb = _mm256_or_si256(_mm256_slli_epi32(rb, 16), _mm256_srli_epi32(rb, 16));
+      _mm256_storeu_si256(reinterpret_cast<__m256i*>(p_dst + (4 * i)), _mm256_or_si256(ga, rb));
+    }
+  }
+#endif
+#if defined(VKEX_SIMD_SSE2)
+  {
+    const __m128i mask_ga = _mm_set1_epi32(static_cast<int>(0xFF00FF00));
+    const __m128i mask_rb = _mm_set1_epi32(0x00FF00FF);
+    for (; (i + 4) <= pixel_count; i += 4) {
+      __m128i v  = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p_src + (4 * i)));
+      __m128i ga = _mm_and_si128(v, mask_ga);
+      __m128i rb = _mm_and_si128(v, mask_rb);
+      rb = _mm_or_si128(_mm_slli_epi32(rb, 16), _mm_srli_epi32(rb, 16));
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(p_dst + (4 * i)), _mm_or_si128(ga, rb));
+    }
+  }
+#endif
+  for (; i < pixel_count; ++i) {
+    uint32_t v  = Load32(p_src + (4 * i));
+    uint32_t rb = v & 0x00FF00FF;
+    Store32(p_dst + (4 * i), (v & 0xFF00FF00) | (rb << 16) | (rb >> 16));
+  }
+}
+
+// Appends an opaque alpha to every 3 byte pixel
+static void ConvertRGBToRGBA(const uint8_t* p_src, uint8_t* p_dst, uint32_t pixel_count)
+{
+  uint32_t i = 0;
+#if defined(VKEX_SIMD_SSSE3)
+  {
+    const __m128i shuffle = _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+    const __m128i alpha   = _mm_set1_epi32(static_cast<int>(0xFF000000));
+    // Each 16 byte load only uses 12 bytes, stop while the load is still
+    // inside the source row.
+    for (; (i + 6) <= pixel_count; i += 4) {
+      __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p_src + (3 * i)));
+      v = _mm_or_si128(_mm_shuffle_epi8(v, shuffle), alpha);
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(p_dst + (4 * i)), v);
+    }
+  }
+#elif defined(VKEX_SIMD_SSE2)
+  {
+    // No byte shuffle, pixel n is shifted up n bytes into its lane and
+    // masked out of the others
+    const __m128i mask0 = _mm_setr_epi32(0x00FFFFFF, 0, 0, 0);
+    const __m128i mask1 = _mm_setr_epi32(0, 0x00FFFFFF, 0, 0);
+    const __m128i mask2 = _mm_setr_epi32(0, 0, 0x00FFFFFF, 0);
+    const __m128i mask3 = _mm_setr_epi32(0, 0, 0, 0x00FFFFFF);
+    const __m128i alpha = _mm_set1_epi32(static_cast<int>(0xFF000000));
+    for (; (i + 6) <= pixel_count; i += 4) {
+      __m128i v  = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p_src + (3 * i)));
+      __m128i p0 = _mm_and_si128(v, mask0);
+      __m128i p1 = _mm_and_si128(_mm_slli_si128(v, 1), mask1);
+      __m128i p2 = _mm_and_si128(_mm_slli_si128(v, 2), mask2);
+      __m128i p3 = _mm_and_si128(_mm_slli_si128(v, 3), mask3);
+      v = _mm_or_si128(_mm_or_si128(p0, p1), _mm_or_si128(p2, p3));
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(p_dst + (4 * i)), _mm_or_si128(v, alpha));
+    }
+  }
+#endif
+  for (; i < pixel_count; ++i) {
+    const uint8_t* p_pixel = p_src + (3 * i);
+    uint32_t v = static_cast<uint32_t>(p_pixel[0]) |
+                 (static_cast<uint32_t>(p_pixel[1]) << 8) |
+                 (static_cast<uint32_t>(p_pixel[2]) << 16) |
+                 0xFF000000;
+    Store32(p_dst + (4 * i), v);
+  }
+}
+
+// Broadcasts a single channel to RGB with an opaque alpha
+static void ConvertRToRGBA(const uint8_t* p_src, uint8_t* p_dst, uint32_t pixel_count)
+{
+  uint32_t i = 0;
+#if defined(VKEX_SIMD_SSE2)
+  {
+    const __m128i alpha = _mm_set1_epi32(static_cast<int>(0xFF000000));
+    for (; (i + 16) <= pixel_count; i += 16) {
+      __m128i r  = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p_src + i));
+      __m128i lo = _mm_unpacklo_epi8(r, r);
+      __m128i hi = _mm_unpackhi_epi8(r, r);
+      __m128i* p_out = reinterpret_cast<__m128i*>(p_dst + (4 * i));
+      _mm_storeu_si128(p_out + 0, _mm_or_si128(_mm_unpacklo_epi16(lo, lo), alpha));
+      _mm_storeu_si128(p_out + 1, _mm_or_si128(_mm_unpackhi_epi16(lo, lo), alpha));
+      _mm_storeu_si128(p_out + 2, _mm_or_si128(_mm_unpacklo_epi16(hi, hi), alpha));
+      _mm_storeu_si128(p_out + 3, _mm_or_si128(_mm_unpackhi_epi16(hi, hi), alpha));
+    }
+  }
+#endif
+  for (; i < pixel_count; ++i) {
+    uint32_t r = p_src[i];
+    Store32(p_dst + (4 * i), (r * 0x00010101) | 0xFF000000);
+  }
+}
+
+// sRGB transfer functions through 256 entry tables. Color channels are
+// looked up per byte, there's no byte wide gather before AVX-512 and the
+// tables stay in L1, so the loop is bound by the lookups either way.
+struct SRGBTables {
+  uint8_t to_linear[256];
+  uint8_t to_srgb[256];
+
+  SRGBTables() {
+    for (uint32_t i = 0; i < 256; ++i) {
+      float c = static_cast<float>(i) / 255.0f;
+      float linear = (c <= 0.04045f) ? (c / 12.92f) : std::pow((c + 0.055f) / 1.055f, 2.4f);
+      float srgb   = (c <= 0.0031308f) ? (c * 12.92f) : ((1.055f * std::pow(c, 1.0f / 2.4f)) - 0.055f);
+      to_linear[i] = static_cast<uint8_t>(std::floor((linear * 255.0f) + 0.5f));
+      to_srgb[i]   = static_cast<uint8_t>(std::floor((srgb * 255.0f) + 0.5f));
+    }
+  }
+};
+
+static const SRGBTables& GetSRGBTables()
+{
+  static const SRGBTables s_tables;
+  return s_tables;
+}
+
+static void ApplyColorTable(const uint8_t* p_table, const uint8_t* p_src, uint8_t* p_dst, uint32_t pixel_count)
+{
+  for (uint32_t i = 0; i < pixel_count; ++i) {
+    uint32_t v = Load32(p_src + (4 * i));
+    v = static_cast<uint32_t>(p_table[v & 0xFF]) |
+        (static_cast<uint32_t>(p_table[(v >> 8) & 0xFF]) << 8) |
+        (static_cast<uint32_t>(p_table[(v >> 16) & 0xFF]) << 16) |
+        (v & 0xFF000000);
+    Store32(p_dst + (4 * i), v);
+  }
+}
+
+static void ConvertSRGBToLinear(const uint8_t* p_src, uint8_t* p_dst, uint32_t pixel_count)
+{
+  ApplyColorTable(GetSRGBTables().to_linear, p_src, p_dst, pixel_count);
+}
+
+static void ConvertLinearToSRGB(const uint8_t* p_src, uint8_t* p_dst, uint32_t pixel_count)
+{
+  ApplyColorTable(GetSRGBTables().to_srgb, p_src, p_dst, pixel_count);
+}
+
+// =================================================================================================
+// Format pairs
+// =================================================================================================
+struct PixelConverter {
+  VkFormat        src_format;
+  VkFormat        dst_format;
+  PixelConvertFn  fn;
+};
+
+static const PixelConverter kPixelConverters[] = {
+  // RGB -> RGBA
+  { VK_FORMAT_R8G8B8_UNORM,         VK_FORMAT_R8G8B8A8_UNORM,       ConvertRGBToRGBA        },
+  { VK_FORMAT_R8G8B8_SRGB,          VK_FORMAT_R8G8B8A8_SRGB,        ConvertRGBToRGBA        },
+  { VK_FORMAT_B8G8R8_UNORM,         VK_FORMAT_B8G8R8A8_UNORM,       ConvertRGBToRGBA        },
+  { VK_FORMAT_B8G8R8_SRGB,          VK_FORMAT_B8G8R8A8_SRGB,        ConvertRGBToRGBA        },
+  // BGRA <-> RGBA
+  { VK_FORMAT_B8G8R8A8_UNORM,       VK_FORMAT_R8G8B8A8_UNORM,       ConvertSwapRB           },
+  { VK_FORMAT_R8G8B8A8_UNORM,       VK_FORMAT_B8G8R8A8_UNORM,       ConvertSwapRB           },
+  { VK_FORMAT_B8G8R8A8_SRGB,        VK_FORMAT_R8G8B8A8_SRGB,        ConvertSwapRB           },
+  { VK_FORMAT_R8G8B8A8_SRGB,        VK_FORMAT_B8G8R8A8_SRGB,        ConvertSwapRB           },
+  // UNORM <-> sRGB
+  { VK_FORMAT_R8G8B8A8_UNORM,       VK_FORMAT_R8G8B8A8_SRGB,        ConvertLinearToSRGB     },
+  { VK_FORMAT_R8G8B8A8_SRGB,        VK_FORMAT_R8G8B8A8_UNORM,       ConvertSRGBToLinear     },
+  { VK_FORMAT_B8G8R8A8_UNORM,       VK_FORMAT_B8G8R8A8_SRGB,        ConvertLinearToSRGB     },
+  { VK_FORMAT_B8G8R8A8_SRGB,        VK_FORMAT_B8G8R8A8_UNORM,       ConvertSRGBToLinear     },
+  // R -> RGBA
+  { VK_FORMAT_R8_UNORM,             VK_FORMAT_R8G8B8A8_UNORM,       ConvertRToRGBA          },
+  { VK_FORMAT_R8_SRGB,              VK_FORMAT_R8G8B8A8_SRGB,        ConvertRToRGBA          },
+  // F32 <-> F16
+  { VK_FORMAT_R32_SFLOAT,           VK_FORMAT_R16_SFLOAT,           ConvertF32ToF16<1>      },
+  { VK_FORMAT_R32G32_SFLOAT,        VK_FORMAT_R16G16_SFLOAT,        ConvertF32ToF16<2>      },
+  { VK_FORMAT_R32G32B32_SFLOAT,     VK_FORMAT_R16G16B16_SFLOAT,     ConvertF32ToF16<3>      },
+  { VK_FORMAT_R32G32B32A32_SFLOAT,  VK_FORMAT_R16G16B16A16_SFLOAT,  ConvertF32ToF16<4>      },
+  { VK_FORMAT_R16_SFLOAT,           VK_FORMAT_R32_SFLOAT,           ConvertF16ToF32<1>      },
+  { VK_FORMAT_R16G16_SFLOAT,        VK_FORMAT_R32G32_SFLOAT,        ConvertF16ToF32<2>      },
+  { VK_FORMAT_R16G16B16_SFLOAT,     VK_FORMAT_R32G32B32_SFLOAT,     ConvertF16ToF32<3>      },
+  { VK_FORMAT_R16G16B16A16_SFLOAT,  VK_FORMAT_R32G32B32A32_SFLOAT,  ConvertF16ToF32<4>      },
+};
+
+PixelConvertFn GetPixelConvertFn(VkFormat src_format, VkFormat dst_format)
+{
+  for (const auto& converter : kPixelConverters) {
+    if ((converter.src_format == src_format) && (converter.dst_format == dst_format)) {
+      return converter.fn;
+    }
+  }
+  return nullptr;
+}
+
+bool IsPixelConvertSupported(VkFormat src_format, VkFormat dst_format)
+{
+  return GetPixelConvertFn(src_format, dst_format) != nullptr;
+}
+
+vkex::Result PixelConvert(
+  uint32_t    width,
+  uint32_t    height,
+  VkFormat    src_format,
+  uint32_t    src_row_stride,
+  const void* p_src,
+  VkFormat    dst_format,
+  uint32_t    dst_row_stride,
+  void*       p_dst)
+{
+  PixelConvertFn fn = GetPixelConvertFn(src_format, dst_format);
+  if (fn == nullptr) {
+    return vkex::Result::ErrorImageFormatNotSupported;
+  }
+
+  const uint8_t* p_src_row = static_cast<const uint8_t*>(p_src);
+  uint8_t*       p_dst_row = static_cast<uint8_t*>(p_dst);
+  for (uint32_t y = 0; y < height; ++y) {
+    fn(p_src_row, p_dst_row, width);
+    p_src_row += src_row_stride;
+    p_dst_row += dst_row_stride;
+  }
+
+  return vkex::Result::Success;
+}
+
+} // namespace vkex
@@ -0,0 +1,79 @@
+/*
+ Copyright 2018-2019 Google Inc.
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+ http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+*/
+
+#ifndef __VKEX_PIXEL_CONVERT_H__
+#define __VKEX_PIXEL_CONVERT_H__
+
+#include "vkex/Config.h"
+
+namespace vkex {
+
+//
+// Supported conversions, UNORM and SRGB variants of the 8-bit formats are
+// supported wherever the conversion doesn't change the encoding:
+//
+//   R8G8B8    -> R8G8B8A8        alpha is set to 255, also B8G8R8 -> B8G8R8A8
+//   B8G8R8A8 <-> R8G8B8A8
+//   R8G8B8A8 <-> R8G8B8A8_SRGB   re-encodes color, alpha is copied, also BGRA
+//   R8        -> R8G8B8A8        R is broadcast to RGB, alpha is set to 255
+//   R32*     <-> R16*_SFLOAT     1 to 4 components, round to nearest even
+//
+
+/** @fn PixelConvertFn
+ *
+ * Converts pixel_count pixels. p_src and p_dst may be the same pointer if
+ * both formats have the same pixel size.
+ *
+ */
+using PixelConvertFn = void (*)(const uint8_t* p_src, uint8_t* p_dst, uint32_t pixel_count);
+
+/** @fn GetPixelConvertFn
+ *
+ * Returns nullptr if the format pair isn't supported.
+ *
+ */
+PixelConvertFn GetPixelConvertFn(VkFormat src_format, VkFormat dst_format);
+
+/** @fn IsPixelConvertSupported
+ *
+ */
+bool IsPixelConvertSupported(VkFormat src_format, VkFormat dst_format);
+
+/** @fn PixelConvert
+ *
+ * Converts a width x height region row by row. Row strides are in bytes.
+ * Returns ErrorImageFormatNotSupported if the pair isn't supported.
+ *
+ */
+vkex::Result PixelConvert(
+  uint32_t    width,
+  uint32_t    height,
+  VkFormat    src_format,
+  uint32_t    src_row_stride,
+  const void* p_src,
+  VkFormat    dst_format,
+  uint32_t    dst_row_stride,
+  void*       p_dst);
+
+// Single values and rows of IEEE half floats
+float     HalfToFloat(uint16_t value);
+uint16_t  FloatToHalf(float value);
+void      HalfToFloatRow(const uint16_t* p_src, float* p_dst, uint32_t count);
+void      FloatToHalfRow(const float* p_src, uint16_t* p_dst, uint32_t count);
+
+} // namespace vkex
+
+#endif // __VKEX_PIXEL_CONVERT_H__
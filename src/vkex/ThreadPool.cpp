@@ -0,0 +1,151 @@
+/*
+ Copyright 2018-2019 Google Inc.
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+ http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+*/
+
+#include "vkex/ThreadPool.h"
+
+#include <algorithm>
+#include <atomic>
+
+namespace vkex {
+
+// =================================================================================================
+// ThreadPool
+// =================================================================================================
+ThreadPool::ThreadPool(uint32_t thread_count)
+{
+  if (thread_count == 0) {
+    thread_count = std::max<uint32_t>(1, std::thread::hardware_concurrency());
+  }
+
+  m_threads.reserve(thread_count);
+  for (uint32_t i = 0; i < thread_count; ++i) {
+    m_threads.emplace_back(&ThreadPool::WorkerMain, this);
+  }
+}
+
+ThreadPool::~ThreadPool()
+{
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stop = true;
+  }
+  m_task_cv.notify_all();
+
+  for (auto& thread : m_threads) {
+    if (thread.joinable()) {
+      thread.join();
+    }
+  }
+}
+
+void ThreadPool::WorkerMain()
+{
+  for (;;) {
+    std::function<void()> task;
+    {
+      std::unique_lock<std::mutex> lock(m_mutex);
+      m_task_cv.wait(lock, [this]() { return m_stop || !m_tasks.empty(); });
+      if (m_stop && m_tasks.empty()) {
+        return;
+      }
+      task = std::move(m_tasks.front());
+      m_tasks.pop_front();
+      ++m_active_count;
+    }
+
+    task();
+
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      --m_active_count;
+      if (m_tasks.empty() && (m_active_count == 0)) {
+        m_idle_cv.notify_all();
+      }
+    }
+  }
+}
+
+void ThreadPool::Submit(std::function<void()> task)
+{
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_tasks.push_back(std::move(task));
+  }
+  m_task_cv.notify_one();
+}
+
+void ThreadPool::ParallelFor(uint32_t count, const std::function<void(uint32_t)>& fn)
+{
+  if (count == 0) {
+    return;
+  }
+
+  if ((count == 1) || m_threads.empty()) {
+    for (uint32_t i = 0; i < count; ++i) {
+      fn(i);
+    }
+    return;
+  }
+
+  // Helpers can start after this function has returned, so everything
+  // they touch lives in shared state.
+  struct State {
+    std::function<void(uint32_t)> fn;
+    uint32_t                      count = 0;
+    std::atomic<uint32_t>         next;
+    std::atomic<uint32_t>         done;
+    std::mutex                    mutex;
+    std::condition_variable       done_cv;
+  };
+  auto state = std::make_shared<State>();
+  state->fn    = fn;
+  state->count = count;
+  state->next  = 0;
+  state->done  = 0;
+
+  auto run = [](State* p_state) {
+    for (;;) {
+      uint32_t index = p_state->next.fetch_add(1);
+      if (index >= p_state->count) {
+        break;
+      }
+      p_state->fn(index);
+      if ((p_state->done.fetch_add(1) + 1) == p_state->count) {
+        std::lock_guard<std::mutex> lock(p_state->mutex);
+        p_state->done_cv.notify_all();
+      }
+    }
+  };
+
+  uint32_t helper_count = std::min<uint32_t>(count - 1, GetThreadCount());
+  for (uint32_t i = 0; i < helper_count; ++i) {
+    Submit([state, run]() { run(state.get()); });
+  }
+
+  // Calling thread works too
+  run(state.get());
+
+  std::unique_lock<std::mutex> lock(state->mutex);
+  state->done_cv.wait(lock, [&state]() { return state->done.load() == state->count; });
+}
+
+void ThreadPool::WaitIdle()
+{
+  std::unique_lock<std::mutex> lock(m_mutex);
+  m_idle_cv.wait(lock, [this]() { return m_tasks.empty() && (m_active_count == 0); });
+}
+
+} // namespace vkex
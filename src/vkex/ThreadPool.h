@@ -0,0 +1,83 @@
+/*
+ Copyright 2018-2019 Google Inc.
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+ http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+*/
+
+#ifndef __VKEX_THREAD_POOL_H__
+#define __VKEX_THREAD_POOL_H__
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace vkex {
+
+/** @class ThreadPool
+ *
+ * Fixed size pool of worker threads pulling tasks from a single FIFO queue.
+ *
+ * ParallelFor() runs on the calling thread as well as the workers and only
+ * waits for items that have actually started, so it's safe to call from
+ * inside a task running on the same pool.
+ *
+ */
+class ThreadPool {
+public:
+  // thread_count of 0 uses std::thread::hardware_concurrency()
+  ThreadPool(uint32_t thread_count = 0);
+  ~ThreadPool();
+
+  uint32_t GetThreadCount() const {
+    return static_cast<uint32_t>(m_threads.size());
+  }
+
+  void Submit(std::function<void()> task);
+
+  template <typename Fn>
+  std::future<void> SubmitWithFuture(Fn fn) {
+    auto task = std::make_shared<std::packaged_task<void()>>(std::move(fn));
+    std::future<void> future = task->get_future();
+    Submit([task]() { (*task)(); });
+    return future;
+  }
+
+  // Calls fn(index) for every index in [0, count) and returns after all
+  // calls have completed.
+  void ParallelFor(uint32_t count, const std::function<void(uint32_t)>& fn);
+
+  // Blocks until the queue is empty and all workers are idle
+  void WaitIdle();
+
+private:
+  void WorkerMain();
+
+private:
+  std::vector<std::thread>          m_threads;
+  std::deque<std::function<void()>> m_tasks;
+  std::mutex                        m_mutex;
+  std::condition_variable           m_task_cv;
+  std::condition_variable           m_idle_cv;
+  uint32_t                          m_active_count = 0;
+  bool                              m_stop         = false;
+};
+
+} // namespace vkex
+
+#endif // __VKEX_THREAD_POOL_H__
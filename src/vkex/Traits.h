@@ -19,8 +19,483 @@
 
 #include <vkex/Config.h>
 
+#include <array>
+#include <atomic>
+#include <iterator>
+#include <mutex>
+#include <new>
+#include <unordered_set>
+
+#if defined(_MSC_VER)
+# include <intrin.h>
+#endif
+
 namespace vkex {
 
+template <typename T> class ObjectStorage;
+
+/** @class IStoredObject
+ *
+ * Where an object lives in its parent's ObjectStorage, so destroying it
+ * doesn't have to search for it.
+ *
+ */
+class IStoredObject {
+protected:
+  template <typename T> friend class ObjectStorage;
+
+  uint32_t  m_storage_shard       = UINT32_MAX;
+  uint32_t  m_storage_index       = UINT32_MAX;
+  uint32_t  m_storage_generation  = 0;
+  uint32_t  m_storage_block       = UINT32_MAX;
+};
+
+/** @fn LowestSetBit
+ *
+ * value must not be 0.
+ *
+ */
+inline uint32_t LowestSetBit(uint64_t value)
+{
+#if defined(_MSC_VER)
+  unsigned long index = 0;
+  _BitScanForward64(&index, value);
+  return static_cast<uint32_t>(index);
+#else
+  return static_cast<uint32_t>(__builtin_ctzll(value));
+#endif
+}
+
+/** @fn GetThreadStorageShard
+ *
+ * Round robin index assigned to each thread the first time it stores an
+ * object, so threads creating objects at the same time use different
+ * shards.
+ *
+ */
+inline uint32_t GetThreadStorageShard()
+{
+  static std::atomic<uint32_t> s_next_shard(0);
+  thread_local uint32_t t_shard = s_next_shard.fetch_add(1);
+  return t_shard;
+}
+
+/** @class ObjectStorage
+ *
+ * Generational slot map owning a parent's objects. Insert and Remove are
+ * O(1): freed slots are reused and each object remembers its slot. A slot's
+ * generation is bumped every time it's freed so an object only matches the
+ * slot it was inserted in.
+ *
+ * Slots are split into kShardCount shards, each with its own lock. Insert
+ * uses the calling thread's shard and Remove locks the shard the object
+ * was inserted in, so Insert, Remove and ForEach are thread safe and
+ * threads creating objects at the same time rarely contend. Iterators and
+ * Clear aren't synchronized, only use them when no other thread can
+ * insert or remove.
+ *
+ * Handles are raw pointers, so a destroyed handle can't be recognized
+ * without dereferencing it. Debug builds keep a set of live objects per
+ * shard and assert on handles that aren't in any of them, e.g. double
+ * destroys. In release builds destroying a handle twice is undefined.
+ *
+ * Objects are allocated with Allocate() out of per shard slabs, chunks of
+ * kSlabChunkSize objects that are only freed with the storage. Each chunk
+ * has a mask of its free blocks and allocation takes the first free block
+ * of the first chunk that has one, so after warm-up creating an object
+ * doesn't allocate and live objects of a type stay packed together at the
+ * start of the slab no matter what order they were destroyed in.
+ *
+ * Iteration visits live objects in shard and slot order as Pointer&.
+ *
+ */
+template <typename T>
+class ObjectStorage {
+public:
+  static const uint32_t kShardCount     = 8;
+  // One bit per block in a chunk's free mask
+  static const uint32_t kSlabChunkSize  = 64;
+
+private:
+  struct Shard;
+
+public:
+  /** @class Deleter
+   *
+   * Destroys the object and returns its memory to the slab it came from.
+   *
+   */
+  class Deleter {
+  public:
+    Deleter() {}
+    explicit Deleter(Shard* p_shard) : m_p_shard(p_shard) {}
+
+    void operator()(T* p_object) const {
+      if (p_object != nullptr) {
+        ObjectStorage::Free(m_p_shard, p_object);
+      }
+    }
+
+    Shard* GetShard() const {
+      return m_p_shard;
+    }
+
+  private:
+    Shard* m_p_shard = nullptr;
+  };
+
+  using Pointer = std::unique_ptr<T, Deleter>;
+
+private:
+  struct Slot {
+    Pointer   object;
+    uint32_t  generation = 0;
+  };
+
+  using Block = typename std::aligned_storage<sizeof(T), alignof(T)>::type;
+
+  // Chunks are declared first so they outlive the objects in slots
+  struct Shard {
+    mutable std::mutex                    mutex;
+    uint32_t                              index = 0;
+    std::vector<std::unique_ptr<Block[]>> chunks;
+    // Bit i is set if block i of the chunk is free
+    std::vector<uint64_t>                 free_masks;
+    // No chunk before this one has a free block
+    uint32_t                              first_free_chunk = 0;
+    std::vector<Slot>                     slots;
+    std::vector<uint32_t>                 free_indices;
+#if !defined(NDEBUG)
+    // Objects inserted through this shard that haven't been removed
+    std::unordered_set<const T*>          live_objects;
+#endif
+  };
+
+  static void Free(Shard* p_shard, T* p_object) {
+    uint32_t block = p_object->m_storage_block;
+    p_object->~T();
+
+    uint32_t chunk_index = block / kSlabChunkSize;
+    std::lock_guard<std::mutex> lock(p_shard->mutex);
+    p_shard->free_masks[chunk_index] |= (1ULL << (block % kSlabChunkSize));
+    p_shard->first_free_chunk = std::min(p_shard->first_free_chunk, chunk_index);
+  }
+
+  template <typename ShardT, typename ReferenceT>
+  class Iterator {
+  public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type        = Pointer;
+    using difference_type   = std::ptrdiff_t;
+    using pointer           = typename std::remove_reference<ReferenceT>::type*;
+    using reference         = ReferenceT;
+
+    Iterator(ShardT* p_shards, uint32_t shard_index)
+      : m_p_shards(p_shards), m_shard_index(shard_index) {
+      SkipFree();
+    }
+
+    reference operator*() const {
+      return m_p_shards[m_shard_index].slots[m_slot_index].object;
+    }
+
+    pointer operator->() const {
+      return &m_p_shards[m_shard_index].slots[m_slot_index].object;
+    }
+
+    Iterator& operator++() {
+      ++m_slot_index;
+      SkipFree();
+      return *this;
+    }
+
+    Iterator operator++(int) {
+      Iterator r = *this;
+      ++(*this);
+      return r;
+    }
+
+    bool operator==(const Iterator& rhs) const {
+      return (m_shard_index == rhs.m_shard_index) && (m_slot_index == rhs.m_slot_index);
+    }
+
+    bool operator!=(const Iterator& rhs) const {
+      return !(*this == rhs);
+    }
+
+  private:
+    void SkipFree() {
+      while (m_shard_index < kShardCount) {
+        auto& slots = m_p_shards[m_shard_index].slots;
+        while ((m_slot_index < slots.size()) && !slots[m_slot_index].object) {
+          ++m_slot_index;
+        }
+        if (m_slot_index < slots.size()) {
+          return;
+        }
+        ++m_shard_index;
+        m_slot_index = 0;
+      }
+    }
+
+  private:
+    ShardT*   m_p_shards    = nullptr;
+    uint32_t  m_shard_index = 0;
+    size_t    m_slot_index  = 0;
+  };
+
+public:
+  using iterator       = Iterator<Shard, Pointer&>;
+  using const_iterator = Iterator<const Shard, const Pointer&>;
+
+  ObjectStorage() {
+    for (uint32_t i = 0; i < kShardCount; ++i) {
+      m_shards[i].index = i;
+    }
+  }
+  ~ObjectStorage() {}
+
+  ObjectStorage(const ObjectStorage&) = delete;
+  ObjectStorage& operator=(const ObjectStorage&) = delete;
+
+  iterator begin() {
+    return iterator(m_shards.data(), 0);
+  }
+
+  iterator end() {
+    return iterator(m_shards.data(), kShardCount);
+  }
+
+  const_iterator begin() const {
+    return const_iterator(m_shards.data(), 0);
+  }
+
+  const_iterator end() const {
+    return const_iterator(m_shards.data(), kShardCount);
+  }
+
+  /** @fn GetCount
+   *
+   */
+  uint32_t GetCount() const {
+    return m_count.load();
+  }
+
+  /** @fn IsEmpty
+   *
+   */
+  bool IsEmpty() const {
+    return (GetCount() == 0);
+  }
+
+  /** @fn Allocate
+   *
+   * Default constructs an object in the calling thread's slab. Pass it to
+   * Insert() to store it, or let it go out of scope to free it.
+   *
+   */
+  Pointer Allocate() {
+    Shard& shard = m_shards[GetThreadStorageShard() % kShardCount];
+
+    void*    p_block = nullptr;
+    uint32_t block   = UINT32_MAX;
+    {
+      std::lock_guard<std::mutex> lock(shard.mutex);
+      uint32_t chunk_count = CountU32(shard.chunks);
+      while ((shard.first_free_chunk < chunk_count) && (shard.free_masks[shard.first_free_chunk] == 0)) {
+        ++shard.first_free_chunk;
+      }
+      if (shard.first_free_chunk == chunk_count) {
+        shard.chunks.emplace_back(new Block[kSlabChunkSize]);
+        shard.free_masks.push_back(~0ULL);
+      }
+
+      uint32_t  chunk_index = shard.first_free_chunk;
+      uint64_t& free_mask   = shard.free_masks[chunk_index];
+      uint32_t  block_index = LowestSetBit(free_mask);
+      free_mask &= (free_mask - 1);
+      p_block = &shard.chunks[chunk_index][block_index];
+      block   = (chunk_index * kSlabChunkSize) + block_index;
+    }
+
+    T* p_object = new (p_block) T();
+    p_object->m_storage_block = block;
+    return Pointer(p_object, Deleter(&shard));
+  }
+
+  /** @fn Insert
+   *
+   * object must come from this storage's Allocate(), it's stored in the
+   * shard it was allocated from.
+   *
+   */
+  T* Insert(Pointer object) {
+    VKEX_ASSERT(object);
+
+    Shard* p_shard = object.get_deleter().GetShard();
+    VKEX_ASSERT((p_shard >= m_shards.data()) && (p_shard < (m_shards.data() + kShardCount)));
+
+    T*       raw_object  = object.get();
+    uint32_t shard_index = p_shard->index;
+    Shard&   shard       = *p_shard;
+    {
+      std::lock_guard<std::mutex> lock(shard.mutex);
+
+      uint32_t index = UINT32_MAX;
+      if (!shard.free_indices.empty()) {
+        index = shard.free_indices.back();
+        shard.free_indices.pop_back();
+      }
+      else {
+        index = CountU32(shard.slots);
+        shard.slots.emplace_back();
+      }
+
+      Slot& slot = shard.slots[index];
+      object->m_storage_shard      = shard_index;
+      object->m_storage_index      = index;
+      object->m_storage_generation = slot.generation;
+      slot.object = std::move(object);
+#if !defined(NDEBUG)
+      shard.live_objects.insert(raw_object);
+#endif
+    }
+    ++m_count;
+
+    return raw_object;
+  }
+
+  /** @fn Remove
+   *
+   * Returns the object if it was in the storage, ownership moves to the
+   * caller.
+   *
+   */
+  Pointer Remove(const T* object) {
+    if (object == nullptr) {
+      return nullptr;
+    }
+
+#if !defined(NDEBUG)
+    {
+      // Checked before the handle is dereferenced, its memory may be gone.
+      // The shard isn't known until then, so each one is looked in under
+      // its own lock.
+      bool live = false;
+      for (auto& shard : m_shards) {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        if (shard.live_objects.erase(object) > 0) {
+          live = true;
+          break;
+        }
+      }
+      VKEX_ASSERT_MSG(live, "Stale handle: object was already destroyed or belongs to another parent");
+      if (!live) {
+        return nullptr;
+      }
+    }
+#endif
+
+    uint32_t shard_index = object->m_storage_shard;
+    if (shard_index >= kShardCount) {
+      return nullptr;
+    }
+
+    Pointer removed;
+    {
+      Shard& shard = m_shards[shard_index];
+      std::lock_guard<std::mutex> lock(shard.mutex);
+
+      uint32_t index = object->m_storage_index;
+      bool matches = (index < shard.slots.size()) &&
+                     (shard.slots[index].object.get() == object) &&
+                     (shard.slots[index].generation == object->m_storage_generation);
+      if (!matches) {
+        return nullptr;
+      }
+
+      Slot& slot = shard.slots[index];
+      removed = std::move(slot.object);
+      slot.generation += 1;
+      shard.free_indices.push_back(index);
+    }
+    --m_count;
+
+    return removed;
+  }
+
+  /** @fn ForEach
+   *
+   * Calls fn with each live object while holding its shard's lock. fn must
+   * not insert into or remove from this storage.
+   *
+   */
+  template <typename Fn>
+  void ForEach(Fn fn) {
+    for (auto& shard : m_shards) {
+      std::lock_guard<std::mutex> lock(shard.mutex);
+      for (auto& slot : shard.slots) {
+        if (slot.object) {
+          fn(slot.object.get());
+        }
+      }
+    }
+  }
+
+  /** @fn ForEach
+   *
+   */
+  template <typename Fn>
+  void ForEach(Fn fn) const {
+    for (auto& shard : m_shards) {
+      std::lock_guard<std::mutex> lock(shard.mutex);
+      for (auto& slot : shard.slots) {
+        if (slot.object) {
+          fn(static_cast<const T*>(slot.object.get()));
+        }
+      }
+    }
+  }
+
+  /** @fn Clear
+   *
+   * Destroys every object, the slabs are kept for reuse.
+   *
+   */
+  void Clear() {
+    for (auto& shard : m_shards) {
+      shard.slots.clear();
+      shard.free_indices.clear();
+#if !defined(NDEBUG)
+      shard.live_objects.clear();
+#endif
+    }
+    m_count = 0;
+  }
+
+private:
+  std::array<Shard, kShardCount>          m_shards;
+  std::atomic<uint32_t>                   m_count{0};
+};
+
+/** @fn FindIf
+ *
+ */
+template <typename T, typename UnaryPredicate>
+typename ObjectStorage<T>::iterator FindIf(ObjectStorage<T>& container, UnaryPredicate pred)
+{
+  return std::find_if(std::begin(container), std::end(container), pred);
+}
+
+/** @fn FindIf
+ *
+ */
+template <typename T, typename UnaryPredicate>
+typename ObjectStorage<T>::const_iterator FindIf(const ObjectStorage<T>& container, UnaryPredicate pred)
+{
+  return std::find_if(std::begin(container), std::end(container), pred);
+}
+
 /** @class IObjectStorageFunctions
  *
  */
@@ -68,6 +543,46 @@ protected:
     return vkex::Result::Success;
   }
 
+  /** @fn CreateObject
+   *
+   */
+  template <
+    typename IObjectT,
+    typename SetParentMemberFnT,
+    typename ParentT,
+    typename CreateInfoT,
+    typename HandleT = typename std::add_pointer<IObjectT>::type,
+    typename PointerT = typename vkex::ObjectStorage<IObjectT>::Pointer
+  >
+  vkex::Result CreateObject(
+    const CreateInfoT&                create_info, 
+    const VkAllocationCallbacks*      p_allocator,
+    vkex::ObjectStorage<IObjectT>&    storage,
+    SetParentMemberFnT                p_set_parent_member_fn,
+    ParentT                           parent,  
+    HandleT*                          p_object
+  )
+  {
+    // Allocate object from the storage's slab
+    PointerT obj = storage.Allocate();
+    if (!obj) {
+      return vkex::Result::ErrorAllocationFailed;
+    }
+    // Set parent
+    HandleT raw_obj = obj.get();
+    (raw_obj->*p_set_parent_member_fn)(parent);
+    // Internal create
+    vkex::Result vkex_result = obj->InternalCreate(create_info, p_allocator);
+    if (!vkex_result) {
+      obj.reset();
+      return vkex_result;
+    }
+    // Store object
+    *p_object = storage.Insert(std::move(obj));
+    // Success
+    return vkex::Result::Success;
+  }
+
   /** @fn DestroyObject
    *
    */
@@ -113,6 +628,56 @@ protected:
     return vkex::Result::Success;
   }
 
+  /** @fn DestroyObject
+   *
+   */
+  template <
+    typename IObjectT,
+    typename HandleT = typename std::add_pointer<IObjectT>::type,
+    typename PointerT = typename vkex::ObjectStorage<IObjectT>::Pointer
+  >
+  vkex::Result DestroyObject(
+    vkex::ObjectStorage<IObjectT>&  storage,
+    HandleT                         object, 
+    const VkAllocationCallbacks*    p_allocator
+  )
+  {
+    // Take ownership, exit if object isn't stored
+    PointerT obj = storage.Remove(object);
+    if (!obj) {
+      return vkex::Result::Success;
+    }
+
+    vkex::Result vkex_result = obj->InternalDestroy(p_allocator);
+    if (!vkex_result) {
+      return vkex_result;
+    }
+
+    return vkex::Result::Success;
+  }
+
+  /** @fn DestroyAllObjects
+   *
+   */
+  template <
+    typename IObjectT
+  >
+  vkex::Result DestroyAllObjects(
+    vkex::ObjectStorage<IObjectT>&  storage,
+    const VkAllocationCallbacks*    p_allocator
+  )
+  {
+    for (auto& obj : storage) {
+      vkex::Result vkex_result = obj->InternalDestroy(p_allocator);
+      if (!vkex_result) {
+        return vkex_result;
+      }
+    }
+    storage.Clear();
+
+    return vkex::Result::Success;
+  }
+
   /** @fn DestroyAllObjects
    *
    */
@@ -140,7 +705,7 @@ protected:
 /** @class IDeviceObject
  *
  */
-class IDeviceObject {
+class IDeviceObject : public IStoredObject {
 public:
   vkex::Device GetDevice() const {
     return m_device;
@@ -0,0 +1,1239 @@
+/*
+ Copyright 2018-2019 Google Inc.
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+ http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+*/
+
+#include <vkex/UploadManager.h>
+#include <vkex/Device.h>
+
+namespace vkex {
+
+// Wait() drops the lock while it waits on a batch's fence. Another thread
+// may retire the batch and reset the fence meanwhile, the timeout makes
+// sure the batch gets checked again.
+const uint64_t kUploadFenceWaitTimeout = 1000000;
+
+// Smallest multiple of both the texel block size and 16 bytes, copies to
+// images need offsets that are multiples of the block size and of 4.
+static VkDeviceSize StagingAlignment(VkFormat format)
+{
+  VkDeviceSize block_size = std::max<VkDeviceSize>(vkex::FormatBlockSize(format), 1);
+  VkDeviceSize alignment  = block_size;
+  while ((alignment % 16) != 0) {
+    alignment += block_size;
+  }
+  return alignment;
+}
+
+static VkDeviceSize LeastCommonMultiple(VkDeviceSize a, VkDeviceSize b)
+{
+  VkDeviceSize x = a;
+  VkDeviceSize y = b;
+  while (y != 0) {
+    VkDeviceSize t = x % y;
+    x = y;
+    y = t;
+  }
+  return (a / x) * b;
+}
+
+// =================================================================================================
+// TransferToken
+// =================================================================================================
+bool TransferToken::IsComplete() const
+{
+  if (m_upload_manager == nullptr) {
+    return true;
+  }
+  return m_upload_manager->IsComplete(m_serial);
+}
+
+vkex::Result TransferToken::Wait() const
+{
+  if (m_upload_manager == nullptr) {
+    return vkex::Result::Success;
+  }
+  return m_upload_manager->Wait(m_serial);
+}
+
+// =================================================================================================
+// TransferBatch
+// =================================================================================================
+void TransferBatch::CopyToBuffer(
+  VkDeviceSize  size,
+  const void*   p_data,
+  vkex::Buffer  dst,
+  VkDeviceSize  dst_offset)
+{
+  VKEX_ASSERT((p_data != nullptr) && (dst != nullptr));
+
+  Operation operation   = {};
+  operation.type        = OPERATION_TYPE_COPY_TO_BUFFER;
+  operation.p_data      = p_data;
+  operation.size        = size;
+  operation.dst_buffer  = dst;
+  operation.dst_offset  = dst_offset;
+  m_operations.push_back(operation);
+}
+
+void TransferBatch::CopyToImage(
+  VkDeviceSize              size,
+  const void*               p_data,
+  vkex::Image               dst,
+  uint32_t                  region_count,
+  const VkBufferImageCopy*  p_regions)
+{
+  VKEX_ASSERT((p_data != nullptr) && (dst != nullptr));
+
+  Operation operation     = {};
+  operation.type          = OPERATION_TYPE_COPY_TO_IMAGE;
+  operation.p_data        = p_data;
+  operation.size          = size;
+  operation.dst_image     = dst;
+  operation.first_region  = CountU32(m_buffer_image_copies);
+  operation.region_count  = region_count;
+  m_buffer_image_copies.insert(m_buffer_image_copies.end(), p_regions, p_regions + region_count);
+  m_operations.push_back(operation);
+}
+
+void TransferBatch::CopyBuffer(
+  vkex::Buffer        src,
+  vkex::Buffer        dst,
+  uint32_t            region_count,
+  const VkBufferCopy* p_regions)
+{
+  VKEX_ASSERT((src != nullptr) && (dst != nullptr));
+
+  Operation operation     = {};
+  operation.type          = OPERATION_TYPE_COPY_BUFFER;
+  operation.src_buffer    = src;
+  operation.dst_buffer    = dst;
+  operation.first_region  = CountU32(m_buffer_copies);
+  operation.region_count  = region_count;
+  m_buffer_copies.insert(m_buffer_copies.end(), p_regions, p_regions + region_count);
+  m_operations.push_back(operation);
+}
+
+void TransferBatch::CopyImage(
+  vkex::Image         src,
+  vkex::Image         dst,
+  uint32_t            region_count,
+  const VkImageCopy*  p_regions)
+{
+  VKEX_ASSERT((src != nullptr) && (dst != nullptr));
+
+  Operation operation     = {};
+  operation.type          = OPERATION_TYPE_COPY_IMAGE;
+  operation.src_image     = src;
+  operation.dst_image     = dst;
+  operation.first_region  = CountU32(m_image_copies);
+  operation.region_count  = region_count;
+  m_image_copies.insert(m_image_copies.end(), p_regions, p_regions + region_count);
+  m_operations.push_back(operation);
+}
+
+void TransferBatch::CopyBufferToImage(
+  vkex::Buffer              src,
+  vkex::Image               dst,
+  uint32_t                  region_count,
+  const VkBufferImageCopy*  p_regions)
+{
+  VKEX_ASSERT((src != nullptr) && (dst != nullptr));
+
+  Operation operation     = {};
+  operation.type          = OPERATION_TYPE_COPY_BUFFER_TO_IMAGE;
+  operation.src_buffer    = src;
+  operation.dst_image     = dst;
+  operation.first_region  = CountU32(m_buffer_image_copies);
+  operation.region_count  = region_count;
+  m_buffer_image_copies.insert(m_buffer_image_copies.end(), p_regions, p_regions + region_count);
+  m_operations.push_back(operation);
+}
+
+void TransferBatch::TransitionImageLayout(
+  vkex::Image           image,
+  VkImageLayout         old_layout,
+  VkImageLayout         new_layout,
+  VkPipelineStageFlags  new_pipeline_stage)
+{
+  VKEX_ASSERT(image != nullptr);
+
+  Operation operation           = {};
+  operation.type                = OPERATION_TYPE_TRANSITION_IMAGE_LAYOUT;
+  operation.dst_image           = image;
+  operation.old_layout          = old_layout;
+  operation.new_layout          = new_layout;
+  operation.new_pipeline_stage  = new_pipeline_stage;
+  m_operations.push_back(operation);
+}
+
+void TransferBatch::Record(std::function<void(vkex::CommandBuffer)> fn)
+{
+  VKEX_ASSERT(fn);
+
+  Operation operation     = {};
+  operation.type          = OPERATION_TYPE_RECORD;
+  operation.record_index  = CountU32(m_record_fns);
+  m_record_fns.push_back(std::move(fn));
+  m_operations.push_back(operation);
+}
+
+void TransferBatch::Clear()
+{
+  m_operations.clear();
+  m_buffer_copies.clear();
+  m_image_copies.clear();
+  m_buffer_image_copies.clear();
+  m_record_fns.clear();
+}
+
+vkex::Result TransferBatch::Submit(vkex::Queue queue, vkex::TransferToken* p_token)
+{
+  return Submit(queue, nullptr, p_token);
+}
+
+vkex::Result TransferBatch::Submit(vkex::Queue queue, vkex::Queue owner_queue, vkex::TransferToken* p_token)
+{
+  VKEX_ASSERT(queue != nullptr);
+  if (queue == nullptr) {
+    return vkex::Result::ErrorUnexpectedNullPointer;
+  }
+
+  if (IsEmpty()) {
+    if (p_token != nullptr) {
+      *p_token = vkex::TransferToken();
+    }
+    return vkex::Result::Success;
+  }
+
+  vkex::UploadManager upload_manager = nullptr;
+  vkex::Result vkex_result = queue->GetDevice()->GetUploadManager(queue, &upload_manager);
+  if (!vkex_result) {
+    return vkex_result;
+  }
+
+  vkex_result = upload_manager->Submit(*this, owner_queue, p_token);
+  if (!vkex_result) {
+    return vkex_result;
+  }
+
+  Clear();
+
+  return vkex::Result::Success;
+}
+
+// =================================================================================================
+// UploadManager
+// =================================================================================================
+CUploadManager::CUploadManager()
+{
+}
+
+CUploadManager::~CUploadManager()
+{
+}
+
+vkex::Result CUploadManager::InternalCreate(
+  const vkex::UploadManagerCreateInfo&  create_info,
+  const VkAllocationCallbacks*          p_allocator
+)
+{
+  // Copy create info
+  m_create_info = create_info;
+
+  VKEX_ASSERT(m_create_info.queue != nullptr);
+  if (m_create_info.queue == nullptr) {
+    return vkex::Result::ErrorUnexpectedNullPointer;
+  }
+
+  if (m_create_info.staging_size == 0) {
+    return vkex::Result::ErrorBufferSizeMustBeGreaterThanZero;
+  }
+
+  if (m_create_info.batch_count == 0) {
+    return vkex::Result::ErrorCommandBufferCountMustNotBeZero;
+  }
+
+  // Command pool
+  {
+    vkex::CommandPoolCreateInfo create_info       = {};
+    create_info.flags.bits.transient              = true;
+    create_info.flags.bits.reset_command_buffer   = true;
+    create_info.queue_family_index                = m_create_info.queue->GetVkQueueFamilyIndex();
+    vkex::Result vkex_result = m_device->CreateCommandPool(create_info, &m_command_pool);
+    if (!vkex_result) {
+      return vkex_result;
+    }
+  }
+
+  // Staging ring, mapped for the lifetime of the manager
+  {
+    vkex::BufferCreateInfo create_info        = {};
+    create_info.size                          = m_create_info.staging_size;
+    create_info.usage_flags.bits.transfer_src = true;
+    create_info.committed                     = true;
+    create_info.memory_usage                  = VMA_MEMORY_USAGE_CPU_TO_GPU;
+    create_info.persistent_map                = true;
+    vkex::Result vkex_result = m_device->CreateBuffer(create_info, &m_staging_buffer);
+    if (!vkex_result) {
+      return vkex_result;
+    }
+    m_staging_address = static_cast<uint8_t*>(m_staging_buffer->GetMappedAddress());
+  }
+
+  // Batches
+  m_batches.resize(m_create_info.batch_count);
+  for (auto& batch : m_batches) {
+    vkex::CommandBufferAllocateInfo allocate_info = {};
+    allocate_info.command_buffer_count            = 1;
+    vkex::Result vkex_result = m_command_pool->AllocateCommandBuffer(allocate_info, &batch.command_buffer);
+    if (!vkex_result) {
+      return vkex_result;
+    }
+
+    vkex::FenceCreateInfo create_info = {};
+    vkex_result = m_device->CreateFence(create_info, &batch.fence);
+    if (!vkex_result) {
+      return vkex_result;
+    }
+  }
+
+  return vkex::Result::Success;
+}
+
+vkex::Result CUploadManager::InternalDestroy(const VkAllocationCallbacks* p_allocator)
+{
+  // Wait for everything in flight
+  if (!m_batches.empty()) {
+    vkex::Result vkex_result = WaitIdle();
+    if (!vkex_result) {
+      return vkex_result;
+    }
+  }
+
+  for (auto& batch : m_batches) {
+    if (batch.fence != nullptr) {
+      vkex::Result vkex_result = m_device->DestroyFence(batch.fence);
+      if (!vkex_result) {
+        return vkex_result;
+      }
+      batch.fence = nullptr;
+    }
+    if (batch.command_buffer != nullptr) {
+      m_command_pool->FreeCommandBuffer(batch.command_buffer);
+      batch.command_buffer = nullptr;
+    }
+  }
+  m_batches.clear();
+
+  // Handoffs that were never acquired still own their semaphores
+  for (auto& handoff : m_handoffs) {
+    m_free_semaphores.push_back(handoff.semaphore);
+  }
+  m_handoffs.clear();
+
+  for (auto& semaphore : m_free_semaphores) {
+    vkex::Result vkex_result = m_device->DestroySemaphore(semaphore);
+    if (!vkex_result) {
+      return vkex_result;
+    }
+  }
+  m_free_semaphores.clear();
+
+  if (m_staging_buffer != nullptr) {
+    vkex::Result vkex_result = m_device->DestroyBuffer(m_staging_buffer);
+    if (!vkex_result) {
+      return vkex_result;
+    }
+    m_staging_buffer  = nullptr;
+    m_staging_address = nullptr;
+  }
+
+  if (m_command_pool != nullptr) {
+    vkex::Result vkex_result = m_device->DestroyCommandPool(m_command_pool);
+    if (!vkex_result) {
+      return vkex_result;
+    }
+    m_command_pool = nullptr;
+  }
+
+  return vkex::Result::Success;
+}
+
+vkex::Result CUploadManager::GetRecordingBatch(Batch** pp_batch)
+{
+  Batch* p_batch = &m_batches[m_batch_index];
+  if (!p_batch->recording) {
+    // Batches are reused round robin so this is always the oldest one
+    if (p_batch->submitted) {
+      vkex::Result vkex_result = RetireBatch(p_batch);
+      if (!vkex_result) {
+        return vkex_result;
+      }
+    }
+
+    vkex::Result vkex_result = p_batch->command_buffer->Begin(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+    if (!vkex_result) {
+      return vkex_result;
+    }
+    p_batch->recording = true;
+  }
+
+  *pp_batch = p_batch;
+
+  return vkex::Result::Success;
+}
+
+vkex::Result CUploadManager::SubmitBatch(Batch* p_batch, vkex::Semaphore signal_semaphore)
+{
+  VKEX_ASSERT(p_batch->recording);
+
+  // Staged data must reach the device before the copies read it, this is
+  // a no-op for coherent memory
+  {
+    vkex::Result vkex_result = m_staging_buffer->Flush();
+    if (!vkex_result) {
+      return vkex_result;
+    }
+    for (auto& buffer : p_batch->dedicated_buffers) {
+      vkex_result = buffer->Flush();
+      if (!vkex_result) {
+        return vkex_result;
+      }
+    }
+  }
+
+  // Make every transfer in the batch visible to later commands on the
+  // queue, including ones in later submissions.
+  {
+    VkMemoryBarrier barrier = { VK_STRUCTURE_TYPE_MEMORY_BARRIER };
+    barrier.srcAccessMask   = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask   = VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+    p_batch->command_buffer->CmdPipelineBarrier(
+      VK_PIPELINE_STAGE_TRANSFER_BIT,
+      VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+      0,
+      1, &barrier,
+      0, nullptr,
+      0, nullptr);
+  }
+
+  vkex::Result vkex_result = p_batch->command_buffer->End();
+  if (!vkex_result) {
+    return vkex_result;
+  }
+
+  vkex::SubmitInfo submit_info;
+  submit_info.AddCommandBuffer(p_batch->command_buffer);
+  submit_info.SetFence(p_batch->fence);
+  if (signal_semaphore != nullptr) {
+    submit_info.AddSignalSemaphore(signal_semaphore);
+  }
+  vkex_result = m_create_info.queue->Submit(submit_info);
+  if (!vkex_result) {
+    return vkex_result;
+  }
+
+  p_batch->serial       = m_next_serial++;
+  p_batch->staging_end  = m_staging_head;
+  p_batch->recording    = false;
+  p_batch->submitted    = true;
+
+  m_batch_index = (m_batch_index + 1) % CountU32(m_batches);
+
+  return vkex::Result::Success;
+}
+
+vkex::Result CUploadManager::RetireBatch(Batch* p_batch)
+{
+  VKEX_ASSERT(p_batch->submitted);
+
+  VkResult vk_result = p_batch->fence->WaitForAndResetFence();
+  if (vk_result != VK_SUCCESS) {
+    return vkex::Result(vk_result);
+  }
+
+  for (auto& buffer : p_batch->dedicated_buffers) {
+    vkex::Result vkex_result = m_device->DestroyBuffer(buffer);
+    if (!vkex_result) {
+      return vkex_result;
+    }
+  }
+  p_batch->dedicated_buffers.clear();
+
+  m_staging_tail      = std::max(m_staging_tail, p_batch->staging_end);
+  m_completed_serial  = std::max(m_completed_serial, p_batch->serial);
+  p_batch->submitted  = false;
+
+  return vkex::Result::Success;
+}
+
+vkex::Result CUploadManager::RetireOldestBatch()
+{
+  Batch* p_oldest = nullptr;
+  for (auto& batch : m_batches) {
+    if (batch.submitted && ((p_oldest == nullptr) || (batch.serial < p_oldest->serial))) {
+      p_oldest = &batch;
+    }
+  }
+
+  if (p_oldest == nullptr) {
+    return vkex::Result::Success;
+  }
+
+  return RetireBatch(p_oldest);
+}
+
+vkex::Result CUploadManager::AllocateStaging(
+  VkDeviceSize    size,
+  VkDeviceSize    alignment,
+  vkex::Buffer*   p_buffer,
+  VkDeviceSize*   p_offset,
+  void**          pp_mapped_address)
+{
+  const VkDeviceSize capacity = m_create_info.staging_size;
+
+  // Too big for the ring, use a buffer that lives as long as the batch
+  if (size > capacity) {
+    vkex::Buffer buffer = nullptr;
+    {
+      vkex::BufferCreateInfo create_info        = {};
+      create_info.size                          = size;
+      create_info.usage_flags.bits.transfer_src = true;
+      create_info.committed                     = true;
+      create_info.memory_usage                  = VMA_MEMORY_USAGE_CPU_TO_GPU;
+      vkex::Result vkex_result = m_device->CreateBuffer(create_info, &buffer);
+      if (!vkex_result) {
+        return vkex_result;
+      }
+    }
+
+    VkResult vk_result = buffer->MapMemory(pp_mapped_address);
+    if (vk_result != VK_SUCCESS) {
+      m_device->DestroyBuffer(buffer);
+      return vkex::Result(vk_result);
+    }
+
+    Batch* p_batch = nullptr;
+    vkex::Result vkex_result = GetRecordingBatch(&p_batch);
+    if (!vkex_result) {
+      m_device->DestroyBuffer(buffer);
+      return vkex_result;
+    }
+    p_batch->dedicated_buffers.push_back(buffer);
+
+    *p_buffer = buffer;
+    *p_offset = 0;
+    return vkex::Result::Success;
+  }
+
+  while (true) {
+    // Allocations never straddle the end of the ring
+    uint64_t offset = ((m_staging_head + alignment - 1) / alignment) * alignment;
+    uint64_t physical_offset = offset % capacity;
+    if ((physical_offset + size) > capacity) {
+      offset += capacity - physical_offset;
+    }
+
+    if ((offset + size - m_staging_tail) <= capacity) {
+      m_staging_head = offset + size;
+      *p_buffer = m_staging_buffer;
+      *p_offset = offset % capacity;
+      *pp_mapped_address = m_staging_address + (offset % capacity);
+      break;
+    }
+
+    bool has_submitted = false;
+    for (auto& batch : m_batches) {
+      has_submitted |= batch.submitted;
+    }
+
+    vkex::Result vkex_result = vkex::Result::Success;
+    if (has_submitted) {
+      // Wait for the oldest batch to release its part of the ring
+      vkex_result = RetireOldestBatch();
+    }
+    else if (m_staging_head != m_staging_tail) {
+      // Only the recording batch is holding staging memory
+      Batch* p_batch = &m_batches[m_batch_index];
+      vkex_result = SubmitBatch(p_batch);
+    }
+    else {
+      // Ring is empty, restart at the beginning
+      m_staging_head = 0;
+      m_staging_tail = 0;
+    }
+    if (!vkex_result) {
+      return vkex_result;
+    }
+  }
+
+  return vkex::Result::Success;
+}
+
+vkex::Result CUploadManager::GetHandoffSemaphore(vkex::Semaphore* p_semaphore)
+{
+  if (!m_free_semaphores.empty()) {
+    *p_semaphore = m_free_semaphores.back();
+    m_free_semaphores.pop_back();
+    return vkex::Result::Success;
+  }
+
+  // Acquire barriers can be for any stage
+  vkex::SemaphoreCreateInfo create_info = {};
+  create_info.wait_dst_stage_mask       = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+  return m_device->CreateSemaphore(create_info, p_semaphore);
+}
+
+vkex::Result CUploadManager::CopyToBuffer(
+  VkDeviceSize  size,
+  const void*   p_data,
+  vkex::Buffer  dst,
+  VkDeviceSize  dst_offset)
+{
+  VKEX_ASSERT(dst != nullptr);
+  if ((dst == nullptr) || (p_data == nullptr)) {
+    return vkex::Result::ErrorUnexpectedNullPointer;
+  }
+
+  std::lock_guard<std::mutex> lock(m_mutex);
+
+  vkex::Buffer  staging_buffer = nullptr;
+  VkDeviceSize  staging_offset = 0;
+  void*         p_staging      = nullptr;
+  vkex::Result vkex_result = AllocateStaging(size, 16, &staging_buffer, &staging_offset, &p_staging);
+  if (!vkex_result) {
+    return vkex_result;
+  }
+  std::memcpy(p_staging, p_data, static_cast<size_t>(size));
+
+  Batch* p_batch = nullptr;
+  vkex_result = GetRecordingBatch(&p_batch);
+  if (!vkex_result) {
+    return vkex_result;
+  }
+
+  VkBufferCopy region = {};
+  region.srcOffset    = staging_offset;
+  region.dstOffset    = dst_offset;
+  region.size         = size;
+  p_batch->command_buffer->CmdCopyBuffer(*staging_buffer, *dst, 1, &region);
+
+  return vkex::Result::Success;
+}
+
+vkex::Result CUploadManager::CopyToImage(
+  VkDeviceSize              size,
+  const void*               p_data,
+  vkex::Image               dst,
+  uint32_t                  region_count,
+  const VkBufferImageCopy*  p_regions)
+{
+  VKEX_ASSERT(dst != nullptr);
+  if ((dst == nullptr) || (p_data == nullptr) || (p_regions == nullptr)) {
+    return vkex::Result::ErrorUnexpectedNullPointer;
+  }
+
+  std::lock_guard<std::mutex> lock(m_mutex);
+
+  vkex::Buffer  staging_buffer = nullptr;
+  VkDeviceSize  staging_offset = 0;
+  void*         p_staging      = nullptr;
+  vkex::Result vkex_result = AllocateStaging(
+    size,
+    StagingAlignment(dst->GetFormat()),
+    &staging_buffer,
+    &staging_offset,
+    &p_staging);
+  if (!vkex_result) {
+    return vkex_result;
+  }
+  std::memcpy(p_staging, p_data, static_cast<size_t>(size));
+
+  Batch* p_batch = nullptr;
+  vkex_result = GetRecordingBatch(&p_batch);
+  if (!vkex_result) {
+    return vkex_result;
+  }
+
+  std::vector<VkBufferImageCopy> regions(p_regions, p_regions + region_count);
+  for (auto& region : regions) {
+    region.bufferOffset += staging_offset;
+  }
+  p_batch->command_buffer->CmdCopyBufferToImage(
+    *staging_buffer,
+    *dst,
+    VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+    CountU32(regions),
+    DataPtr(regions));
+
+  return vkex::Result::Success;
+}
+
+vkex::Result CUploadManager::CopyBuffer(
+  vkex::Buffer        src,
+  vkex::Buffer        dst,
+  uint32_t            region_count,
+  const VkBufferCopy* p_regions)
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+
+  Batch* p_batch = nullptr;
+  vkex::Result vkex_result = GetRecordingBatch(&p_batch);
+  if (!vkex_result) {
+    return vkex_result;
+  }
+
+  p_batch->command_buffer->CmdCopyBuffer(*src, *dst, region_count, p_regions);
+
+  return vkex::Result::Success;
+}
+
+vkex::Result CUploadManager::CopyImage(
+  vkex::Image         src,
+  vkex::Image         dst,
+  uint32_t            region_count,
+  const VkImageCopy*  p_regions)
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+
+  Batch* p_batch = nullptr;
+  vkex::Result vkex_result = GetRecordingBatch(&p_batch);
+  if (!vkex_result) {
+    return vkex_result;
+  }
+
+  p_batch->command_buffer->CmdCopyImage(
+    *src,
+    VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+    *dst,
+    VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+    region_count,
+    p_regions);
+
+  return vkex::Result::Success;
+}
+
+vkex::Result CUploadManager::CopyBufferToImage(
+  vkex::Buffer              src,
+  vkex::Image               dst,
+  uint32_t                  region_count,
+  const VkBufferImageCopy*  p_regions)
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+
+  Batch* p_batch = nullptr;
+  vkex::Result vkex_result = GetRecordingBatch(&p_batch);
+  if (!vkex_result) {
+    return vkex_result;
+  }
+
+  p_batch->command_buffer->CmdCopyBufferToImage(
+    *src,
+    *dst,
+    VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+    region_count,
+    p_regions);
+
+  return vkex::Result::Success;
+}
+
+vkex::Result CUploadManager::TransitionImageLayout(
+  vkex::Image           image,
+  VkImageLayout         old_layout,
+  VkImageLayout         new_layout,
+  VkPipelineStageFlags  new_pipeline_stage)
+{
+  VKEX_ASSERT(image != nullptr);
+  if (image == nullptr) {
+    return vkex::Result::ErrorUnexpectedNullPointer;
+  }
+
+  std::lock_guard<std::mutex> lock(m_mutex);
+
+  Batch* p_batch = nullptr;
+  vkex::Result vkex_result = GetRecordingBatch(&p_batch);
+  if (!vkex_result) {
+    return vkex_result;
+  }
+
+  p_batch->command_buffer->CmdTransitionImageLayout(
+    *image,
+    image->GetAspectFlags(),
+    0,
+    image->GetMipLevels(),
+    0,
+    image->GetArrayLayers(),
+    old_layout,
+    new_layout,
+    new_pipeline_stage);
+
+  return vkex::Result::Success;
+}
+
+vkex::Result CUploadManager::Flush(uint64_t* p_serial)
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+
+  Batch* p_batch = &m_batches[m_batch_index];
+  if (p_batch->recording) {
+    vkex::Result vkex_result = SubmitBatch(p_batch);
+    if (!vkex_result) {
+      return vkex_result;
+    }
+  }
+
+  if (p_serial != nullptr) {
+    *p_serial = m_next_serial - 1;
+  }
+
+  return vkex::Result::Success;
+}
+
+vkex::Result CUploadManager::Wait(uint64_t serial)
+{
+  std::unique_lock<std::mutex> lock(m_mutex);
+
+  VKEX_ASSERT(serial < m_next_serial);
+  while (m_completed_serial < serial) {
+    Batch* p_oldest = nullptr;
+    for (auto& batch : m_batches) {
+      if (batch.submitted && ((p_oldest == nullptr) || (batch.serial < p_oldest->serial))) {
+        p_oldest = &batch;
+      }
+    }
+    if (p_oldest == nullptr) {
+      break;
+    }
+
+    // Other threads keep uploading while this one waits
+    vkex::Fence fence        = p_oldest->fence;
+    uint64_t    batch_serial = p_oldest->serial;
+    lock.unlock();
+    VkResult vk_result = fence->WaitForFence(kUploadFenceWaitTimeout);
+    lock.lock();
+    if ((vk_result != VK_SUCCESS) && (vk_result != VK_TIMEOUT)) {
+      return vkex::Result(vk_result);
+    }
+
+    // Retire it unless another thread already has
+    if ((vk_result == VK_SUCCESS) && p_oldest->submitted && (p_oldest->serial == batch_serial)) {
+      vkex::Result vkex_result = RetireBatch(p_oldest);
+      if (!vkex_result) {
+        return vkex_result;
+      }
+    }
+  }
+
+  return vkex::Result::Success;
+}
+
+bool CUploadManager::IsComplete(uint64_t serial)
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+
+  if (m_completed_serial >= serial) {
+    return true;
+  }
+
+  for (auto& batch : m_batches) {
+    if (batch.submitted && (batch.serial == serial)) {
+      return (batch.fence->GetFenceStatus() == VK_SUCCESS);
+    }
+  }
+
+  // Not submitted yet
+  return false;
+}
+
+vkex::Result CUploadManager::Submit(const vkex::TransferBatch& transfer_batch, vkex::TransferToken* p_token)
+{
+  return Submit(transfer_batch, nullptr, p_token);
+}
+
+vkex::Result CUploadManager::Submit(
+  const vkex::TransferBatch&  transfer_batch,
+  vkex::Queue                 owner_queue,
+  vkex::TransferToken*        p_token)
+{
+  using Operation = vkex::TransferBatch::Operation;
+
+  const bool      handoff             = (owner_queue != nullptr) && (owner_queue != m_create_info.queue);
+  const uint32_t  src_family_index    = m_create_info.queue->GetVkQueueFamilyIndex();
+  const uint32_t  dst_family_index    = handoff ? owner_queue->GetVkQueueFamilyIndex() : src_family_index;
+  const bool      transfer_ownership  = (dst_family_index != src_family_index);
+
+  // Every resource the batch writes is released once at the end. An image's
+  // last transition is folded into its release if nothing is copied to the
+  // image after it.
+  struct Release {
+    vkex::Image           image;
+    vkex::Buffer          buffer;
+    size_t                transition_index;
+    VkImageLayout         old_layout;
+    VkImageLayout         new_layout;
+    VkPipelineStageFlags  dst_stage_mask;
+  };
+  std::vector<Release> releases;
+  std::vector<bool>    folded(transfer_batch.m_operations.size(), false);
+  if (transfer_ownership) {
+    for (size_t i = 0; i < transfer_batch.m_operations.size(); ++i) {
+      const Operation& operation = transfer_batch.m_operations[i];
+      if (operation.type == vkex::TransferBatch::OPERATION_TYPE_RECORD) {
+        continue;
+      }
+      Release* p_release = nullptr;
+      for (auto& release : releases) {
+        if ((release.image == operation.dst_image) && (release.buffer == operation.dst_buffer)) {
+          p_release = &release;
+          break;
+        }
+      }
+      if (p_release == nullptr) {
+        Release release = {};
+        release.image   = operation.dst_image;
+        release.buffer  = operation.dst_buffer;
+        releases.push_back(release);
+        p_release = &releases.back();
+      }
+
+      if (operation.type == vkex::TransferBatch::OPERATION_TYPE_TRANSITION_IMAGE_LAYOUT) {
+        p_release->transition_index = i;
+        p_release->old_layout       = operation.old_layout;
+        p_release->new_layout       = operation.new_layout;
+        p_release->dst_stage_mask   = operation.new_pipeline_stage;
+      }
+      else {
+        p_release->transition_index = SIZE_MAX;
+        p_release->old_layout       = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        p_release->new_layout       = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        p_release->dst_stage_mask   = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+      }
+    }
+
+    for (auto& release : releases) {
+      if (release.transition_index != SIZE_MAX) {
+        folded[release.transition_index] = true;
+      }
+    }
+  }
+
+  std::lock_guard<std::mutex> lock(m_mutex);
+
+  // Anything already recorded goes first so the transfer batch gets a
+  // command buffer of its own
+  {
+    Batch* p_batch = &m_batches[m_batch_index];
+    if (p_batch->recording) {
+      vkex::Result vkex_result = SubmitBatch(p_batch);
+      if (!vkex_result) {
+        return vkex_result;
+      }
+    }
+  }
+
+  vkex::Semaphore semaphore = nullptr;
+  if (handoff) {
+    vkex::Result vkex_result = GetHandoffSemaphore(&semaphore);
+    if (!vkex_result) {
+      return vkex_result;
+    }
+  }
+
+  // Lay out all staged data in one allocation
+  std::vector<VkDeviceSize> staging_offsets(transfer_batch.m_operations.size(), 0);
+  VkDeviceSize staging_size      = 0;
+  VkDeviceSize staging_alignment = 16;
+  for (size_t i = 0; i < transfer_batch.m_operations.size(); ++i) {
+    const Operation& operation = transfer_batch.m_operations[i];
+    VkDeviceSize alignment = 0;
+    if (operation.type == vkex::TransferBatch::OPERATION_TYPE_COPY_TO_BUFFER) {
+      alignment = 16;
+    }
+    else if (operation.type == vkex::TransferBatch::OPERATION_TYPE_COPY_TO_IMAGE) {
+      alignment = StagingAlignment(operation.dst_image->GetFormat());
+    }
+    else {
+      continue;
+    }
+    staging_offsets[i] = ((staging_size + alignment - 1) / alignment) * alignment;
+    staging_size       = staging_offsets[i] + operation.size;
+    staging_alignment  = LeastCommonMultiple(staging_alignment, alignment);
+  }
+
+  vkex::Buffer  staging_buffer = nullptr;
+  VkDeviceSize  staging_base   = 0;
+  if (staging_size > 0) {
+    void* p_staging = nullptr;
+    vkex::Result vkex_result = AllocateStaging(staging_size, staging_alignment, &staging_buffer, &staging_base, &p_staging);
+    if (!vkex_result) {
+      if (semaphore != nullptr) {
+        m_free_semaphores.push_back(semaphore);
+      }
+      return vkex_result;
+    }
+
+    for (size_t i = 0; i < transfer_batch.m_operations.size(); ++i) {
+      const Operation& operation = transfer_batch.m_operations[i];
+      if (operation.p_data != nullptr) {
+        std::memcpy(
+          static_cast<uint8_t*>(p_staging) + staging_offsets[i], 
+          operation.p_data, 
+          static_cast<size_t>(operation.size));
+      }
+    }
+  }
+
+  Batch* p_batch = nullptr;
+  vkex::Result vkex_result = GetRecordingBatch(&p_batch);
+  if (!vkex_result) {
+    if (semaphore != nullptr) {
+      m_free_semaphores.push_back(semaphore);
+    }
+    return vkex_result;
+  }
+
+  vkex::CommandBuffer command_buffer = p_batch->command_buffer;
+  std::vector<VkBufferImageCopy> staged_regions;
+  for (size_t i = 0; i < transfer_batch.m_operations.size(); ++i) {
+    const Operation& operation = transfer_batch.m_operations[i];
+    switch (operation.type) {
+      case vkex::TransferBatch::OPERATION_TYPE_COPY_TO_BUFFER: {
+        VkBufferCopy region = {};
+        region.srcOffset    = staging_base + staging_offsets[i];
+        region.dstOffset    = operation.dst_offset;
+        region.size         = operation.size;
+        command_buffer->CmdCopyBuffer(*staging_buffer, *operation.dst_buffer, 1, &region);
+      } break;
+
+      case vkex::TransferBatch::OPERATION_TYPE_COPY_TO_IMAGE: {
+        const VkBufferImageCopy* p_regions = &transfer_batch.m_buffer_image_copies[operation.first_region];
+        staged_regions.assign(p_regions, p_regions + operation.region_count);
+        for (auto& region : staged_regions) {
+          region.bufferOffset += staging_base + staging_offsets[i];
+        }
+        command_buffer->CmdCopyBufferToImage(
+          *staging_buffer,
+          *operation.dst_image,
+          VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+          CountU32(staged_regions),
+          DataPtr(staged_regions));
+      } break;
+
+      case vkex::TransferBatch::OPERATION_TYPE_COPY_BUFFER: {
+        command_buffer->CmdCopyBuffer(
+          *operation.src_buffer,
+          *operation.dst_buffer,
+          operation.region_count,
+          &transfer_batch.m_buffer_copies[operation.first_region]);
+      } break;
+
+      case vkex::TransferBatch::OPERATION_TYPE_COPY_IMAGE: {
+        command_buffer->CmdCopyImage(
+          *operation.src_image,
+          VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+          *operation.dst_image,
+          VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+          operation.region_count,
+          &transfer_batch.m_image_copies[operation.first_region]);
+      } break;
+
+      case vkex::TransferBatch::OPERATION_TYPE_COPY_BUFFER_TO_IMAGE: {
+        command_buffer->CmdCopyBufferToImage(
+          *operation.src_buffer,
+          *operation.dst_image,
+          VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+          operation.region_count,
+          &transfer_batch.m_buffer_image_copies[operation.first_region]);
+      } break;
+
+      case vkex::TransferBatch::OPERATION_TYPE_TRANSITION_IMAGE_LAYOUT: {
+        // Performed by the release barrier
+        if (folded[i]) {
+          break;
+        }
+        vkex::Image image = operation.dst_image;
+        command_buffer->CmdTransitionImageLayout(
+          *image,
+          image->GetAspectFlags(),
+          0,
+          image->GetMipLevels(),
+          0,
+          image->GetArrayLayers(),
+          operation.old_layout,
+          operation.new_layout,
+          operation.new_pipeline_stage);
+      } break;
+
+      case vkex::TransferBatch::OPERATION_TYPE_RECORD: {
+        transfer_batch.m_record_fns[operation.record_index](command_buffer);
+      } break;
+    }
+  }
+
+  // Release barriers, the matching acquires are recorded on the owner queue
+  Handoff pending = {};
+  if (transfer_ownership) {
+    std::vector<VkImageMemoryBarrier>  image_barriers;
+    std::vector<VkBufferMemoryBarrier> buffer_barriers;
+    for (auto& release : releases) {
+      if (release.image != nullptr) {
+        vkex::Image image     = release.image;
+        const bool  exclusive = (image->GetSharingMode() == VK_SHARING_MODE_EXCLUSIVE);
+        VkImageMemoryBarrier barrier            = { VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER };
+        barrier.srcAccessMask                   = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask                   = 0;
+        barrier.oldLayout                       = release.old_layout;
+        barrier.newLayout                       = release.new_layout;
+        barrier.srcQueueFamilyIndex             = exclusive ? src_family_index : VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex             = exclusive ? dst_family_index : VK_QUEUE_FAMILY_IGNORED;
+        barrier.image                           = *image;
+        barrier.subresourceRange.aspectMask     = image->GetAspectFlags();
+        barrier.subresourceRange.baseMipLevel   = 0;
+        barrier.subresourceRange.levelCount     = image->GetMipLevels();
+        barrier.subresourceRange.baseArrayLayer = 0;
+        barrier.subresourceRange.layerCount     = image->GetArrayLayers();
+        image_barriers.push_back(barrier);
+
+        if (exclusive) {
+          barrier.srcAccessMask = 0;
+          barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+          pending.image_barriers.push_back(barrier);
+          pending.dst_stage_mask |= release.dst_stage_mask;
+        }
+      }
+      else if (release.buffer->GetSharingMode() == VK_SHARING_MODE_EXCLUSIVE) {
+        VkBufferMemoryBarrier barrier = { VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER };
+        barrier.srcAccessMask         = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask         = 0;
+        barrier.srcQueueFamilyIndex   = src_family_index;
+        barrier.dstQueueFamilyIndex   = dst_family_index;
+        barrier.buffer                = *release.buffer;
+        barrier.offset                = 0;
+        barrier.size                  = VK_WHOLE_SIZE;
+        buffer_barriers.push_back(barrier);
+
+        barrier.srcAccessMask = 0;
+        barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+        pending.buffer_barriers.push_back(barrier);
+        pending.dst_stage_mask |= release.dst_stage_mask;
+      }
+    }
+
+    if (!image_barriers.empty() || !buffer_barriers.empty()) {
+      command_buffer->CmdPipelineBarrier(
+        VK_PIPELINE_STAGE_TRANSFER_BIT,
+        VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+        0,
+        0, nullptr,
+        CountU32(buffer_barriers), DataPtr(buffer_barriers),
+        CountU32(image_barriers), DataPtr(image_barriers));
+    }
+  }
+
+  vkex_result = SubmitBatch(p_batch, semaphore);
+  if (!vkex_result) {
+    if (semaphore != nullptr) {
+      m_free_semaphores.push_back(semaphore);
+    }
+    return vkex_result;
+  }
+
+  if (handoff) {
+    pending.queue     = owner_queue;
+    pending.semaphore = semaphore;
+    m_handoffs.push_back(std::move(pending));
+  }
+
+  if (p_token != nullptr) {
+    p_token->m_upload_manager = this;
+    p_token->m_serial         = p_batch->serial;
+  }
+
+  return vkex::Result::Success;
+}
+
+bool CUploadManager::HasPendingHandoffs(vkex::Queue queue)
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+
+  for (auto& handoff : m_handoffs) {
+    if (handoff.queue == queue) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+vkex::Result CUploadManager::AcquireHandoffs(
+  vkex::Queue                   queue,
+  vkex::CommandBuffer           command_buffer,
+  std::vector<vkex::Semaphore>* p_wait_semaphores)
+{
+  VKEX_ASSERT((command_buffer != nullptr) && (p_wait_semaphores != nullptr));
+  if ((command_buffer == nullptr) || (p_wait_semaphores == nullptr)) {
+    return vkex::Result::ErrorUnexpectedNullPointer;
+  }
+
+  std::lock_guard<std::mutex> lock(m_mutex);
+
+  std::vector<VkImageMemoryBarrier>  image_barriers;
+  std::vector<VkBufferMemoryBarrier> buffer_barriers;
+  VkPipelineStageFlags               dst_stage_mask = 0;
+  auto it = m_handoffs.begin();
+  while (it != m_handoffs.end()) {
+    if (it->queue != queue) {
+      ++it;
+      continue;
+    }
+    image_barriers.insert(image_barriers.end(), it->image_barriers.begin(), it->image_barriers.end());
+    buffer_barriers.insert(buffer_barriers.end(), it->buffer_barriers.begin(), it->buffer_barriers.end());
+    dst_stage_mask |= it->dst_stage_mask;
+    p_wait_semaphores->push_back(it->semaphore);
+    it = m_handoffs.erase(it);
+  }
+
+  if (!image_barriers.empty() || !buffer_barriers.empty()) {
+    command_buffer->CmdPipelineBarrier(
+      VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+      dst_stage_mask,
+      0,
+      0, nullptr,
+      CountU32(buffer_barriers), DataPtr(buffer_barriers),
+      CountU32(image_barriers), DataPtr(image_barriers));
+  }
+
+  return vkex::Result::Success;
+}
+
+void CUploadManager::RecycleSemaphores(const std::vector<vkex::Semaphore>& semaphores)
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+
+  m_free_semaphores.insert(m_free_semaphores.end(), semaphores.begin(), semaphores.end());
+}
+
+vkex::Result CUploadManager::WaitIdle()
+{
+  uint64_t serial = 0;
+  vkex::Result vkex_result = Flush(&serial);
+  if (!vkex_result) {
+    return vkex_result;
+  }
+
+  return Wait(serial);
+}
+
+} // namespace vkex
@@ -0,0 +1,479 @@
+/*
+ Copyright 2018-2019 Google Inc.
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+ http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+*/
+
+#ifndef __VKEX_UPLOAD_MANAGER_H__
+#define __VKEX_UPLOAD_MANAGER_H__
+
+#include <vkex/Config.h>
+#include <vkex/Traits.h>
+#include <vkex/VulkanUtil.h>
+
+#include <functional>
+
+namespace vkex {
+
+// =================================================================================================
+// UploadManager
+// =================================================================================================
+
+/** @struct UploadManagerCreateInfo
+ *
+ */
+struct UploadManagerCreateInfo {
+  vkex::Queue   queue;
+  // Size of the persistently mapped staging ring
+  VkDeviceSize  staging_size;
+  // Number of batches that can be in flight before recording waits
+  uint32_t      batch_count;
+};
+
+/** @class TransferToken
+ *
+ * Identifies a submitted TransferBatch.
+ *
+ */
+class TransferToken {
+public:
+  /** @fn IsValid
+   *
+   */
+  bool IsValid() const {
+    return (m_upload_manager != nullptr);
+  }
+
+  /** @fn IsComplete
+   *
+   */
+  bool IsComplete() const;
+
+  /** @fn Wait
+   *
+   */
+  vkex::Result Wait() const;
+
+private:
+  friend class CUploadManager;
+
+  vkex::UploadManager m_upload_manager = nullptr;
+  uint64_t            m_serial = 0;
+};
+
+/** @class TransferBatch
+ *
+ * Collects transfers and layout transitions on the CPU so they can be
+ * recorded into one command buffer and submitted with a single fence.
+ *
+ * Nothing is copied until Submit(), p_data passed to CopyToBuffer and
+ * CopyToImage must stay valid until then. Source resources must stay
+ * valid until the returned token has completed.
+ *
+ */
+class TransferBatch {
+public:
+  TransferBatch() {}
+  ~TransferBatch() {}
+
+  /** @fn CopyToBuffer
+   *
+   */
+  void CopyToBuffer(
+    VkDeviceSize  size,
+    const void*   p_data,
+    vkex::Buffer  dst,
+    VkDeviceSize  dst_offset = 0);
+
+  /** @fn CopyToImage
+   *
+   * bufferOffset in each region is relative to p_data.
+   *
+   */
+  void CopyToImage(
+    VkDeviceSize              size,
+    const void*               p_data,
+    vkex::Image               dst,
+    uint32_t                  region_count,
+    const VkBufferImageCopy*  p_regions);
+
+  /** @fn CopyBuffer
+   *
+   */
+  void CopyBuffer(
+    vkex::Buffer        src,
+    vkex::Buffer        dst,
+    uint32_t            region_count,
+    const VkBufferCopy* p_regions);
+
+  /** @fn CopyImage
+   *
+   */
+  void CopyImage(
+    vkex::Image         src,
+    vkex::Image         dst,
+    uint32_t            region_count,
+    const VkImageCopy*  p_regions);
+
+  /** @fn CopyBufferToImage
+   *
+   */
+  void CopyBufferToImage(
+    vkex::Buffer              src,
+    vkex::Image               dst,
+    uint32_t                  region_count,
+    const VkBufferImageCopy*  p_regions);
+
+  /** @fn TransitionImageLayout
+   *
+   */
+  void TransitionImageLayout(
+    vkex::Image           image,
+    VkImageLayout         old_layout,
+    VkImageLayout         new_layout,
+    VkPipelineStageFlags  new_pipeline_stage);
+
+  /** @fn Record
+   *
+   * Calls fn with the batch's command buffer when the batch is recorded,
+   * after the operations added before it. Resources fn writes are not
+   * part of an ownership handoff, so it should only be used with batches
+   * submitted on the queue that uses them.
+   *
+   */
+  void Record(std::function<void(vkex::CommandBuffer)> fn);
+
+  /** @fn IsEmpty
+   *
+   */
+  bool IsEmpty() const {
+    return m_operations.empty();
+  }
+
+  /** @fn Clear
+   *
+   */
+  void Clear();
+
+  /** @fn Submit
+   *
+   * Submits everything through the device's upload manager for queue and
+   * clears the batch. Commands submitted to queue afterwards are ordered
+   * after the batch, p_token is only needed to wait on the CPU.
+   *
+   */
+  vkex::Result Submit(vkex::Queue queue, vkex::TransferToken* p_token = nullptr);
+
+  /** @fn Submit
+   *
+   * Submits on queue and hands every image and buffer the batch writes
+   * over to owner_queue, see CUploadManager::Submit. Nothing written by
+   * the batch may be used on owner_queue until the submission that waits
+   * on the handoff.
+   *
+   */
+  vkex::Result Submit(vkex::Queue queue, vkex::Queue owner_queue, vkex::TransferToken* p_token = nullptr);
+
+private:
+  friend class CUploadManager;
+
+  enum OperationType {
+    OPERATION_TYPE_COPY_TO_BUFFER = 0,
+    OPERATION_TYPE_COPY_TO_IMAGE,
+    OPERATION_TYPE_COPY_BUFFER,
+    OPERATION_TYPE_COPY_IMAGE,
+    OPERATION_TYPE_COPY_BUFFER_TO_IMAGE,
+    OPERATION_TYPE_TRANSITION_IMAGE_LAYOUT,
+    OPERATION_TYPE_RECORD,
+  };
+
+  struct Operation {
+    OperationType         type;
+    const void*           p_data;
+    VkDeviceSize          size;
+    VkDeviceSize          dst_offset;
+    vkex::Buffer          src_buffer;
+    vkex::Image           src_image;
+    vkex::Buffer          dst_buffer;
+    vkex::Image           dst_image;
+    // Range in the region vector for the operation's type
+    uint32_t              first_region;
+    uint32_t              region_count;
+    VkImageLayout         old_layout;
+    VkImageLayout         new_layout;
+    VkPipelineStageFlags  new_pipeline_stage;
+    // Index into m_record_fns
+    uint32_t              record_index;
+  };
+
+  std::vector<Operation>          m_operations;
+  std::vector<VkBufferCopy>       m_buffer_copies;
+  std::vector<VkImageCopy>        m_image_copies;
+  std::vector<VkBufferImageCopy>  m_buffer_image_copies;
+  std::vector<std::function<void(vkex::CommandBuffer)>> m_record_fns;
+};
+
+/** @class CUploadManager
+ *
+ * Records uploads and transfer commands for one queue into batches.
+ *
+ * Source data is copied into a persistently mapped CPU_TO_GPU staging ring
+ * and each batch owns a command buffer and a fence, both recycled. A batch
+ * is submitted when Flush() is called or when it runs out of staging
+ * memory, and its part of the ring is reclaimed once its fence signals.
+ * Uploads larger than the ring get a dedicated staging buffer that's
+ * destroyed when the batch retires.
+ *
+ * Every upload ends with a barrier that makes the written data visible to
+ * all later commands on the queue, so work submitted after Flush() doesn't
+ * need to wait on the CPU.
+ *
+ * All functions can be called from any thread, the manager's own state
+ * is guarded by a mutex. Its submits are not synchronized with anything
+ * else submitted to the same queue, the application has to keep its own
+ * submits to that queue from running at the same time as Flush(),
+ * Submit(), WaitIdle() and uploads that run out of staging memory.
+ * Wait() doesn't hold the mutex while it waits on a fence.
+ *
+ */
+class CUploadManager : public IDeviceObject {
+public:
+  CUploadManager();
+  ~CUploadManager();
+
+  /** @fn GetQueue
+   *
+   */
+  vkex::Queue GetQueue() const {
+    return m_create_info.queue;
+  }
+
+  /** @fn GetStagingSize
+   *
+   */
+  VkDeviceSize GetStagingSize() const {
+    return m_create_info.staging_size;
+  }
+
+  /** @fn CopyToBuffer
+   *
+   * Stages size bytes from p_data and copies them to dst at dst_offset.
+   *
+   */
+  vkex::Result CopyToBuffer(
+    VkDeviceSize  size,
+    const void*   p_data,
+    vkex::Buffer  dst,
+    VkDeviceSize  dst_offset = 0);
+
+  /** @fn CopyToImage
+   *
+   * Stages size bytes from p_data and copies them to dst, which must be in
+   * VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL. bufferOffset in each region is
+   * relative to p_data.
+   *
+   */
+  vkex::Result CopyToImage(
+    VkDeviceSize              size,
+    const void*               p_data,
+    vkex::Image               dst,
+    uint32_t                  region_count,
+    const VkBufferImageCopy*  p_regions);
+
+  /** @fn CopyBuffer
+   *
+   * Copies between caller owned resources, src must stay valid until the
+   * batch has completed.
+   *
+   */
+  vkex::Result CopyBuffer(
+    vkex::Buffer        src,
+    vkex::Buffer        dst,
+    uint32_t            region_count,
+    const VkBufferCopy* p_regions);
+
+  /** @fn CopyImage
+   *
+   */
+  vkex::Result CopyImage(
+    vkex::Image         src,
+    vkex::Image         dst,
+    uint32_t            region_count,
+    const VkImageCopy*  p_regions);
+
+  /** @fn CopyBufferToImage
+   *
+   */
+  vkex::Result CopyBufferToImage(
+    vkex::Buffer              src,
+    vkex::Image               dst,
+    uint32_t                  region_count,
+    const VkBufferImageCopy*  p_regions);
+
+  /** @fn TransitionImageLayout
+   *
+   */
+  vkex::Result TransitionImageLayout(
+    vkex::Image           image,
+    VkImageLayout         old_layout,
+    VkImageLayout         new_layout,
+    VkPipelineStageFlags  new_pipeline_stage);
+
+  /** @fn Flush
+   *
+   * Submits the recording batch without waiting for it. Returns the
+   * batch's submission serial in p_serial if it's not null.
+   *
+   */
+  vkex::Result Flush(uint64_t* p_serial = nullptr);
+
+  /** @fn Wait
+   *
+   * Waits until the batch with the given serial has completed.
+   *
+   */
+  vkex::Result Wait(uint64_t serial);
+
+  /** @fn WaitIdle
+   *
+   * Submits the recording batch and waits for every batch to complete.
+   *
+   */
+  vkex::Result WaitIdle();
+
+  /** @fn Submit
+   *
+   * Submits the recording batch, then records transfer_batch into a 
+   * command buffer of its own and submits it. Staging for all of its
+   * uploads is allocated at once.
+   *
+   */
+  vkex::Result Submit(const vkex::TransferBatch& transfer_batch, vkex::TransferToken* p_token = nullptr);
+
+  /** @fn Submit
+   *
+   * Same as above but the submission signals a semaphore and is queued as
+   * a handoff to owner_queue. If owner_queue is in a different queue family
+   * the last layout transition of each image is replaced by a release
+   * barrier that performs it, buffers the batch writes are released as a
+   * whole, and the matching acquire barriers are recorded by
+   * AcquireHandoffs(). Resources created with VK_SHARING_MODE_CONCURRENT
+   * only get the layout transition.
+   *
+   * Stages used by intermediate transitions must be supported by this
+   * manager's queue.
+   *
+   */
+  vkex::Result Submit(
+    const vkex::TransferBatch&  transfer_batch,
+    vkex::Queue                 owner_queue,
+    vkex::TransferToken*        p_token = nullptr);
+
+  /** @fn IsComplete
+   *
+   */
+  bool IsComplete(uint64_t serial);
+
+  /** @fn HasPendingHandoffs
+   *
+   */
+  bool HasPendingHandoffs(vkex::Queue queue);
+
+  /** @fn AcquireHandoffs
+   *
+   * Records the acquire barriers of every pending handoff to queue into
+   * command_buffer and appends the semaphores its submission must wait on
+   * to p_wait_semaphores. The semaphores go back to the manager through
+   * RecycleSemaphores() once that submission has completed.
+   *
+   */
+  vkex::Result AcquireHandoffs(
+    vkex::Queue                   queue,
+    vkex::CommandBuffer           command_buffer,
+    std::vector<vkex::Semaphore>* p_wait_semaphores);
+
+  /** @fn RecycleSemaphores
+   *
+   */
+  void RecycleSemaphores(const std::vector<vkex::Semaphore>& semaphores);
+
+private:
+  friend class CDevice;
+  friend class IObjectStorageFunctions;
+
+  struct Batch {
+    vkex::CommandBuffer       command_buffer = nullptr;
+    vkex::Fence               fence = nullptr;
+    uint64_t                  serial = 0;
+    bool                      recording = false;
+    bool                      submitted = false;
+    // End of this batch's staging in ring offsets, everything before it
+    // is free once the batch retires
+    uint64_t                  staging_end = 0;
+    std::vector<vkex::Buffer> dedicated_buffers;
+  };
+
+  struct Handoff {
+    vkex::Queue                         queue = nullptr;
+    vkex::Semaphore                     semaphore = nullptr;
+    VkPipelineStageFlags                dst_stage_mask = 0;
+    std::vector<VkImageMemoryBarrier>   image_barriers;
+    std::vector<VkBufferMemoryBarrier>  buffer_barriers;
+  };
+
+  /** @fn InternalCreate
+   *
+   */
+  vkex::Result InternalCreate(
+    const vkex::UploadManagerCreateInfo&  create_info,
+    const VkAllocationCallbacks*          p_allocator
+  );
+
+  /** @fn InternalDestroy
+   *
+   */
+  vkex::Result InternalDestroy(const VkAllocationCallbacks* p_allocator);
+
+  // These expect m_mutex to be held
+  vkex::Result  GetRecordingBatch(Batch** pp_batch);
+  vkex::Result  SubmitBatch(Batch* p_batch, vkex::Semaphore signal_semaphore = nullptr);
+  vkex::Result  RetireBatch(Batch* p_batch);
+  vkex::Result  RetireOldestBatch();
+  vkex::Result  AllocateStaging(
+                  VkDeviceSize    size,
+                  VkDeviceSize    alignment,
+                  vkex::Buffer*   p_buffer,
+                  VkDeviceSize*   p_offset,
+                  void**          pp_mapped_address);
+  vkex::Result  GetHandoffSemaphore(vkex::Semaphore* p_semaphore);
+
+private:
+  vkex::UploadManagerCreateInfo   m_create_info = {};
+  vkex::CommandPool               m_command_pool = nullptr;
+  vkex::Buffer                    m_staging_buffer = nullptr;
+  uint8_t*                        m_staging_address = nullptr;
+  // Monotonic ring offsets, the physical offset is modulo staging_size
+  uint64_t                        m_staging_head = 0;
+  uint64_t                        m_staging_tail = 0;
+  std::vector<Batch>              m_batches;
+  uint32_t                        m_batch_index = 0;
+  uint64_t                        m_next_serial = 1;
+  uint64_t                        m_completed_serial = 0;
+  std::vector<Handoff>            m_handoffs;
+  std::vector<vkex::Semaphore>    m_free_semaphores;
+  std::mutex                      m_mutex;
+};
+
+} // namespace vkex
+
+#endif // __VKEX_UPLOAD_MANAGER_H__
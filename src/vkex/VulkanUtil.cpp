@@ -546,6 +546,20 @@ vkex::ComponentType FormatComponentType(VkFormat format)
     case VK_FORMAT_R8G8B8A8_SRGB: return ComponentType::UINT8; break;
     case VK_FORMAT_B8G8R8_SRGB: return ComponentType::UINT8; break;
     case VK_FORMAT_B8G8R8A8_SRGB: return ComponentType::UINT8; break;
+
+    // Block compressed
+    case VK_FORMAT_BC1_RGB_UNORM_BLOCK: return ComponentType::COMPRESSED; break;
+    case VK_FORMAT_BC1_RGB_SRGB_BLOCK: return ComponentType::COMPRESSED; break;
+    case VK_FORMAT_BC1_RGBA_UNORM_BLOCK: return ComponentType::COMPRESSED; break;
+    case VK_FORMAT_BC1_RGBA_SRGB_BLOCK: return ComponentType::COMPRESSED; break;
+    case VK_FORMAT_BC3_UNORM_BLOCK: return ComponentType::COMPRESSED; break;
+    case VK_FORMAT_BC3_SRGB_BLOCK: return ComponentType::COMPRESSED; break;
+    case VK_FORMAT_BC4_UNORM_BLOCK: return ComponentType::COMPRESSED; break;
+    case VK_FORMAT_BC4_SNORM_BLOCK: return ComponentType::COMPRESSED; break;
+    case VK_FORMAT_BC5_UNORM_BLOCK: return ComponentType::COMPRESSED; break;
+    case VK_FORMAT_BC5_SNORM_BLOCK: return ComponentType::COMPRESSED; break;
+    case VK_FORMAT_BC7_UNORM_BLOCK: return ComponentType::COMPRESSED; break;
+    case VK_FORMAT_BC7_SRGB_BLOCK: return ComponentType::COMPRESSED; break;
   }
   return ComponentType::UNDEFINED;
 }
@@ -678,6 +692,20 @@ uint32_t FormatComponentCount(VkFormat format)
     case VK_FORMAT_R8G8B8A8_SRGB: return 4; break;
     case VK_FORMAT_B8G8R8_SRGB: return 3; break;
     case VK_FORMAT_B8G8R8A8_SRGB: return 4; break;
+
+    // Block compressed
+    case VK_FORMAT_BC1_RGB_UNORM_BLOCK: return 3; break;
+    case VK_FORMAT_BC1_RGB_SRGB_BLOCK: return 3; break;
+    case VK_FORMAT_BC1_RGBA_UNORM_BLOCK: return 4; break;
+    case VK_FORMAT_BC1_RGBA_SRGB_BLOCK: return 4; break;
+    case VK_FORMAT_BC3_UNORM_BLOCK: return 4; break;
+    case VK_FORMAT_BC3_SRGB_BLOCK: return 4; break;
+    case VK_FORMAT_BC4_UNORM_BLOCK: return 1; break;
+    case VK_FORMAT_BC4_SNORM_BLOCK: return 1; break;
+    case VK_FORMAT_BC5_UNORM_BLOCK: return 2; break;
+    case VK_FORMAT_BC5_SNORM_BLOCK: return 2; break;
+    case VK_FORMAT_BC7_UNORM_BLOCK: return 4; break;
+    case VK_FORMAT_BC7_SRGB_BLOCK: return 4; break;
   }
   return 0;
 }
@@ -690,6 +718,42 @@ uint32_t FormatSize(VkFormat format)
   return size;
 }
 
+bool FormatIsBlockCompressed(VkFormat format)
+{
+  vkex::ComponentType component_type = FormatComponentType(format);
+  return (component_type == vkex::ComponentType::COMPRESSED);
+}
+
+uint32_t FormatBlockWidth(VkFormat format)
+{
+  return FormatIsBlockCompressed(format) ? 4 : 1;
+}
+
+uint32_t FormatBlockHeight(VkFormat format)
+{
+  return FormatIsBlockCompressed(format) ? 4 : 1;
+}
+
+uint32_t FormatBlockSize(VkFormat format)
+{
+  switch (format) {
+    default: break;
+    case VK_FORMAT_BC1_RGB_UNORM_BLOCK: return 8; break;
+    case VK_FORMAT_BC1_RGB_SRGB_BLOCK: return 8; break;
+    case VK_FORMAT_BC1_RGBA_UNORM_BLOCK: return 8; break;
+    case VK_FORMAT_BC1_RGBA_SRGB_BLOCK: return 8; break;
+    case VK_FORMAT_BC3_UNORM_BLOCK: return 16; break;
+    case VK_FORMAT_BC3_SRGB_BLOCK: return 16; break;
+    case VK_FORMAT_BC4_UNORM_BLOCK: return 8; break;
+    case VK_FORMAT_BC4_SNORM_BLOCK: return 8; break;
+    case VK_FORMAT_BC5_UNORM_BLOCK: return 16; break;
+    case VK_FORMAT_BC5_SNORM_BLOCK: return 16; break;
+    case VK_FORMAT_BC7_UNORM_BLOCK: return 16; break;
+    case VK_FORMAT_BC7_SRGB_BLOCK: return 16; break;
+  }
+  return FormatSize(format);
+}
+
 VkClearValue ClearColorValue(float r, float g, float b, float a)
 {
   VkClearValue value = {};
@@ -727,67 +791,24 @@ vkex::Result TransitionImageLayout(
   }
 
   VKEX_ASSERT(image != nullptr);
-  if (queue == nullptr) {
+  if (image == nullptr) {
     return vkex::Result::ErrorUnexpectedNullPointer;
   }
 
-  // Grab device
-  vkex::Device device = queue->GetDevice();
-  // Create command pool
-  vkex::CommandPool command_pool = nullptr;
-  {
-    vkex::CommandPoolCreateInfo create_info = {};
-    create_info.flags.bits.transient        = true;
-    vkex::Result vkex_result                = device->CreateCommandPool(create_info, &command_pool);
-    if (vkex_result != vkex::Result::Success) {
-      return vkex_result;
-    }
-  }
-  // Allocate command buffer
-  vkex::CommandBuffer command_buffer = nullptr;
-  {
-    vkex::CommandBufferAllocateInfo allocate_info = {};
-    allocate_info.command_buffer_count            = 1;
-    vkex::Result vkex_result = command_pool->AllocateCommandBuffer(allocate_info, &command_buffer);
-    if (vkex_result != vkex::Result::Success) {
-      return vkex_result;
-    }
+  vkex::UploadManager upload_manager = nullptr;
+  vkex::Result vkex_result = queue->GetDevice()->GetUploadManager(queue, &upload_manager);
+  if (!vkex_result) {
+    return vkex_result;
   }
 
-  // Build command buffer
-  {
-    VkCommandBufferBeginInfo begin_info = {};
-    begin_info.flags                    = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
-    // Begin command buffer
-    vkex::Result vkex_result = command_buffer->Begin();
-    VKEX_ASSERT(vkex_result == vkex::Result::Success);
-    // Commands
-    {
-      command_buffer->CmdTransitionImageLayout(*image, image->GetAspectFlags(), 0, image->GetMipLevels(), 0, image->GetArrayLayers(), old_layout, new_layout, new_pipeline_stage);
-    }
-    // End command buffer
-    vkex_result = command_buffer->End();
-    VKEX_ASSERT(vkex_result == vkex::Result::Success);
+  vkex_result = upload_manager->TransitionImageLayout(image, old_layout, new_layout, new_pipeline_stage);
+  if (!vkex_result) {
+    return vkex_result;
   }
 
-  // Submit info
-  VkCommandBuffer vk_command_buffer = command_buffer->GetVkObject();
-  VkSubmitInfo    vk_submit_info    = {VK_STRUCTURE_TYPE_SUBMIT_INFO};
-  vk_submit_info.commandBufferCount = 1;
-  vk_submit_info.pCommandBuffers    = &vk_command_buffer;
-  // Queue submit
-  VkResult vk_result = vkex::QueueSubmit(queue->GetVkObject(), 1, &vk_submit_info, VK_NULL_HANDLE);
-  VKEX_ASSERT(vk_result == VK_SUCCESS);
-
-  // Wait for queue to be done
-  vk_result = queue->WaitIdle();
-  VKEX_ASSERT(vk_result == VK_SUCCESS);
-
-  // Free command buffers
-  command_pool->FreeCommandBuffer(command_buffer);
-  // Destroy command pool
-  vkex::Result vkex_result = device->DestroyCommandPool(command_pool);
-  if (vkex_result != vkex::Result::Success) {
+  // Later submissions on the queue are ordered after the barrier
+  vkex_result = upload_manager->Flush();
+  if (!vkex_result) {
     return vkex_result;
   }
 
@@ -807,7 +828,7 @@ vkex::Result TransitionImageLayout(
   }
 
   VKEX_ASSERT(texture != nullptr);
-  if (queue == nullptr) {
+  if (texture == nullptr) {
     return vkex::Result::ErrorUnexpectedNullPointer;
   }
 
@@ -819,6 +840,25 @@ vkex::Result TransitionImageLayout(
 // =================================================================================================
 // Buffer/Image Copy Functions
 // =================================================================================================
+
+// Submits the upload manager's batch and waits for it, the source is
+// owned by the caller and may be destroyed as soon as this returns.
+static vkex::Result FlushAndWait(vkex::UploadManager upload_manager)
+{
+  uint64_t serial = 0;
+  vkex::Result vkex_result = upload_manager->Flush(&serial);
+  if (!vkex_result) {
+    return vkex_result;
+  }
+
+  vkex_result = upload_manager->Wait(serial);
+  if (!vkex_result) {
+    return vkex_result;
+  }
+
+  return vkex::Result::Success;
+}
+
 vkex::Result CopyResource(
   vkex::Queue         queue,
   vkex::Buffer        src,
@@ -826,85 +866,23 @@ vkex::Result CopyResource(
   uint32_t            region_count,
   const VkBufferCopy* p_regions)
 {
-  // Grab device
-  vkex::Device device = queue->GetDevice();
-  // Create command pool
-  vkex::CommandPool command_pool = nullptr;
-  {
-    vkex::CommandPoolCreateInfo create_info = {};
-    create_info.flags.bits.transient        = true;
-    vkex::Result vkex_result                = device->CreateCommandPool(create_info, &command_pool);
-    if (vkex_result != vkex::Result::Success) {
-      return vkex_result;
-    }
-  }
-
-  // Allocate command buffer
-  vkex::CommandBuffer command_buffer = nullptr;
-  {
-    vkex::CommandBufferAllocateInfo allocate_info = {};
-    allocate_info.command_buffer_count            = 1;
-    vkex::Result vkex_result = command_pool->AllocateCommandBuffer(allocate_info, &command_buffer);
-    VKEX_ASSERT(vkex_result == vkex::Result::Success);
-    if (vkex_result != vkex::Result::Success) {
-      return vkex_result;
-    }
-  }
-
-  // Build command buffer
-  {
-    VkCommandBufferBeginInfo begin_info = {};
-    begin_info.flags                    = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
-    // Begin command buffer
-    vkex::Result vkex_result = command_buffer->Begin();
-    VKEX_ASSERT(vkex_result == vkex::Result::Success);
-    if (vkex_result != vkex::Result::Success) {
-      return vkex_result;
-    }
-    // Commands
-    {
-      command_buffer->CmdCopyBuffer(
-        src->GetVkObject(),
-        dst->GetVkObject(),
-        region_count,
-        p_regions);
-    }
-    // End command buffer
-    vkex_result = command_buffer->End();
-    VKEX_ASSERT(vkex_result == vkex::Result::Success);
-    if (vkex_result != vkex::Result::Success) {
-      return vkex_result;
-    }
-  }
-
-  // Submit info
-  VkCommandBuffer vk_command_buffer = command_buffer->GetVkObject();
-  VkSubmitInfo    vk_submit_info    = {VK_STRUCTURE_TYPE_SUBMIT_INFO};
-  vk_submit_info.commandBufferCount = 1;
-  vk_submit_info.pCommandBuffers    = &vk_command_buffer;
-  // Queue submit
-  VkResult vk_result = vkex::QueueSubmit(queue->GetVkObject(), 1, &vk_submit_info, VK_NULL_HANDLE);
-  VKEX_ASSERT(vk_result == VK_SUCCESS);
-  if (vk_result != VK_SUCCESS) {
-    return vkex::Result(vk_result);
+  VKEX_ASSERT(queue != nullptr);
+  if (queue == nullptr) {
+    return vkex::Result::ErrorUnexpectedNullPointer;
   }
 
-  // Wait for queue to be done
-  vk_result = queue->WaitIdle();
-  VKEX_ASSERT(vk_result == VK_SUCCESS);
-  if (vk_result != VK_SUCCESS) {
-    return vkex::Result(vk_result);
+  vkex::UploadManager upload_manager = nullptr;
+  vkex::Result vkex_result = queue->GetDevice()->GetUploadManager(queue, &upload_manager);
+  if (!vkex_result) {
+    return vkex_result;
   }
 
-  // Free command buffers
-  command_pool->FreeCommandBuffer(command_buffer);
-  // Destroy command pool
-  vkex::Result vkex_result = device->DestroyCommandPool(command_pool);
-  if (vkex_result != vkex::Result::Success) {
+  vkex_result = upload_manager->CopyBuffer(src, dst, region_count, p_regions);
+  if (!vkex_result) {
     return vkex_result;
   }
 
-  return vkex::Result::Success;
+  return FlushAndWait(upload_manager);
 }
 
 vkex::Result CopyResource(
@@ -913,56 +891,28 @@ vkex::Result CopyResource(
   const void*         p_src_data,
   vkex::Buffer        dst)
 {
-  // Grab device
-  vkex::Device device = queue->GetDevice();
-  // Create temporary buffer
-  vkex::Buffer src_buffer = nullptr;
-  {
-    vkex::BufferCreateInfo create_info        = {};
-    create_info.size                          = src_size;
-    create_info.usage_flags.bits.transfer_src = true;
-    create_info.committed                     = true;
-    create_info.memory_usage                  = VMA_MEMORY_USAGE_CPU_TO_GPU;
-    vkex::Result result = device->CreateBuffer(create_info, &src_buffer);
-    if (!result) {
-      return result;
-    }
+  VKEX_ASSERT(queue != nullptr);
+  if (queue == nullptr) {
+    return vkex::Result::ErrorUnexpectedNullPointer;
   }
-  // Copy source data
-  {
-    vkex::Result result = src_buffer->Copy(src_size, p_src_data);
-    if (!result) {
-      // Destroy temporary buffer
-      if (src_buffer != nullptr) {
-        vkex::Result result = device->DestroyBuffer(src_buffer);
-        if (!result) {
-          // @TODO: Warn!
-        }
-      }
-      return result;
-    }
+
+  vkex::UploadManager upload_manager = nullptr;
+  vkex::Result vkex_result = queue->GetDevice()->GetUploadManager(queue, &upload_manager);
+  if (!vkex_result) {
+    return vkex_result;
   }
-  // Copy buffer
-  {
-    VkBufferCopy region = {};
-     region.srcOffset = 0;
-     region.dstOffset = 0;
-     region.size      = src_size;
-
-    vkex::Result result = CopyResource(
-      queue,
-      src_buffer,
-      dst,
-      1,
-      &region);
+
+  vkex_result = upload_manager->CopyToBuffer(src_size, p_src_data, dst);
+  if (!vkex_result) {
+    return vkex_result;
   }
-  // Destroy temporary buffer
-  if (src_buffer != nullptr) {
-    vkex::Result result = device->DestroyBuffer(src_buffer);
-    if (!result) {
-      // @TODO: Warn!
-    }
+
+  // The data has already been staged so there's nothing to wait for
+  vkex_result = upload_manager->Flush();
+  if (!vkex_result) {
+    return vkex_result;
   }
+
   return vkex::Result::Success;
 }
 
@@ -973,73 +923,23 @@ vkex::Result CopyResource(
   uint32_t           region_count,
   const VkImageCopy* p_regions)
 {
-  // Grab device
-  vkex::Device device = queue->GetDevice();
-  // Create command pool
-  vkex::CommandPool command_pool = nullptr;
-  {
-    vkex::CommandPoolCreateInfo create_info = {};
-    create_info.flags.bits.transient        = true;
-    vkex::Result vkex_result                = device->CreateCommandPool(create_info, &command_pool);
-    if (vkex_result != vkex::Result::Success) {
-      return vkex_result;
-    }
-  }
-  // Allocate command buffer
-  vkex::CommandBuffer command_buffer = nullptr;
-  {
-    vkex::CommandBufferAllocateInfo allocate_info = {};
-    allocate_info.command_buffer_count            = 1;
-    vkex::Result vkex_result = command_pool->AllocateCommandBuffer(allocate_info, &command_buffer);
-    if (vkex_result != vkex::Result::Success) {
-      return vkex_result;
-    }
+  VKEX_ASSERT(queue != nullptr);
+  if (queue == nullptr) {
+    return vkex::Result::ErrorUnexpectedNullPointer;
   }
 
-  // Build command buffer
-  {
-    VkCommandBufferBeginInfo begin_info = {};
-    begin_info.flags                    = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
-    // Begin command buffer
-    vkex::Result vkex_result = command_buffer->Begin();
-    VKEX_ASSERT(vkex_result == vkex::Result::Success);
-    // Commands
-    {
-      command_buffer->CmdCopyImage(
-        src->GetVkObject(),
-        VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
-        dst->GetVkObject(),
-        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-        region_count,
-        p_regions);
-    }
-    // End command buffer
-    vkex_result = command_buffer->End();
-    VKEX_ASSERT(vkex_result == vkex::Result::Success);
+  vkex::UploadManager upload_manager = nullptr;
+  vkex::Result vkex_result = queue->GetDevice()->GetUploadManager(queue, &upload_manager);
+  if (!vkex_result) {
+    return vkex_result;
   }
 
-  // Submit info
-  VkCommandBuffer vk_command_buffer = command_buffer->GetVkObject();
-  VkSubmitInfo    vk_submit_info    = {VK_STRUCTURE_TYPE_SUBMIT_INFO};
-  vk_submit_info.commandBufferCount = 1;
-  vk_submit_info.pCommandBuffers    = &vk_command_buffer;
-  // Queue submit
-  VkResult vk_result = vkex::QueueSubmit(queue->GetVkObject(), 1, &vk_submit_info, VK_NULL_HANDLE);
-  VKEX_ASSERT(vk_result == VK_SUCCESS);
-
-  // Wait for queue to be done
-  vk_result = queue->WaitIdle();
-  VKEX_ASSERT(vk_result == VK_SUCCESS);
-
-  // Free command buffers
-  command_pool->FreeCommandBuffer(command_buffer);
-  // Destroy command pool
-  vkex::Result vkex_result = device->DestroyCommandPool(command_pool);
-  if (vkex_result != vkex::Result::Success) {
+  vkex_result = upload_manager->CopyImage(src, dst, region_count, p_regions);
+  if (!vkex_result) {
     return vkex_result;
   }
 
-  return vkex::Result::Success;
+  return FlushAndWait(upload_manager);
 }
 
 vkex::Result CopyResource(
@@ -1049,87 +949,23 @@ vkex::Result CopyResource(
   uint32_t                 region_count,
   const VkBufferImageCopy* p_regions)
 {
-  // Grab device
-  vkex::Device device = queue->GetDevice();
-  // Create command pool
-  vkex::CommandPool command_pool = nullptr;
-  {
-    vkex::CommandPoolCreateInfo create_info = {};
-    create_info.flags.bits.transient        = true;
-    vkex::Result vkex_result = device->CreateCommandPool(create_info, &command_pool);
-    VKEX_ASSERT(vkex_result == vkex::Result::Success);
-    if (!vkex_result) {
-      return vkex_result;
-    }
-  }
-  // Allocate command buffer
-  vkex::CommandBuffer command_buffer = nullptr;
-  {
-    vkex::CommandBufferAllocateInfo allocate_info = {};
-    allocate_info.command_buffer_count            = 1;
-    vkex::Result vkex_result = command_pool->AllocateCommandBuffer(allocate_info, &command_buffer);
-    VKEX_ASSERT(vkex_result == vkex::Result::Success);
-    if (!vkex_result) {
-      return vkex_result;
-    }
-  }
-
-  // Build command buffer
-  {
-    VkCommandBufferBeginInfo begin_info = {};
-    begin_info.flags                    = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
-    // Begin command buffer
-    vkex::Result vkex_result = command_buffer->Begin();
-    VKEX_ASSERT(vkex_result == vkex::Result::Success);
-    if (!vkex_result) {
-      return vkex_result;
-    }
-    // Commands
-    {
-      command_buffer->CmdCopyBufferToImage(
-        src->GetVkObject(),
-        dst->GetVkObject(),
-        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-        region_count,
-        p_regions);
-    }
-    // End command buffer
-    vkex_result = command_buffer->End();
-    VKEX_ASSERT(vkex_result == vkex::Result::Success);
-    if (!vkex_result) {
-      return vkex_result;
-    }
-  }
-
-  // Submit info
-  VkCommandBuffer vk_command_buffer = command_buffer->GetVkObject();
-  VkSubmitInfo    vk_submit_info    = {VK_STRUCTURE_TYPE_SUBMIT_INFO};
-  vk_submit_info.commandBufferCount = 1;
-  vk_submit_info.pCommandBuffers    = &vk_command_buffer;
-  // Queue submit
-  VkResult vk_result = vkex::QueueSubmit(queue->GetVkObject(), 1, &vk_submit_info, VK_NULL_HANDLE);
-  VKEX_ASSERT(vk_result == VK_SUCCESS);
-  if (vk_result != VK_SUCCESS) {
-    return vkex::Result(vk_result);
+  VKEX_ASSERT(queue != nullptr);
+  if (queue == nullptr) {
+    return vkex::Result::ErrorUnexpectedNullPointer;
   }
 
-  // Wait for queue to be done
-  vk_result = queue->WaitIdle();
-  VKEX_ASSERT(vk_result == VK_SUCCESS);
-  if (vk_result != VK_SUCCESS) {
-    return vkex::Result(vk_result);
+  vkex::UploadManager upload_manager = nullptr;
+  vkex::Result vkex_result = queue->GetDevice()->GetUploadManager(queue, &upload_manager);
+  if (!vkex_result) {
+    return vkex_result;
   }
 
-  // Free command buffers
-  command_pool->FreeCommandBuffer(command_buffer);
-  // Destroy command pool
-  vkex::Result vkex_result = device->DestroyCommandPool(command_pool);
-  VKEX_ASSERT(vkex_result == vkex::Result::Success);
-  if (vkex_result != vkex::Result::Success) {
+  vkex_result = upload_manager->CopyBufferToImage(src, dst, region_count, p_regions);
+  if (!vkex_result) {
     return vkex_result;
   }
 
-  return vkex::Result::Success;
+  return FlushAndWait(upload_manager);
 }
 
 } // namespace vkex
\ No newline at end of file
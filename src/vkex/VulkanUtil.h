@@ -953,6 +953,32 @@ uint32_t FormatComponentCount(VkFormat format);
  */
 uint32_t FormatSize(VkFormat format);
 
+/** @fn FormatIsBlockCompressed
+ *
+ */
+bool FormatIsBlockCompressed(VkFormat format);
+
+/** @fn FormatBlockWidth
+ *
+ * Width of a block in texels, 1 for uncompressed formats.
+ *
+ */
+uint32_t FormatBlockWidth(VkFormat format);
+
+/** @fn FormatBlockHeight
+ *
+ * Height of a block in texels, 1 for uncompressed formats.
+ *
+ */
+uint32_t FormatBlockHeight(VkFormat format);
+
+/** @fn FormatBlockSize
+ *
+ * Size of a block in bytes, same as FormatSize() for uncompressed formats.
+ *
+ */
+uint32_t FormatBlockSize(VkFormat format);
+
 /** @fn ClearColorValue
  *
  */
@@ -966,6 +992,11 @@ VkClearValue ClearDepthStencilValue(float depth = 1.0f, uint32_t stencil = 0xFF)
 // =================================================================================================
 // Image Layout Transition Functions
 // =================================================================================================
+//
+// These record into the device's upload manager for queue and submit
+// without waiting, commands submitted to the queue afterwards see the new
+// layout.
+//
 vkex::Result TransitionImageLayout(
   vkex::Queue          queue,
   vkex::Image          image,
@@ -983,6 +1014,11 @@ vkex::Result TransitionImageLayout(
 // =================================================================================================
 // Buffer/Image Copy Functions
 // =================================================================================================
+//
+// These go through the device's upload manager for queue. Copies from
+// caller owned resources wait for the copy to complete, uploads from
+// p_src_data are staged in the upload manager's ring and only submitted.
+//
 vkex::Result CopyResource(
   vkex::Queue         queue,
   vkex::Buffer        src,
@@ -19,10 +19,12 @@
 
 #include <vkex/Application.h>
 #include <vkex/Buffer.h>
+#include <vkex/BufferHeap.h>
 #include <vkex/Command.h>
 #include <vkex/Config.h>
 #include <vkex/Descriptor.h>
 #include <vkex/Device.h>
+#include <vkex/HostAllocator.h>
 #include <vkex/Image.h>
 #include <vkex/Instance.h>
 #include <vkex/Pipeline.h>